@@ -0,0 +1,87 @@
+#include "airtime.h"
+#include <core.h>
+
+namespace Airtime {
+
+    // Airtime used in each slot of the sliding window, in us. The current slot is only partly
+    // elapsed, so the slot before the window is kept as well : the whole last hour is always
+    // accounted for, along with up to one slot of older traffic.
+    const int N_KEPT_SLOTS = N_SLOTS + 1;
+    uint32_t _slots[N_KEPT_SLOTS] = {0};
+    int _currentSlot = 0;
+    Core::Time _tCurrentSlot = 0;
+
+    // Internal functions
+    void update();
+
+
+    // Account for a transmission of the given duration, in us
+    void record(uint32_t airtime) {
+        update();
+        _slots[_currentSlot] += airtime;
+    }
+
+    // Airtime used during the last WINDOW, in us, possibly with some of the slot before it
+    uint32_t used() {
+        update();
+        uint32_t total = 0;
+        for (int i = 0; i < N_KEPT_SLOTS; i++) {
+            total += _slots[i];
+        }
+        return total;
+    }
+
+    // Airtime still available in the current window, in us
+    uint32_t remaining() {
+        uint32_t u = used();
+        if (u >= BUDGET) {
+            return 0;
+        }
+        return BUDGET - u;
+    }
+
+    // Check if a transmission of the given duration fits into the budget.
+    // Triggers may use the whole budget, while other frames must leave
+    // TRIGGER_RESERVE untouched.
+    bool allowed(uint32_t airtime, Priority priority) {
+        uint32_t r = remaining();
+        if (priority != Priority::TRIGGER) {
+            if (r < TRIGGER_RESERVE) {
+                return false;
+            }
+            r -= TRIGGER_RESERVE;
+        }
+        return airtime <= r;
+    }
+
+    // Delay between two hold keepalives : nominalDelay while the budget is comfortable,
+    // then stretched linearly up to maxDelay as the budget gets close to the reserve
+    unsigned long keepaliveDelay(unsigned long nominalDelay, unsigned long maxDelay) {
+        uint32_t r = remaining();
+        if (r >= THROTTLE_THRESHOLD) {
+            return nominalDelay;
+        } else if (r <= TRIGGER_RESERVE) {
+            return maxDelay;
+        }
+        uint64_t ratio = ((uint64_t)(THROTTLE_THRESHOLD - r) << 16) / (THROTTLE_THRESHOLD - TRIGGER_RESERVE);
+        return nominalDelay + (((maxDelay - nominalDelay) * ratio) >> 16);
+    }
+
+    // Slide the window, clearing the slots that went out of it
+    void update() {
+        Core::Time t = Core::time();
+        if (t >= _tCurrentSlot + SLOT_DURATION + WINDOW) {
+            // Nothing was sent for a whole window
+            for (int i = 0; i < N_KEPT_SLOTS; i++) {
+                _slots[i] = 0;
+            }
+            _tCurrentSlot = t - (t - _tCurrentSlot) % SLOT_DURATION;
+        }
+        while (t >= _tCurrentSlot + SLOT_DURATION) {
+            _currentSlot = (_currentSlot + 1) % N_KEPT_SLOTS;
+            _slots[_currentSlot] = 0;
+            _tCurrentSlot += SLOT_DURATION;
+        }
+    }
+
+}
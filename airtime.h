@@ -0,0 +1,37 @@
+#ifndef _AIRTIME_H_
+#define _AIRTIME_H_
+
+#include <stdint.h>
+
+// Radio duty-cycle accounting
+// ETSI EN 300 220 limits the time spent transmitting in the 868MHz sub-bands,
+// measured over a sliding window of one hour. The limit depends on the sub-band
+// (0.1% to 10%) ; 1% is the most common one and is used here as a safe default.
+namespace Airtime {
+
+    const unsigned long WINDOW = 3600000; // ms, 1 hour
+    const int N_SLOTS = 60;
+    const unsigned long SLOT_DURATION = WINDOW / N_SLOTS; // ms
+    const int DUTY_CYCLE_PERMIL = 10; // 1%
+    const uint32_t BUDGET = WINDOW * DUTY_CYCLE_PERMIL; // us
+
+    // The last part of the budget is reserved for trigger commands, and keepalives
+    // are sent less often when the remaining budget drops under THROTTLE_THRESHOLD
+    const uint32_t TRIGGER_RESERVE = BUDGET / 10; // us
+    const uint32_t THROTTLE_THRESHOLD = BUDGET / 2; // us
+
+    enum class Priority {
+        TRIGGER,
+        SETTINGS,
+        KEEPALIVE,
+    };
+
+    void record(uint32_t airtime);
+    uint32_t used();
+    uint32_t remaining();
+    bool allowed(uint32_t airtime, Priority priority);
+    unsigned long keepaliveDelay(unsigned long nominalDelay, unsigned long maxDelay);
+
+}
+
+#endif
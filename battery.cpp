@@ -0,0 +1,85 @@
+#include "battery.h"
+#include <gpio.h>
+#include <adc.h>
+#include <timers.h>
+#include "discharge.h"
+#include "pins.h"
+
+namespace Battery {
+
+    uint16_t _samples[N_SAMPLES];
+    volatile bool _measured = false;
+
+    // Internal functions
+    void measTimerHandler();
+    void settledHandler();
+    void acquisitionHandler();
+
+
+    void init() {
+        GPIO::enableOutput(PIN_VBAT_MEAS_CMD, GPIO::LOW);
+        ADC::setPin(ADC_VBAT, PIN_VBAT_MEAS);
+        ADC::enable(ADC_VBAT);
+        Timers::startAt(1000, measTimerHandler, MEAS_PERIOD);
+    }
+
+    // Called from the timer interrupt : enable the divider and wait for it to settle
+    void measTimerHandler() {
+        if (ADC::isAcquisitionRunning()) {
+            return;
+        }
+        GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::HIGH);
+        if (Timers::start(SETTLING_DELAY, settledHandler) == Timers::INVALID) {
+            GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::LOW);
+        }
+    }
+
+    void settledHandler() {
+        if (!ADC::startAcquisition(ADC_VBAT, _samples, N_SAMPLES, SAMPLING_FREQUENCY, acquisitionHandler)) {
+            GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::LOW);
+        }
+    }
+
+    // Called from the DMA interrupt when all the samples have been copied
+    void acquisitionHandler() {
+        GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::LOW);
+        _measured = true;
+    }
+
+    // Average the last burst of samples, if any, and update the estimates.
+    // Return true if a new measurement was available.
+    bool update(Core::Time t) {
+        if (!_measured) {
+            return false;
+        }
+        _measured = false;
+        int sum = 0;
+        for (int i = 0; i < N_SAMPLES; i++) {
+            sum += _samples[i];
+        }
+        Discharge::update(t, DIVIDER_RATIO * ADC::toMillivolts(sum) / N_SAMPLES);
+        return true;
+    }
+
+    // The power profile (radio mode, wake interval...) changes the discharge rate
+    void setProfile(int profile) {
+        Discharge::setProfile(profile);
+    }
+
+    // Filtered battery voltage (mV)
+    int voltage() {
+        return Discharge::voltage();
+    }
+
+    // Percent, or -1 before the first measurement
+    int level() {
+        int soc = Discharge::stateOfCharge();
+        return soc == Discharge::UNKNOWN ? -1 : soc / 10;
+    }
+
+    // Minutes left at the current power profile, or -1 if unknown
+    long minutesLeft() {
+        return Discharge::remainingMinutes();
+    }
+
+}
@@ -0,0 +1,29 @@
+#ifndef _BATTERY_H_
+#define _BATTERY_H_
+
+#include <stdint.h>
+#include <core.h>
+
+// Asynchronous battery measurement
+// A periodic timer enables the voltage divider, then starts a burst of conversions after it has
+// settled : the ADC internal timer triggers them and the DMA copies the results, so the main loop
+// never waits for the measurement. The samples are averaged, then fed to the discharge model
+// (see discharge.h) which estimates the state of charge and the remaining runtime.
+namespace Battery {
+
+    const unsigned long MEAS_PERIOD = 10000; // ms
+    const unsigned long SETTLING_DELAY = 10; // ms, after the divider is enabled
+    const int N_SAMPLES = 16; // Oversampling
+    const unsigned long SAMPLING_FREQUENCY = 10000; // Hz
+    const int DIVIDER_RATIO = 2;
+
+    void init();
+    bool update(Core::Time t);
+    void setProfile(int profile);
+    int voltage();
+    int level();
+    long minutesLeft();
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "buttons.h"
+#include <core.h>
+#include <gpio.h>
+#include <timers.h>
+#include <Queue.h>
+#include "pins.h"
+
+namespace Buttons {
+
+    struct Config {
+        GPIO::Pin pin;
+        bool activeHigh; // The power button has an external pull-down, the others are pulled up
+        bool repeat; // For the value editors
+    };
+
+    // In the order of Button
+    const Config CONFIGS[N_BUTTONS] = {
+        {PIN_BTN_UP, false, true},
+        {PIN_BTN_DOWN, false, true},
+        {PIN_BTN_LEFT, false, false},
+        {PIN_BTN_RIGHT, false, false},
+        {PIN_BTN_OK, false, false},
+        {PIN_BTN_PW, true, false},
+        {PIN_BTN_FOCUS, false, false},
+        {PIN_BTN_TRIGGER, false, false},
+    };
+
+    Debounce::Button _buttons[N_BUTTONS];
+    volatile int _pollTimer = Timers::INVALID;
+
+    // Pushed from the GPIO interrupt and from the timer interrupt, but always with the interrupts
+    // disabled, so there is a single producer at a time
+    Queue<Event, 16> _events;
+
+    // Internal functions
+    void edgeHandler();
+    void pollHandler();
+    bool read(int button);
+    void push(int button, Debounce::Transition transition, uint64_t t);
+
+
+    void init() {
+        uint32_t now = Core::time();
+        for (int i = 0; i < N_BUTTONS; i++) {
+            GPIO::enableInput(CONFIGS[i].pin, CONFIGS[i].activeHigh ? GPIO::Pulling::NONE : GPIO::Pulling::PULLUP);
+            Debounce::init(_buttons[i], read(i), CONFIGS[i].repeat, now);
+        }
+        for (int i = 0; i < N_BUTTONS; i++) {
+            GPIO::enableInterrupt(CONFIGS[i].pin, edgeHandler, GPIO::Trigger::CHANGE, true);
+        }
+    }
+
+    // Oldest event not yet handled, if any
+    bool next(Event& event) {
+        return _events.pop(event);
+    }
+
+    // Debounced state
+    bool isPressed(Button button) {
+        return _buttons[static_cast<int>(button)].pressed;
+    }
+
+    // Number of events lost because the main loop did not handle them in time
+    unsigned int overflows() {
+        return _events.overflows();
+    }
+
+    // Called on both edges of every button : the pins which changed are found by comparing them
+    // with their last known state
+    void edgeHandler() {
+        // Critical section, shared with the timer handler
+        Core::disableInterrupts();
+        uint64_t t = Core::time();
+        for (int i = 0; i < N_BUTTONS; i++) {
+            bool pressed = read(i);
+            if (pressed != _buttons[i].level) {
+                push(i, Debounce::edge(_buttons[i], pressed, t), t);
+            }
+        }
+        bool startTimer = _pollTimer == Timers::INVALID;
+        Core::enableInterrupts();
+
+        // The timer is started out of the critical section because Timers has its own
+        if (startTimer) {
+            _pollTimer = Timers::start(POLL_PERIOD, pollHandler, true);
+        }
+    }
+
+    // Called periodically while a button is not idle. The pins are read again in case the
+    // interrupt of an edge was missed, when both edges of a glitch happened before it was served.
+    void pollHandler() {
+        // Critical section, shared with the edge handler
+        Core::disableInterrupts();
+        uint64_t t = Core::time();
+        bool idle = true;
+        for (int i = 0; i < N_BUTTONS; i++) {
+            Debounce::Button& button = _buttons[i];
+            bool pressed = read(i);
+            if (pressed != button.level) {
+                push(i, Debounce::edge(button, pressed, t), t);
+            }
+            push(i, Debounce::poll(button, t), t);
+            idle = idle && Debounce::isIdle(button, t);
+        }
+        int timer = Timers::INVALID;
+        if (idle) {
+            timer = _pollTimer;
+            _pollTimer = Timers::INVALID;
+        }
+        Core::enableInterrupts();
+
+        // An edge which happens now starts a new timer
+        if (timer != Timers::INVALID) {
+            Timers::cancel(timer);
+        }
+    }
+
+    bool read(int button) {
+        return GPIO::get(CONFIGS[button].pin) == CONFIGS[button].activeHigh;
+    }
+
+    void push(int button, Debounce::Transition transition, uint64_t t) {
+        if (transition != Debounce::Transition::NONE) {
+            _events.push({static_cast<Button>(button), transition, t});
+        }
+    }
+
+}
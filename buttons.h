@@ -0,0 +1,42 @@
+#ifndef _BUTTONS_H_
+#define _BUTTONS_H_
+
+#include <stdint.h>
+#include "debounce.h"
+
+// Push buttons
+// Each edge of a button triggers a GPIO interrupt, with the glitch filter enabled, and is
+// debounced in the handler (see debounce.h). The presses, releases and auto-repeats are queued
+// with their time, so that the main loop handles all of them in order even when an iteration
+// was long (screen refresh, radio transmission...). A periodic timer only runs while a button is
+// held or bouncing, to end the debouncing lockout and to time the repeats.
+namespace Buttons {
+
+    enum class Button : uint8_t {
+        UP,
+        DOWN,
+        LEFT,
+        RIGHT,
+        OK,
+        PW,
+        FOCUS,
+        TRIGGER,
+    };
+    const int N_BUTTONS = 8;
+
+    const unsigned long POLL_PERIOD = 5; // ms
+
+    struct Event {
+        Button button;
+        Debounce::Transition transition;
+        uint64_t t; // ms, see Core::time()
+    };
+
+    void init();
+    bool next(Event& event);
+    bool isPressed(Button button);
+    unsigned int overflows();
+
+}
+
+#endif
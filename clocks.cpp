@@ -0,0 +1,99 @@
+#include "clocks.h"
+#include <core.h>
+#include <pm.h>
+#include <scif.h>
+#include <bpm.h>
+#include <flash.h>
+#include "governor.h"
+#include "profiler.h"
+
+namespace Clocks {
+
+    bool _available = false;
+
+    // Internal functions
+    void apply(Governor::Step step);
+
+
+    // Must be called after the USB is initialized, from the idle clock
+    void init() {
+        _available = SCIF::getPLLFrequency() == Governor::BOOST_FREQUENCY
+                && PM::getMainClockFrequency() == Governor::IDLE_FREQUENCY;
+        Governor::reset();
+        Governor::setEnabled(_available);
+    }
+
+    // Passthrough mode, see Governor::IDLE_PS2
+    void setLowLatency(bool lowLatency) {
+        Governor::setLowLatency(_available && lowLatency);
+        update();
+    }
+
+    void boost() {
+        Governor::demand(Core::time());
+        update();
+    }
+
+    void update() {
+        Governor::Level from;
+        Governor::Level to;
+        if (Governor::change(Core::time(), from, to)) {
+            int nSteps = 0;
+            const Governor::Step* steps = Governor::sequence(from, to, nSteps);
+            for (int i = 0; i < nSteps; i++) {
+                apply(steps[i]);
+            }
+        }
+    }
+
+    bool isBoosted() {
+        return Governor::level() == Governor::Level::BOOST;
+    }
+
+    void apply(Governor::Step step) {
+        switch (step) {
+            case Governor::Step::DISABLE_INTERRUPTS:
+                Core::disableInterrupts();
+                break;
+
+            case Governor::Step::ENABLE_INTERRUPTS:
+                Core::enableInterrupts();
+                break;
+
+            case Governor::Step::POWER_SCALING_PS0:
+                BPM::setPowerScaling(BPM::PowerScaling::PS0);
+                break;
+
+            case Governor::Step::POWER_SCALING_PS2:
+                BPM::setPowerScaling(BPM::PowerScaling::PS2);
+                break;
+
+            case Governor::Step::FLASH_NO_WAIT_STATE:
+                Flash::setWaitState(false);
+                break;
+
+            case Governor::Step::FLASH_WAIT_STATE:
+                Flash::setWaitState(true);
+                break;
+
+            case Governor::Step::PBA_UNDIVIDED:
+                PM::setPBADivider(0);
+                break;
+
+            case Governor::Step::PBA_DIVIDED:
+                PM::setPBADivider(Governor::PBA_DIVIDER_BOOST);
+                break;
+
+            case Governor::Step::MAIN_CLOCK_IDLE:
+                PM::setMainClockSource(PM::MainClockSource::RCFAST);
+                PROFILE_CLOCK(1);
+                break;
+
+            case Governor::Step::MAIN_CLOCK_BOOST:
+                PM::setMainClockSource(PM::MainClockSource::PLL);
+                PROFILE_CLOCK(Governor::BOOST_FREQUENCY / Governor::IDLE_FREQUENCY);
+                break;
+        }
+    }
+
+}
@@ -0,0 +1,22 @@
+#ifndef _CLOCKS_H_
+#define _CLOCKS_H_
+
+#include <stdint.h>
+
+// Dynamic scaling of the main clock, following the policy of the governor (see governor.h)
+// The main loop calls boost() before the work which benefits from a faster CPU, and update()
+// before it sleeps, which goes back to the idle clock once the boost is no longer held.
+// The boost is only available when the USB has started the PLL at 48MHz. In passthrough mode,
+// the power scaling is kept between the levels (see Governor::IDLE_PS2), because changing it
+// masks the interrupts for a few tens of microseconds, which would delay the input edges.
+namespace Clocks {
+
+    void init();
+    void setLowLatency(bool lowLatency);
+    void boost();
+    void update();
+    bool isBoosted();
+
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "context.h"
 #include "gui.h"
+#include "sync.h"
+#include "journal.h"
+#include "schema.h"
 #include <flash.h>
 
 int Context::_menuItemSelected = 0;
@@ -9,6 +12,7 @@ int Context::_editingItemCursor = 0;
 bool Context::_btnOkPressed = false;
 bool Context::_submenuFocusHold = false;
 bool Context::_submenuTriggerHold = false;
+int Context::_presetSelected = 0;
 
 bool Context::_triggerSync = true;
 unsigned int Context::_delayMs = 0;
@@ -18,11 +22,15 @@ unsigned int Context::_intervalDelayMs = 1000;
 bool Context::_intervalSync = true;
 int Context::_inputMode = GUI::SUBMENU_INPUT_MODE_PASSTHROUGH;
 bool Context::_inputSync = true;
+unsigned int Context::_inputPassthroughDelayUs = 0;
+unsigned int Context::_inputPassthroughStretchUs = 0;
 unsigned int Context::_timingsFocusDurationMs = 0;
 unsigned int Context::_timingsTriggerDurationMs = 100;
 bool Context::_timingsSync = true;
 int Context::_syncChannel = 0;
 int Context::_radio = GUI::SUBMENU_SETTINGS_RADIO_ENABLED;
+int Context::_wakeInterval = 0;
+int Context::_channelWakeInterval = 0;
 int Context::_brightness = 3;
 
 Core::Time Context::_tFocus = 0;
@@ -31,8 +39,16 @@ bool Context::_inhibitTriggerHold = false;
 bool Context::_skipDelay = false;
 int Context::_shotsLeft = 0;
 unsigned int Context::_countdown = 0;
+bool Context::_remoteFocusHold = false;
+bool Context::_remoteFocusHoldFromUSB = false;
+Core::Time Context::_tRemoteFocusHold = 0;
+bool Context::_remoteTriggerHold = false;
+bool Context::_remoteTriggerHoldFromUSB = false;
+Core::Time Context::_tRemoteTriggerHold = 0;
 
 int Context::_vBat = 0;
+int Context::_batteryLevel = -1;
+long Context::_batteryMinutesLeft = -1;
 
 unsigned int Context::_shadowDelayMs = 0;
 int Context::_shadowIntervalNShots = 1;
@@ -41,53 +57,60 @@ unsigned int Context::_shadowTimingsFocusDurationMs = 0;
 unsigned int Context::_shadowTimingsTriggerDurationMs = 0;
 
 int Context::_rssi = -137;
+uint32_t Context::_rxTimestamp = 0;
 Core::Time Context::_tReceivedCommand = 0;
 
 
-void Context::read() {
+// Number of settings saved in the user page by older firmwares
+const int LEGACY_N_FIELDS = 15;
+
+// Internal functions
+bool readLegacyUserPage(uint32_t values[]);
+
+
+// Settings saved by older firmwares, in the user page
+bool readLegacyUserPage(uint32_t values[]) {
     uint32_t pageBuffer[Flash::FLASH_PAGE_SIZE_WORDS];
     Flash::readUserPage(pageBuffer);
     // First two words are reserved
-    int i = 2;
-    if (pageBuffer[i] == 0xFFFFFFFF) {
-        // Empty config, initialize it by saving the default config
-        save();
+    if (pageBuffer[2] == 0xFFFFFFFF) {
+        return false;
+    }
+    // The fields were saved in the same order as in the journal
+    for (int i = 0; i < LEGACY_N_FIELDS; i++) {
+        values[i] = pageBuffer[2 + i];
+    }
+    return true;
+}
+
+void Context::read() {
+    uint32_t values[Schema::N_SAVED];
+
+    // Fields missing from the journal (settings added in later versions) keep their default value
+    uint32_t mask = Journal::init(values, Schema::N_SAVED);
+    if (mask != 0) {
+        Schema::setSaved(values, mask);
     } else {
-        _triggerSync = static_cast<bool>(pageBuffer[i++]);
-        _delayMs = static_cast<unsigned int>(pageBuffer[i++]);
-        _delaySync = static_cast<bool>(pageBuffer[i++]);
-        _intervalNShots = static_cast<int>(pageBuffer[i++]);
-        _intervalDelayMs = static_cast<unsigned int>(pageBuffer[i++]);
-        _intervalSync = static_cast<bool>(pageBuffer[i++]);
-        _inputMode = static_cast<int>(pageBuffer[i++]);
-        _inputSync = static_cast<bool>(pageBuffer[i++]);
-        _timingsFocusDurationMs = static_cast<unsigned int>(pageBuffer[i++]);
-        _timingsTriggerDurationMs = static_cast<unsigned int>(pageBuffer[i++]);
-        _timingsSync = static_cast<bool>(pageBuffer[i++]);
-        _syncChannel = static_cast<int>(pageBuffer[i++]);
-        _radio = static_cast<int>(pageBuffer[i++]);
-        _brightness = static_cast<int>(pageBuffer[i++]);
+        // Empty journal : import the settings of an older firmware if any, and initialize it
+        if (readLegacyUserPage(values)) {
+            Schema::setSaved(values, (1u << LEGACY_N_FIELDS) - 1);
+        }
+        save();
+    }
+
+    // Settings added in later versions are not initialized in older configs
+    if (_wakeInterval < 0 || _wakeInterval >= Sync::N_WAKE_INTERVALS) {
+        _wakeInterval = 0;
+    }
+    if (_channelWakeInterval < _wakeInterval || _channelWakeInterval >= Sync::N_WAKE_INTERVALS) {
+        _channelWakeInterval = _wakeInterval;
     }
 }
 
+// Only the settings which changed since the last save are written, so this is cheap enough to
+// be called on every change
 void Context::save() {
-    uint32_t pageBuffer[Flash::FLASH_PAGE_SIZE_WORDS];
-    Flash::readUserPage(pageBuffer);
-    // First two words are reserved
-    int i = 2;
-    pageBuffer[i++] = static_cast<uint32_t>(_triggerSync);
-    pageBuffer[i++] = static_cast<uint32_t>(_delayMs);
-    pageBuffer[i++] = static_cast<uint32_t>(_delaySync);
-    pageBuffer[i++] = static_cast<uint32_t>(_intervalNShots);
-    pageBuffer[i++] = static_cast<uint32_t>(_intervalDelayMs);
-    pageBuffer[i++] = static_cast<uint32_t>(_intervalSync);
-    pageBuffer[i++] = static_cast<uint32_t>(_inputMode);
-    pageBuffer[i++] = static_cast<uint32_t>(_inputSync);
-    pageBuffer[i++] = static_cast<uint32_t>(_timingsFocusDurationMs);
-    pageBuffer[i++] = static_cast<uint32_t>(_timingsTriggerDurationMs);
-    pageBuffer[i++] = static_cast<uint32_t>(_timingsSync);
-    pageBuffer[i++] = static_cast<uint32_t>(_syncChannel);
-    pageBuffer[i++] = static_cast<uint32_t>(_radio);
-    pageBuffer[i++] = static_cast<uint32_t>(_brightness);
-    Flash::writeUserPage(pageBuffer);
+    uint32_t values[Schema::N_SAVED];
+    Schema::getSaved(values);
+    Journal::save(values, Schema::N_SAVED);
 }
@@ -1,6 +1,7 @@
 #ifndef _CONTEXT_H_
 #define _CONTEXT_H_
 
+#include <stdint.h>
 #include <core.h>
 
 namespace Context {
@@ -12,6 +13,7 @@ namespace Context {
     extern bool _btnOkPressed;
     extern bool _submenuFocusHold;
     extern bool _submenuTriggerHold;
+    extern int _presetSelected;
 
     extern bool _triggerSync;
     extern unsigned int _delayMs;
@@ -21,11 +23,15 @@ namespace Context {
     extern bool _intervalSync;
     extern int _inputMode;
     extern bool _inputSync;
+    extern unsigned int _inputPassthroughDelayUs;
+    extern unsigned int _inputPassthroughStretchUs;
     extern unsigned int _timingsFocusDurationMs;
     extern unsigned int _timingsTriggerDurationMs;
     extern bool _timingsSync;
     extern int _syncChannel;
     extern int _radio;
+    extern int _wakeInterval;
+    extern int _channelWakeInterval;
     extern int _brightness;
 
     extern Core::Time _tFocus;
@@ -35,7 +41,17 @@ namespace Context {
     extern int _shotsLeft;
     extern unsigned int _countdown;
 
+    // Focus and trigger held by a remote module or by the host (see dispatch.cpp)
+    extern bool _remoteFocusHold;
+    extern bool _remoteFocusHoldFromUSB;
+    extern Core::Time _tRemoteFocusHold;
+    extern bool _remoteTriggerHold;
+    extern bool _remoteTriggerHoldFromUSB;
+    extern Core::Time _tRemoteTriggerHold;
+
     extern int _vBat;
+    extern int _batteryLevel; // %, -1 if unknown
+    extern long _batteryMinutesLeft; // -1 if unknown
 
     extern unsigned int _shadowDelayMs;
     extern int _shadowIntervalNShots;
@@ -44,6 +60,7 @@ namespace Context {
     extern unsigned int _shadowTimingsTriggerDurationMs;
 
     extern int _rssi;
+    extern uint32_t _rxTimestamp;
     extern Core::Time _tReceivedCommand;
     const int RSSI_TIMEOUT = 1000;
     const int RSSI_MID = -100;
@@ -0,0 +1,75 @@
+#include "debounce.h"
+
+namespace Debounce {
+
+    // Internal functions
+    Transition change(Button& button, bool pressed, uint32_t now);
+    bool before(uint32_t t, uint32_t deadline);
+
+
+    // Start from the current state of the pin, without reporting it
+    void init(Button& button, bool pressed, bool repeat, uint32_t now) {
+        button.pressed = pressed;
+        button.level = pressed;
+        button.repeat = repeat;
+        button.tChange = now - LOCKOUT;
+        button.tRepeat = now + REPEAT_DELAY;
+        button.repeatPeriod = REPEAT_PERIOD;
+    }
+
+    // The pin changed : accept the transition, unless it is still bouncing from the previous one
+    Transition edge(Button& button, bool pressed, uint32_t now) {
+        button.level = pressed;
+        if (pressed == button.pressed || before(now, button.tChange + LOCKOUT)) {
+            return Transition::NONE;
+        }
+        return change(button, pressed, now);
+    }
+
+    // Called periodically while the button is not idle : report a level which has changed during
+    // the lockout, or the next repeat. At most one transition is reported by call.
+    Transition poll(Button& button, uint32_t now) {
+        if (before(now, button.tChange + LOCKOUT)) {
+            return Transition::NONE;
+        }
+        if (button.level != button.pressed) {
+            return change(button, button.level, now);
+        }
+        if (button.pressed && button.repeat && !before(now, button.tRepeat)) {
+            // After a long delay between two polls, the next repeats start again from now
+            // instead of being reported in a burst
+            if (before(button.tRepeat + button.repeatPeriod, now)) {
+                button.tRepeat = now;
+            }
+            button.tRepeat += button.repeatPeriod;
+            button.repeatPeriod -= button.repeatPeriod >> REPEAT_ACCELERATION_SHIFT;
+            if (button.repeatPeriod < REPEAT_PERIOD_MIN) {
+                button.repeatPeriod = REPEAT_PERIOD_MIN;
+            }
+            return Transition::REPEAT;
+        }
+        return Transition::NONE;
+    }
+
+    // True if poll() has nothing to do for this button until its next edge
+    bool isIdle(const Button& button, uint32_t now) {
+        return !before(now, button.tChange + LOCKOUT) && button.level == button.pressed && !(button.pressed && button.repeat);
+    }
+
+    Transition change(Button& button, bool pressed, uint32_t now) {
+        button.pressed = pressed;
+        button.tChange = now;
+        if (pressed) {
+            button.tRepeat = now + REPEAT_DELAY;
+            button.repeatPeriod = REPEAT_PERIOD;
+            return Transition::PRESS;
+        }
+        return Transition::RELEASE;
+    }
+
+    // Compare times across the wrap-around of the 32-bit milliseconds, for deadlines less than ~24 days away
+    bool before(uint32_t t, uint32_t deadline) {
+        return (int32_t)(t - deadline) < 0;
+    }
+
+}
@@ -0,0 +1,45 @@
+#ifndef _DEBOUNCE_H_
+#define _DEBOUNCE_H_
+
+#include <stdint.h>
+
+// Debouncing and auto-repeat of a push button, driven by its edges and by a periodic poll (see
+// Buttons), with the times in milliseconds. The first edge of a transition is accepted at once,
+// so that a press is reported with the time of its first contact, then the contact is ignored for
+// LOCKOUT while it bounces : if it has settled on the other level at the end, this is reported by
+// poll(). Glitches shorter than a few clock cycles are filtered by the hardware beforehand.
+// While a button with auto-repeat is held, repeats are reported after REPEAT_DELAY, each one
+// sooner than the previous one down to REPEAT_PERIOD_MIN, to scroll through large values quickly.
+// This module does not access the hardware, so that it can be checked on a host.
+namespace Debounce {
+
+    const uint32_t LOCKOUT = 20; // ms, longer than the bounces of the buttons
+    const uint32_t REPEAT_DELAY = 400; // ms, before the first repeat
+    const uint32_t REPEAT_PERIOD = 150; // ms, between the first repeats
+    const uint32_t REPEAT_PERIOD_MIN = 30; // ms
+    const int REPEAT_ACCELERATION_SHIFT = 3; // Each period is 1/2^SHIFT shorter than the previous one
+
+    enum class Transition : uint8_t {
+        NONE,
+        PRESS,
+        RELEASE,
+        REPEAT,
+    };
+
+    struct Button {
+        bool pressed; // Debounced state
+        bool level; // Last state seen on the pin
+        bool repeat; // Auto-repeat enabled
+        uint32_t tChange; // Last accepted transition
+        uint32_t tRepeat; // Next repeat, while pressed
+        uint32_t repeatPeriod;
+    };
+
+    void init(Button& button, bool pressed, bool repeat, uint32_t now);
+    Transition edge(Button& button, bool pressed, uint32_t now);
+    Transition poll(Button& button, uint32_t now);
+    bool isIdle(const Button& button, uint32_t now);
+
+}
+
+#endif
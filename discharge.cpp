@@ -0,0 +1,176 @@
+#include "discharge.h"
+
+namespace Discharge {
+
+    struct Sample {
+        unsigned long t; // ms
+        int32_t soc; // FINE permil
+    };
+
+    int _profile = 0;
+    bool _filterReset = true;
+    int32_t _filtered = 0; // FINE mV
+    int _soc = UNKNOWN;
+
+    // History of the state of charge since the last profile change, used to estimate the discharge rate
+    Sample _samples[N_RATE_SAMPLES];
+    int _nSamples = 0;
+    unsigned long _samplePeriod = RATE_SAMPLE_PERIOD;
+    int32_t _rate = UNKNOWN; // FINE permil per hour
+
+    // Internal functions
+    int32_t interpolate(int32_t voltage, int scale);
+    void restartRate();
+    void addSample(unsigned long t, int32_t soc);
+    int32_t computeRate();
+
+
+    // State of charge (permil) for the given open-circuit voltage (mV), interpolated on CURVE
+    int socFromVoltage(int voltage) {
+        return interpolate(voltage, 1);
+    }
+
+    // Same as socFromVoltage() with a voltage and a result multiplied by scale
+    int32_t interpolate(int32_t voltage, int scale) {
+        if (voltage <= CURVE[0] * scale) {
+            return 0;
+        }
+        for (int i = 1; i < N_CURVE_POINTS; i++) {
+            if (voltage < CURVE[i] * scale) {
+                return (i - 1) * CURVE_STEP * scale + (voltage - CURVE[i - 1] * scale) * CURVE_STEP / (CURVE[i] - CURVE[i - 1]);
+            }
+        }
+        return SOC_MAX * scale;
+    }
+
+    void reset() {
+        _filterReset = true;
+        _soc = UNKNOWN;
+        restartRate();
+    }
+
+    // The discharge rate and the voltage drop depend on the load : start again on a change
+    void setProfile(int profile) {
+        if (profile != _profile) {
+            _profile = profile;
+            _filterReset = true;
+            restartRate();
+        }
+    }
+
+    // Add a new voltage measurement (mV) taken at time t (ms)
+    void update(unsigned long t, int measured) {
+        // Filter the voltage, or start from this measurement
+        if (_filterReset) {
+            _filtered = measured * FINE;
+        } else {
+            _filtered += (measured * FINE - _filtered) / (1 << FILTER_SHIFT);
+        }
+        int32_t fineSoc = interpolate(_filtered, FINE);
+
+        // The state of charge which is displayed only goes up again on a significant change
+        int soc = fineSoc / FINE;
+        if (_soc == UNKNOWN || _filterReset || soc < _soc || soc > _soc + CHARGE_HYSTERESIS) {
+            if (_soc != UNKNOWN && !_filterReset && soc > _soc + CHARGE_HYSTERESIS) {
+                restartRate();
+            }
+            _soc = soc;
+        }
+        _filterReset = false;
+
+        // Sample the state of charge for the discharge rate
+        if (_nSamples == 0 || t - _samples[_nSamples - 1].t >= _samplePeriod) {
+            addSample(t, fineSoc);
+            _rate = computeRate();
+        }
+    }
+
+    // Filtered voltage (mV)
+    int voltage() {
+        return _filtered / FINE;
+    }
+
+    // Permil, or UNKNOWN before the first measurement
+    int stateOfCharge() {
+        return _soc;
+    }
+
+    // FINE permil per hour, or UNKNOWN if there is not enough history or if the battery is not discharging
+    int dischargeRate() {
+        return _rate;
+    }
+
+    // Duration of the history used to compute the discharge rate (ms)
+    unsigned long rateWindow() {
+        return _nSamples > 0 ? _samples[_nSamples - 1].t - _samples[0].t : 0;
+    }
+
+    // Minutes until the battery is empty at the current discharge rate, or UNKNOWN
+    long remainingMinutes() {
+        if (_rate == UNKNOWN || _soc == UNKNOWN) {
+            return UNKNOWN;
+        }
+        long remaining = (long)_soc * FINE * 60 / _rate;
+        return remaining > MAX_REMAINING ? MAX_REMAINING : remaining;
+    }
+
+    void restartRate() {
+        _nSamples = 0;
+        _samplePeriod = RATE_SAMPLE_PERIOD;
+        _rate = UNKNOWN;
+    }
+
+    // When the history is full, drop every other sample and sample half as often, unless the
+    // maximum window is reached : the oldest sample is then dropped instead
+    void addSample(unsigned long t, int32_t soc) {
+        if (_nSamples == N_RATE_SAMPLES) {
+            if (_samplePeriod < RATE_MAX_SAMPLE_PERIOD) {
+                for (int i = 0; i < N_RATE_SAMPLES / 2; i++) {
+                    _samples[i] = _samples[2 * i];
+                }
+                _nSamples = N_RATE_SAMPLES / 2;
+                _samplePeriod *= 2;
+            } else {
+                for (int i = 0; i < N_RATE_SAMPLES - 1; i++) {
+                    _samples[i] = _samples[i + 1];
+                }
+                _nSamples--;
+            }
+        }
+        _samples[_nSamples].t = t;
+        _samples[_nSamples].soc = soc;
+        _nSamples++;
+    }
+
+    // Least-squares slope of the history, with the times relative to the oldest sample
+    int32_t computeRate() {
+        if (_nSamples < 2 || rateWindow() < RATE_MIN_WINDOW) {
+            return UNKNOWN;
+        }
+        int64_t sumT = 0;
+        int64_t sumS = 0;
+        for (int i = 0; i < _nSamples; i++) {
+            sumT += (_samples[i].t - _samples[0].t) / 1000; // s
+            sumS += _samples[i].soc;
+        }
+        int64_t covariance = 0;
+        int64_t variance = 0;
+        for (int i = 0; i < _nSamples; i++) {
+            int64_t dt = (int64_t)((_samples[i].t - _samples[0].t) / 1000) * _nSamples - sumT;
+            int64_t ds = (int64_t)_samples[i].soc * _nSamples - sumS;
+            covariance += dt * ds;
+            variance += dt * dt;
+        }
+        if (variance == 0) {
+            return UNKNOWN;
+        }
+
+        // Discharging is a negative slope, converted to FINE permil per hour
+        int64_t rate = -covariance * 3600 / variance;
+        if (rate < RATE_MIN) {
+            return UNKNOWN;
+        }
+        return rate;
+    }
+
+}
@@ -0,0 +1,55 @@
+#ifndef _DISCHARGE_H_
+#define _DISCHARGE_H_
+
+#include <stdint.h>
+
+// Li-ion state of charge and remaining runtime, estimated from the battery voltage.
+// The voltage is filtered then mapped to a state of charge with the typical open-circuit
+// discharge curve of a cell, which is flat in the middle and steep at both ends. The
+// remaining runtime is extrapolated from the slope of the state of charge since the power
+// profile (radio mode, low-power reception...) last changed : the history is sampled every
+// RATE_SAMPLE_PERIOD, and every other sample is dropped when it is full, so that the window
+// grows up to RATE_MAX_WINDOW. A long window is needed at low power, when the state of charge
+// only drops by a few permil per hour. The voltage filter also restarts on a profile change,
+// because the voltage drop in the internal resistance of the cell changes with the load.
+// This module does not access the hardware (see Battery), so that it can be checked on a host.
+namespace Discharge {
+
+    // Open-circuit voltage (mV) at each step of CURVE_STEP permil of state of charge
+    const int N_CURVE_POINTS = 11;
+    const int CURVE_STEP = 100; // permil
+    const uint16_t CURVE[N_CURVE_POINTS] = {3300, 3690, 3730, 3770, 3800, 3840, 3870, 3950, 4020, 4110, 4200};
+
+    const int SOC_MAX = 1000; // permil
+    const int UNKNOWN = -1;
+
+    // Exponential filter on the voltage : each measurement has a weight of 1/2^FILTER_SHIFT
+    const int FILTER_SHIFT = 3;
+
+    // The displayed state of charge only goes up again (charger plugged, lower load) when the
+    // estimate exceeds it by more than CHARGE_HYSTERESIS, to hide the noise
+    const int CHARGE_HYSTERESIS = 30; // permil
+
+    // Slope of the state of charge, by least squares over the samples of the history
+    const int N_RATE_SAMPLES = 32;
+    const unsigned long RATE_SAMPLE_PERIOD = 5 * 60 * 1000; // ms, doubled each time the history is full
+    const unsigned long RATE_MAX_SAMPLE_PERIOD = 60 * 60 * 1000; // ms
+    const unsigned long RATE_MAX_WINDOW = (N_RATE_SAMPLES - 1) * RATE_MAX_SAMPLE_PERIOD;
+    const unsigned long RATE_MIN_WINDOW = 30 * 60 * 1000; // ms before the first estimate
+    const int FINE = 1 << FILTER_SHIFT; // Resolution of the samples and of the rate, in fractions of permil
+    const int RATE_MIN = 2; // FINE permil per hour, below which the battery is not considered discharging
+    const long MAX_REMAINING = 1000L * 60; // minutes
+
+    int socFromVoltage(int voltage);
+    void reset();
+    void setProfile(int profile);
+    void update(unsigned long t, int measured);
+    int voltage();
+    int stateOfCharge();
+    int dischargeRate();
+    unsigned long rateWindow();
+    long remainingMinutes();
+
+}
+
+#endif
@@ -0,0 +1,256 @@
+#include "dispatch.h"
+#include "gui.h"
+#include "sync.h"
+#include "sync_usb.h"
+#include "schema.h"
+#include "presets.h"
+#include "context.h"
+
+namespace Dispatch {
+
+    // Internal functions
+    bool isSynced(const Command* c);
+    int menu(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int preset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int recallPreset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int storePreset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int setPassthrough(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int focus(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int focusHold(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int focusRelease(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int trigger(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int triggerHold(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int triggerRelease(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+    int wakeInterval(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+
+    const uint8_t MENU_FLAGS = FROM_RADIO | FROM_USB | RELAY_RADIO | RELAY_USB;
+    const uint8_t TRIGGER_FLAGS = FROM_RADIO | FROM_USB | RELAY_RADIO | EVENT_USB;
+
+    // 0x0_ : settings of a menu, in the format described in schema.h
+    constexpr Command MENU_COMMANDS[] = {
+        {GUI::MENU_TRIGGER, menu, MENU_FLAGS, Schema::menuPayloadSize(GUI::MENU_TRIGGER, false), GUI::MENU_TRIGGER},
+        {GUI::MENU_DELAY, menu, MENU_FLAGS, Schema::menuPayloadSize(GUI::MENU_DELAY, false), GUI::MENU_DELAY},
+        {GUI::MENU_INTERVAL, menu, MENU_FLAGS, Schema::menuPayloadSize(GUI::MENU_INTERVAL, false), GUI::MENU_INTERVAL},
+        {GUI::MENU_TIMINGS, menu, MENU_FLAGS, Schema::menuPayloadSize(GUI::MENU_TIMINGS, false), GUI::MENU_TIMINGS},
+        {GUI::MENU_INPUT, menu, MENU_FLAGS, Schema::menuPayloadSize(GUI::MENU_INPUT, false), GUI::MENU_INPUT},
+        {GUI::MENU_SETTINGS, menu, FROM_USB, Schema::menuPayloadSize(GUI::MENU_SETTINGS, false), ALWAYS}, // Not synced
+    };
+
+    // 0x1_ : preset recalled on another module
+    constexpr Command PRESET_COMMANDS[] = {
+        {Sync::CMD_PRESET, preset, FROM_RADIO, Presets::FRAME_SIZE, ALWAYS}, // Filtered by menu in preset()
+    };
+
+    // 0x8_ : requests of the host. The GET requests are answered directly by SyncUSB::usbControlHandler().
+    constexpr Command USB_COMMANDS[] = {
+        {Sync::CMD_GET_GUI_STATE, nullptr, 0, 0, ALWAYS},
+        {Sync::CMD_GET_GUI_UPDATE, nullptr, 0, 0, ALWAYS},
+        {Sync::CMD_GET_RADIO_STATS, nullptr, 0, 0, ALWAYS},
+        {Sync::CMD_GET_PRESETS, nullptr, 0, 0, ALWAYS},
+        {Sync::CMD_RECALL_PRESET, recallPreset, FROM_USB, 1, ALWAYS},
+        {Sync::CMD_STORE_PRESET, storePreset, FROM_USB, 1, ALWAYS},
+        {Sync::CMD_SET_PASSTHROUGH, setPassthrough, FROM_USB, 8, ALWAYS},
+    };
+
+    // 0x9_ : focus and trigger
+    constexpr Command TRIGGER_COMMANDS[] = {
+        {Sync::CMD_FOCUS, focus, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_FOCUS_HOLD, focusHold, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_FOCUS_RELEASE, focusRelease, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_TRIGGER, trigger, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_TRIGGER_NO_DELAY, trigger, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_TRIGGER_HOLD, triggerHold, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+        {Sync::CMD_TRIGGER_RELEASE, triggerRelease, TRIGGER_FLAGS, 0, GUI::MENU_TRIGGER},
+    };
+
+    // 0xB_ : wake interval of the channel, in the low nibble
+    constexpr Command WAKE_COMMANDS[] = {
+        {Sync::CMD_WAKE_INTERVAL + 0, wakeInterval, FROM_RADIO, 0, ALWAYS},
+        {Sync::CMD_WAKE_INTERVAL + 1, wakeInterval, FROM_RADIO, 0, ALWAYS},
+        {Sync::CMD_WAKE_INTERVAL + 2, wakeInterval, FROM_RADIO, 0, ALWAYS},
+        {Sync::CMD_WAKE_INTERVAL + 3, wakeInterval, FROM_RADIO, 0, ALWAYS},
+        {Sync::CMD_WAKE_INTERVAL + 4, wakeInterval, FROM_RADIO, 0, ALWAYS},
+    };
+
+    struct Group {
+        const Command* commands;
+        int nCommands;
+    };
+
+    const Group GROUPS[N_GROUPS] = {
+        {MENU_COMMANDS, sizeof(MENU_COMMANDS) / sizeof(Command)}, // 0x0_
+        {PRESET_COMMANDS, sizeof(PRESET_COMMANDS) / sizeof(Command)}, // 0x1_
+        {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, // 0x2_ - 0x7_
+        {USB_COMMANDS, sizeof(USB_COMMANDS) / sizeof(Command)}, // 0x8_
+        {TRIGGER_COMMANDS, sizeof(TRIGGER_COMMANDS) / sizeof(Command)}, // 0x9_
+        {nullptr, 0}, // 0xA_
+        {WAKE_COMMANDS, sizeof(WAKE_COMMANDS) / sizeof(Command)}, // 0xB_
+        {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, {nullptr, 0}, // 0xC_ - 0xF_
+    };
+
+    // Every command must be at the index given by its ID
+    constexpr bool isGroupIndexed(const Command* commands, int n, int group, int i=0) {
+        return i == n || (commands[i].id == group * GROUP_SIZE + i && isGroupIndexed(commands, n, group, i + 1));
+    }
+    static_assert(isGroupIndexed(MENU_COMMANDS, sizeof(MENU_COMMANDS) / sizeof(Command), 0x0)
+            && isGroupIndexed(PRESET_COMMANDS, sizeof(PRESET_COMMANDS) / sizeof(Command), 0x1)
+            && isGroupIndexed(USB_COMMANDS, sizeof(USB_COMMANDS) / sizeof(Command), 0x8)
+            && isGroupIndexed(TRIGGER_COMMANDS, sizeof(TRIGGER_COMMANDS) / sizeof(Command), 0x9)
+            && isGroupIndexed(WAKE_COMMANDS, sizeof(WAKE_COMMANDS) / sizeof(Command), 0xB),
+            "a command is not at the index given by its ID");
+    static_assert(sizeof(WAKE_COMMANDS) / sizeof(Command) == Sync::N_WAKE_INTERVALS, "every wake interval must have a command");
+    static_assert(sizeof(MENU_COMMANDS) / sizeof(Command) == Schema::N_MENUS, "every menu must have a command");
+
+
+    const Command* find(uint8_t command) {
+        const Group& group = GROUPS[command / GROUP_SIZE];
+        int i = command % GROUP_SIZE;
+        if (i >= group.nCommands || group.commands[i].handler == nullptr) {
+            return nullptr;
+        }
+        return &group.commands[i];
+    }
+
+    bool dispatch(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        const Command* c = find(command);
+        if (c == nullptr) {
+            return false;
+        }
+
+        // Notify the host immediately of remote triggers, even if they are not synced on this module
+        if (!fromUSB && (c->flags & EVENT_USB) && SyncUSB::isConnected()) {
+            SyncUSB::sendEvent(command, Context::_rssi, Context::_rxTimestamp);
+        }
+
+        // Check the source, the payload and the sync flag of the menu
+        if (!(c->flags & (fromUSB ? FROM_USB : FROM_RADIO)) || payloadSize < c->minPayloadSize || (!fromUSB && !isSynced(c))) {
+            return false;
+        }
+
+        int relaySize = c->handler(command, payload, payloadSize, fromUSB);
+        if (relaySize < 0) {
+            return false;
+        }
+
+        // Relay the command to the other side. The settings received from USB can change the sync flag.
+        if (fromUSB && (c->flags & RELAY_RADIO) && isSynced(c)) {
+            Sync::send(command, relaySize > 0 ? payload : nullptr, relaySize);
+        } else if (!fromUSB && (c->flags & RELAY_USB) && SyncUSB::isConnected()) {
+            SyncUSB::send(command, payload, relaySize);
+        }
+        return true;
+    }
+
+    bool isSynced(const Command* c) {
+        return c->syncMenu == ALWAYS || Schema::isMenuSynced(c->syncMenu);
+    }
+
+    // Settings of a menu, relayed in the format of the other side
+    int menu(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        if (!Schema::decodeMenu(command, payload, payloadSize, fromUSB)) {
+            return -1;
+        }
+        return Schema::encodeMenu(command, payload, !fromUSB);
+    }
+
+    // Preset recalled on another module : only apply the menus synced on this one too
+    int preset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        Presets::Preset preset;
+        uint8_t mask = 0;
+        if (!Presets::decodeFrame(payload, payloadSize, preset, mask)) {
+            return -1;
+        }
+        mask = Schema::syncedMenus(mask);
+        Presets::apply(preset, mask);
+        GUI::sendMenusUSB(mask);
+        return 0;
+    }
+
+    // The preset is sent to the other modules by GUI::recallPreset()
+    int recallPreset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        if (payload[0] >= Presets::N_PRESETS) {
+            return -1;
+        }
+        Context::_presetSelected = payload[0];
+        GUI::recallPreset(payload[0]);
+        return 0;
+    }
+
+    int storePreset(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        char name[Presets::NAME_SIZE + 1] = "";
+        for (int i = 1; i < payloadSize && i <= Presets::NAME_SIZE; i++) {
+            name[i - 1] = payload[i];
+        }
+        return Presets::store(payload[0], payloadSize > 1 ? name : nullptr) ? 0 : -1;
+    }
+
+    // Applied by the main loop, which reconfigures Shutter when they change
+    int setPassthrough(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        Context::_inputPassthroughDelayUs = (uint32_t)payload[0] << 24 | payload[1] << 16 | payload[2] << 8 | payload[3];
+        Context::_inputPassthroughStretchUs = (uint32_t)payload[4] << 24 | payload[5] << 16 | payload[6] << 8 | payload[7];
+        return 0;
+    }
+
+    int focus(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        GUI::copyShadowContext();
+        Context::_tFocus = Core::time();
+        return 0;
+    }
+
+    int focusHold(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        if (!Context::_remoteFocusHold) {
+            Context::_remoteFocusHold = true;
+            Context::_remoteFocusHoldFromUSB = fromUSB;
+        }
+        Context::_tRemoteFocusHold = Core::time();
+        return 0;
+    }
+
+    int focusRelease(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        Context::_tFocus = 0;
+        Context::_remoteFocusHold = false;
+        return 0;
+    }
+
+    // CMD_TRIGGER and CMD_TRIGGER_NO_DELAY
+    int trigger(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        GUI::copyShadowContext();
+        Context::_tTrigger = Core::time();
+        Context::_skipDelay = command == Sync::CMD_TRIGGER_NO_DELAY;
+        return 0;
+    }
+
+    int triggerHold(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        if (!Context::_remoteTriggerHold) {
+            Context::_remoteTriggerHold = true;
+            Context::_remoteTriggerHoldFromUSB = fromUSB;
+        }
+        Context::_tRemoteTriggerHold = Core::time();
+        Context::_skipDelay = false;
+
+        // The sender doesn't send the focus keepalives during a trigger hold, which also holds
+        // the focus : keep a focus hold alive until the trigger is released
+        if (Context::_remoteFocusHold) {
+            Context::_tRemoteFocusHold = Context::_tRemoteTriggerHold;
+        }
+        return 0;
+    }
+
+    int triggerRelease(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        Context::_tTrigger = 0;
+        Context::_skipDelay = false;
+        Context::_remoteTriggerHold = false;
+        return 0;
+    }
+
+    // Wake interval of the channel changed on another module : the preamble of the frames sent
+    // follows it, and this module wakes up more often if needed to still receive the others
+    int wakeInterval(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB) {
+        Context::_channelWakeInterval = command - Sync::CMD_WAKE_INTERVAL;
+        if (Context::_wakeInterval > Context::_channelWakeInterval) {
+            Context::_wakeInterval = Context::_channelWakeInterval;
+        }
+        return 0;
+    }
+
+}
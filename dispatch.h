@@ -0,0 +1,47 @@
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+#include <stdint.h>
+
+// Handling of the commands received from the other modules over the radio and from the host over
+// USB. Every command has an entry in a table indexed by its ID (see dispatch.cpp) which describes
+// where it is accepted from, its minimum payload size, the menu whose sync flag enables it and
+// where it is relayed once handled, so that this logic is shared by all the commands.
+namespace Dispatch {
+
+    // Flags of a command
+    const uint8_t FROM_RADIO = 1 << 0; // Accepted from the other modules, if its menu is synced
+    const uint8_t FROM_USB = 1 << 1; // Accepted from the host
+    const uint8_t RELAY_RADIO = 1 << 2; // Received from USB : sent to the other modules, if its menu is synced
+    const uint8_t RELAY_USB = 1 << 3; // Received from the radio : sent to the host
+    const uint8_t EVENT_USB = 1 << 4; // Received from the radio : notified immediately to the host with the RSSI
+
+    // Sync menu of the commands which do not depend on a sync flag
+    const int8_t ALWAYS = -1;
+
+    // Handle a command and return the size of the payload to relay, which the handler writes over
+    // the received one, or -1 to ignore the command
+    using Handler = int (*)(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+
+    struct Command {
+        uint8_t id;
+        Handler handler;
+        uint8_t flags;
+        uint8_t minPayloadSize;
+        int8_t syncMenu; // GUI::MENU_* or ALWAYS
+    };
+
+    // The commands are grouped by the high nibble of their ID, and the low nibble is the index
+    // of the command in its group
+    const int N_GROUPS = 16;
+    const int GROUP_SIZE = 16;
+
+    // Entry of a command in the table, or nullptr if this command is not handled
+    const Command* find(uint8_t command);
+
+    // Handle a command received from the radio or from USB, and return false if it was ignored
+    bool dispatch(uint8_t command, uint8_t* payload, int payloadSize, bool fromUSB);
+
+}
+
+#endif
@@ -9,16 +9,21 @@ namespace LoRa {
     SPI::Peripheral _spi = 0;
     bool _spiEnabled = false;
     uint32_t _frequency = 0;
+    int32_t _frequencyOffset = 0;
     Mode _mode = Mode::STANDBY;
     int _txPowerdBm = 0;
     int _spreadingFactor = 7;
     CodingRate _codingRate = CodingRate::RATE_4_5;
     Bandwidth _bandwidth = Bandwidth::BW_125kHz;
     bool _explicitHeaderEnabled = true;
+    unsigned int _payloadLength = 1;
+    int _preambleLength = DEFAULT_PREAMBLE_LENGTH;
     bool _isRxEnabled = false;
 
     // Internal functions
     void writeConfig();
+    void writeFrequency();
+    bool lowDataRateOptimize();
 
 
     // Set the GPIOs used by the module
@@ -89,8 +94,48 @@ namespace LoRa {
             return;
         }
         _frequency = frequency;
-        uint64_t frequency_mHz = (uint64_t)frequency * 1000;
-        uint32_t regFr = frequency_mHz / 61035; // Resolution with 32MHz XOSC according to the datasheet
+        writeFrequency();
+    }
+
+    // Set an offset in Hz applied to the frequency, to compensate for the crystal
+    // drift between modules
+    void setFrequencyOffset(int32_t offset) {
+        if (offset > AFC_MAX_OFFSET) {
+            offset = AFC_MAX_OFFSET;
+        } else if (offset < -AFC_MAX_OFFSET) {
+            offset = -AFC_MAX_OFFSET;
+        }
+        _frequencyOffset = offset;
+
+        // The frequency must not be changed while receiving
+        bool rxEnabled = _isRxEnabled;
+        if (rxEnabled) {
+            setMode(Mode::STANDBY);
+        }
+        writeFrequency();
+        if (rxEnabled) {
+            enableRx();
+        }
+    }
+
+    int32_t getFrequencyOffset() {
+        return _frequencyOffset;
+    }
+
+    // Automatic frequency correction : move the frequency toward the one of a peer,
+    // given the frequency error measured on one of its packets (see lastPacketFrequencyError()),
+    // and toward the nominal frequency
+    void correctFrequency(int32_t frequencyError) {
+        int32_t correction = frequencyError / (1 << AFC_GAIN_SHIFT) - _frequencyOffset / (1 << AFC_LEAK_SHIFT);
+        if (correction >= AFC_MIN_CORRECTION || correction <= -AFC_MIN_CORRECTION) {
+            setFrequencyOffset(_frequencyOffset + correction);
+        }
+    }
+
+    void writeFrequency() {
+        // Frf = F * 2^19 / Fxosc, rounded to the nearest step
+        uint64_t frequency = (int64_t)_frequency + _frequencyOffset;
+        uint32_t regFr = ((frequency << FSTEP_SHIFT) + XOSC_FREQUENCY / 2) / XOSC_FREQUENCY;
         writeRegister(REG_FR_MSB, (regFr >> 16) & 0xFF);
         writeRegister(REG_FR_MID, (regFr >> 8) & 0xFF);
         writeRegister(REG_FR_LSB, regFr & 0xFF);
@@ -129,6 +174,7 @@ namespace LoRa {
             return;
         }
         _spreadingFactor = spreadingFactor;
+        writeConfig();
     }
 
     // Set the length of the error-correction code
@@ -150,11 +196,67 @@ namespace LoRa {
         writeConfig();
     }
 
+    // In explicit header mode, the length, coding rate and CRC presence are sent in a
+    // PHY header before the payload. In implicit header mode, this header is omitted
+    // to save airtime, and the receiver must know the payload length in advance
+    // (see setPayloadLength()).
     void setExplicitHeader(bool explicitHeaderEnabled) {
         _explicitHeaderEnabled = explicitHeaderEnabled;
         writeConfig();
     }
 
+    // Set the fixed length of the packets expected by the receiver in implicit header mode
+    void setPayloadLength(unsigned int length) {
+        if (length < 1 || length > MAX_TX_LENGTH) {
+            return;
+        }
+        _payloadLength = length;
+        if (!_explicitHeaderEnabled) {
+            writeRegister(REG_PAYLOAD_LENGTH, _payloadLength);
+        }
+    }
+
+    // Set the length of the preamble in symbols, between 6 and 65535. The receiver
+    // should be configured with the longest preamble it may receive.
+    void setPreambleLength(int length) {
+        if (length < 6 || length > 0xFFFF) {
+            return;
+        }
+        _preambleLength = length;
+        writeRegister(REG_PREAMBLE_MSB, (length >> 8) & 0xFF);
+        writeRegister(REG_PREAMBLE_LSB, length & 0xFF);
+    }
+
+    // Duration of a symbol with the current modem settings, in us
+    uint32_t symbolDuration() {
+        return ((uint64_t)1000000 << _spreadingFactor) / BANDWIDTH_HZ[static_cast<int>(_bandwidth)];
+    }
+
+    // Time on air of a packet of the given length with the current modem settings
+    // and the given header mode, in us. The payload CRC and the low data rate
+    // optimization are counted as writeConfig() sets them : the CRC is always on.
+    // See datasheet §4.1.1.7. Time on air
+    uint32_t timeOnAir(unsigned int length, bool explicitHeader) {
+        const int sf = _spreadingFactor;
+        const int cr = static_cast<int>(_codingRate);
+        const int ih = explicitHeader ? 0 : 1;
+        const int crc = 1;
+        const int de = lowDataRateOptimize() ? 1 : 0;
+
+        // Number of payload symbols
+        int numerator = 8 * length - 4 * sf + 28 + 16 * crc - 20 * ih;
+        int denominator = 4 * (sf - 2 * de);
+        int nPayloadSymbols = 8;
+        if (numerator > 0) {
+            nPayloadSymbols += ((numerator + denominator - 1) / denominator) * (cr + 4);
+        }
+
+        // The preamble lasts (nPreamble + 4.25) symbols : count in quarters of symbols
+        // to keep integer arithmetic, with Tsym = 2^SF / BW
+        uint64_t nQuarterSymbols = 4 * (_preambleLength + nPayloadSymbols) + 17;
+        return ((nQuarterSymbols << sf) * 1000000) / (4 * BANDWIDTH_HZ[static_cast<int>(_bandwidth)]);
+    }
+
     void writeConfig() {
         writeRegister(REG_MODEM_CONFIG_1, 
             (_explicitHeaderEnabled ? 0 : 1) << REG_MODEM_CONFIG_1_IMPLICIT_HEADER_MODE |
@@ -167,12 +269,29 @@ namespace LoRa {
             _spreadingFactor << REG_MODEM_CONFIG_2_SPREADING_FACTOR
         );
         writeRegister(REG_MODEM_CONFIG_3, 
+            (lowDataRateOptimize() ? 1 : 0) << REG_MODEM_CONFIG_3_LOW_DATA_RATE_OPTIMIZE |
             1 << REG_MODEM_CONFIG_3_AGC_AUTO_ON
         );
     }
 
-    // Send data
+    // The low data rate optimization is mandated when a symbol lasts more than 16ms,
+    // that is from SF11 at 125kHz
+    // See datasheet §4.1.1.6. Low Data Rate Optimization
+    bool lowDataRateOptimize() {
+        return symbolDuration() > 16000;
+    }
+
+    // Send data and wait until it is sent
     void tx(uint8_t* payload, unsigned int length) {
+        startTx(payload, length);
+        while (!txDone()) {
+            Core::sleep(1);
+        }
+    }
+
+    // Start sending data : a long preamble can keep the modem busy for seconds, during which
+    // txDone() can be polled
+    void startTx(uint8_t* payload, unsigned int length) {
         // Check length
         if (length > MAX_TX_LENGTH) {
             length = MAX_TX_LENGTH;
@@ -194,10 +313,12 @@ namespace LoRa {
 
         // Switch to TX mode to send the payload
         setMode(Mode::TX);
+    }
 
-        // Wait for TxDone IRQ
-        while (!(readRegister(REG_IRQ_FLAGS) & (1 << IRQ_TX_DONE))) {
-            Core::sleep(1);
+    // Check if the data given to startTx() is sent, in which case RX is enabled again if it was
+    bool txDone() {
+        if (!(readRegister(REG_IRQ_FLAGS) & (1 << IRQ_TX_DONE))) {
+            return false;
         }
 
         // Clear all flags
@@ -207,6 +328,7 @@ namespace LoRa {
         if (_isRxEnabled) {
             enableRx();
         }
+        return true;
     }
 
     void enableRx() {
@@ -215,6 +337,12 @@ namespace LoRa {
         // Reset FIFO RX address to the start of the FIFO
         writeRegister(REG_FIFO_RX_BASE_ADDR, 0x00);
 
+        // In implicit header mode, the receiver needs to know the length of the
+        // packets in advance ; this register is also used by tx()
+        if (!_explicitHeaderEnabled) {
+            writeRegister(REG_PAYLOAD_LENGTH, _payloadLength);
+        }
+
         // Start RX mode
         setMode(Mode::RX_CONTINUOUS);
     }
@@ -230,6 +358,25 @@ namespace LoRa {
         return readRegister(REG_IRQ_FLAGS) & (1 << IRQ_RX_DONE);
     }
 
+    // Start a Channel Activity Detection, which looks for a preamble during
+    // about 2 symbols then goes back to standby
+    void startCAD() {
+        _isRxEnabled = false;
+        writeRegister(REG_IRQ_FLAGS, (1 << IRQ_CAD_DONE) | (1 << IRQ_CAD_DETECTED));
+        setMode(Mode::CAD);
+    }
+
+    bool cadDone() {
+        return readRegister(REG_IRQ_FLAGS) & (1 << IRQ_CAD_DONE);
+    }
+
+    // Result of the last CAD : true if a preamble was detected
+    bool cadDetected() {
+        uint8_t irqFlags = readRegister(REG_IRQ_FLAGS);
+        writeRegister(REG_IRQ_FLAGS, (1 << IRQ_CAD_DONE) | (1 << IRQ_CAD_DETECTED));
+        return irqFlags & (1 << IRQ_CAD_DETECTED);
+    }
+
     // Receive data into a user buffer
     int rx(uint8_t* buffer, unsigned int length) {
         uint8_t irqFlags = readRegister(REG_IRQ_FLAGS);
@@ -237,8 +384,8 @@ namespace LoRa {
             // Clear all flags
             writeRegister(REG_IRQ_FLAGS, 0xFF);
 
-            // Check that header is valid
-            if (!(irqFlags & (1 << IRQ_VALID_HEADER))) {
+            // Check that header is valid (there is no header to check in implicit mode)
+            if (_explicitHeaderEnabled && !(irqFlags & (1 << IRQ_VALID_HEADER))) {
                 return INVALID_HEADER;
             }
 
@@ -281,6 +428,24 @@ namespace LoRa {
         return readRegister(REG_PKT_RSSI_VALUE) - 137;
     }
 
+    // Signal to Noise Ratio of the last packet, in dB
+    int lastPacketSNR() {
+        return static_cast<int8_t>(readRegister(REG_PKT_SNR_VALUE)) / 4;
+    }
+
+    // Frequency error of the last packet, in Hz : a positive value means that the
+    // carrier of the sender is above the frequency of this module
+    // See datasheet §4.1.5. Frequency Error Indication
+    int32_t lastPacketFrequencyError() {
+        // 20-bit signed value
+        int32_t fei = (readRegister(REG_FEI_MSB) & 0x0F) << 16 | readRegister(REG_FEI_MID) << 8 | readRegister(REG_FEI_LSB);
+        if (fei & 0x80000) {
+            fei -= 0x100000;
+        }
+        // Ferr = FEI * 2^24 / Fxosc * BW / 500kHz
+        return (int64_t)fei * (1 << 24) * BANDWIDTH_HZ[static_cast<int>(_bandwidth)] / ((int64_t)XOSC_FREQUENCY * 500000);
+    }
+
     // Instantaneous Received Signal Strength Indicator, in dBm
     int currentRSSI() {
         return readRegister(REG_RSSI_VALUE) - 137;
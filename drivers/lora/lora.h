@@ -9,6 +9,22 @@ namespace LoRa {
 
     const uint32_t DEFAULT_FREQUENCY = 868000000L; // 868MHz
     const int MAX_TX_LENGTH = 128;
+    const int DEFAULT_PREAMBLE_LENGTH = 8; // Symbols, register default
+    const uint32_t XOSC_FREQUENCY = 32000000L; // 32MHz
+    const int FSTEP_SHIFT = 19; // Fstep = XOSC_FREQUENCY / 2^19 ~= 61.035Hz
+
+    // Automatic frequency correction : at each packet, the frequency offset moves toward
+    // the frequency of the peer by a fraction (1 / 2^AFC_GAIN_SHIFT) of the measured error,
+    // and back toward the nominal frequency of the crystal by a smaller fraction
+    // (1 / 2^AFC_LEAK_SHIFT) of the offset, and is limited to +/- AFC_MAX_OFFSET. Without
+    // the latter, modules correcting toward each other only keep their difference in check,
+    // and the measurement errors make their common offset walk up to the limit. The error
+    // left to a peer is ~1 / (1 + 2^(AFC_LEAK_SHIFT - AFC_GAIN_SHIFT)) of the difference
+    // between the crystals (~6%, less when both modules correct).
+    const int AFC_GAIN_SHIFT = 2;
+    const int AFC_LEAK_SHIFT = 6;
+    const int32_t AFC_MAX_OFFSET = 25000; // Hz, ~29ppm at 868MHz
+    const int32_t AFC_MIN_CORRECTION = 100; // Hz
 
     // Registers
     const uint8_t REG_FIFO = 0x00;
@@ -24,13 +40,19 @@ namespace LoRa {
     const uint8_t REG_IRQ_FLAGS_MASK = 0x11;
     const uint8_t REG_IRQ_FLAGS = 0x12;
     const uint8_t REG_FIFO_RX_BYTES_NB = 0x13;
+    const uint8_t REG_PKT_SNR_VALUE = 0x19;
     const uint8_t REG_PKT_RSSI_VALUE = 0x1A;
     const uint8_t REG_RSSI_VALUE = 0x1B;
     const uint8_t REG_MODEM_CONFIG_1 = 0x1D;
     const uint8_t REG_MODEM_CONFIG_2 = 0x1E;
+    const uint8_t REG_PREAMBLE_MSB = 0x20;
+    const uint8_t REG_PREAMBLE_LSB = 0x21;
     const uint8_t REG_PAYLOAD_LENGTH = 0x22;
     const uint8_t REG_MODEM_CONFIG_3 = 0x26;
     const uint8_t REG_FIFO_RX_BYTE_ADDR = 0x25;
+    const uint8_t REG_FEI_MSB = 0x28;
+    const uint8_t REG_FEI_MID = 0x29;
+    const uint8_t REG_FEI_LSB = 0x2A;
     const uint8_t REG_VERSION = 0x42;
     const uint8_t REG_PA_DAC = 0x4D;
 
@@ -43,6 +65,7 @@ namespace LoRa {
     const uint8_t REG_MODEM_CONFIG_2_SPREADING_FACTOR = 4;
     const uint8_t REG_MODEM_CONFIG_3_AGC_AUTO_ON = 2;
     const uint8_t REG_MODEM_CONFIG_3_MOBILE_NODE = 3;
+    const uint8_t REG_MODEM_CONFIG_3_LOW_DATA_RATE_OPTIMIZE = 3; // Name of the MOBILE_NODE bit on the SX1276/77/78
     const uint8_t REG_PA_CONFIG_OUTPUT_POWER = 0;
     const uint8_t REG_PA_CONFIG_MAX_POWER = 4;
     const uint8_t REG_PA_CONFIG_PA_BOOST = 7;
@@ -94,6 +117,7 @@ namespace LoRa {
         BW_250kHz,
         BW_500kHz
     };
+    const uint32_t BANDWIDTH_HZ[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
 
     enum class PinFunction {
         RESET
@@ -105,17 +129,31 @@ namespace LoRa {
     bool init(SPI::Peripheral slave, uint32_t frequency=DEFAULT_FREQUENCY);
     void setMode(Mode mode);
     void setFrequency(uint32_t frequency);
+    void setFrequencyOffset(int32_t offset);
+    int32_t getFrequencyOffset();
+    void correctFrequency(int32_t frequencyError);
     void setTxPower(int dBm);
     void setSpreadingFactor(int spreadingFactor);
     void setCodingRate(CodingRate codingRate);
     void setBandwidth(Bandwidth bandwidth);
     void setExplicitHeader(bool explicitHeaderEnabled);
+    void setPayloadLength(unsigned int length);
+    void setPreambleLength(int length);
+    uint32_t symbolDuration();
+    uint32_t timeOnAir(unsigned int length, bool explicitHeader);
     void tx(uint8_t* payload, unsigned int length);
+    void startTx(uint8_t* payload, unsigned int length);
+    bool txDone();
     void enableRx();
     void disableRx();
     bool rxAvailable();
+    void startCAD();
+    bool cadDone();
+    bool cadDetected();
     int rx(uint8_t* buffer, unsigned int length);
     int lastPacketRSSI();
+    int lastPacketSNR();
+    int32_t lastPacketFrequencyError();
     int currentRSSI();
     uint8_t readRegister(uint8_t reg);
     void writeRegister(uint8_t reg, uint8_t value);
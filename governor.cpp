@@ -0,0 +1,73 @@
+#include "governor.h"
+
+namespace Governor {
+
+    Level _level = Level::IDLE;
+    bool _enabled = true;
+    bool _lowLatency = false;
+    bool _demand = false; // A demand is held
+    uint32_t _tDemand = 0;
+
+
+    void reset() {
+        _level = Level::IDLE;
+        _enabled = true;
+        _lowLatency = false;
+        _demand = false;
+    }
+
+    // When disabled, the clock goes back to idle at the next change()
+    void setEnabled(bool enabled) {
+        _enabled = enabled;
+    }
+
+    // Idle in IDLE_PS2 rather than IDLE, so that the switches are short
+    void setLowLatency(bool lowLatency) {
+        _lowLatency = lowLatency;
+    }
+
+    // Work which benefits from the boost is about to be done
+    void demand(uint32_t now) {
+        _demand = true;
+        _tDemand = now;
+    }
+
+    // Returns true if the clock must be switched from one level to another now, by applying
+    // the sequence between them, in which case the new level is considered as current
+    bool change(uint32_t now, Level& from, Level& to) {
+        // The demand is dropped at the end of the hold, so that the wrap-around
+        // of the time does not bring it back
+        if (_demand && now - _tDemand >= HOLD) {
+            _demand = false;
+        }
+        Level target = _lowLatency ? Level::IDLE_PS2 : Level::IDLE;
+        if (_enabled && _demand) {
+            target = Level::BOOST;
+        }
+        if (target == _level) {
+            return false;
+        }
+        from = _level;
+        to = target;
+        _level = target;
+        return true;
+    }
+
+    Level level() {
+        return _level;
+    }
+
+    const Step* sequence(Level from, Level to, int& nSteps) {
+        if (from == Level::IDLE_PS2 || to == Level::IDLE_PS2) {
+            if (from == Level::BOOST || to == Level::BOOST) {
+                nSteps = N_CLOCK_STEPS;
+                return to == Level::BOOST ? CLOCK_BOOST_SEQUENCE : CLOCK_IDLE_SEQUENCE;
+            }
+            nSteps = N_SCALING_STEPS;
+            return to == Level::IDLE_PS2 ? SCALING_UP_SEQUENCE : SCALING_DOWN_SEQUENCE;
+        }
+        nSteps = N_STEPS;
+        return to == Level::BOOST ? BOOST_SEQUENCE : IDLE_SEQUENCE;
+    }
+
+}
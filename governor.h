@@ -0,0 +1,102 @@
+#ifndef _GOVERNOR_H_
+#define _GOVERNOR_H_
+
+#include <stdint.h>
+
+// Policy of the main clock (see Clocks) : the CPU runs from RCFAST at 12MHz while idle, and is
+// boosted to 48MHz from the PLL which already runs for the USB while there is work to do in the
+// main loop (button events, commands, screen rendering). The boost is kept for HOLD after the
+// last demand, so that the work of consecutive iterations does not switch back and forth.
+// The PBA clock is divided in boost to stay at 12MHz : the SPI baudrate, the TC timebases
+// (see Timestamp and Shutter) and the ADC are the same at both levels. The AST runs from its own
+// 32kHz clock and the USB from the PLL, which are never changed.
+// In passthrough mode, the idle level keeps the core voltage and the flash settings of the boost
+// (IDLE_PS2), at the cost of a slightly higher consumption : a switch then only changes the PBA
+// divider and the main clock, with the interrupts masked for a few cycles instead of the time
+// the regulator takes to settle, which would delay the input edges. The power scaling is only
+// changed when the mode is selected.
+// The switches follow the sequences below, checked on a host against a model of the clock tree.
+// This module does not access the hardware, so that it can be checked on a host.
+namespace Governor {
+
+    enum class Level : uint8_t {
+        IDLE,
+        IDLE_PS2,
+        BOOST,
+    };
+
+    const unsigned long IDLE_FREQUENCY = 12000000; // Hz, RCFAST
+    const unsigned long BOOST_FREQUENCY = 48000000; // Hz, PLL
+    const unsigned long PBA_DIVIDER_BOOST = 2; // PBA = main clock / 2^2 in boost
+    const uint32_t HOLD = 20; // ms
+
+    enum class Step : uint8_t {
+        DISABLE_INTERRUPTS,
+        ENABLE_INTERRUPTS,
+        POWER_SCALING_PS0,
+        POWER_SCALING_PS2, // The flash high speed mode is enabled before PS2, and disabled after it
+        FLASH_NO_WAIT_STATE,
+        FLASH_WAIT_STATE,
+        PBA_UNDIVIDED,
+        PBA_DIVIDED,
+        MAIN_CLOCK_IDLE,
+        MAIN_CLOCK_BOOST,
+    };
+
+    // The core voltage and the flash wait state are raised before the clock, and lowered after it.
+    // The PBA divider and the main clock are changed together with the interrupts disabled, so that
+    // the PBA clock is only slower than 12MHz for a few cycles, and never faster.
+    const int N_STEPS = 6;
+    const Step BOOST_SEQUENCE[N_STEPS] = {
+        Step::POWER_SCALING_PS2,
+        Step::FLASH_WAIT_STATE,
+        Step::DISABLE_INTERRUPTS,
+        Step::PBA_DIVIDED,
+        Step::MAIN_CLOCK_BOOST,
+        Step::ENABLE_INTERRUPTS,
+    };
+    const Step IDLE_SEQUENCE[N_STEPS] = {
+        Step::DISABLE_INTERRUPTS,
+        Step::MAIN_CLOCK_IDLE,
+        Step::PBA_UNDIVIDED,
+        Step::ENABLE_INTERRUPTS,
+        Step::FLASH_NO_WAIT_STATE,
+        Step::POWER_SCALING_PS0,
+    };
+
+    // Between IDLE_PS2 and the other levels : the same sequences, without the steps which are
+    // already done
+    const int N_CLOCK_STEPS = 4;
+    const Step CLOCK_BOOST_SEQUENCE[N_CLOCK_STEPS] = {
+        Step::DISABLE_INTERRUPTS,
+        Step::PBA_DIVIDED,
+        Step::MAIN_CLOCK_BOOST,
+        Step::ENABLE_INTERRUPTS,
+    };
+    const Step CLOCK_IDLE_SEQUENCE[N_CLOCK_STEPS] = {
+        Step::DISABLE_INTERRUPTS,
+        Step::MAIN_CLOCK_IDLE,
+        Step::PBA_UNDIVIDED,
+        Step::ENABLE_INTERRUPTS,
+    };
+    const int N_SCALING_STEPS = 2;
+    const Step SCALING_UP_SEQUENCE[N_SCALING_STEPS] = {
+        Step::POWER_SCALING_PS2,
+        Step::FLASH_WAIT_STATE,
+    };
+    const Step SCALING_DOWN_SEQUENCE[N_SCALING_STEPS] = {
+        Step::FLASH_NO_WAIT_STATE,
+        Step::POWER_SCALING_PS0,
+    };
+
+    void reset();
+    void setEnabled(bool enabled);
+    void setLowLatency(bool lowLatency);
+    void demand(uint32_t now);
+    bool change(uint32_t now, Level& from, Level& to);
+    Level level();
+    const Step* sequence(Level from, Level to, int& nSteps);
+
+}
+
+#endif
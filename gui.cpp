@@ -1,8 +1,11 @@
 #include "gui.h"
 #include "sync.h"
 #include "sync_usb.h"
+#include "schema.h"
+#include "presets.h"
 #include "pins.h"
 #include "icons.h"
+#include "profiler.h"
 #include "drivers/oled_ssd1306/oled.h"
 #include "drivers/oled_ssd1306/font.h"
 #include <string.h>
@@ -27,6 +30,15 @@ const char MENU_LABELS[GUI::N_MENU_ITEMS][10] = {
 
 
 
+// The payloads of the menus are described in schema.h
+static_assert(Schema::N_MENUS == GUI::N_MENU_ITEMS
+        && Schema::MENUS[GUI::MENU_TRIGGER].syncField == Schema::TRIGGER_SYNC
+        && Schema::MENUS[GUI::MENU_DELAY].syncField == Schema::DELAY_SYNC
+        && Schema::MENUS[GUI::MENU_INTERVAL].syncField == Schema::INTERVAL_SYNC
+        && Schema::MENUS[GUI::MENU_TIMINGS].syncField == Schema::TIMINGS_SYNC
+        && Schema::MENUS[GUI::MENU_INPUT].syncField == Schema::INPUT_SYNC
+        && Schema::MENUS[GUI::MENU_SETTINGS].fields[0] == Schema::SYNC_CHANNEL, "the menus don't match schema.h");
+
 const int MENU_HEIGHT = 11;
 const int FOOTER_HEIGHT = 11;
 Core::Time _tMenuChange = 0;
@@ -34,6 +46,25 @@ const int DELAY_MENU_LABEL = 500;
 Core::Time _tGUIInit = 0;
 const int DELAY_LOGO_INIT = 1500;
 
+const int N_VISIBLE_SUBMENU_ITEMS = 3;
+
+const char WAKE_LABELS[Sync::N_WAKE_INTERVALS][22] = {
+    "Wake : always on",
+    "Wake : every 250ms",
+    "Wake : every 500ms",
+    "Wake : every 1s",
+    "Wake : every 2s",
+};
+
+// Longest wake interval of the modules of the channel, which sizes the preamble (see sync.h)
+const char CHANNEL_WAKE_LABELS[Sync::N_WAKE_INTERVALS][22] = {
+    "Group : always on",
+    "Group : every 250ms",
+    "Group : every 500ms",
+    "Group : every 1s",
+    "Group : every 2s",
+};
+
 const int N_BRIGHTNESS_LEVELS = 4;
 const int _brightnessValues[N_BRIGHTNESS_LEVELS] = {0, 10, 20, 255};
 
@@ -113,7 +144,7 @@ void GUI::showFooter(bool trigger, bool triggerHold, bool focus, bool focusHold,
     const int BAT_BAR_WIDTH = 2;
     const int BAT_WIDTH = 2 + BAT_N_BARS * BAT_BAR_WIDTH + (BAT_N_BARS - 1) + 2 + 1;
     const int BAT_HEIGHT = 7;
-    const int BAT_LEVELS[BAT_N_BARS] = {3300, 3700, 4000};
+    const int BAT_LEVELS[BAT_N_BARS] = {10, 40, 70}; // %
     for (int x = 0; x < BAT_WIDTH; x++) {
         if (x == 0 || x == BAT_WIDTH - 2) {
             for (int y = 1; y < BAT_HEIGHT - 1; y++) {
@@ -129,7 +160,7 @@ void GUI::showFooter(bool trigger, bool triggerHold, bool focus, bool focusHold,
         }
     }
     for (int i = 0; i < BAT_N_BARS; i++) {
-        if (Context::_vBat >= BAT_LEVELS[i]) {
+        if (Context::_batteryLevel >= BAT_LEVELS[i]) {
             for (int x = 0; x < BAT_BAR_WIDTH; x++) {
                 for (int y = 2; y < BAT_HEIGHT - 2; y++) {
                     OLED::setPixel(BAT_X + 2 + i * BAT_BAR_WIDTH + i + x, BAT_Y + y);
@@ -157,6 +188,17 @@ void GUI::showFooter(bool trigger, bool triggerHold, bool focus, bool focusHold,
         }
     }
 
+    // Remaining runtime at the current power profile, in hours or in minutes under one hour
+    if (!(trigger || focus || waiting) && Context::_batteryMinutesLeft >= 0) {
+        if (Context::_batteryMinutesLeft >= 60) {
+            OLED::printInt(26, OLED::HEIGHT - 8, Context::_batteryMinutesLeft / 60);
+            OLED::print("h");
+        } else {
+            OLED::printInt(26, OLED::HEIGHT - 8, Context::_batteryMinutesLeft);
+            OLED::print("m");
+        }
+    }
+
     // Shots left and countdown
     if (trigger || focus || waiting) {
         if (Context::_tTrigger > 0) {
@@ -259,39 +301,79 @@ void GUI::showMenuContent() {
             OLED::checkbox(2, MENU_HEIGHT + 2 + buttonHeight + 1, OLED::WIDTH - 4, buttonHeight, "Sync", Context::_submenuItemSelected == SUBMENU_INPUT_SYNC, Context::_submenuItemSelected == SUBMENU_INPUT_SYNC && Context::_btnOkPressed, Context::_inputSync);
 
         } else if (Context::_menuItemSelected == MENU_SETTINGS) {
-            char str[22] = "";
-            if (Context::_radio == SUBMENU_SETTINGS_RADIO_DISABLED) {
-                strncpy(str, "Radio : disabled", 22);
-            } else if (Context::_radio == SUBMENU_SETTINGS_RADIO_RX_ONLY) {
-                strncpy(str, "Radio : receiver only", 22);
-            } else if (Context::_radio == SUBMENU_SETTINGS_RADIO_ENABLED) {
-                strncpy(str, "Radio : enabled", 22);
+            // This menu has more items than the screen can display : scroll to keep the selected one visible
+            int firstItem = SUBMENU_SETTINGS_RADIO;
+            if (Context::_submenuItemSelected > SUBMENU_SETTINGS_RADIO + N_VISIBLE_SUBMENU_ITEMS - 1) {
+                firstItem = Context::_submenuItemSelected - N_VISIBLE_SUBMENU_ITEMS + 1;
             }
-            OLED::button(2, MENU_HEIGHT + 2, OLED::WIDTH - 4, buttonHeight, str, Context::_submenuItemSelected == SUBMENU_SETTINGS_RADIO, false, Context::_radio != SUBMENU_SETTINGS_RADIO_DISABLED, Context::_radio != SUBMENU_SETTINGS_RADIO_ENABLED);
+            const int yMin = MENU_HEIGHT + 2;
+            const int yMax = OLED::HEIGHT - FOOTER_HEIGHT - buttonHeight;
+            int y = yMin + (SUBMENU_SETTINGS_RADIO - firstItem) * (buttonHeight + 1);
+
+            if (y >= yMin && y <= yMax) {
+                char str[22] = "";
+                if (Context::_radio == SUBMENU_SETTINGS_RADIO_DISABLED) {
+                    strncpy(str, "Radio : disabled", 22);
+                } else if (Context::_radio == SUBMENU_SETTINGS_RADIO_RX_ONLY) {
+                    strncpy(str, "Radio : receiver only", 22);
+                } else if (Context::_radio == SUBMENU_SETTINGS_RADIO_ENABLED) {
+                    strncpy(str, "Radio : enabled", 22);
+                }
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, str, Context::_submenuItemSelected == SUBMENU_SETTINGS_RADIO, false, Context::_radio != SUBMENU_SETTINGS_RADIO_DISABLED, Context::_radio != SUBMENU_SETTINGS_RADIO_ENABLED);
+            }
+            y += buttonHeight + 1;
 
-            char strChannel[13] = "Channel :   ";
-            if (Context::_syncChannel >= 10) {
-                strChannel[10] = ((Context::_syncChannel / 10) % 10) + '0';
-                strChannel[11] = (Context::_syncChannel % 10) + '0';
-            } else {
-                strChannel[10] = Context::_syncChannel + '0';
+            if (y >= yMin && y <= yMax) {
+                char strChannel[13] = "Channel :   ";
+                if (Context::_syncChannel >= 10) {
+                    strChannel[10] = ((Context::_syncChannel / 10) % 10) + '0';
+                    strChannel[11] = (Context::_syncChannel % 10) + '0';
+                } else {
+                    strChannel[10] = Context::_syncChannel + '0';
+                }
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, strChannel, Context::_submenuItemSelected == SUBMENU_SETTINGS_CHANNEL, false);
+            }
+            y += buttonHeight + 1;
+
+            if (y >= yMin && y <= yMax) {
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, WAKE_LABELS[Context::_wakeInterval], Context::_submenuItemSelected == SUBMENU_SETTINGS_WAKE, false, Context::_wakeInterval > 0, Context::_wakeInterval < Sync::N_WAKE_INTERVALS - 1);
             }
-            OLED::button(2, MENU_HEIGHT + 2 + buttonHeight + 1, OLED::WIDTH - 4, buttonHeight, strChannel, Context::_submenuItemSelected == SUBMENU_SETTINGS_CHANNEL, false);
+            y += buttonHeight + 1;
 
-            OLED::button(2, MENU_HEIGHT + 2 + 2 * (buttonHeight + 1), OLED::WIDTH - 4, buttonHeight, "", Context::_submenuItemSelected == SUBMENU_SETTINGS_BRIGHTNESS, false, Context::_brightness > 0, Context::_brightness < N_BRIGHTNESS_LEVELS - 1);
-            const char* label = "Brightness : ";
-            int width = OLED::textWidth(label) + 14;
-            OLED::print((OLED::WIDTH - width) / 2, MENU_HEIGHT + 2 + 2 * (buttonHeight + 1) + (buttonHeight - 8) / 2, label);
-            OLED::progressbar(OLED::cursorX(), OLED::cursorY() + 1, 14, 7, Context::_brightness * 100 / (N_BRIGHTNESS_LEVELS - 1));
+            if (y >= yMin && y <= yMax) {
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, CHANNEL_WAKE_LABELS[Context::_channelWakeInterval], Context::_submenuItemSelected == SUBMENU_SETTINGS_CHANNEL_WAKE, false, Context::_channelWakeInterval > 0, Context::_channelWakeInterval < Sync::N_WAKE_INTERVALS - 1);
+            }
+            y += buttonHeight + 1;
+
+            if (y >= yMin && y <= yMax) {
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, "", Context::_submenuItemSelected == SUBMENU_SETTINGS_BRIGHTNESS, false, Context::_brightness > 0, Context::_brightness < N_BRIGHTNESS_LEVELS - 1);
+                const char* label = "Brightness : ";
+                int width = OLED::textWidth(label) + 14;
+                OLED::print((OLED::WIDTH - width) / 2, y + (buttonHeight - 8) / 2, label);
+                OLED::progressbar(OLED::cursorX(), OLED::cursorY() + 1, 14, 7, Context::_brightness * 100 / (N_BRIGHTNESS_LEVELS - 1));
+            }
+            y += buttonHeight + 1;
+
+            if (y >= yMin && y <= yMax) {
+                char str[22] = "Preset : ";
+                strncat(str, Presets::get(Context::_presetSelected).name, sizeof(str) - strlen(str) - 1);
+                OLED::button(2, y, OLED::WIDTH - 4, buttonHeight, str, Context::_submenuItemSelected == SUBMENU_SETTINGS_PRESET, Context::_submenuItemSelected == SUBMENU_SETTINGS_PRESET && Context::_btnOkPressed, Context::_presetSelected > 0, Context::_presetSelected < Presets::N_PRESETS - 1);
+            }
         }
     }
 }
 
-bool GUI::handleButtons(int forceSync) {
+bool GUI::handleButtons(const Buttons::Event* event, int forceSync) {
     bool buttonPressed = false;
     int menuModified = -1;
 
-    if (GPIO::fallingEdge(PIN_BTN_UP)) {
+    // A press, or a repeat while a value is being edited
+    bool pressed = event != nullptr && (event->transition == Debounce::Transition::PRESS
+            || (event->transition == Debounce::Transition::REPEAT && Context::_editingItem));
+    bool okChanged = event != nullptr && event->button == Buttons::Button::OK
+            && (event->transition == Debounce::Transition::PRESS || event->transition == Debounce::Transition::RELEASE);
+
+    if (pressed && event->button == Buttons::Button::UP) {
         if (Context::_menuItemSelected == MENU_TRIGGER && Context::_submenuItemSelected > 0) {
             Context::_submenuItemSelected--;
 
@@ -342,7 +424,7 @@ bool GUI::handleButtons(int forceSync) {
         }
         buttonPressed = true;
 
-    } else if (GPIO::fallingEdge(PIN_BTN_DOWN)) {
+    } else if (pressed && event->button == Buttons::Button::DOWN) {
         _tMenuChange = 0;
         if (Context::_menuItemSelected == MENU_TRIGGER && Context::_submenuItemSelected < SUBMENU_TRIGGER_SYNC) {
             Context::_submenuItemSelected++;
@@ -386,7 +468,7 @@ bool GUI::handleButtons(int forceSync) {
         } else if (Context::_menuItemSelected == MENU_INPUT && Context::_submenuItemSelected < SUBMENU_INPUT_SYNC) {
             Context::_submenuItemSelected++;
 
-        } else if (Context::_menuItemSelected == MENU_SETTINGS && Context::_submenuItemSelected < SUBMENU_SETTINGS_BRIGHTNESS) {
+        } else if (Context::_menuItemSelected == MENU_SETTINGS && Context::_submenuItemSelected < SUBMENU_SETTINGS_PRESET) {
             Context::_submenuItemSelected++;
         }
         if (Context::_submenuItemSelected == 1) {
@@ -394,7 +476,7 @@ bool GUI::handleButtons(int forceSync) {
         }
         buttonPressed = true;
 
-    } else if (GPIO::fallingEdge(PIN_BTN_LEFT)) {
+    } else if (pressed && event->button == Buttons::Button::LEFT) {
         if (Context::_submenuItemSelected == 0) {
             if (Context::_menuItemSelected > 0) {
                 setMenu(Context::_menuItemSelected - 1);
@@ -475,18 +557,35 @@ bool GUI::handleButtons(int forceSync) {
                     if (Context::_syncChannel > 0) {
                         Context::_syncChannel--;
                     }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_WAKE) {
+                    if (Context::_wakeInterval > 0) {
+                        Context::_wakeInterval--;
+                    }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_CHANNEL_WAKE) {
+                    // The frames of the other modules would be missed by this one if it slept longer
+                    if (Context::_channelWakeInterval > 0) {
+                        Context::_channelWakeInterval--;
+                        if (Context::_wakeInterval > Context::_channelWakeInterval) {
+                            Context::_wakeInterval = Context::_channelWakeInterval;
+                        }
+                        Sync::sendWakeInterval();
+                    }
                 } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_BRIGHTNESS) {
                     if (Context::_brightness > 0) {
                         Context::_brightness--;
                         updateBrightness();
                     }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_PRESET) {
+                    if (Context::_presetSelected > 0) {
+                        Context::_presetSelected--;
+                    }
                 }
                 menuModified = MENU_SETTINGS;
             }
         }
         buttonPressed = true;
 
-    } else if (GPIO::fallingEdge(PIN_BTN_RIGHT)) {
+    } else if (pressed && event->button == Buttons::Button::RIGHT) {
         if (Context::_submenuItemSelected == 0) {
             if (Context::_menuItemSelected < N_MENU_ITEMS - 1) {
                 setMenu(Context::_menuItemSelected + 1);
@@ -567,19 +666,37 @@ bool GUI::handleButtons(int forceSync) {
                     if (Context::_syncChannel < Sync::N_CHANNELS) {
                         Context::_syncChannel++;
                     }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_WAKE) {
+                    // The other modules must use a preamble which spans this interval
+                    if (Context::_wakeInterval < Sync::N_WAKE_INTERVALS - 1) {
+                        Context::_wakeInterval++;
+                        if (Context::_channelWakeInterval < Context::_wakeInterval) {
+                            Context::_channelWakeInterval = Context::_wakeInterval;
+                            Sync::sendWakeInterval();
+                        }
+                    }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_CHANNEL_WAKE) {
+                    if (Context::_channelWakeInterval < Sync::N_WAKE_INTERVALS - 1) {
+                        Context::_channelWakeInterval++;
+                        Sync::sendWakeInterval();
+                    }
                 } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_BRIGHTNESS) {
                     if (Context::_brightness < N_BRIGHTNESS_LEVELS - 1) {
                         Context::_brightness++;
                         updateBrightness();
                     }
+                } else if (Context::_submenuItemSelected == SUBMENU_SETTINGS_PRESET) {
+                    if (Context::_presetSelected < Presets::N_PRESETS - 1) {
+                        Context::_presetSelected++;
+                    }
                 }
                 menuModified = MENU_SETTINGS;
             }
         }
         buttonPressed = true;
 
-    } else if ((!Context::_btnOkPressed && GPIO::fallingEdge(PIN_BTN_OK)) || (Context::_btnOkPressed && GPIO::risingEdge(PIN_BTN_OK))) {
-        Context::_btnOkPressed = !GPIO::get(PIN_BTN_OK);
+    } else if (okChanged) {
+        Context::_btnOkPressed = event->transition == Debounce::Transition::PRESS;
 
         if (Context::_menuItemSelected == MENU_TRIGGER) {
             if (Context::_submenuItemSelected == SUBMENU_TRIGGER_FOCUS && !Context::_submenuFocusHold) {
@@ -587,7 +704,7 @@ bool GUI::handleButtons(int forceSync) {
                     if (Context::_tFocus == 0) {
                         // Start
                         copyShadowContext();
-                        Context::_tFocus = Core::time();
+                        Context::_tFocus = event->t;
                         if (Context::_triggerSync) {
                             Sync::send(Sync::CMD_FOCUS);
                         }
@@ -607,7 +724,7 @@ bool GUI::handleButtons(int forceSync) {
                         if (!Context::_submenuTriggerHold) {
                             // Start
                             copyShadowContext();
-                            Context::_tTrigger = Core::time();
+                            Context::_tTrigger = event->t;
                             Context::_skipDelay = false;
                             if (Context::_triggerSync) {
                                 Sync::send(Sync::CMD_TRIGGER);
@@ -695,7 +812,11 @@ bool GUI::handleButtons(int forceSync) {
             }
 
         } else if (Context::_menuItemSelected == MENU_SETTINGS) {
-            // Nothing to check in this menu
+            if (Context::_submenuItemSelected == SUBMENU_SETTINGS_PRESET) {
+                if (Context::_btnOkPressed) {
+                    recallPreset(Context::_presetSelected);
+                }
+            }
         }
 
         buttonPressed = true;
@@ -705,78 +826,13 @@ bool GUI::handleButtons(int forceSync) {
     if (forceSync > -1) {
         menuModified = forceSync;
     }
-    if (menuModified > -1) {
+    if (menuModified > -1 && menuModified < Schema::N_MENUS) {
         uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
-        int payloadSize = 0;
-        int payloadSizeUSB = 0;
-        bool sendSync = false;
-        bool sendUSB = SyncUSB::isConnected();
-        if (menuModified == MENU_TRIGGER) {
-            payload[0] = Context::_submenuFocusHold;
-            payload[1] = Context::_submenuTriggerHold;
-            payload[2] = Context::_triggerSync;
-            payloadSize = 2;
-            payloadSizeUSB = 3;
-            if (Context::_triggerSync) {
-                sendSync = true;
-            }
-
-        } else if (menuModified == MENU_DELAY) {
-            payload[0] = ((Context::_delayMs / 100) >> 16) & 0xFF;
-            payload[1] = ((Context::_delayMs / 100) >> 8) & 0xFF;
-            payload[2] = (Context::_delayMs / 100) & 0xFF;
-            payload[3] = Context::_delaySync;
-            payloadSize = 3;
-            payloadSizeUSB = 4;
-            if (Context::_delaySync) {
-                sendSync = true;
-            }
-
-        } else if (menuModified == MENU_INTERVAL) {
-            payload[0] = Context::_intervalNShots & 0xFF;
-            payload[1] = ((Context::_intervalDelayMs / 100) >> 16) & 0xFF;
-            payload[2] = ((Context::_intervalDelayMs / 100) >> 8) & 0xFF;
-            payload[3] = (Context::_intervalDelayMs / 100) & 0xFF;
-            payload[4] = Context::_intervalSync;
-            payloadSize = 4;
-            payloadSizeUSB = 5;
-            if (Context::_intervalSync) {
-                sendSync = true;
-            }
-
-        } else if (menuModified == MENU_TIMINGS) {
-            payload[0] = ((Context::_timingsFocusDurationMs / 100) >> 16) & 0xFF;
-            payload[1] = ((Context::_timingsFocusDurationMs / 100) >> 8) & 0xFF;
-            payload[2] = (Context::_timingsFocusDurationMs / 100) & 0xFF;
-            payload[3] = ((Context::_timingsTriggerDurationMs / 100) >> 16) & 0xFF;
-            payload[4] = ((Context::_timingsTriggerDurationMs / 100) >> 8) & 0xFF;
-            payload[5] = (Context::_timingsTriggerDurationMs / 100) & 0xFF;
-            payload[6] = Context::_timingsSync;
-            payloadSize = 6;
-            payloadSizeUSB = 7;
-            if (Context::_timingsSync) {
-                sendSync = true;
-            }
-
-        } else if (menuModified == MENU_INPUT) {
-            payload[0] = Context::_inputMode & 0xFF;
-            payload[1] = Context::_inputSync;
-            payloadSize = 1;
-            payloadSizeUSB = 2;
-            if (Context::_inputSync) {
-                sendSync = true;
-            }
-
-        } else if (menuModified == MENU_SETTINGS) {
-            payload[0] = Context::_syncChannel;
-            payloadSizeUSB = 1;
+        if (Schema::isMenuSynced(menuModified)) {
+            Sync::send(menuModified, payload, Schema::encodeMenu(menuModified, payload, false));
         }
-
-        if (sendSync) {
-            Sync::send(menuModified, payload, payloadSize);
-        }
-        if (sendUSB) {
-            SyncUSB::send(menuModified, payload, payloadSizeUSB);
+        if (SyncUSB::isConnected()) {
+            SyncUSB::send(menuModified, payload, Schema::encodeMenu(menuModified, payload, true));
         }
     }
 
@@ -814,7 +870,9 @@ void GUI::update(bool refresh, bool refreshFooter, bool trigger, bool triggerHol
 
     // Update screen
     if (refresh || refreshFooter) {
+        PROFILE_START(OLED_REFRESH);
         OLED::refresh();
+        PROFILE_STOP(OLED_REFRESH);
     }
 }
 
@@ -1053,6 +1111,30 @@ void GUI::showExitScreen() {
     OLED::refresh();
 }
 
+// Apply a preset, and send it to the other modules which have the same menus synced
+void GUI::recallPreset(int index) {
+    uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+    Presets::apply(Presets::get(index), Presets::menus());
+    uint8_t synced = Schema::syncedMenus(Presets::menus());
+    if (synced != 0) {
+        Sync::send(Sync::CMD_PRESET, payload, Presets::encodeFrame(index, synced, payload));
+    }
+    sendMenusUSB(Presets::menus());
+}
+
+// Send the new settings of several menus (1 << MENU_*) to the host
+void GUI::sendMenusUSB(uint8_t mask) {
+    if (!SyncUSB::isConnected()) {
+        return;
+    }
+    uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+    for (int i = 0; i < Schema::N_MENUS; i++) {
+        if (mask & (1 << i)) {
+            SyncUSB::send(i, payload, Schema::encodeMenu(i, payload, true));
+        }
+    }
+}
+
 void GUI::updateBrightness() {
     OLED::setContrast(_brightnessValues[Context::_brightness]);
 }
@@ -4,6 +4,7 @@
 #include <core.h>
 #include "drivers/oled_ssd1306/oled.h"
 #include "context.h"
+#include "buttons.h"
 
 namespace GUI {
 
@@ -39,7 +40,10 @@ namespace GUI {
     const int SUBMENU_SETTINGS_RADIO_RX_ONLY = 1;
     const int SUBMENU_SETTINGS_RADIO_ENABLED = 2;
     const int SUBMENU_SETTINGS_CHANNEL = 2;
-    const int SUBMENU_SETTINGS_BRIGHTNESS = 3;
+    const int SUBMENU_SETTINGS_WAKE = 3;
+    const int SUBMENU_SETTINGS_CHANNEL_WAKE = 4;
+    const int SUBMENU_SETTINGS_BRIGHTNESS = 5;
+    const int SUBMENU_SETTINGS_PRESET = 6;
 
 
     void init();
@@ -47,7 +51,7 @@ namespace GUI {
     void showMenu();
     void showFooter(bool trigger, bool triggerHold, bool focus, bool focusHold, bool waiting, bool input);
     void showMenuContent();
-    bool handleButtons(int forceSync=-1);
+    bool handleButtons(const Buttons::Event* event, int forceSync=-1);
     void update(bool refresh, bool refreshFooter, bool trigger, bool triggerHold, bool focus, bool focusHold, bool waiting, bool input);
     void displayTimeButton(unsigned int x, unsigned int y, unsigned int width, unsigned int height, const char* label, unsigned int valueMs, bool selected=false, bool editing=false, int editingCursor=0);
     void displayTime(unsigned int x, unsigned int y, const char* label, unsigned int valueMs, bool selected=false, bool editing=false, int editingCursor=0, OLED::Alignment alignment=OLED::Alignment::LEFT, bool displayFrac=true);
@@ -57,6 +61,8 @@ namespace GUI {
     void incrementIntButton(int& value, unsigned int length);
     void decrementIntButton(int& value, unsigned int length, int min=0);
     void showExitScreen();
+    void recallPreset(int index);
+    void sendMenusUSB(uint8_t mask);
     void updateBrightness();
     void copyShadowContext();
 
@@ -0,0 +1,183 @@
+#include "journal.h"
+#include <string.h>
+
+namespace Journal {
+
+    // Last saved state
+    uint32_t _values[MAX_FIELDS];
+    uint32_t _known = 0;
+
+    // Write position
+    int _page = -1;
+    int _pos = 0;
+    uint32_t _sequence = 0;
+    bool _mustCompact = false;
+
+    // CRC-32 lookup table for one nibble
+    const uint32_t CRC32_TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    // Internal functions
+    bool isPageValid(const uint32_t page[], uint32_t& sequence);
+    int parseRecord(const uint32_t page[], int pos);
+    int writeRecord(uint32_t page[], int pos, uint32_t mask);
+    void compact(uint32_t mask);
+
+
+    uint32_t crc32(const uint32_t* words, int n) {
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(words);
+        uint32_t crc = 0xFFFFFFFF;
+        for (int i = 0; i < 4 * n; i++) {
+            crc ^= data[i];
+            crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+            crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+        }
+        return ~crc;
+    }
+
+    // A page is valid if its header is complete and its first record is intact
+    bool isPageValid(const uint32_t page[], uint32_t& sequence) {
+        if (page[0] != PAGE_MAGIC || page[1] != ~page[2]) {
+            return false;
+        }
+        sequence = page[1];
+        return parseRecord(page, PAGE_HEADER_SIZE) > 0;
+    }
+
+    // Return the size of the record at pos, 0 if there is none, or -1 if it is corrupted
+    int parseRecord(const uint32_t page[], int pos) {
+        if (pos >= Flash::FLASH_PAGE_SIZE_WORDS || page[pos] == 0xFFFFFFFF) {
+            return 0;
+        }
+        int n = page[pos] & 0xFF;
+        if (page[pos] >> 16 != RECORD_TAG || n == 0 || n > MAX_FIELDS
+                || pos + RECORD_OVERHEAD + n > Flash::FLASH_PAGE_SIZE_WORDS
+                || __builtin_popcount(page[pos + 1]) != n
+                || crc32(page + pos, 2 + n) != page[pos + 2 + n]) {
+            return -1;
+        }
+        return RECORD_OVERHEAD + n;
+    }
+
+    // Write a record containing the fields of mask from the saved state, and return its size
+    int writeRecord(uint32_t page[], int pos, uint32_t mask) {
+        int n = 0;
+        for (int i = 0; i < MAX_FIELDS; i++) {
+            if (mask & (1u << i)) {
+                page[pos + 2 + n] = _values[i];
+                n++;
+            }
+        }
+        page[pos] = RECORD_TAG << 16 | n;
+        page[pos + 1] = mask;
+        page[pos + 2 + n] = crc32(page + pos, 2 + n);
+        return RECORD_OVERHEAD + n;
+    }
+
+    uint32_t init(uint32_t values[], int nFields) {
+        _known = 0;
+        _page = -1;
+        _pos = 0;
+        _sequence = 0;
+        _mustCompact = false;
+
+        // Find the active page
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        for (int i = 0; i < N_PAGES; i++) {
+            uint32_t sequence = 0;
+            Flash::readPage(FIRST_PAGE + i, page);
+            if (isPageValid(page, sequence) && (_page < 0 || sequence > _sequence)) {
+                _page = i;
+                _sequence = sequence;
+            }
+        }
+        if (_page < 0) {
+            return 0;
+        }
+
+        // Replay its records
+        Flash::readPage(FIRST_PAGE + _page, page);
+        _pos = PAGE_HEADER_SIZE;
+        int size = 0;
+        while ((size = parseRecord(page, _pos)) > 0) {
+            uint32_t mask = page[_pos + 1];
+            int n = 0;
+            for (int i = 0; i < MAX_FIELDS; i++) {
+                if (mask & (1u << i)) {
+                    _values[i] = page[_pos + 2 + n];
+                    n++;
+                }
+            }
+            _known |= mask;
+            _pos += size;
+        }
+
+        // A record interrupted by a power loss may have left programmed bits anywhere after the
+        // last valid one : don't append to this page anymore
+        if (size < 0) {
+            _mustCompact = true;
+        }
+        for (int i = _pos; i < Flash::FLASH_PAGE_SIZE_WORDS; i++) {
+            if (page[i] != 0xFFFFFFFF) {
+                _mustCompact = true;
+            }
+        }
+
+        for (int i = 0; i < nFields && i < MAX_FIELDS; i++) {
+            if (_known & (1u << i)) {
+                values[i] = _values[i];
+            }
+        }
+        return _known & (nFields < MAX_FIELDS ? (1u << nFields) - 1 : 0xFFFFFFFF);
+    }
+
+    // Write the whole saved state at the beginning of the next page of the ring. The current page
+    // is left untouched, so it is still the active one if this is interrupted.
+    void compact(uint32_t mask) {
+        _page = (_page + 1) % N_PAGES;
+        _sequence++;
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        memset(page, 0xFF, sizeof(page));
+        page[0] = PAGE_MAGIC;
+        page[1] = _sequence;
+        page[2] = ~_sequence;
+        _pos = PAGE_HEADER_SIZE + writeRecord(page, PAGE_HEADER_SIZE, mask);
+        Flash::erasePage(FIRST_PAGE + _page);
+        Flash::programPage(FIRST_PAGE + _page, page);
+        _mustCompact = false;
+    }
+
+    int save(const uint32_t values[], int nFields) {
+        // Find the fields which changed
+        uint32_t changed = 0;
+        for (int i = 0; i < nFields && i < MAX_FIELDS; i++) {
+            if (!(_known & (1u << i)) || values[i] != _values[i]) {
+                changed |= 1u << i;
+                _values[i] = values[i];
+            }
+        }
+        if (changed == 0) {
+            return 0;
+        }
+        _known |= changed;
+        int n = __builtin_popcount(changed);
+
+        if (_page < 0 || _mustCompact || _pos + RECORD_OVERHEAD + n > Flash::FLASH_PAGE_SIZE_WORDS) {
+            compact(_known);
+        } else {
+            // Append the record : the erased words of the page buffer don't modify the flash
+            uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+            memset(page, 0xFF, sizeof(page));
+            _pos += writeRecord(page, _pos, changed);
+            Flash::programPage(FIRST_PAGE + _page, page);
+        }
+        return n;
+    }
+
+    int activePage() {
+        return _page;
+    }
+
+}
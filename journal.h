@@ -0,0 +1,53 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <stdint.h>
+#include <flash.h>
+
+// Wear-levelled, append-only storage for the settings, in the last pages of the main flash.
+// Each save appends a record containing only the fields which changed since the last one.
+// When the current page is full, the whole state is compacted into the next page of the ring,
+// which spreads the erases over every page. Records are protected by a CRC-32 and written with
+// a single page program command, so a power loss during a save leaves either the previous or
+// the new state. This module only depends on the Flash API, so it can be tested on the host
+// (see tools/journal_sim).
+//
+// Page layout (32-bit words) :
+// - header : PAGE_MAGIC, sequence number, inverted sequence number
+// - records : RECORD_TAG << 16 | number of values, mask of the fields, values in field order,
+//   CRC-32 of the previous words
+// - erased words (0xFFFFFFFF) up to the end of the page
+// The active page is the valid one with the highest sequence number ; its first record
+// always contains every field.
+namespace Journal {
+
+    const int N_PAGES = 4;
+    // These pages are reserved with N_RESERVED_FLASH_PAGES in the Makefile, so that the firmware
+    // can't grow into them and the bootloader doesn't overwrite them
+    const int FIRST_PAGE = Flash::FLASH_PAGES - N_PAGES;
+#ifdef N_RESERVED_FLASH_PAGES
+    static_assert(N_PAGES <= N_RESERVED_FLASH_PAGES, "The journal pages must be reserved in the Makefile");
+#endif
+    const int MAX_FIELDS = 32;
+
+    const uint32_t PAGE_MAGIC = 0x4A524E4C; // "JRNL"
+    const uint32_t RECORD_TAG = 0x5E7A;
+    const int PAGE_HEADER_SIZE = 3; // words
+    const int RECORD_OVERHEAD = 3; // words
+
+    // Recover the latest state : write the value of every field found in the journal into
+    // values, and return the mask of these fields. The others are left untouched.
+    uint32_t init(uint32_t values[], int nFields);
+
+    // Append the fields which differ from the last saved state, and return how many there were
+    int save(const uint32_t values[], int nFields);
+
+    // Index (from 0 to N_PAGES - 1) of the active page, or -1 if the journal is empty
+    int activePage();
+
+    // CRC-32 (same as zlib's) of n words, also used by the other modules storing data in flash
+    uint32_t crc32(const uint32_t* words, int n);
+
+}
+
+#endif
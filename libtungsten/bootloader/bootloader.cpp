@@ -9,6 +9,7 @@
 #include <flash.h>
 #include <string.h>
 #include "bootloader_config.h"
+#include "upload.h"
 
 // This is the bootloader for the libtungsten library. It can be configured to either open an
 // UART (serial) port or to connect via USB, and to be activated with an external input (such
@@ -27,6 +28,10 @@ enum class Request {
     GET_STATUS,
     WRITE,
     GET_ERROR,
+    WRITE_PAGE,
+    FINISH,
+    GET_PAGE_HASHES,
+    WRITE_COMPRESSED,
 };
 
 // USB status codes (Device -> Host)
@@ -34,6 +39,7 @@ enum class Status {
     READY,
     BUSY,
     ERROR,
+    DONE,
 };
 
 // USB error codes (Device -> Host)
@@ -43,6 +49,9 @@ enum class BLError {
     PROTECTED_AREA,
     UNKNOWN_RECORD_TYPE,
     OVERFLOW,
+    IMAGE_CRC_MISMATCH,
+    SEQUENCE,
+    INCOMPLETE_IMAGE,
 };
 
 // Currently active channel
@@ -67,6 +76,10 @@ enum class Mode {
 // in bytes) = 16384 = 0x4000.
 const int BOOTLOADER_N_FLASH_PAGES = 32;
 
+// Number of flash pages at the end of the flash reserved to the data of the application, which
+// must be kept across uploads. N_RESERVED_FLASH_PAGES is defined in the Makefile.
+const int N_USER_FLASH_PAGES = Flash::FLASH_PAGES - N_RESERVED_FLASH_PAGES;
+
 const int BUFFER_SIZE = 128;
 char _buffer[BUFFER_SIZE];
 volatile int _currentPage = -1;
@@ -83,6 +96,17 @@ bool _onePageWritten = false;
 uint16_t _extendedSegmentAddress = 0;
 uint16_t _extendedLinearAddress = 0;
 
+// Binary upload (WRITE_PAGE/FINISH requests) : the host sends whole pages, then asks for the
+// CRC-32 of the written range to be checked before the firmware is marked as ready.
+// The FINISH payload is : first page (2 bytes), number of pages (2 bytes), CRC-32 (4 bytes), big-endian.
+const int FINISH_PAYLOAD_SIZE = 8;
+const unsigned int DONE_EXIT_DELAY = 200; // ms, gives the host the time to read the DONE status
+volatile bool _finishRequested = false;
+int _finishFirstPage = 0;
+int _finishNPages = 0;
+uint32_t _finishCRC = 0;
+Core::Time _tExit = 0;
+
 
 int usbControlHandler(USB::SetupPacket &lastSetupPacket, uint8_t* data, int size);
 unsigned int parseHex(const char* buffer, int pos, int n);
@@ -184,6 +208,10 @@ int main() {
             Flash::writeFuse(Flash::FUSE_BOOTLOADER_FORCE, false);
         }
 
+        // Pages received with the binary protocol can be written anywhere between the bootloader
+        // and the reserved pages
+        Upload::init(BOOTLOADER_N_FLASH_PAGES, N_USER_FLASH_PAGES - 1);
+
         // Initialize the page buffer used to cache the data to write to the flash
         const int PAGE_BUFFER_SIZE = Flash::FLASH_PAGE_SIZE_BYTES;
         uint8_t pageBuffer[PAGE_BUFFER_SIZE];
@@ -304,6 +332,37 @@ int main() {
                     }
                 }
                 
+                // Program the pages received with the binary protocol
+                Upload::process();
+                if (LED_WRITE_ENABLED && _tExit == 0) {
+                    GPIO::set(PIN_LED_WRITE, Upload::isWriting() ? LED_POLARITY : !LED_POLARITY);
+                }
+
+                // When the whole image has been programmed, check it before marking the firmware as ready.
+                // The range given by the host must only contain user pages and cover every page it
+                // sent, otherwise the CRC would read the bootloader or miss a page.
+                if (_finishRequested) {
+                    Upload::flush();
+                }
+                if (_finishRequested && Upload::isIdle()) {
+                    _finishRequested = false;
+                    Upload::Result range = Upload::checkImageRange(_finishFirstPage, _finishNPages);
+                    if (range == Upload::Result::PROTECTED_AREA) {
+                        _error = BLError::PROTECTED_AREA;
+                    } else if (range == Upload::Result::INCOMPLETE) {
+                        _error = BLError::INCOMPLETE_IMAGE;
+                    } else if (Upload::flashCRC32(_finishFirstPage, _finishNPages) == _finishCRC) {
+                        Flash::writeFuse(Flash::FUSE_BOOTLOADER_FW_READY, true);
+                        _status = Status::DONE;
+                        _tExit = Core::time() + DONE_EXIT_DELAY;
+                    } else {
+                        _error = BLError::IMAGE_CRC_MISMATCH;
+                    }
+                }
+                if (_tExit > 0 && Core::time() >= _tExit) {
+                    _exitBootloader = true;
+                }
+
                 // Handle errors that might have happened in the interrupt handler
                 if (_error != BLError::NONE) {
                     _status = Status::ERROR;
@@ -348,8 +407,8 @@ int main() {
 
                     // Command 0x00 is a data frame
                     if (recordType == 0x00) {
-                        // Bootloader's flash domain is protected
-                        if (page < BOOTLOADER_N_FLASH_PAGES) {
+                        // Bootloader's flash domain and the reserved pages are protected
+                        if (page < BOOTLOADER_N_FLASH_PAGES || page >= N_USER_FLASH_PAGES) {
                             // Error
                             _status = Status::ERROR;
                             _error = BLError::PROTECTED_AREA;
@@ -479,10 +538,29 @@ int usbControlHandler(USB::SetupPacket &lastSetupPacket, uint8_t* data, int size
             _activeChannel = Channel::USB;
 
         } else if (request == Request::GET_STATUS) {
+            // Status, number of free page buffers for WRITE_PAGE, error, 1 if a WRITE_COMPRESSED chunk
+            // can be received ; older hosts only read the first byte
             lastSetupPacket.handled = true;
             if (data != nullptr && size >= 1) {
                 data[0] = static_cast<int>(_status);
-                return 1;
+                if (size < 3) {
+                    return 1;
+                }
+                data[1] = Upload::freeBuffers();
+                data[2] = static_cast<int>(_error);
+                data[3] = Upload::canReceiveCompressed();
+                return size >= 4 ? 4 : 3;
+            }
+
+        } else if (request == Request::GET_PAGE_HASHES) {
+            // Hashes of the current content of the pages starting at wValue, 4 bytes per page,
+            // to let the host send only the pages which have changed
+            lastSetupPacket.handled = true;
+            if (data != nullptr && lastSetupPacket.wValue >= BOOTLOADER_N_FLASH_PAGES) {
+                if (size > USB::BANK_EP0_SIZE) {
+                    size = USB::BANK_EP0_SIZE;
+                }
+                return Upload::getPageHashes(lastSetupPacket.wValue, data, size);
             }
 
         } else if (request == Request::GET_ERROR) {
@@ -505,6 +583,50 @@ int usbControlHandler(USB::SetupPacket &lastSetupPacket, uint8_t* data, int size
                 _status = Status::ERROR;
                 _error = BLError::OVERFLOW;
             }
+
+        } else if (request == Request::WRITE_PAGE && !lastSetupPacket.handled) {
+            // A whole page, wValue is the page number. When both buffers are full the request
+            // is not handled and is STALLed : the host should wait for a free buffer and try again.
+            Upload::Result result = Upload::receivePage(lastSetupPacket.wValue, data, size);
+            if (result == Upload::Result::OK) {
+                lastSetupPacket.handled = true;
+            } else if (result == Upload::Result::PROTECTED_AREA) {
+                lastSetupPacket.handled = true;
+                _error = BLError::PROTECTED_AREA;
+            } else if (result == Upload::Result::INVALID_SIZE) {
+                lastSetupPacket.handled = true;
+                _error = BLError::OVERFLOW;
+            }
+
+        } else if (request == Request::WRITE_COMPRESSED && !lastSetupPacket.handled) {
+            // A chunk of a compressed stream of pages (see lz.h), wIndex is the chunk number and wValue
+            // is the first page of the stream. Like WRITE_PAGE, the request is STALLed if the
+            // previous chunk hasn't been decompressed yet.
+            Upload::Result result = Upload::receiveCompressed(lastSetupPacket.wIndex, lastSetupPacket.wValue, data, size);
+            if (result == Upload::Result::OK) {
+                lastSetupPacket.handled = true;
+            } else if (result == Upload::Result::PROTECTED_AREA) {
+                lastSetupPacket.handled = true;
+                _error = BLError::PROTECTED_AREA;
+            } else if (result == Upload::Result::INVALID_SIZE) {
+                lastSetupPacket.handled = true;
+                _error = BLError::OVERFLOW;
+            } else if (result == Upload::Result::SEQUENCE) {
+                lastSetupPacket.handled = true;
+                _error = BLError::SEQUENCE;
+            }
+
+        } else if (request == Request::FINISH && !lastSetupPacket.handled) {
+            lastSetupPacket.handled = true;
+            if (size >= FINISH_PAYLOAD_SIZE) {
+                _finishFirstPage = data[0] << 8 | data[1];
+                _finishNPages = data[2] << 8 | data[3];
+                _finishCRC = (uint32_t)data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+                _status = Status::BUSY;
+                _finishRequested = true;
+            } else {
+                _error = BLError::OVERFLOW;
+            }
         }
     }
 
@@ -535,6 +657,11 @@ unsigned int parseHex(const char* buffer, int pos, int n) {
 
 // Write a page to flash memory
 void writePage(int page, const uint8_t* buffer) {
+    // Don't wear the flash if the page didn't change since the last upload. The comparison
+    // reads the flash through the cache, which Flash::writePage() invalidates.
+    if (Upload::isPageUnchanged(page, (const uint32_t*)buffer)) {
+        return;
+    }
     if (!_onePageWritten) {
         // If this is the first time a page is written, this means that
         // the flash doesn't contain a valid firmware anymore : disable
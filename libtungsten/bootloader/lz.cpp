@@ -0,0 +1,85 @@
+#include "lz.h"
+
+namespace LZ {
+
+    enum class State {
+        FLAGS, // Waiting for a flag byte
+        ITEM, // Waiting for the first byte of an item
+        MATCH, // Waiting for the second byte of a match
+    };
+
+    // History of the last WINDOW_SIZE bytes produced, for the matches
+    uint8_t _window[WINDOW_SIZE];
+    int _windowPos = 0;
+
+    State _state = State::FLAGS;
+    uint8_t _flags = 0;
+    int _nItems = 0; // Items left in the current group
+    uint8_t _matchByte0 = 0;
+    int _matchOffset = 0;
+    int _matchLength = 0; // Bytes of the current match still to be written
+
+    void reset() {
+        _windowPos = 0;
+        _state = State::FLAGS;
+        _nItems = 0;
+        _matchLength = 0;
+    }
+
+    bool hasPendingOutput() {
+        return _matchLength > 0;
+    }
+
+    int decompress(const uint8_t* input, int inputSize, int& consumed, uint8_t* output, int outputSize) {
+        int in = 0;
+        int out = 0;
+        while (out < outputSize) {
+            // Finish the current match first
+            if (_matchLength > 0) {
+                uint8_t byte = _window[(_windowPos - _matchOffset) & (WINDOW_SIZE - 1)];
+                _window[_windowPos] = byte;
+                _windowPos = (_windowPos + 1) & (WINDOW_SIZE - 1);
+                output[out++] = byte;
+                _matchLength--;
+                continue;
+            }
+
+            if (in >= inputSize) {
+                break;
+            }
+            uint8_t byte = input[in++];
+
+            if (_state == State::FLAGS) {
+                _flags = byte;
+                _nItems = 8;
+                _state = State::ITEM;
+
+            } else if (_state == State::ITEM) {
+                if (_flags & 0x01) {
+                    _matchByte0 = byte;
+                    _state = State::MATCH;
+                } else {
+                    // Literal
+                    _window[_windowPos] = byte;
+                    _windowPos = (_windowPos + 1) & (WINDOW_SIZE - 1);
+                    output[out++] = byte;
+                    _flags >>= 1;
+                    _nItems--;
+                    if (_nItems == 0) {
+                        _state = State::FLAGS;
+                    }
+                }
+
+            } else { // MATCH
+                _matchOffset = (_matchByte0 | (byte >> 5) << 8) + 1;
+                _matchLength = (byte & 0x1F) + MIN_MATCH;
+                _flags >>= 1;
+                _nItems--;
+                _state = (_nItems == 0 ? State::FLAGS : State::ITEM);
+            }
+        }
+        consumed = in;
+        return out;
+    }
+
+}
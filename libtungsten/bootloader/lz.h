@@ -0,0 +1,35 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include <stdint.h>
+
+// Streaming decompressor for the LZ format used to upload compressed firmwares. The same code
+// is compiled in the bootloader and on the host (tools/bootloader_sim), where it is checked
+// against the compressor.
+//
+// The compressed stream is a sequence of groups : a flag byte, followed by 8 items (fewer at the
+// end of the stream), the least significant bit of the flag byte describing the first item.
+// - flag 0 : literal, 1 byte copied to the output
+// - flag 1 : match, 2 bytes : the low 8 bits of (offset - 1), then the high 3 bits of (offset - 1)
+//   followed by (length - MIN_MATCH) on 5 bits ; copy length bytes starting offset bytes back
+//   in the output (the source and the destination may overlap)
+namespace LZ {
+
+    const int WINDOW_SIZE = 2048; // Maximum offset of a match
+    const int MIN_MATCH = 3;
+    const int MAX_MATCH = MIN_MATCH + 31;
+
+    // Start a new stream
+    void reset();
+
+    // Decompress as much as possible of the input into output. The number of input bytes used
+    // is written in consumed, and the number of bytes produced is returned. The input can be
+    // split anywhere : the decoder keeps its state between calls.
+    int decompress(const uint8_t* input, int inputSize, int& consumed, uint8_t* output, int outputSize);
+
+    // True if the end of a match is still waiting to be written because the output was full
+    bool hasPendingOutput();
+
+}
+
+#endif
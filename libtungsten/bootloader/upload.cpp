@@ -0,0 +1,311 @@
+#include "upload.h"
+#include "lz.h"
+#include <string.h>
+
+namespace Upload {
+
+    enum class State {
+        IDLE,
+        ERASING,
+        PROGRAMMING,
+    };
+
+    // Page buffers : filled by receivePage() (producer) and emptied by process() (consumer).
+    // Each side only moves its own index, and _full[] is the handshake between them.
+    uint32_t _buffers[N_BUFFERS][Flash::FLASH_PAGE_SIZE_WORDS];
+    int _pages[N_BUFFERS];
+    volatile bool _full[N_BUFFERS];
+    int _receiveIndex = 0;
+    int _writeIndex = 0;
+
+    State _state = State::IDLE;
+    int _firstPage = 0;
+    int _lastPage = -1;
+    int _nPagesWritten = 0;
+    int _nPagesSkipped = 0;
+    bool _fwReadyCleared = false;
+
+    // Range of the pages received since reset(), empty if _maxPageReceived < _minPageReceived
+    int _minPageReceived = 0;
+    int _maxPageReceived = -1;
+
+    // Compressed stream : the chunk is filled by receiveCompressed() and released by process()
+    // once decompressed into the staging page, which is then queued in the page buffers
+    uint8_t _chunk[COMPRESSED_CHUNK_SIZE];
+    volatile int _chunkSize = 0; // 0 when the chunk buffer is free
+    int _chunkPos = 0;
+    int _nextChunk = 0;
+    uint32_t _staging[Flash::FLASH_PAGE_SIZE_WORDS];
+    int _stagingSize = 0;
+    int _stagingPage = 0;
+
+    const uint32_t FNV_OFFSET_BASIS = 0x811C9DC5;
+    const uint32_t FNV_PRIME = 0x01000193;
+
+    // Internal functions
+    bool queueStagingPage();
+    void decompress();
+
+    // CRC-32 lookup table for one nibble, small enough for the bootloader
+    const uint32_t CRC32_TABLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+
+    void init(int firstPage, int lastPage) {
+        _firstPage = firstPage;
+        _lastPage = lastPage;
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < N_BUFFERS; i++) {
+            _full[i] = false;
+        }
+        _receiveIndex = 0;
+        _writeIndex = 0;
+        _state = State::IDLE;
+        _nPagesWritten = 0;
+        _nPagesSkipped = 0;
+        _fwReadyCleared = false;
+        _minPageReceived = 0;
+        _maxPageReceived = -1;
+        _chunkSize = 0;
+        _nextChunk = 0;
+        _stagingSize = 0;
+    }
+
+    Result receivePage(int page, const uint8_t* data, int size) {
+        if (page < _firstPage || page > _lastPage) {
+            return Result::PROTECTED_AREA;
+        }
+        if (size < 0 || size > Flash::FLASH_PAGE_SIZE_BYTES) {
+            return Result::INVALID_SIZE;
+        }
+        if (_full[_receiveIndex]) {
+            return Result::BUSY;
+        }
+
+        uint8_t* buffer = reinterpret_cast<uint8_t*>(_buffers[_receiveIndex]);
+        memcpy(buffer, data, size);
+        memset(buffer + size, 0xFF, Flash::FLASH_PAGE_SIZE_BYTES - size);
+        _pages[_receiveIndex] = page;
+        if (_maxPageReceived < _minPageReceived) {
+            _minPageReceived = page;
+            _maxPageReceived = page;
+        } else if (page < _minPageReceived) {
+            _minPageReceived = page;
+        } else if (page > _maxPageReceived) {
+            _maxPageReceived = page;
+        }
+        _full[_receiveIndex] = true;
+        _receiveIndex = (_receiveIndex + 1) % N_BUFFERS;
+        return Result::OK;
+    }
+
+    int freeBuffers() {
+        int n = 0;
+        for (int i = 0; i < N_BUFFERS; i++) {
+            if (!_full[i]) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    Result receiveCompressed(int chunk, int firstPage, const uint8_t* data, int size) {
+        if (size <= 0 || size > COMPRESSED_CHUNK_SIZE) {
+            return Result::INVALID_SIZE;
+        }
+        if (_chunkSize != 0) {
+            return Result::BUSY;
+        }
+        if (chunk == 0) {
+            // The previous stream must be completely queued first
+            if (_stagingSize > 0 || LZ::hasPendingOutput()) {
+                return Result::BUSY;
+            }
+            if (firstPage < _firstPage || firstPage > _lastPage) {
+                return Result::PROTECTED_AREA;
+            }
+            LZ::reset();
+            _nextChunk = 0;
+            _stagingPage = firstPage;
+            _stagingSize = 0;
+        }
+        if (chunk != _nextChunk) {
+            return Result::SEQUENCE;
+        }
+        memcpy(_chunk, data, size);
+        _chunkPos = 0;
+        _nextChunk++;
+        _chunkSize = size;
+        return Result::OK;
+    }
+
+    bool canReceiveCompressed() {
+        return _chunkSize == 0;
+    }
+
+    // Queue the staging page in the page buffers ; return false if there is no free buffer
+    bool queueStagingPage() {
+        uint8_t* staging = reinterpret_cast<uint8_t*>(_staging);
+        memset(staging + _stagingSize, 0xFF, Flash::FLASH_PAGE_SIZE_BYTES - _stagingSize);
+        if (receivePage(_stagingPage, staging, Flash::FLASH_PAGE_SIZE_BYTES) != Result::OK) {
+            return false;
+        }
+        _stagingPage++;
+        _stagingSize = 0;
+        return true;
+    }
+
+    // Decompress the pending chunk into the staging page, as long as there are free page buffers
+    void decompress() {
+        while (_chunkSize > 0 || LZ::hasPendingOutput()) {
+            if (_stagingSize == Flash::FLASH_PAGE_SIZE_BYTES && !queueStagingPage()) {
+                return;
+            }
+            int consumed = 0;
+            _stagingSize += LZ::decompress(_chunk + _chunkPos, _chunkSize - _chunkPos, consumed,
+                    reinterpret_cast<uint8_t*>(_staging) + _stagingSize, Flash::FLASH_PAGE_SIZE_BYTES - _stagingSize);
+            _chunkPos += consumed;
+            if (_chunkSize > 0 && _chunkPos == _chunkSize) {
+                // Release the chunk buffer for the next one
+                _chunkSize = 0;
+            }
+        }
+        if (_stagingSize == Flash::FLASH_PAGE_SIZE_BYTES) {
+            queueStagingPage();
+        }
+    }
+
+    void flush() {
+        if (_chunkSize == 0 && !LZ::hasPendingOutput() && _stagingSize > 0) {
+            queueStagingPage();
+        }
+    }
+
+    void process() {
+        decompress();
+
+        // Every flash command must wait for the previous one to finish
+        if (!Flash::isReady()) {
+            return;
+        }
+
+        if (_state == State::ERASING) {
+            // The page is erased, program it
+            Flash::programPage(_pages[_writeIndex], _buffers[_writeIndex]);
+            _state = State::PROGRAMMING;
+
+        } else if (_state == State::PROGRAMMING) {
+            // The page is programmed, release the buffer
+            _nPagesWritten++;
+            _full[_writeIndex] = false;
+            _writeIndex = (_writeIndex + 1) % N_BUFFERS;
+            _state = State::IDLE;
+        }
+
+        if (_state == State::IDLE && _full[_writeIndex]) {
+            // Skip the page if the flash already contains the same data
+            if (isPageUnchanged(_pages[_writeIndex], _buffers[_writeIndex])) {
+                _nPagesSkipped++;
+                _full[_writeIndex] = false;
+                _writeIndex = (_writeIndex + 1) % N_BUFFERS;
+                return;
+            }
+
+            if (!_fwReadyCleared) {
+                // If this is the first time a page is written, this means that the flash
+                // doesn't contain a valid firmware anymore : disable the FW_READY fuse, and
+                // wait for the fuse to be written before erasing the page
+                Flash::writeFuse(Flash::FUSE_BOOTLOADER_FW_READY, false);
+                _fwReadyCleared = true;
+                return;
+            }
+            Flash::erasePage(_pages[_writeIndex]);
+            _state = State::ERASING;
+        }
+    }
+
+    bool isPageUnchanged(int page, const uint32_t* data) {
+        for (int i = 0; i < Flash::FLASH_PAGE_SIZE_WORDS; i++) {
+            if (Flash::read(page * Flash::FLASH_PAGE_SIZE_BYTES + i * 4) != data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int nPagesSkipped() {
+        return _nPagesSkipped;
+    }
+
+    uint32_t pageHash(const uint32_t* page) {
+        uint32_t hash = FNV_OFFSET_BASIS;
+        for (int i = 0; i < Flash::FLASH_PAGE_SIZE_WORDS; i++) {
+            hash = (hash ^ page[i]) * FNV_PRIME;
+        }
+        return hash;
+    }
+
+    int getPageHashes(int firstPage, uint8_t* data, int size) {
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        int n = 0;
+        for (int p = firstPage; p < Flash::FLASH_PAGES && n + 4 <= size; p++) {
+            Flash::readPage(p, page);
+            uint32_t hash = pageHash(page);
+            data[n++] = hash >> 24;
+            data[n++] = hash >> 16;
+            data[n++] = hash >> 8;
+            data[n++] = hash;
+        }
+        return n;
+    }
+
+    bool isIdle() {
+        return _state == State::IDLE && freeBuffers() == N_BUFFERS && Flash::isReady()
+                && _chunkSize == 0 && !LZ::hasPendingOutput() && _stagingSize == 0;
+    }
+
+    bool isWriting() {
+        return _state != State::IDLE;
+    }
+
+    int nPagesWritten() {
+        return _nPagesWritten;
+    }
+
+    Result checkImageRange(int firstPage, int nPages) {
+        if (nPages <= 0 || firstPage < _firstPage || firstPage > _lastPage || nPages > _lastPage - firstPage + 1) {
+            return Result::PROTECTED_AREA;
+        }
+        if (_maxPageReceived >= _minPageReceived
+                && (_minPageReceived < firstPage || _maxPageReceived > firstPage + nPages - 1)) {
+            return Result::INCOMPLETE;
+        }
+        return Result::OK;
+    }
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, int size) {
+        crc = ~crc;
+        for (int i = 0; i < size; i++) {
+            crc ^= data[i];
+            crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+            crc = (crc >> 4) ^ CRC32_TABLE[crc & 0x0F];
+        }
+        return ~crc;
+    }
+
+    uint32_t flashCRC32(int firstPage, int nPages) {
+        uint32_t crc = 0;
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        for (int i = 0; i < nPages; i++) {
+            Flash::readPage(firstPage + i, page);
+            crc = crc32(crc, reinterpret_cast<uint8_t*>(page), Flash::FLASH_PAGE_SIZE_BYTES);
+        }
+        return crc;
+    }
+
+}
@@ -0,0 +1,80 @@
+#ifndef _UPLOAD_H_
+#define _UPLOAD_H_
+
+#include <stdint.h>
+#include <flash.h>
+
+// Binary firmware upload : whole pages are received from the host (in interrupt context) into
+// one of two page buffers, while the main loop erases and programs the other one. The host
+// keeps sending as long as a buffer is free, so the transfer of a page overlaps with the
+// programming of the previous one. This module only depends on the Flash API, so it can be
+// compiled on the host against a simulated flash.
+namespace Upload {
+
+    const int N_BUFFERS = 2;
+    const int COMPRESSED_CHUNK_SIZE = 512;
+
+    enum class Result {
+        OK,
+        BUSY, // No free buffer, try again later
+        PROTECTED_AREA,
+        INVALID_SIZE,
+        SEQUENCE, // Compressed chunk received out of order
+        INCOMPLETE, // The image doesn't cover every page received
+    };
+
+    // Pages outside [firstPage, lastPage] are rejected
+    void init(int firstPage, int lastPage);
+    void reset();
+
+    // Called by the channel handler when a page is received ; size may be smaller than a page,
+    // in which case the end of the page is filled with 0xFF
+    Result receivePage(int page, const uint8_t* data, int size);
+    int freeBuffers();
+
+    // Called by the channel handler for each chunk of a compressed stream (see lz.h) of
+    // consecutive pages starting at firstPage. Chunk 0 starts a new stream ; every stream but the
+    // last one must decompress to whole pages. The chunks are decompressed by
+    // process() ; only one chunk is buffered, BUSY is returned until it has been decompressed.
+    // Don't mix with receivePage() : the decompressed pages go through the same page buffers.
+    Result receiveCompressed(int chunk, int firstPage, const uint8_t* data, int size);
+    bool canReceiveCompressed();
+
+    // Called from the main loop : decompress the pending chunk if any, and advance the
+    // erase/program state machine without blocking
+    void process();
+
+    // Called once the last chunk has been received : queue the last page of the compressed
+    // stream, even if it is incomplete (it is filled with 0xFF)
+    void flush();
+
+    // Pages identical to the current flash content are not erased nor programmed
+    bool isPageUnchanged(int page, const uint32_t* data);
+    int nPagesSkipped();
+
+    // Hash of the content of a page (32-bit FNV-1a over the little-endian words), used by the
+    // host to find which pages differ from the image to upload. Write the big-endian hashes
+    // of the pages from firstPage into data, and return the number of bytes written.
+    uint32_t pageHash(const uint32_t* page);
+    int getPageHashes(int firstPage, uint8_t* data, int size);
+
+    // True when every received page (or compressed chunk) has been programmed
+    bool isIdle();
+
+    // True while the flash is being erased or programmed
+    bool isWriting();
+
+    // Number of pages programmed since reset()
+    int nPagesWritten();
+
+    // Check the range of pages of the image before its CRC-32 is computed : it must be inside
+    // [firstPage, lastPage] given to init(), and cover every page received since reset()
+    Result checkImageRange(int firstPage, int nPages);
+
+    // CRC-32 (same as zlib's) of the flash content of a range of pages
+    uint32_t crc32(uint32_t crc, const uint8_t* data, int size);
+    uint32_t flashCRC32(int firstPage, int nPages);
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "adc.h"
 #include "pm.h"
+#include "dma.h"
 
 namespace ADC {
 
@@ -19,6 +20,18 @@ namespace ADC {
     // For VCC_0625 and VCC_OVER_2, this is simply the Vcc voltage
     int _vref = 0;
 
+    // Frequency of the ADC clock after the prescaler, which also drives the internal timer
+    unsigned long _clockFrequency = 0;
+
+    // Asynchronous acquisition
+    int _dmaChannel = -1;
+    volatile bool _acquisitionRunning = false;
+    void (*_acquisitionHandler)() = nullptr;
+
+    // Internal functions
+    void setupSequencer(Channel channel, Gain gain, Channel relativeTo, uint32_t trigger);
+    void acquisitionFinishedHandler();
+
 
     // Initialize the common ressources of the ADC controller
     void init(AnalogReference analogReference, int vref) {
@@ -44,6 +57,8 @@ namespace ADC {
             }
         }
 
+        _clockFrequency = frequency >> (prescal + 2);
+
         // CR (Control Register) : enable the ADC
         (*(volatile uint32_t*)(ADC_BASE + OFFSET_CR))
             = 1 << CR_EN        // EN : enable ADC
@@ -89,28 +104,32 @@ namespace ADC {
         }
     }
 
-    // Read the current raw value measured by the ADC on the given channel
-    uint16_t readRaw(Channel channel, Gain gain, Channel relativeTo) {
-        // Enable the channels if they are not already
-        if (!(_enabledChannels & 1 << channel)) {
-            enable(channel);
-        }
-        if (relativeTo != 0xFF && !(_enabledChannels & 1 << relativeTo)) {
-            enable(relativeTo);
-        }
-
+    void setupSequencer(Channel channel, Gain gain, Channel relativeTo, uint32_t trigger) {
         // SEQCFG (Sequencer Configuration Register) : setup the conversion
         (*(volatile uint32_t*)(ADC_BASE + OFFSET_SEQCFG))
             = 0 << SEQCFG_HWLA                                                    // HWLA : Half Word Left Adjust disabled
             | (relativeTo != 0xFF) << SEQCFG_BIPOLAR                              // BIPOLAR : single-ended or bipolar mode
             | static_cast<int>(gain) << SEQCFG_GAIN                               // GAIN : user-selected gain
             | 1 << SEQCFG_GCOMP                                                   // GCOMP : gain error reduction enabled
-            | 0b000 << SEQCFG_TRGSEL                                              // TRGSEL : software trigger
+            | trigger << SEQCFG_TRGSEL                                            // TRGSEL : software trigger or internal timer
             | 0 << SEQCFG_RES                                                     // RES : 12-bit resolution
             | (relativeTo != 0xFF ? 0b00 : 0b10) << SEQCFG_INTERNAL               // INTERNAL : POS external, NEG internal or external
             | (channel & 0b1111) << SEQCFG_MUXPOS                                 // MUXPOS : selected channel
             | (relativeTo != 0xFF ? relativeTo & 0b111 : 0b111) << SEQCFG_MUXNEG  // MUXNEG : pad ground or neg channel
             | 0b000 << SEQCFG_ZOOMRANGE;                                          // ZOOMRANGE : default
+    }
+
+    // Read the current raw value measured by the ADC on the given channel
+    uint16_t readRaw(Channel channel, Gain gain, Channel relativeTo) {
+        // Enable the channels if they are not already
+        if (!(_enabledChannels & 1 << channel)) {
+            enable(channel);
+        }
+        if (relativeTo != 0xFF && !(_enabledChannels & 1 << relativeTo)) {
+            enable(relativeTo);
+        }
+
+        setupSequencer(channel, gain, relativeTo, TRGSEL_SOFTWARE);
 
         // CR (Control Register) : start conversion
         (*(volatile uint32_t*)(ADC_BASE + OFFSET_CR))
@@ -128,8 +147,12 @@ namespace ADC {
 
     // Return the current value on the given channel in mV
     int read(Channel channel, Gain gain, Channel relativeTo) {
-        int value = readRaw(channel, gain, relativeTo);
+        return toMillivolts(readRaw(channel, gain, relativeTo), gain, relativeTo != 0xFF);
+    }
 
+    // Convert a raw value to mV. The value can also be the sum of several samples, as long as
+    // the result is divided by the number of samples afterwards (up to 16 samples of 12 bits).
+    int toMillivolts(int value, Gain gain, bool differential) {
         // Compute reference
         int vref = _vref;
         if (_analogReference == AnalogReference::VCC_0625) {
@@ -143,7 +166,7 @@ namespace ADC {
         // Convert the result to mV
         // Single-ended : value = gain * voltage / ref * 4095 <=> voltage = value * ref / (gain * 4095)
         // Differential : value = 2047 + gain * voltage / ref * 2047 <=> voltage = (value - 2047) * ref / (gain * 2047)
-        if (relativeTo != 0xFF) {
+        if (differential) {
             value -= 2047;
         }
         int gainCoefficients[] = {1, 2, 4, 8, 16, 32, 64};
@@ -151,7 +174,7 @@ namespace ADC {
             value *= 2;
         }
         value *= vref;
-        if (relativeTo != 0xFF) {
+        if (differential) {
             value /= 2047;
         } else {
             value /= 4095;
@@ -163,6 +186,69 @@ namespace ADC {
         return value;
     }
 
+    // Start converting nSamples values at the given frequency (in Hz) into buffer, without
+    // blocking. handler is called from the DMA interrupt once the buffer is full. Return false if
+    // an acquisition is already running.
+    bool startAcquisition(Channel channel, uint16_t* buffer, int nSamples, unsigned long frequency, void (*handler)(), Gain gain) {
+        if (_acquisitionRunning || nSamples <= 0 || frequency == 0) {
+            return false;
+        }
+        if (!(_enabledChannels & 1 << channel)) {
+            enable(channel);
+        }
+        _acquisitionRunning = true;
+        _acquisitionHandler = handler;
+
+        // Every conversion is copied from LCV (Last Converted Value) by the DMA
+        if (_dmaChannel < 0) {
+            _dmaChannel = DMA::newChannel(DMA::Device::ADC_RX, DMA::Size::HALFWORD);
+        }
+        DMA::setupChannel(_dmaChannel, (uint32_t)buffer, nSamples);
+        DMA::enableInterrupt(_dmaChannel, acquisitionFinishedHandler, DMA::Interrupt::TRANSFER_FINISHED);
+        DMA::startChannel(_dmaChannel);
+
+        setupSequencer(channel, gain, 0xFF, TRGSEL_INTERNAL_TIMER);
+
+        // ITIMER (Internal Timer Register) : a conversion is triggered every ITMC + 1 clock cycles
+        unsigned long period = _clockFrequency / frequency;
+        if (period < 1) {
+            period = 1;
+        } else if (period > 0x10000) {
+            period = 0x10000;
+        }
+        (*(volatile uint32_t*)(ADC_BASE + OFFSET_ITIMER))
+            = (period - 1) << ITIMER_ITMC;
+
+        // CR (Control Register) : start the internal timer
+        (*(volatile uint32_t*)(ADC_BASE + OFFSET_CR))
+            = 1 << CR_TSTART;   // TSTART : internal timer start
+
+        return true;
+    }
+
+    void stopAcquisition() {
+        // CR (Control Register) : stop the internal timer
+        (*(volatile uint32_t*)(ADC_BASE + OFFSET_CR))
+            = 1 << CR_TSTOP;    // TSTOP : internal timer stop
+
+        if (_dmaChannel >= 0) {
+            DMA::stopChannel(_dmaChannel);
+        }
+        _acquisitionRunning = false;
+    }
+
+    bool isAcquisitionRunning() {
+        return _acquisitionRunning;
+    }
+
+    void acquisitionFinishedHandler() {
+        // The transfer finished interrupt is cleared when the channel is stopped
+        stopAcquisition();
+        if (_acquisitionHandler != nullptr) {
+            _acquisitionHandler();
+        }
+    }
+
     void setPin(Channel channel, GPIO::Pin pin) {
         PINS[channel] = pin;
     }
@@ -60,6 +60,9 @@ namespace ADC {
     const uint32_t SEQCFG_MUXPOS = 16;
     const uint32_t SEQCFG_MUXNEG = 20;
     const uint32_t SEQCFG_ZOOMRANGE = 28;
+    const uint32_t ITIMER_ITMC = 0;
+    const uint32_t TRGSEL_SOFTWARE = 0b000;
+    const uint32_t TRGSEL_INTERNAL_TIMER = 0b001;
 
 
     using Channel = uint8_t;
@@ -90,6 +93,12 @@ namespace ADC {
     void disable(Channel channel);
     uint16_t readRaw(Channel channel, Gain gain=Gain::X05, Channel relativeTo=0xFF);
     int read(Channel channel, Gain gain=Gain::X05, Channel relativeTo=0xFF);
+    int toMillivolts(int value, Gain gain=Gain::X05, bool differential=false);
+
+    // Asynchronous acquisition : the internal timer triggers the conversions and the DMA copies them
+    bool startAcquisition(Channel channel, uint16_t* buffer, int nSamples, unsigned long frequency, void (*handler)()=nullptr, Gain gain=Gain::X05);
+    void stopAcquisition();
+    bool isAcquisitionRunning();
     void setPin(Channel channel, GPIO::Pin pin);
 
 }
@@ -143,11 +143,6 @@ namespace AST {
     }
 
     void alarmHandlerWrapper() {
-        // Call the user handler if defined
-        if (_alarmHandler != nullptr) {
-            _alarmHandler();
-        }
-
         // Disable the alarm so it is not triggered again after
         // the next counter overflow
         disableAlarm();
@@ -155,6 +150,12 @@ namespace AST {
         // SCR (Status Clear Register) : clear the interrupt
         waitWhileBusy();
         (*(volatile uint32_t*)(BASE + OFFSET_SCR)) = 1 << SR_ALARM0;
+
+        // Call the user handler if defined, after the alarm is disabled
+        // so that the handler is able to program the next one
+        if (_alarmHandler != nullptr) {
+            _alarmHandler();
+        }
     }
 
     bool alarmPassed() {
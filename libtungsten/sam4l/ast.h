@@ -6,7 +6,9 @@
 // Asynchronous Timer
 // This module manages the 32-bit asynchronous timer/counter
 // which is used as a system time (with a 2-ms resolution) and is able
-// to wake up the chip at a specific time
+// to wake up the chip at a specific time. The alarm is shared between
+// several deadlines by the Timers module, which should be used instead
+// of enableAlarm()
 namespace AST {
 
     // Peripheral memory space base address
@@ -54,10 +56,31 @@ namespace AST {
     using Time = volatile uint64_t;
     extern Time _currentTimeHighBytes;
 
+    // Raw time base : the counter is incremented at 32768Hz / 2, i.e. every ~61us.
+    // Reading ticks() is cheaper than time() and keeps the full resolution of the counter.
+    // The conversions to ticks round up, so that a delay converted to ticks is never shorter
+    // than requested and ticksToMs(msToTicks(ms)) == ms.
+    using Ticks = uint64_t;
+    const unsigned long TICKS_PER_SECOND = 32768 / 2;
+    constexpr uint64_t ticksToMs(Ticks ticks) { return ticks * 1000 / TICKS_PER_SECOND; }
+    constexpr uint64_t ticksToUs(Ticks ticks) { return ticks * 1000000 / TICKS_PER_SECOND; }
+    constexpr Ticks msToTicks(uint64_t ms) { return (ms * TICKS_PER_SECOND + 999) / 1000; }
+    constexpr Ticks usToTicks(uint64_t us) { return (us * TICKS_PER_SECOND + 999999) / 1000000; }
+
 
     // Module API
     void init();
-    inline Time time() { return ((_currentTimeHighBytes + (*(volatile uint32_t*)(BASE + OFFSET_CV))) * 1000) / (32768/2); };
+    inline Ticks ticks() {
+        // Read the high bytes again in case the counter has overflowed in the meantime
+        uint64_t high;
+        uint32_t low;
+        do {
+            high = _currentTimeHighBytes;
+            low = *(volatile uint32_t*)(BASE + OFFSET_CV);
+        } while (high != _currentTimeHighBytes);
+        return high + low;
+    };
+    inline Time time() { return ticksToMs(ticks()); };
     void enableAlarm(Time time, bool relative=true, void (*handler)()=nullptr, bool wake=true);
     void disableAlarm();
     bool alarmPassed();
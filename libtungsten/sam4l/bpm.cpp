@@ -42,7 +42,7 @@ namespace BPM {
         while (!(*(volatile uint32_t*)(BASE + OFFSET_SR) & (1 << SR_PSOK)));
 
         // Disable Flash High Speed mode if exiting PS2
-        if (_currentPS == PowerScaling::PS2) {
+        if (_currentPS == PowerScaling::PS2 && ps != PowerScaling::PS2) {
             Flash::disableHighSpeedMode();
         }
 
@@ -5,6 +5,7 @@
 #include "gpio.h"
 #include "flash.h"
 #include "ast.h"
+#include "timers.h"
 #include "wdt.h"
 #include "error.h"
 #include <string.h>
@@ -55,6 +56,9 @@ namespace Core {
         // Init the GPIO module
         GPIO::init();
 
+        // Enable the flash cache
+        Flash::enableCache();
+
         // Enable the default clocks
         BSCIF::enableOSC32K();
 
@@ -195,6 +199,15 @@ namespace Core {
         (*(volatile uint8_t*) (NVIC_IPR0 + static_cast<int>(interrupt))) = priority;
     }
 
+    // Check if an interrupt has been triggered but its handler has not been executed yet,
+    // for example because interrupts are disabled or a higher-priority handler is running
+    bool isInterruptPending(Interrupt interrupt) {
+        const int channel = static_cast<int>(interrupt);
+
+        // ISPR (Interrupt Set-Pending Register) : reading returns the pending state of each channel
+        return (*(volatile uint32_t*) (NVIC_ISPR0 + ((channel >> 3) & 0xFFFC))) & (1 << (channel & 0x1F));
+    }
+
     // Disable temporarily all the interrupts at the NVIC level. The user is still
     // able to re-enable some interrupts manually. This is useful to create a code
     // section where only some selected interrupts can be triggered. Use applyStashedInterrupts()
@@ -246,21 +259,32 @@ namespace Core {
                 length *= 1000;
             }
 
-            // Enable an alarm to wake up the chip after a specified
-            // amount of time
-            AST::enableAlarm(length);
+            // Start a timer to wake up the chip after a specified amount of time. The other
+            // timers keep running and their handlers are called during the sleep.
+            Time end = time() + length;
+            int timer = Timers::start(length);
+            if (timer == Timers::INVALID) {
+                // No timer left : wait actively
+                while (time() < end);
+                return;
+            }
+
+            // Sleep until the timer expires
+            do {
+                // WFI : Wait For Interrupt
+                // This special ARM instruction can put the chip in sleep mode until
+                // an interrupt with a sufficient priority is triggered
+                // See §B1.5.17 Power Management in the ARMv7-M Architecture Reference Manual
+                __asm__ __volatile__("WFI");
+            } while (Timers::isRunning(timer) && time() < end);
+            Timers::cancel(timer);
+            return;
         }
 
-        // Sleep until a known event happens
+        // Sleep until any interrupt
         do {
-            // WFI : Wait For Interrupt
-            // This special ARM instruction can put the chip in sleep mode until
-            // an interrupt with a sufficient priority is triggered
-            // See §B1.5.17 Power Management in the ARMv7-M Architecture Reference Manual
             __asm__ __volatile__("WFI");
-        } while (!(length > 0 
-                    ? AST::alarmPassed()                    // If length is specified, wait until the AST alarm is triggered
-                    : PM::wakeUpCause() != PM::WakeUpCause::UNKNOWN)); // Otherwise, wait for any interrupt
+        } while (PM::wakeUpCause() == PM::WakeUpCause::UNKNOWN);
     }
 
     // The default sleep mode is SLEEP0
@@ -284,6 +308,14 @@ namespace Core {
         *(volatile uint32_t*) SYST_CSR = 0;
     }
 
+    // Start the DWT cycle counter, which counts the CPU clock cycles (but not while the core is
+    // sleeping) and is used to profile code. It is also enabled by the debugger when attached.
+    void enableCycleCounter() {
+        *(volatile uint32_t*) DEMCR |= 1 << DEMCR_TRCENA;
+        *(volatile uint32_t*) DWT_CYCCNT = 0;
+        *(volatile uint32_t*) DWT_CTRL |= 1 << DWT_CTRL_CYCCNTENA;
+    }
+
     // Waste CPU clock cycles to wait for a specified amount of time
     void waitMicroseconds(unsigned long length) {
         // Save the last CVR (Current Value Register) value at each loop iteration
@@ -39,6 +39,11 @@ namespace Core {
     const uint32_t NVIC_IABR0 = 0xE000E300; // Interrupt Active Bit Register 0
     const uint32_t NVIC_IPR0 = 0xE000E400;  // Interrupt Priority Register 0
 
+    // Debug and Data Watchpoint and Trace (DWT) Registers
+    const uint32_t DEMCR = 0xE000EDFC;      // Debug Exception and Monitor Control Register
+    const uint32_t DWT_CTRL = 0xE0001000;   // DWT Control Register
+    const uint32_t DWT_CYCCNT = 0xE0001004; // DWT Cycle Count Register
+
     // Peripheral Debug
     const uint32_t PDBG = 0xE0042000; // Peripheral Debug Register
 
@@ -58,6 +63,8 @@ namespace Core {
     const uint32_t SYST_CSR_COUNTFLAG = 6; // SysTick timer has reached 0
     const uint32_t AIRCR_SYSRESETREQ = 2; // System reset request
     const uint32_t AIRCR_VECTKEY = 0x05FA << 16; // AIRCR access key
+    const uint32_t DEMCR_TRCENA = 24; // Enable the DWT and ITM units
+    const uint32_t DWT_CTRL_CYCCNTENA = 0; // Enable the cycle counter
     const uint32_t PDBG_WDT = 0; // Freeze WDT when Core is halted in debug mode
     const uint32_t PDBG_AST = 1; // Freeze AST when Core is halted in debug mode
     const uint32_t PDBG_PEVC = 2; // Freeze PEVX when Core is halted in debug mode
@@ -212,6 +219,7 @@ namespace Core {
     };
 
     using Time = AST::Time;
+    using Ticks = AST::Ticks;
 
 
     // General purpose functions
@@ -231,20 +239,30 @@ namespace Core {
     void setInterruptHandler(Interrupt interrupt, void (*handler)());
     void enableInterrupt(Interrupt interrupt, uint8_t priority);
     void disableInterrupt(Interrupt interrupt);
+#if SIMULATION
+    // Implemented by the host simulation (see tools/silver_sim), which delivers the pending interrupts
+    void enableInterrupts();
+    void disableInterrupts();
+#else
     inline void enableInterrupts() { __asm__("CPSIE I"); } // Change Program State Interrupt Enable
     inline void disableInterrupts() { __asm__("CPSID I"); } // Change Program State Interrupt Disable
+#endif
     void setInterruptPriority(Interrupt interrupt, uint8_t priority);
+    bool isInterruptPending(Interrupt interrupt);
     void stashInterrupts();
     void applyStashedInterrupts();
     Interrupt currentInterrupt();
 
     // Time and power related functions
     inline Time time() { return AST::time(); }
+    inline Ticks ticks() { return AST::ticks(); }
     void sleep(unsigned long length, TimeUnit unit=TimeUnit::MILLISECONDS);
     void sleep(SleepMode mode=SleepMode::SLEEP0, unsigned long length=0, TimeUnit unit=TimeUnit::MILLISECONDS);
     void waitMicroseconds(unsigned long length);
     void enableSysTick();
     void disableSysTick();
+    void enableCycleCounter();
+    inline uint32_t cycles() { return *(volatile uint32_t*) DWT_CYCCNT; } // CPU clock cycles, wraps around
 
     // Default exception handlers
     void handlerNMI();
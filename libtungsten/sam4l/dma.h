@@ -70,6 +70,7 @@ namespace DMA {
         I2C3_M_RX = 8,
         I2C0_S_RX = 9,
         I2C1_S_RX = 10,
+        ADC_RX = 11,
         USART0_TX = 18,
         USART1_TX = 19,
         USART2_TX = 20,
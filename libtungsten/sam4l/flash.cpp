@@ -1,7 +1,12 @@
 #include "flash.h"
+#include "pm.h"
 
 namespace Flash {
 
+    // The registers of the PicoCache are not clocked until it is enabled
+    bool _cacheEnabled = false;
+
+
     bool isReady() {
         return (*(volatile uint32_t*)(FLASH_BASE + OFFSET_FSR)) & (1 << FSR_FRDY);
     }
@@ -33,6 +38,10 @@ namespace Flash {
             = FCMD_CMD_EP << FCMD_CMD   // CMD : command code to issue (EP = Erase Page)
             | page << FCMD_PAGEN        // PAGEN : page number
             | FCMD_KEY;                 // KEY : write protection key
+
+        // The cache may hold the previous content of the page. The lines which are filled
+        // from now on wait for the end of the operation, so they will get the new content.
+        invalidateCache();
     }
 
     void clearPageBuffer() {
@@ -47,8 +56,15 @@ namespace Flash {
 
     void writePage(int page, const uint32_t data[]) {
         // The flash technology only allows 1-to-0 transitions, so the 
-        // page and the buffer must first be cleared (set to 1)
+        // page must first be cleared (set to 1)
         erasePage(page);
+        programPage(page, data);
+    }
+
+    // Program a page which has already been erased. Like erasePage(), this returns as soon as
+    // the command is issued : use isReady() to know when the operation is finished.
+    void programPage(int page, const uint32_t data[]) {
+        // The page buffer must be cleared (set to 1) before being filled
         clearPageBuffer();
 
         // Wait for the flash to be ready
@@ -64,6 +80,9 @@ namespace Flash {
             = FCMD_CMD_WP << FCMD_CMD   // CMD : command code to issue (WP = Write Page)
             | page << FCMD_PAGEN        // PAGEN : page number
             | FCMD_KEY;                 // KEY : write protection key
+
+        // See erasePage()
+        invalidateCache();
     }
 
     void readUserPage(uint32_t data[]) {
@@ -84,6 +103,9 @@ namespace Flash {
         (*(volatile uint32_t*)(FLASH_BASE + OFFSET_FCMD))
             = FCMD_CMD_EUP << FCMD_CMD  // CMD : command code to issue (EUP = Erase User Page)
             | FCMD_KEY;                 // KEY : write protection key
+
+        // See erasePage()
+        invalidateCache();
     }
 
     void writeUserPage(const uint32_t data[]) {
@@ -104,6 +126,9 @@ namespace Flash {
         (*(volatile uint32_t*)(FLASH_BASE + OFFSET_FCMD))
             = FCMD_CMD_WUP << FCMD_CMD  // CMD : command code to issue (WUP = Write User Page)
             | FCMD_KEY;                 // KEY : write protection key
+
+        // See erasePage()
+        invalidateCache();
     }
 
     void writeFuse(Fuse fuse, bool state) {
@@ -162,4 +187,116 @@ namespace Flash {
             | FCMD_KEY;                  // KEY : write protection key
     }
 
+    // One wait state is required above 18MHz in PS0 and PS1, or above 24MHz in
+    // high speed mode (see datasheet §42.8 Flash Characteristics)
+    void setWaitState(bool enabled) {
+        // FCR (Flash Control Register) : set or clear FWS
+        if (enabled) {
+            (*(volatile uint32_t*)(FLASH_BASE + OFFSET_FCR)) |= 1 << FCR_FWS;
+        } else {
+            (*(volatile uint32_t*)(FLASH_BASE + OFFSET_FCR)) &= ~(uint32_t)(1 << FCR_FWS);
+        }
+    }
+
+    // The PicoCache is a 2KB cache between the CPU and the flash, for both the instructions
+    // and the constant data such as the font tables. It is enabled by Core::init().
+    void enableCache() {
+        if (_cacheEnabled) {
+            return;
+        }
+
+        // Enable the clocks of the cache memory and of its registers
+        PM::enablePeripheralClock(PM::CLK_PICOCACHE);
+        PM::enablePeripheralClock(PM::CLK_PICOCACHE_REGS);
+
+        // The lines are kept while the cache is disabled, but the flash may have been written
+        // in the meantime
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MAINT0))
+            = 1 << MAINT0_INVALL;       // INVALL : invalidate all the lines
+
+        // CTRL (Control Register) : enable the cache
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_CTRL))
+            = 1 << CTRL_CEN;
+
+        // Wait for the cache to be enabled
+        while (!((*(volatile uint32_t*)(FLASH_BASE + OFFSET_SR)) & (1 << SR_CSTS)));
+
+        _cacheEnabled = true;
+    }
+
+    void disableCache() {
+        if (!_cacheEnabled) {
+            return;
+        }
+
+        // CTRL (Control Register) : disable the cache
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_CTRL))
+            = 0 << CTRL_CEN;
+
+        // Wait for the cache to be disabled
+        while ((*(volatile uint32_t*)(FLASH_BASE + OFFSET_SR)) & (1 << SR_CSTS));
+
+        _cacheEnabled = false;
+    }
+
+    bool isCacheEnabled() {
+        return _cacheEnabled;
+    }
+
+    // Must be called when the flash has been written, otherwise the cache may still return the
+    // previous content. This is done by the write functions of this module.
+    void invalidateCache() {
+        // A disabled cache is invalidated when it is enabled again
+        if (!_cacheEnabled) {
+            return;
+        }
+
+        // MAINT0 (Maintenance Register 0) : invalidate all the lines
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MAINT0))
+            = 1 << MAINT0_INVALL;
+    }
+
+    // Start counting the events of the given kind from 0. The hit rate of some code can
+    // be estimated by comparing the instruction hits with the cycles of another run.
+    void startCacheMonitor(CacheMonitor event) {
+        if (!_cacheEnabled) {
+            return;
+        }
+
+        // MEN (Monitor Enable Register) : the monitor must be disabled to change its mode
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MEN))
+            = 0 << MEN_MENABLE;
+
+        // MCFG (Monitor Configuration Register) : select the events to count
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MCFG))
+            = static_cast<int>(event) << MCFG_MODE;
+
+        // MCTRL (Monitor Control Register) : reset the counter
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MCTRL))
+            = 1 << MCTRL_SWRST;
+
+        // MEN (Monitor Enable Register) : enable the monitor
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MEN))
+            = 1 << MEN_MENABLE;
+    }
+
+    void stopCacheMonitor() {
+        if (!_cacheEnabled) {
+            return;
+        }
+
+        // MEN (Monitor Enable Register) : disable the monitor, the counter is kept
+        (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MEN))
+            = 0 << MEN_MENABLE;
+    }
+
+    uint32_t cacheMonitorCount() {
+        if (!_cacheEnabled) {
+            return 0;
+        }
+
+        // MSR (Monitor Status Register) : number of events counted
+        return (*(volatile uint32_t*)(FLASH_BASE + OFFSET_MSR));
+    }
+
 }
\ No newline at end of file
@@ -34,6 +34,7 @@ namespace Flash {
     const uint32_t OFFSET_PVR =         0x4FC; // Version Register
     
     // Constants
+    const uint32_t FCR_FWS = 6;
     const uint32_t FSR_FRDY = 0;
     const uint32_t FSR_HSMODE = 6;
     const uint32_t FCMD_CMD = 0;
@@ -57,6 +58,12 @@ namespace Flash {
     const uint32_t FCMD_CMD_HSDIS = 17;
     const uint32_t FCMD_PAGEN = 8;
     const uint32_t FCMD_KEY = 0xA5 << 24;
+    const uint32_t CTRL_CEN = 0;
+    const uint32_t SR_CSTS = 0;
+    const uint32_t MAINT0_INVALL = 0;
+    const uint32_t MCFG_MODE = 0;
+    const uint32_t MEN_MENABLE = 0;
+    const uint32_t MCTRL_SWRST = 0;
 
     // General-purpose fuses
     using Fuse = uint8_t;
@@ -69,6 +76,13 @@ namespace Flash {
     const Fuse FUSE_BOOTLOADER_SKIP_TIMEOUT = 2;
     const int BOOTLOADER_N_RESERVED_FUSES = 3;
 
+    // Events counted by the PicoCache monitor, one kind at a time
+    enum class CacheMonitor {
+        CYCLES = 0,
+        INSTRUCTION_HITS = 1,
+        DATA_HITS = 2,
+    };
+
 
     // Module API
     bool isReady();
@@ -77,6 +91,7 @@ namespace Flash {
     void erasePage(int page);
     void clearPageBuffer();
     void writePage(int page, const uint32_t data[]);
+    void programPage(int page, const uint32_t data[]);
     void readUserPage(uint32_t data[]);
     void eraseUserPage();
     void writeUserPage(const uint32_t data[]);
@@ -84,6 +99,16 @@ namespace Flash {
     bool getFuse(Fuse fuse);
     void enableHighSpeedMode();
     void disableHighSpeedMode();
+    void setWaitState(bool enabled);
+
+    // PicoCache
+    void enableCache();
+    void disableCache();
+    bool isCacheEnabled();
+    void invalidateCache();
+    void startCacheMonitor(CacheMonitor event);
+    void stopCacheMonitor();
+    uint32_t cacheMonitorCount();
 
 }
 
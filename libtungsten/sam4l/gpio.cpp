@@ -132,9 +132,16 @@ namespace GPIO {
         }
     }
 
-    void enableInterrupt(const Pin& pin, Trigger trigger) {
+    void enableInterrupt(const Pin& pin, Trigger trigger, bool filter) {
         const uint32_t REG_BASE = GPIO_BASE + static_cast<uint8_t>(pin.port) * PORT_REG_SIZE;
 
+        // GFER (Glitch Filter Enable Register) : must be set while the interrupt is disabled
+        if (filter) {
+            ((volatile RSCT_REG*)(REG_BASE + OFFSET_GFER))->SET = 1 << pin.number;
+        } else {
+            ((volatile RSCT_REG*)(REG_BASE + OFFSET_GFER))->CLEAR = 1 << pin.number;
+        }
+
         // Select the trigger type : CHANGE = 00, RISING = 01, FALLING = 10
         if (trigger == Trigger::RISING) {
             ((volatile RSCT_REG*)(REG_BASE + OFFSET_IMR0))->SET = 1 << pin.number;
@@ -157,7 +164,7 @@ namespace GPIO {
                 + pin.number / 8), INTERRUPT_PRIORITY);
     }
 
-    void enableInterrupt(const Pin& pin, void (*handler)(), Trigger trigger) {
+    void enableInterrupt(const Pin& pin, void (*handler)(), Trigger trigger, bool filter) {
         // Set the interrupt handler
         _interruptHandlers[static_cast<uint8_t>(pin.port) * 32 + pin.number] = (uint32_t) handler;
         Core::setInterruptHandler(static_cast<Core::Interrupt>(
@@ -166,7 +173,7 @@ namespace GPIO {
                 + pin.number / 8), &interruptHandlerWrapper);
 
         // Enable the interrupt with the function above
-        enableInterrupt(pin, trigger);
+        enableInterrupt(pin, trigger, filter);
     }
 
     void disableInterrupt(const Pin& pin) {
@@ -81,87 +81,87 @@ namespace GPIO {
         Periph function;
     };
 
-    // Pin name helpers
-    const Pin PA00 = {Port::A,  0};
-    const Pin PA01 = {Port::A,  1};
-    const Pin PA02 = {Port::A,  2};
-    const Pin PA03 = {Port::A,  3};
-    const Pin PA04 = {Port::A,  4};
-    const Pin PA05 = {Port::A,  5};
-    const Pin PA06 = {Port::A,  6};
-    const Pin PA07 = {Port::A,  7};
-    const Pin PA08 = {Port::A,  8};
-    const Pin PA09 = {Port::A,  9};
-    const Pin PA10 = {Port::A, 10};
-    const Pin PA11 = {Port::A, 11};
-    const Pin PA12 = {Port::A, 12};
-    const Pin PA13 = {Port::A, 13};
-    const Pin PA14 = {Port::A, 14};
-    const Pin PA15 = {Port::A, 15};
-    const Pin PA16 = {Port::A, 16};
-    const Pin PA17 = {Port::A, 17};
-    const Pin PA18 = {Port::A, 18};
-    const Pin PA19 = {Port::A, 19};
-    const Pin PA20 = {Port::A, 20};
-    const Pin PA21 = {Port::A, 21};
-    const Pin PA22 = {Port::A, 22};
-    const Pin PA23 = {Port::A, 23};
-    const Pin PA24 = {Port::A, 24};
-    const Pin PA25 = {Port::A, 25};
-    const Pin PA26 = {Port::A, 26};
-    const Pin PA27 = {Port::A, 27};
-    const Pin PA28 = {Port::A, 28};
-    const Pin PA29 = {Port::A, 29};
-    const Pin PA30 = {Port::A, 30};
-    const Pin PA31 = {Port::A, 31};
-    const Pin PB00 = {Port::B,  0};
-    const Pin PB01 = {Port::B,  1};
-    const Pin PB02 = {Port::B,  2};
-    const Pin PB03 = {Port::B,  3};
-    const Pin PB04 = {Port::B,  4};
-    const Pin PB05 = {Port::B,  5};
-    const Pin PB06 = {Port::B,  6};
-    const Pin PB07 = {Port::B,  7};
-    const Pin PB08 = {Port::B,  8};
-    const Pin PB09 = {Port::B,  9};
-    const Pin PB10 = {Port::B, 10};
-    const Pin PB11 = {Port::B, 11};
-    const Pin PB12 = {Port::B, 12};
-    const Pin PB13 = {Port::B, 13};
-    const Pin PB14 = {Port::B, 14};
-    const Pin PB15 = {Port::B, 15};
-    const Pin PC00 = {Port::C,  0};
-    const Pin PC01 = {Port::C,  1};
-    const Pin PC02 = {Port::C,  2};
-    const Pin PC03 = {Port::C,  3};
-    const Pin PC04 = {Port::C,  4};
-    const Pin PC05 = {Port::C,  5};
-    const Pin PC06 = {Port::C,  6};
-    const Pin PC07 = {Port::C,  7};
-    const Pin PC08 = {Port::C,  8};
-    const Pin PC09 = {Port::C,  9};
-    const Pin PC10 = {Port::C, 10};
-    const Pin PC11 = {Port::C, 11};
-    const Pin PC12 = {Port::C, 12};
-    const Pin PC13 = {Port::C, 13};
-    const Pin PC14 = {Port::C, 14};
-    const Pin PC15 = {Port::C, 15};
-    const Pin PC16 = {Port::C, 16};
-    const Pin PC17 = {Port::C, 17};
-    const Pin PC18 = {Port::C, 18};
-    const Pin PC19 = {Port::C, 19};
-    const Pin PC20 = {Port::C, 20};
-    const Pin PC21 = {Port::C, 21};
-    const Pin PC22 = {Port::C, 22};
-    const Pin PC23 = {Port::C, 23};
-    const Pin PC24 = {Port::C, 24};
-    const Pin PC25 = {Port::C, 25};
-    const Pin PC26 = {Port::C, 26};
-    const Pin PC27 = {Port::C, 27};
-    const Pin PC28 = {Port::C, 28};
-    const Pin PC29 = {Port::C, 29};
-    const Pin PC30 = {Port::C, 30};
-    const Pin PC31 = {Port::C, 31};
+    // Pin name helpers (constant expressions, see FastPin)
+    constexpr Pin PA00 = {Port::A,  0};
+    constexpr Pin PA01 = {Port::A,  1};
+    constexpr Pin PA02 = {Port::A,  2};
+    constexpr Pin PA03 = {Port::A,  3};
+    constexpr Pin PA04 = {Port::A,  4};
+    constexpr Pin PA05 = {Port::A,  5};
+    constexpr Pin PA06 = {Port::A,  6};
+    constexpr Pin PA07 = {Port::A,  7};
+    constexpr Pin PA08 = {Port::A,  8};
+    constexpr Pin PA09 = {Port::A,  9};
+    constexpr Pin PA10 = {Port::A, 10};
+    constexpr Pin PA11 = {Port::A, 11};
+    constexpr Pin PA12 = {Port::A, 12};
+    constexpr Pin PA13 = {Port::A, 13};
+    constexpr Pin PA14 = {Port::A, 14};
+    constexpr Pin PA15 = {Port::A, 15};
+    constexpr Pin PA16 = {Port::A, 16};
+    constexpr Pin PA17 = {Port::A, 17};
+    constexpr Pin PA18 = {Port::A, 18};
+    constexpr Pin PA19 = {Port::A, 19};
+    constexpr Pin PA20 = {Port::A, 20};
+    constexpr Pin PA21 = {Port::A, 21};
+    constexpr Pin PA22 = {Port::A, 22};
+    constexpr Pin PA23 = {Port::A, 23};
+    constexpr Pin PA24 = {Port::A, 24};
+    constexpr Pin PA25 = {Port::A, 25};
+    constexpr Pin PA26 = {Port::A, 26};
+    constexpr Pin PA27 = {Port::A, 27};
+    constexpr Pin PA28 = {Port::A, 28};
+    constexpr Pin PA29 = {Port::A, 29};
+    constexpr Pin PA30 = {Port::A, 30};
+    constexpr Pin PA31 = {Port::A, 31};
+    constexpr Pin PB00 = {Port::B,  0};
+    constexpr Pin PB01 = {Port::B,  1};
+    constexpr Pin PB02 = {Port::B,  2};
+    constexpr Pin PB03 = {Port::B,  3};
+    constexpr Pin PB04 = {Port::B,  4};
+    constexpr Pin PB05 = {Port::B,  5};
+    constexpr Pin PB06 = {Port::B,  6};
+    constexpr Pin PB07 = {Port::B,  7};
+    constexpr Pin PB08 = {Port::B,  8};
+    constexpr Pin PB09 = {Port::B,  9};
+    constexpr Pin PB10 = {Port::B, 10};
+    constexpr Pin PB11 = {Port::B, 11};
+    constexpr Pin PB12 = {Port::B, 12};
+    constexpr Pin PB13 = {Port::B, 13};
+    constexpr Pin PB14 = {Port::B, 14};
+    constexpr Pin PB15 = {Port::B, 15};
+    constexpr Pin PC00 = {Port::C,  0};
+    constexpr Pin PC01 = {Port::C,  1};
+    constexpr Pin PC02 = {Port::C,  2};
+    constexpr Pin PC03 = {Port::C,  3};
+    constexpr Pin PC04 = {Port::C,  4};
+    constexpr Pin PC05 = {Port::C,  5};
+    constexpr Pin PC06 = {Port::C,  6};
+    constexpr Pin PC07 = {Port::C,  7};
+    constexpr Pin PC08 = {Port::C,  8};
+    constexpr Pin PC09 = {Port::C,  9};
+    constexpr Pin PC10 = {Port::C, 10};
+    constexpr Pin PC11 = {Port::C, 11};
+    constexpr Pin PC12 = {Port::C, 12};
+    constexpr Pin PC13 = {Port::C, 13};
+    constexpr Pin PC14 = {Port::C, 14};
+    constexpr Pin PC15 = {Port::C, 15};
+    constexpr Pin PC16 = {Port::C, 16};
+    constexpr Pin PC17 = {Port::C, 17};
+    constexpr Pin PC18 = {Port::C, 18};
+    constexpr Pin PC19 = {Port::C, 19};
+    constexpr Pin PC20 = {Port::C, 20};
+    constexpr Pin PC21 = {Port::C, 21};
+    constexpr Pin PC22 = {Port::C, 22};
+    constexpr Pin PC23 = {Port::C, 23};
+    constexpr Pin PC24 = {Port::C, 24};
+    constexpr Pin PC25 = {Port::C, 25};
+    constexpr Pin PC26 = {Port::C, 26};
+    constexpr Pin PC27 = {Port::C, 27};
+    constexpr Pin PC28 = {Port::C, 28};
+    constexpr Pin PC29 = {Port::C, 29};
+    constexpr Pin PC30 = {Port::C, 30};
+    constexpr Pin PC31 = {Port::C, 31};
 
     // The PinState type can be used for clearer types, even though it's basically a boolean
     using PinState = bool;
@@ -194,8 +194,9 @@ namespace GPIO {
     void disablePeripheral(const Pin& pin);
 
     // Interrupts
-    void enableInterrupt(const Pin& pin, void (*handler)(), Trigger trigger=Trigger::RISING);
-    void enableInterrupt(const Pin& pin, Trigger trigger=Trigger::RISING);
+    // With filter, pulses shorter than a cycle of the GPIO clock are ignored
+    void enableInterrupt(const Pin& pin, void (*handler)(), Trigger trigger=Trigger::RISING, bool filter=false);
+    void enableInterrupt(const Pin& pin, Trigger trigger=Trigger::RISING, bool filter=false);
     void disableInterrupt(const Pin& pin);
 
     // Helper functions
@@ -221,6 +222,87 @@ namespace GPIO {
     inline void setHighPB00() {((volatile RSCT_REG*)(GPIO_BASE + PORT_REG_SIZE + OFFSET_OVR))->SET = 1;}
     inline void setLowPB00() {((volatile RSCT_REG*)(GPIO_BASE + PORT_REG_SIZE + OFFSET_OVR))->CLEAR = 1;}
 
+    // Pins known at compile time, for the hot paths : the address of the port registers and the
+    // mask of the pin are constants, so that set() and get() compile to a single store or load,
+    // instead of the computation done by GPIO::set() and GPIO::get() at each call, e.g.
+    // using FastLed = GPIO::FastPin<GPIO::PA20.port, GPIO::PA20.number>;
+    // GPIO::enableOutput(FastLed::pin(), GPIO::LOW);
+    // FastLed::set(GPIO::HIGH);
+    template<Port PORT, uint8_t NUMBER>
+    struct FastPin {
+        static_assert(NUMBER < 32, "invalid pin number");
+        static const uint32_t REG_BASE = GPIO_BASE + static_cast<uint8_t>(PORT) * PORT_REG_SIZE;
+        static const uint32_t MASK = 1u << NUMBER;
+
+        // For the other functions of this module
+        static Pin pin() { return {PORT, NUMBER, Periph::A}; }
+
+        static inline PinState get() {
+            // PVR (Pin Value Register) : get the pin state
+            return ((volatile RSCT_REG*)(REG_BASE + OFFSET_PVR))->RW & MASK;
+        }
+
+        static inline void set(PinState value) {
+            // OVR (Output Value Register) : set the pin output state
+            if (value) {
+                ((volatile RSCT_REG*)(REG_BASE + OFFSET_OVR))->SET = MASK;
+            } else {
+                ((volatile RSCT_REG*)(REG_BASE + OFFSET_OVR))->CLEAR = MASK;
+            }
+        }
+
+        static inline void setHigh() { set(HIGH); }
+        static inline void setLow() { set(LOW); }
+    };
+
+    // Internal : port and mask of a list of FastPin
+    template<typename... PINS>
+    struct FastPinsMask;
+
+    template<typename PIN>
+    struct FastPinsMask<PIN> {
+        static const uint32_t REG_BASE = PIN::REG_BASE;
+        static const uint32_t MASK = PIN::MASK;
+
+        static constexpr uint32_t bits(PinState value) {
+            return value ? PIN::MASK : 0;
+        }
+    };
+
+    template<typename PIN, typename... OTHERS>
+    struct FastPinsMask<PIN, OTHERS...> {
+        static_assert(PIN::REG_BASE == FastPinsMask<OTHERS...>::REG_BASE, "the pins must be on the same port");
+        static_assert((PIN::MASK & FastPinsMask<OTHERS...>::MASK) == 0, "the same pin is given twice");
+        static const uint32_t REG_BASE = PIN::REG_BASE;
+        static const uint32_t MASK = PIN::MASK | FastPinsMask<OTHERS...>::MASK;
+
+        template<typename... VALUES>
+        static constexpr uint32_t bits(PinState value, VALUES... others) {
+            return (value ? PIN::MASK : 0) | FastPinsMask<OTHERS...>::bits(others...);
+        }
+    };
+
+    // Several FastPin of the same port, set by a single write so that their edges happen in the
+    // same cycle, with the values given in the same order as the pins, e.g.
+    // using Outputs = GPIO::FastPins<FastFocus, FastTrigger>;
+    // Outputs::set(GPIO::HIGH, GPIO::LOW);
+    // The pins which change are toggled from their current output value : the other writers of
+    // these pins must not interrupt set().
+    template<typename... PINS>
+    struct FastPins {
+        static const uint32_t REG_BASE = FastPinsMask<PINS...>::REG_BASE;
+        static const uint32_t MASK = FastPinsMask<PINS...>::MASK;
+
+        template<typename... VALUES>
+        static inline void set(VALUES... values) {
+            static_assert(sizeof...(VALUES) == sizeof...(PINS), "one value is required for each pin");
+            volatile RSCT_REG* ovr = (volatile RSCT_REG*)(REG_BASE + OFFSET_OVR);
+
+            // OVR (Output Value Register) : toggle the pins which must change
+            ovr->TOGGLE = (ovr->RW ^ FastPinsMask<PINS...>::bits(values...)) & MASK;
+        }
+    };
+
     // Internal initialization function. This is called in Core::init() and don't have to
     // be called by the user.
     void init();
@@ -10,6 +10,7 @@ namespace PM {
     unsigned long _cpuClockFrequency = RCSYS_FREQUENCY;
     unsigned long _hsbClockFrequency = RCSYS_FREQUENCY;
     unsigned long _pbaClockFrequency = RCSYS_FREQUENCY;
+    unsigned long _pbaDivider = 0;
 
     // Interrupt handlers
     extern uint8_t INTERRUPT_PRIORITY;
@@ -76,7 +77,37 @@ namespace PM {
         }
         _cpuClockFrequency = _mainClockFrequency / (1 << cpudiv);
         _hsbClockFrequency = _mainClockFrequency;
-        _pbaClockFrequency = _mainClockFrequency;
+        _pbaClockFrequency = _mainClockFrequency >> _pbaDivider;
+    }
+
+    // The PBA clock, used by most peripherals (SPI, TC, ADC, USART...), is the main clock
+    // divided by 2^pbadiv (0 : not divided). This allows the main clock to be changed
+    // while keeping the same frequency for these peripherals.
+    void setPBADivider(unsigned long pbadiv) {
+        if (pbadiv > 7) {
+            pbadiv = 7;
+        }
+
+        // Unlock the PBASEL register
+        (*(volatile uint32_t*)(BASE + OFFSET_UNLOCK))
+                = UNLOCK_KEY               // KEY : Magic word (see datasheet)
+                | OFFSET_PBASEL;           // ADDR : unlock PBASEL
+
+        // Configure the PBA clock divider
+        if (pbadiv >= 1) {
+            (*(volatile uint32_t*)(BASE + OFFSET_PBASEL))
+                    = (pbadiv - 1) << PBASEL_PBSEL  // PBSEL : select divider factor
+                    | 1 << PBASEL_PBDIV;            // PBDIV : enable divider
+        } else {
+            (*(volatile uint32_t*)(BASE + OFFSET_PBASEL)) = 0;
+        }
+
+        // Wait for the divider to be ready
+        while (!((*(volatile uint32_t*)(BASE + OFFSET_SR)) & (1 << SR_CKRDY)));
+
+        // Save the frequency
+        _pbaDivider = pbadiv;
+        _pbaClockFrequency = _mainClockFrequency >> pbadiv;
     }
 
     unsigned long getModuleClockFrequency(uint8_t peripheral) {
@@ -46,6 +46,8 @@ namespace PM {
     // Subregisters
     const uint32_t CPUSEL_CPUSEL = 0;
     const uint32_t CPUSEL_CPUDIV = 7;
+    const uint32_t PBASEL_PBSEL = 0;
+    const uint32_t PBASEL_PBDIV = 7;
     const uint32_t MCCTRL_MCSEL = 0;
     const uint32_t SR_CFD = 0;
     const uint32_t SR_CKRDY = 5;
@@ -108,6 +110,8 @@ namespace PM {
 
     // Peripheral clocks
     const int CLK_DMA = HSBMASK + HSBMASK_PDCA;
+    const int CLK_PICOCACHE = HSBMASK + HSBMASK_FLASHCALW_PICOCACHE; // The PicoCache has 2 clocks
+    const int CLK_PICOCACHE_REGS = PBBMASK + PBBMASK_HRAMC1;
     const int CLK_USB_HSB = HSBMASK + HSBMASK_USBC; // The USB has 2 clocks
     const int CLK_CRC = HSBMASK + HSBMASK_CRCCU;
     const int CLK_AES = HSBMASK + HSBMASK_AESA;
@@ -200,6 +204,7 @@ namespace PM {
 
     // Clock management
     void setMainClockSource(MainClockSource clockSource, unsigned long cpudiv=0);
+    void setPBADivider(unsigned long pbadiv);
     inline unsigned long getMainClockFrequency() { return _mainClockFrequency; }
     inline unsigned long getCPUClockFrequency() { return _cpuClockFrequency; }
     unsigned long getModuleClockFrequency(uint8_t peripheral);
@@ -30,6 +30,11 @@ namespace TC {
 
     void execDelayedHandlerWrapper();
 
+    // Overflow handlers of the free-running counters
+    uint32_t _overflowHandlers[MAX_N_TC][N_COUNTERS_PER_TC];
+
+    void overflowHandlerWrapper();
+
     // Internal functions
     inline void checkTC(Counter counter) {
         if (counter.tc + 1 > N_TC) {
@@ -113,6 +118,75 @@ namespace TC {
     }
 
 
+    // Free-running counter mode
+
+    // Count continuously from 0 to 0xFFFF and wrap around, calling overflowHandler (if any) on each
+    // overflow. Useful as a high-resolution timebase, extended in software by counting the overflows.
+    void enableFreeRunningCounter(Counter counter, void (*overflowHandler)(), SourceClock sourceClock, unsigned long sourceClockFrequency) {
+        checkTC(counter);
+        uint32_t REG = TC_BASE + counter.tc * TC_SIZE + counter.n * OFFSET_COUNTER_SIZE;
+
+        // Initialize the counter and its clock
+        initCounter(counter, sourceClock, sourceClockFrequency);
+
+        // WPMR (Write Protect Mode Register) : disable write protect
+        (*(volatile uint32_t*)(TC_BASE + counter.tc * TC_SIZE + OFFSET_WPMR))
+            = 0 << WPMR_WPEN            // WPEN : write protect disabled
+            | UNLOCK_KEY << WPMR_WPKEY; // WPKEY : write protect key
+
+        // CCR (Channel Control Register) : disable the clock
+        (*(volatile uint32_t*)(REG + OFFSET_CCR0))
+            = 1 << CCR_CLKDIS;       // CLKDIS : disable the clock
+
+        // CMR (Channel Mode Register) : setup the counter in Waveform Generation Mode
+        (*(volatile uint32_t*)(REG + OFFSET_CMR0))
+            =                   // TCCLKS : clock selection
+              (static_cast<int>(sourceClock) & 0b111) << CMR_TCCLKS
+            | 0 << CMR_WAVSEL   // WAVSEL : UP mode without automatic trigger on RC Compare
+            | 1 << CMR_WAVE;    // WAVE : waveform generation mode
+
+        // CCR (Channel Control Register) : enable the clock
+        (*(volatile uint32_t*)(REG + OFFSET_CCR0))
+            = 1 << CCR_CLKEN;        // CLKEN : enable the clock
+
+        // WPMR (Write Protect Mode Register) : re-enable write protect
+        (*(volatile uint32_t*)(TC_BASE + counter.tc * TC_SIZE + OFFSET_WPMR))
+            = 1 << WPMR_WPEN            // WPEN : write protect enabled
+            | UNLOCK_KEY << WPMR_WPKEY; // WPKEY : write protect key
+
+        // Enable the overflow interrupt
+        _overflowHandlers[counter.tc][counter.n] = (uint32_t)overflowHandler;
+        if (overflowHandler != nullptr) {
+            Core::Interrupt interrupt = static_cast<Core::Interrupt>(static_cast<int>(Core::Interrupt::TC00) + counter.tc * N_COUNTERS_PER_TC + counter.n);
+            Core::setInterruptHandler(interrupt, &overflowHandlerWrapper);
+            Core::enableInterrupt(interrupt, INTERRUPT_PRIORITY);
+
+            // IER (Interrupt Enable Register) : enable the COVFS (counter overflow) interrupt
+            (*(volatile uint32_t*)(REG + OFFSET_IER0)) = 1 << SR_COVFS;
+        }
+
+        // Reset and start the counter
+        start(counter);
+    }
+
+    void overflowHandlerWrapper() {
+        // Get the channel which generated the interrupt
+        int interrupt = static_cast<int>(Core::currentInterrupt()) - static_cast<int>(Core::Interrupt::TC00);
+        int tc = interrupt / N_COUNTERS_PER_TC;
+        int counter = interrupt % N_COUNTERS_PER_TC;
+        uint32_t REG = TC_BASE + tc * TC_SIZE + counter * OFFSET_COUNTER_SIZE;
+
+        // Reading SR clears the interrupt
+        (*(volatile uint32_t*)(REG + OFFSET_SR0));
+
+        // Call the user handler
+        void (*handler)() = (void (*)())_overflowHandlers[tc][counter];
+        if (handler) {
+            handler();
+        }
+    }
+
+
     // PWM mode
 
     // Initialize a TC channel and counter in PWM mode with the given period and hightime in microseconds
@@ -500,7 +574,7 @@ namespace TC {
     }
 
     // Call the given handler after the specified delay
-    void execDelayed(Counter counter, void (*handler)(), unsigned long delay, bool repeat, Unit unit, SourceClock sourceClock, unsigned long sourceClockFrequency) {
+    void execDelayed(Counter counter, void (*handler)(), unsigned long delay, Unit unit, bool repeat, SourceClock sourceClock, unsigned long sourceClockFrequency) {
         checkTC(counter);
         uint32_t REG = TC_BASE + counter.tc * TC_SIZE + counter.n * OFFSET_COUNTER_SIZE;
 
@@ -517,20 +591,34 @@ namespace TC {
         // Compute timings
         // If the requested delay is longer than a full period of the counter, compute and save the number
         // of periods to skip before calling the user handler
+        unsigned long value = delay;
         if (unit == Unit::MILLISECONDS) {
-            delay *= 1000;
+            value = (uint64_t)delay * TC::sourceClockFrequency(counter) / 1000;
+        } else if (unit == Unit::MICROSECONDS) {
+            value = (uint64_t)delay * TC::sourceClockFrequency(counter) / 1000000;
         }
-        unsigned int basePeriod = 80000000L / PM::getModuleClockFrequency(PM::CLK_TC0 + counter.tc);
-        unsigned long value = delay * 10 / basePeriod;
         unsigned int skipPeriods = value / 0x10000; // 0x10000 is the max counter value
         unsigned int rest = value % 0x10000;
-        data.skipPeriods = data.skipPeriodsReset = skipPeriods;
+        // The first full period is already running when the counter starts
+        data.skipPeriodsReset = skipPeriods;
+        data.skipPeriods = (skipPeriods > 0 ? skipPeriods - 1 : 0);
         data.rest = data.restReset = (skipPeriods > 0 ? rest : 0);
         data.repeat = repeat;
         (*(volatile uint32_t*)(TC_BASE + counter.tc * TC_SIZE + OFFSET_WPMR)) = 0 << WPMR_WPEN | UNLOCK_KEY << WPMR_WPKEY;
+
+        // CMR (Channel Mode Register) : count up to RC and restart, so that each RC compare ends a period
+        (*(volatile uint32_t*)(REG + OFFSET_CMR0))
+            =                   // TCCLKS : clock selection
+              (static_cast<int>(sourceClock) & 0b111) << CMR_TCCLKS
+            | 2 << CMR_WAVSEL   // WAVSEL : UP mode with automatic trigger on RC Compare
+            | 1 << CMR_WAVE;    // WAVE : waveform generation mode
+
         (*(volatile uint32_t*)(REG + OFFSET_RC0)) = (skipPeriods > 0 ? 0xFFFF : rest);
         (*(volatile uint32_t*)(TC_BASE + counter.tc * TC_SIZE + OFFSET_WPMR)) = 1 << WPMR_WPEN | UNLOCK_KEY << WPMR_WPKEY;
 
+        // SR (Status Register) : clear a compare left by a previous call
+        (*(volatile uint32_t*)(REG + OFFSET_SR0));
+
         // Enable the interrupt at the core level
         Core::Interrupt interrupt = static_cast<Core::Interrupt>(static_cast<int>(Core::Interrupt::TC00) + counter.tc * N_COUNTERS_PER_TC + counter.n);
         Core::setInterruptHandler(interrupt, &execDelayedHandlerWrapper);
@@ -579,10 +667,10 @@ namespace TC {
             // Repeat
             if (data.repeat) {
                 // Reset the data structure with their initial value
-                data.skipPeriods = data.skipPeriodsReset;
+                data.skipPeriods = (data.skipPeriodsReset > 0 ? data.skipPeriodsReset - 1 : 0);
                 data.rest = data.restReset;
                 (*(volatile uint32_t*)(TC_BASE + tc * TC_SIZE + OFFSET_WPMR)) = 0 << WPMR_WPEN | UNLOCK_KEY << WPMR_WPKEY;
-                (*(volatile uint32_t*)(REG + OFFSET_RC0)) = (data.skipPeriods > 0 ? 0xFFFF : data.rest);
+                (*(volatile uint32_t*)(REG + OFFSET_RC0)) = (data.skipPeriodsReset > 0 ? 0xFFFF : data.restReset);
                 (*(volatile uint32_t*)(TC_BASE + tc * TC_SIZE + OFFSET_WPMR)) = 1 << WPMR_WPEN | UNLOCK_KEY << WPMR_WPKEY;
                 (*(volatile uint32_t*)(REG + OFFSET_CCR0)) = 1 << CCR_SWTRG;
 
@@ -593,6 +681,21 @@ namespace TC {
         }
     }
 
+    // Cancel a delayed call which has not been executed yet. If its interrupt is already pending,
+    // the handler may still be called once.
+    void cancelDelayed(Counter counter) {
+        checkTC(counter);
+        uint32_t REG = TC_BASE + counter.tc * TC_SIZE + counter.n * OFFSET_COUNTER_SIZE;
+
+        // IDR (Interrupt Disable Register) : disable the CPCS (RC value reached) interrupt
+        (*(volatile uint32_t*)(REG + OFFSET_IDR0)) = 1 << SR_CPCS;
+
+        // Stop the timer and clear its status
+        (*(volatile uint32_t*)(REG + OFFSET_CCR0)) = 1 << CCR_CLKDIS;
+        (*(volatile uint32_t*)(REG + OFFSET_SR0));
+        execDelayedData[counter.tc][counter.n].repeat = false;
+    }
+
     // Start the counter and reset its value by issuing a software trigger
     void start(Counter counter) {
         checkTC(counter);
@@ -116,7 +116,8 @@ namespace TC {
 
     enum class Unit {
         MILLISECONDS,
-        MICROSECONDS
+        MICROSECONDS,
+        TICKS // Periods of the source clock of the counter
     };
     
     // The actual number of TCs available is package-dependant
@@ -180,6 +181,9 @@ namespace TC {
     // Simple counter mode
     void enableSimpleCounter(Counter counter, uint16_t maxValue=0xFFFF, SourceClock sourceClock=SourceClock::PBA_OVER_8, unsigned long sourceClockFrequency=0, bool invertClock=false, bool upDown=false);
 
+    // Free-running counter mode
+    void enableFreeRunningCounter(Counter counter, void (*overflowHandler)()=nullptr, SourceClock sourceClock=SourceClock::PBA_OVER_8, unsigned long sourceClockFrequency=0);
+
     // PWM mode
     bool enablePWM(Channel channel, float period=0, float highTime=0, bool output=true, SourceClock sourceClock=SourceClock::PBA_OVER_8, unsigned long sourceClockFrequency=0);
     bool setPeriod(Counter counter, float period);
@@ -210,6 +214,7 @@ namespace TC {
     // Timing functions
     void wait(Counter counter, unsigned long delay, Unit unit=Unit::MILLISECONDS, SourceClock sourceClock=SourceClock::PBA_OVER_8, unsigned long sourceClockFrequency=0);
     void execDelayed(Counter counter, void (*handler)(), unsigned long delay, Unit unit=Unit::MILLISECONDS, bool repeat=false, SourceClock sourceClock=SourceClock::PBA_OVER_8, unsigned long sourceClockFrequency=0);
+    void cancelDelayed(Counter counter);
 
     // Functions common to all modes
     void start(Counter counter);
@@ -0,0 +1,95 @@
+#include "timers.h"
+#include "core.h"
+#include <TimerList.h>
+
+namespace Timers {
+
+    TimerList<N_TIMERS> _timers;
+
+
+    // Internal functions
+    void program();
+    void alarmHandler();
+
+
+    // Start a timer which expires in delay milliseconds, and then every delay milliseconds if
+    // periodic is set. handler is optional : isRunning() becomes false when a one-shot timer
+    // expires. Return a handle for cancel() and isRunning(), or INVALID if all the timers are used.
+    int start(unsigned long delay, void (*handler)(), bool periodic) {
+        return startAt(AST::time() + delay, handler, periodic ? delay : 0);
+    }
+
+    // Start a timer which expires at the given time (see Core::time()), and then every period
+    // milliseconds if period is not 0
+    int startAt(AST::Time time, void (*handler)(), unsigned long period) {
+        // Critical section
+        Core::disableInterrupts();
+        int handle = _timers.add(time, period, handler);
+        if (handle != INVALID) {
+            program();
+        }
+        Core::enableInterrupts();
+        return handle;
+    }
+
+    // Stop a timer, and return false if it was not running anymore
+    bool cancel(int handle) {
+        // Critical section
+        Core::disableInterrupts();
+        bool cancelled = _timers.cancel(handle);
+        Core::enableInterrupts();
+        return cancelled;
+    }
+
+    bool isRunning(int handle) {
+        // Critical section
+        Core::disableInterrupts();
+        bool running = _timers.isRunning(handle);
+        Core::enableInterrupts();
+        return running;
+    }
+
+    int nRunning() {
+        return _timers.size();
+    }
+
+    // Program the AST alarm for the earliest deadline. The alarm is relative, so that a deadline
+    // which has just passed still triggers it. A deadline which is cancelled afterwards only
+    // causes a spurious interrupt.
+    void program() {
+        if (_timers.isEmpty()) {
+            AST::disableAlarm();
+            return;
+        }
+        AST::Time now = AST::time();
+        AST::Time next = _timers.next();
+        unsigned long delay = next > now ? next - now : 0;
+        if (delay > MAX_ALARM_DELAY) {
+            delay = MAX_ALARM_DELAY;
+        }
+        AST::enableAlarm(delay, true, alarmHandler);
+    }
+
+    void alarmHandler() {
+        // Call the handlers of the timers which have expired. The alarm can fire up to a
+        // millisecond early because of the conversion between ms and clock cycles : the timer
+        // then stays in the list and the alarm is programmed again.
+        // The list is only locked while it is modified, so the handlers can start and cancel timers.
+        while (1) {
+            void (*handler)() = nullptr;
+            Core::disableInterrupts();
+            bool expired = _timers.expire(AST::time(), handler);
+            if (!expired) {
+                program();
+            }
+            Core::enableInterrupts();
+            if (!expired) {
+                break;
+            }
+            if (handler != nullptr) {
+                handler();
+            }
+        }
+    }
+
+}
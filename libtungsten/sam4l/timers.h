@@ -0,0 +1,30 @@
+#ifndef _TIMERS_H_
+#define _TIMERS_H_
+
+#include <stdint.h>
+#include "ast.h"
+
+// Software timers
+// This module owns the single alarm of the AST and multiplexes it between any number of one-shot
+// or periodic deadlines : the alarm is always programmed for the earliest one. The handlers are
+// called from the AST alarm interrupt, so they should be short (set a flag, start a transfer...).
+// Core::sleep() is based on this module, so AST::enableAlarm() must not be used directly.
+namespace Timers {
+
+    const int N_TIMERS = 16;
+    const int INVALID = -1;
+
+    // The alarm is programmed at most this far in the future, see AST::enableAlarm()
+    const unsigned long MAX_ALARM_DELAY = 3600000L; // 1h
+
+    // Module API
+    int start(unsigned long delay, void (*handler)()=nullptr, bool periodic=false);
+    int startAt(AST::Time time, void (*handler)()=nullptr, unsigned long period=0);
+    bool cancel(int handle);
+    bool isRunning(int handle);
+    int nRunning();
+
+}
+
+
+#endif
@@ -237,7 +237,7 @@ namespace USB {
             ep->descriptor.bEndpointAddress = n | ((direction == EPDir::IN ? 1 : 0) << 7);
             ep->descriptor.bmAttributes = static_cast<int>(type);
             ep->descriptor.wMaxPacketSize = EP_SIZES[static_cast<int>(size)];
-            ep->descriptor.bInterval = 10;
+            ep->descriptor.bInterval = (type == EPType::INTERRUPT ? EP_INTERRUPT_INTERVAL : 10);
 
             // Set up descriptor for bank0
             //memset(bank0, 0, EP_SIZES[static_cast<int>(size)]);
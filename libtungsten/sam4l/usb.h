@@ -306,6 +306,7 @@ namespace USB {
         int (*handlers[static_cast<int>(EPHandlerType::NUMBER)])(int); // Array of function pointers of EPHandlerType
         EndpointDescriptor descriptor;
     };
+    const uint8_t EP_INTERRUPT_INTERVAL = 1; // ms, polling interval requested for interrupt endpoints
     using Endpoint = int; // Helper type to manage endpoints, created by newEndpoint()
     const Endpoint EP_ERROR = -1;
     extern const int BANK_EP0_SIZE;
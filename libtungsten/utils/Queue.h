@@ -0,0 +1,82 @@
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
+#include <stdint.h>
+
+// Bounded single-producer/single-consumer queue, safe to use between an interrupt handler
+// and the main loop without masking interrupts, as long as only one context calls push()
+// and only one context calls front()/pop()/clear().
+// SIZE must be a power of two : the cursors are free-running and are masked when indexing,
+// which makes the full and empty states unambiguous and keeps each cursor owned by one side.
+template<typename T, unsigned int SIZE>
+class Queue {
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "Queue SIZE must be a power of two");
+
+private:
+    T _items[SIZE];
+    volatile unsigned int _cursorW = 0; // Only modified by the producer
+    volatile unsigned int _cursorR = 0; // Only modified by the consumer
+    volatile unsigned int _overflows = 0; // Only modified by the producer
+
+    // Make sure the item is written (or read) before the cursor is published
+    static inline void barrier() { __sync_synchronize(); }
+
+public:
+    // Producer : append an item, or count an overflow and return false if the queue is full
+    bool push(const T& item) {
+        unsigned int w = _cursorW;
+        if (w - _cursorR >= SIZE) {
+            _overflows = _overflows + 1;
+            return false;
+        }
+        _items[w & (SIZE - 1)] = item;
+        barrier();
+        _cursorW = w + 1;
+        return true;
+    }
+
+    // Consumer : access the oldest item without removing it. The queue must not be empty.
+    T& front() {
+        barrier();
+        return _items[_cursorR & (SIZE - 1)];
+    }
+
+    // Consumer : remove the oldest item and copy it into item, or return false if the queue is empty
+    bool pop(T& item) {
+        unsigned int r = _cursorR;
+        if (r == _cursorW) {
+            return false;
+        }
+        barrier();
+        item = _items[r & (SIZE - 1)];
+        barrier();
+        _cursorR = r + 1;
+        return true;
+    }
+
+    // Consumer : remove the oldest item
+    void pop() {
+        unsigned int r = _cursorR;
+        if (r != _cursorW) {
+            barrier();
+            _cursorR = r + 1;
+        }
+    }
+
+    // Consumer : drop every pending item
+    void clear() {
+        _cursorR = _cursorW;
+    }
+
+    // Number of items currently in the queue
+    unsigned int size() const { return _cursorW - _cursorR; }
+    bool isEmpty() const { return _cursorW == _cursorR; }
+    bool isFull() const { return size() >= SIZE; }
+    unsigned int capacity() const { return SIZE; }
+
+    // Number of items dropped by push() because the queue was full
+    unsigned int overflows() const { return _overflows; }
+
+};
+
+#endif
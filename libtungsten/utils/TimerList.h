@@ -0,0 +1,138 @@
+#ifndef _TIMER_LIST_H_
+#define _TIMER_LIST_H_
+
+#include <stdint.h>
+
+// Fixed pool of SIZE timers, kept in a list sorted by deadline so that the earliest one is always
+// at the head. Timers with the same deadline expire in the order they were added. Adding a timer
+// is linear in the number of running timers, everything else is constant time except cancel().
+// This class only handles the bookkeeping : the time is given by the caller, and it is not safe to
+// use from several contexts at once (see Timers in the sam4l library for the interrupt-driven service).
+// A handle identifies a timer until it is cancelled or, for a one-shot timer, until it expires :
+// the slot is then tagged with a new generation, so an old handle cannot reach a new timer.
+template<unsigned int SIZE>
+class TimerList {
+    static_assert(SIZE > 0 && SIZE <= 256, "TimerList SIZE must be between 1 and 256");
+
+public:
+    using Time = uint64_t;
+    using Handler = void (*)();
+    static const int INVALID = -1;
+
+private:
+    static const int END = -1;
+
+    struct Timer {
+        Time deadline;
+        Time period; // 0 : one-shot
+        Handler handler;
+        int next;
+        uint16_t generation;
+        bool running;
+    };
+
+    Timer _timers[SIZE] = {};
+    int _head = END;
+    unsigned int _size = 0;
+
+    int handleOf(int slot) const { return _timers[slot].generation << 8 | slot; }
+
+    // Slot of a running timer, or END if the handle is stale
+    int slotOf(int handle) const {
+        if (handle < 0) {
+            return END;
+        }
+        int slot = handle & 0xFF;
+        if (slot >= (int)SIZE || !_timers[slot].running || handleOf(slot) != handle) {
+            return END;
+        }
+        return slot;
+    }
+
+    // Insert a slot after the timers which expire at the same time or before
+    void insert(int slot) {
+        int* link = &_head;
+        while (*link != END && _timers[*link].deadline <= _timers[slot].deadline) {
+            link = &_timers[*link].next;
+        }
+        _timers[slot].next = *link;
+        *link = slot;
+    }
+
+    // Unlink a running slot from the list
+    void unlink(int slot) {
+        int* link = &_head;
+        while (*link != slot) {
+            link = &_timers[*link].next;
+        }
+        *link = _timers[slot].next;
+    }
+
+    void release(int slot) {
+        _timers[slot].running = false;
+        _timers[slot].generation = (_timers[slot].generation + 1) & 0x7FFF;
+        _size--;
+    }
+
+public:
+    // Start a timer which expires at deadline, and then every period if period is not 0.
+    // Return its handle, or INVALID if all the timers are already running.
+    int add(Time deadline, Time period=0, Handler handler=nullptr) {
+        for (unsigned int slot = 0; slot < SIZE; slot++) {
+            if (!_timers[slot].running) {
+                _timers[slot].deadline = deadline;
+                _timers[slot].period = period;
+                _timers[slot].handler = handler;
+                _timers[slot].running = true;
+                _size++;
+                insert(slot);
+                return handleOf(slot);
+            }
+        }
+        return INVALID;
+    }
+
+    // Stop a timer, and return false if it was not running anymore
+    bool cancel(int handle) {
+        int slot = slotOf(handle);
+        if (slot == END) {
+            return false;
+        }
+        unlink(slot);
+        release(slot);
+        return true;
+    }
+
+    bool isRunning(int handle) const { return slotOf(handle) != END; }
+
+    // Deadline of the timer which expires first. The list must not be empty.
+    Time next() const { return _timers[_head].deadline; }
+
+    // Remove the first timer if it has expired at now, and return its handler in handler. A
+    // periodic timer is rescheduled on its next deadline after now : missed periods are skipped
+    // instead of expiring in a burst. Return false if no timer has expired.
+    bool expire(Time now, Handler& handler) {
+        if (_head == END || _timers[_head].deadline > now) {
+            return false;
+        }
+        int slot = _head;
+        Timer& timer = _timers[slot];
+        handler = timer.handler;
+        _head = timer.next;
+        if (timer.period > 0) {
+            timer.deadline += ((now - timer.deadline) / timer.period + 1) * timer.period;
+            insert(slot);
+        } else {
+            release(slot);
+        }
+        return true;
+    }
+
+    // Number of running timers
+    unsigned int size() const { return _size; }
+    bool isEmpty() const { return _size == 0; }
+    unsigned int capacity() const { return SIZE; }
+
+};
+
+#endif
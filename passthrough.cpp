@@ -0,0 +1,119 @@
+#include "passthrough.h"
+
+namespace Passthrough {
+
+    uint32_t _delay = 0; // ticks
+    uint32_t _stretch = 0; // ticks
+    State _state = State::IDLE;
+    uint32_t _deadline = 0; // End of the delay or of the outputs, when the timer is running
+    uint32_t _minEnd = 0; // The outputs last at least until then, because of the stretch
+    uint32_t _delayedRelease = 0; // Release of an input pulse which ended during the delay, delayed
+
+    // Internal functions
+    Action action(Timer timer=Timer::KEEP, uint32_t timerDelay=0);
+    bool before(uint32_t t, uint32_t deadline);
+    uint32_t latest(uint32_t t1, uint32_t t2);
+
+
+    // Set the delay and the minimum duration of the outputs (ticks), and release them
+    void configure(uint32_t delay, uint32_t stretch) {
+        _delay = delay;
+        _stretch = stretch;
+        _state = State::IDLE;
+    }
+
+    // The input was asserted or released
+    Action edge(bool asserted, uint32_t now) {
+        if (asserted) {
+            if (_state == State::IDLE) {
+                _minEnd = now + _delay + _stretch;
+                if (_delay == 0) {
+                    _state = State::ACTIVE;
+                    return action();
+                }
+                _state = State::DELAY;
+                _deadline = now + _delay;
+                return action(Timer::START, _delay);
+
+            } else if (_state == State::DELAY_RELEASED) {
+                // Merged with the pulse which is waiting for the end of the delay
+                _state = State::DELAY;
+                _minEnd = latest(_minEnd, now + _delay + _stretch);
+
+            } else if (_state == State::STRETCH) {
+                // The outputs are still asserted : continue the same pulse
+                _state = State::ACTIVE;
+                _minEnd = latest(_minEnd, now + _delay + _stretch);
+                return action(Timer::CANCEL);
+            }
+
+        } else {
+            if (_state == State::DELAY) {
+                _state = State::DELAY_RELEASED;
+                _delayedRelease = now + _delay;
+
+            } else if (_state == State::ACTIVE) {
+                // The release is delayed as well, and the pulse is stretched if necessary
+                uint32_t deadline = latest(_minEnd, now + _delay);
+                if (!before(now, deadline)) {
+                    _state = State::IDLE;
+                    return action();
+                }
+                _state = State::STRETCH;
+                _deadline = deadline;
+                return action(Timer::START, deadline - now);
+            }
+        }
+        return action();
+    }
+
+    // The timer expired. It may be late, or early if it was cancelled too late and fires anyway :
+    // the deadline is checked again.
+    Action timeout(uint32_t now) {
+        if (_state != State::DELAY && _state != State::DELAY_RELEASED && _state != State::STRETCH) {
+            return action();
+        }
+        if (before(now, _deadline)) {
+            return action(Timer::START, _deadline - now);
+        }
+
+        if (_state == State::DELAY) {
+            _state = State::ACTIVE;
+
+        } else if (_state == State::DELAY_RELEASED) {
+            // Replay the input pulse, stretched if necessary. A pulse too short to be measured
+            // still lasts one tick, so that it is not lost.
+            _state = State::STRETCH;
+            uint32_t deadline = latest(_minEnd, _delayedRelease);
+            uint32_t duration = before(now, deadline) ? deadline - now : 1;
+            _deadline = now + duration;
+            return action(Timer::START, duration);
+
+        } else if (_state == State::STRETCH) {
+            _state = State::IDLE;
+        }
+        return action();
+    }
+
+    State state() {
+        return _state;
+    }
+
+    bool outputs() {
+        return _state == State::ACTIVE || _state == State::STRETCH;
+    }
+
+    Action action(Timer timer, uint32_t timerDelay) {
+        return {outputs(), timer, timerDelay};
+    }
+
+    // Comparison of free-running times, correct across the wrap-around
+    bool before(uint32_t t, uint32_t deadline) {
+        return (int32_t)(t - deadline) < 0;
+    }
+
+    uint32_t latest(uint32_t t1, uint32_t t2) {
+        return before(t1, t2) ? t2 : t1;
+    }
+
+}
@@ -0,0 +1,43 @@
+#ifndef _PASSTHROUGH_H_
+#define _PASSTHROUGH_H_
+
+#include <stdint.h>
+
+// State machine of the input passthrough : the outputs follow the external input, delayed by an
+// optional delay, and each pulse lasts at least an optional minimum duration (pulse stretch) so
+// that a short pulse from a sensor is still long enough for the camera. It is driven from the
+// interrupt handlers of the input edges and of a hardware timer (see Shutter), with the times in
+// ticks of the timer : every event returns the state of the outputs and what to do with the timer.
+// An input pulse which is asserted again before its delayed or stretched end is merged with it.
+// This module does not access the hardware, so that it can be checked on a host.
+namespace Passthrough {
+
+    enum class State : uint8_t {
+        IDLE,
+        DELAY, // Input asserted, outputs not yet
+        DELAY_RELEASED, // Input pulse already over, outputs not yet
+        ACTIVE, // Input and outputs asserted
+        STRETCH, // Input released, outputs held until the minimum duration
+    };
+
+    enum class Timer : uint8_t {
+        KEEP, // Leave the timer as it is
+        START, // (Re)start the timer for timerDelay
+        CANCEL,
+    };
+
+    struct Action {
+        bool outputs;
+        Timer timer;
+        uint32_t timerDelay; // ticks
+    };
+
+    void configure(uint32_t delay, uint32_t stretch);
+    Action edge(bool asserted, uint32_t now);
+    Action timeout(uint32_t now);
+    State state();
+    bool outputs();
+
+}
+
+#endif
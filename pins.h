@@ -7,73 +7,82 @@
 
 // I2C
 const I2C::Port I2C_PORT = I2C::Port::I2C1;
-const GPIO::Pin PIN_I2C_SDA = {GPIO::Port::B,  0, GPIO::Periph::A};
-const GPIO::Pin PIN_I2C_SCL = {GPIO::Port::B,  1, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_I2C_SDA = {GPIO::Port::B,  0, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_I2C_SCL = {GPIO::Port::B,  1, GPIO::Periph::A};
 
 // SPI
-const GPIO::Pin PIN_MISO = {GPIO::Port::A, 27, GPIO::Periph::A};
-const GPIO::Pin PIN_MOSI = {GPIO::Port::A, 28, GPIO::Periph::A};
-const GPIO::Pin PIN_SCK = {GPIO::Port::A, 29, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_MISO = {GPIO::Port::A, 27, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_MOSI = {GPIO::Port::A, 28, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_SCK = {GPIO::Port::A, 29, GPIO::Periph::A};
 
 // OLED
 const SPI::Peripheral SPI_SLAVE_OLED = 0;
-const GPIO::Pin PIN_OLED_CS = {GPIO::Port::A, 30, GPIO::Periph::A};
-const GPIO::Pin PIN_OLED_RES = GPIO::PB02;
-const GPIO::Pin PIN_OLED_DC = GPIO::PB03;
+constexpr GPIO::Pin PIN_OLED_CS = {GPIO::Port::A, 30, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_OLED_RES = GPIO::PB02;
+constexpr GPIO::Pin PIN_OLED_DC = GPIO::PB03;
 
 // LoRa
 const SPI::Peripheral SPI_SLAVE_LORA = 1;
-const GPIO::Pin PIN_LORA_CS = {GPIO::Port::A, 31, GPIO::Periph::A};
-const GPIO::Pin PIN_LORA_RESET = GPIO::PA09;
-const GPIO::Pin PIN_LORA_DIO0 = GPIO::PA07;
-const GPIO::Pin PIN_LORA_DIO1 = GPIO::PA06;
-const GPIO::Pin PIN_LORA_DIO2 = GPIO::PB05;
-const GPIO::Pin PIN_LORA_DIO3 = GPIO::PB06;
-const GPIO::Pin PIN_LORA_DIO4 = GPIO::PA08;
-const GPIO::Pin PIN_LORA_DIO5 = GPIO::PB07;
+constexpr GPIO::Pin PIN_LORA_CS = {GPIO::Port::A, 31, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_LORA_RESET = GPIO::PA09;
+constexpr GPIO::Pin PIN_LORA_DIO0 = GPIO::PA07;
+constexpr GPIO::Pin PIN_LORA_DIO1 = GPIO::PA06;
+constexpr GPIO::Pin PIN_LORA_DIO2 = GPIO::PB05;
+constexpr GPIO::Pin PIN_LORA_DIO3 = GPIO::PB06;
+constexpr GPIO::Pin PIN_LORA_DIO4 = GPIO::PA08;
+constexpr GPIO::Pin PIN_LORA_DIO5 = GPIO::PB07;
 
 // Buttons
-const GPIO::Pin PIN_BTN_UP = GPIO::PA19;
-const GPIO::Pin PIN_BTN_DOWN = GPIO::PA10;
-const GPIO::Pin PIN_BTN_LEFT = GPIO::PA11;
-const GPIO::Pin PIN_BTN_RIGHT = GPIO::PA13;
-const GPIO::Pin PIN_BTN_OK = GPIO::PA14;
-const GPIO::Pin PIN_BTN_PW = GPIO::PA01;
-const GPIO::Pin PIN_BTN_FOCUS = GPIO::PB04;
-const GPIO::Pin PIN_BTN_TRIGGER = GPIO::PA18;
+constexpr GPIO::Pin PIN_BTN_UP = GPIO::PA19;
+constexpr GPIO::Pin PIN_BTN_DOWN = GPIO::PA10;
+constexpr GPIO::Pin PIN_BTN_LEFT = GPIO::PA11;
+constexpr GPIO::Pin PIN_BTN_RIGHT = GPIO::PA13;
+constexpr GPIO::Pin PIN_BTN_OK = GPIO::PA14;
+constexpr GPIO::Pin PIN_BTN_PW = GPIO::PA01;
+constexpr GPIO::Pin PIN_BTN_FOCUS = GPIO::PB04;
+constexpr GPIO::Pin PIN_BTN_TRIGGER = GPIO::PA18;
 
 // LEDs
-const GPIO::Pin PIN_LED_FOCUS = GPIO::PA20;
-const GPIO::Pin PIN_LED_TRIGGER = GPIO::PB11;
-const GPIO::Pin PIN_LED_INPUT = GPIO::PB15;
+constexpr GPIO::Pin PIN_LED_FOCUS = GPIO::PA20;
+constexpr GPIO::Pin PIN_LED_TRIGGER = GPIO::PB11;
+constexpr GPIO::Pin PIN_LED_INPUT = GPIO::PB15;
 
 // Jack ports
-const GPIO::Pin PIN_P1_T = GPIO::PA17;
-const GPIO::Pin PIN_P1_T_PD = GPIO::PB08;
-const GPIO::Pin PIN_P1_R1 = GPIO::PB09;
-const GPIO::Pin PIN_P1_R1_PD = GPIO::PB10;
-const GPIO::Pin PIN_P1_R2 = GPIO::PA12;
-const GPIO::Pin PIN_P1_R2_PD = GPIO::PA16;
-const GPIO::Pin PIN_P1_SW = GPIO::PA15;
-const GPIO::Pin PIN_P2_T = GPIO::PB13;
-const GPIO::Pin PIN_P2_T_PD = GPIO::PB12;
-const GPIO::Pin PIN_P2_R1 = GPIO::PA23;
-const GPIO::Pin PIN_P2_R1_PD = GPIO::PA24;
-const GPIO::Pin PIN_P2_R2 = GPIO::PB14;
-const GPIO::Pin PIN_P2_R2_PD = GPIO::PA22;
-const GPIO::Pin PIN_P2_SW = GPIO::PA21;
+constexpr GPIO::Pin PIN_P1_T = GPIO::PA17;
+constexpr GPIO::Pin PIN_P1_T_PD = GPIO::PB08;
+constexpr GPIO::Pin PIN_P1_R1 = GPIO::PB09;
+constexpr GPIO::Pin PIN_P1_R1_PD = GPIO::PB10;
+constexpr GPIO::Pin PIN_P1_R2 = GPIO::PA12;
+constexpr GPIO::Pin PIN_P1_R2_PD = GPIO::PA16;
+constexpr GPIO::Pin PIN_P1_SW = GPIO::PA15;
+constexpr GPIO::Pin PIN_P2_T = GPIO::PB13;
+constexpr GPIO::Pin PIN_P2_T_PD = GPIO::PB12;
+constexpr GPIO::Pin PIN_P2_R1 = GPIO::PA23;
+constexpr GPIO::Pin PIN_P2_R1_PD = GPIO::PA24;
+constexpr GPIO::Pin PIN_P2_R2 = GPIO::PB14;
+constexpr GPIO::Pin PIN_P2_R2_PD = GPIO::PA22;
+constexpr GPIO::Pin PIN_P2_SW = GPIO::PA21;
 
 // Power enable command
-const GPIO::Pin PIN_PW_EN = GPIO::PA00;
+constexpr GPIO::Pin PIN_PW_EN = GPIO::PA00;
 
 // Battery voltage measurement
-const GPIO::Pin PIN_VBAT_MEAS = {GPIO::Port::A,  4, GPIO::Periph::A};
+constexpr GPIO::Pin PIN_VBAT_MEAS = {GPIO::Port::A,  4, GPIO::Periph::A};
 const int ADC_VBAT = 0;
-const GPIO::Pin PIN_VBAT_MEAS_CMD = GPIO::PA05;
+constexpr GPIO::Pin PIN_VBAT_MEAS_CMD = GPIO::PA05;
 
 // Aliases for features of the jack ports
-const GPIO::Pin PIN_INPUT = PIN_P2_T;
-const GPIO::Pin PIN_FOCUS = PIN_P1_R1_PD;
-const GPIO::Pin PIN_TRIGGER = PIN_P1_T_PD;
+constexpr GPIO::Pin PIN_INPUT = PIN_P2_T;
+constexpr GPIO::Pin PIN_FOCUS = PIN_P1_R1_PD;
+constexpr GPIO::Pin PIN_TRIGGER = PIN_P1_T_PD;
+
+// Compile-time versions of the pins used in the hot paths (see GPIO::FastPin)
+using FastPinInput = GPIO::FastPin<PIN_INPUT.port, PIN_INPUT.number>;
+using FastPinFocus = GPIO::FastPin<PIN_FOCUS.port, PIN_FOCUS.number>;
+using FastPinTrigger = GPIO::FastPin<PIN_TRIGGER.port, PIN_TRIGGER.number>;
+using FastPinsOutputs = GPIO::FastPins<FastPinFocus, FastPinTrigger>; // Edges in the same cycle
+using FastPinLedFocus = GPIO::FastPin<PIN_LED_FOCUS.port, PIN_LED_FOCUS.number>;
+using FastPinLedTrigger = GPIO::FastPin<PIN_LED_TRIGGER.port, PIN_LED_TRIGGER.number>;
+using FastPinLedInput = GPIO::FastPin<PIN_LED_INPUT.port, PIN_LED_INPUT.number>;
 
 #endif
\ No newline at end of file
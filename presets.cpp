@@ -0,0 +1,179 @@
+#include "presets.h"
+#include "sync.h"
+#include <string.h>
+
+namespace Presets {
+
+    Preset _presets[N_PRESETS];
+    int _page = -1;
+    uint32_t _sequence = 0;
+
+    const int HEADER_SIZE = 4; // words
+    const int RECORD_SIZE_WORDS = RECORD_SIZE / 4;
+    const int PAGE_SIZE = HEADER_SIZE + N_PRESETS * RECORD_SIZE_WORDS + 1; // words, with the CRC
+
+    constexpr int packedBits(int i=0) {
+        return i == N_FIELDS ? 0 : FIELDS[i].bits + packedBits(i + 1);
+    }
+    static_assert(packedBits() <= 8 * PACKED_SIZE, "the packed preset doesn't fit in PACKED_SIZE");
+    static_assert(NAME_SIZE + PACKED_SIZE <= RECORD_SIZE && RECORD_SIZE % 4 == 0, "invalid RECORD_SIZE");
+    static_assert(PAGE_SIZE <= Flash::FLASH_PAGE_SIZE_WORDS, "the presets don't fit in a page");
+    static_assert(FRAME_SIZE <= Sync::MAX_PAYLOAD_SIZE, "the preset frame doesn't fit in a radio frame");
+
+    // Internal functions
+    bool load(const uint32_t page[]);
+    void save();
+    void capture(Preset& preset);
+
+
+    // Read the presets of a page, and return false if it isn't valid
+    bool load(const uint32_t page[]) {
+        if (page[0] != PAGE_MAGIC || page[1] != ~page[2]
+                || page[3] != (uint32_t)(VERSION << 24 | N_PRESETS << 16 | RECORD_SIZE)
+                || Journal::crc32(page, PAGE_SIZE - 1) != page[PAGE_SIZE - 1]) {
+            return false;
+        }
+        for (int i = 0; i < N_PRESETS; i++) {
+            const uint8_t* record = reinterpret_cast<const uint8_t*>(page + HEADER_SIZE + i * RECORD_SIZE_WORDS);
+            memcpy(_presets[i].name, record, NAME_SIZE);
+            _presets[i].name[NAME_SIZE] = 0;
+            unpack(record + NAME_SIZE, _presets[i]);
+        }
+        return true;
+    }
+
+    void init() {
+        // Default presets, overwritten by the ones in flash if any
+        for (int i = 0; i < N_PRESETS; i++) {
+            memset(_presets[i].name, 0, sizeof(_presets[i].name));
+            strncpy(_presets[i].name, "Preset ", NAME_SIZE);
+            _presets[i].name[7] = '1' + i;
+            capture(_presets[i]);
+        }
+
+        // Find the most recent valid page
+        _page = -1;
+        _sequence = 0;
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        for (int i = 0; i < N_PAGES; i++) {
+            Flash::readPage(FIRST_PAGE + i, page);
+            if (page[0] == PAGE_MAGIC && page[1] == ~page[2] && (_page < 0 || page[1] > _sequence)
+                    && Journal::crc32(page, PAGE_SIZE - 1) == page[PAGE_SIZE - 1]) {
+                _page = i;
+                _sequence = page[1];
+            }
+        }
+        if (_page >= 0) {
+            // The presets stored by a firmware using another format are ignored
+            Flash::readPage(FIRST_PAGE + _page, page);
+            load(page);
+        }
+    }
+
+    // Write the presets in the page which isn't the current one, so that it stays valid until
+    // the new one is completely written
+    void save() {
+        _page = (_page + 1) % N_PAGES;
+        _sequence++;
+        uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+        memset(page, 0xFF, sizeof(page));
+        page[0] = PAGE_MAGIC;
+        page[1] = _sequence;
+        page[2] = ~_sequence;
+        page[3] = VERSION << 24 | N_PRESETS << 16 | RECORD_SIZE;
+        for (int i = 0; i < N_PRESETS; i++) {
+            uint8_t* record = reinterpret_cast<uint8_t*>(page + HEADER_SIZE + i * RECORD_SIZE_WORDS);
+            memcpy(record, _presets[i].name, NAME_SIZE);
+            pack(_presets[i], record + NAME_SIZE);
+        }
+        page[PAGE_SIZE - 1] = Journal::crc32(page, PAGE_SIZE - 1);
+        Flash::erasePage(FIRST_PAGE + _page);
+        Flash::programPage(FIRST_PAGE + _page, page);
+    }
+
+    void capture(Preset& preset) {
+        for (int i = 0; i < N_FIELDS; i++) {
+            preset.values[i] = Schema::get(FIELDS[i].field);
+        }
+    }
+
+    const Preset& get(int index) {
+        return _presets[index];
+    }
+
+    bool store(int index, const char* name) {
+        if (index < 0 || index >= N_PRESETS) {
+            return false;
+        }
+        capture(_presets[index]);
+        if (name != nullptr) {
+            memset(_presets[index].name, 0, sizeof(_presets[index].name));
+            strncpy(_presets[index].name, name, NAME_SIZE);
+        }
+        save();
+        return true;
+    }
+
+    uint8_t menus() {
+        uint8_t mask = 0;
+        for (int i = 0; i < N_FIELDS; i++) {
+            mask |= 1 << FIELDS[i].menu;
+        }
+        return mask;
+    }
+
+    void apply(const Preset& preset, uint8_t mask) {
+        for (int i = 0; i < N_FIELDS; i++) {
+            if (mask & (1 << FIELDS[i].menu)) {
+                Schema::set(FIELDS[i].field, preset.values[i]);
+            }
+        }
+    }
+
+    // The fields are packed one after the other, most significant bit first
+    void pack(const Preset& preset, uint8_t* buffer) {
+        memset(buffer, 0, PACKED_SIZE);
+        int pos = 0;
+        for (int i = 0; i < N_FIELDS; i++) {
+            uint32_t max = (1u << FIELDS[i].bits) - 1;
+            uint32_t value = preset.values[i] / Schema::FIELDS[FIELDS[i].field].scale;
+            if (value > max) {
+                value = max;
+            }
+            for (int bit = FIELDS[i].bits - 1; bit >= 0; bit--) {
+                if (value & (1u << bit)) {
+                    buffer[pos / 8] |= 0x80 >> (pos % 8);
+                }
+                pos++;
+            }
+        }
+    }
+
+    void unpack(const uint8_t* buffer, Preset& preset) {
+        int pos = 0;
+        for (int i = 0; i < N_FIELDS; i++) {
+            uint32_t value = 0;
+            for (int bit = 0; bit < FIELDS[i].bits; bit++) {
+                value = value << 1 | ((buffer[pos / 8] >> (7 - pos % 8)) & 1);
+                pos++;
+            }
+            preset.values[i] = value * Schema::FIELDS[FIELDS[i].field].scale;
+        }
+    }
+
+    int encodeFrame(int index, uint8_t mask, uint8_t* payload) {
+        payload[0] = mask;
+        pack(_presets[index], payload + 1);
+        return FRAME_SIZE;
+    }
+
+    bool decodeFrame(const uint8_t* payload, int size, Preset& preset, uint8_t& mask) {
+        if (size < FRAME_SIZE) {
+            return false;
+        }
+        mask = payload[0] & menus();
+        unpack(payload + 1, preset);
+        return true;
+    }
+
+}
@@ -0,0 +1,84 @@
+#ifndef _PRESETS_H_
+#define _PRESETS_H_
+
+#include <stdint.h>
+#include "journal.h"
+#include "schema.h"
+
+// Named presets of the shooting settings (delay, interval, timings and input mode), stored in
+// two flash pages just before the journal, which are written alternately so that a power loss
+// while storing a preset leaves the previous set intact. A preset is exchanged as a packed
+// bit field (see FIELDS), in flash as well as over the radio and USB.
+//
+// Page layout (32-bit words) :
+// - PAGE_MAGIC, sequence number, inverted sequence number
+// - VERSION << 24 | N_PRESETS << 16 | RECORD_SIZE
+// - N_PRESETS records : name (NAME_SIZE bytes, padded with 0), packed preset, padding
+// - CRC-32 of the previous words
+namespace Presets {
+
+    const int N_PRESETS = 4;
+    const int NAME_SIZE = 8;
+    const int N_PAGES = 2;
+    // Reserved with the journal pages, see journal.h
+    const int FIRST_PAGE = Journal::FIRST_PAGE - N_PAGES;
+#ifdef N_RESERVED_FLASH_PAGES
+    static_assert(Journal::N_PAGES + N_PAGES <= N_RESERVED_FLASH_PAGES, "The presets pages must be reserved in the Makefile");
+#endif
+
+    // Incremented when the packed format changes : the presets stored with another version
+    // are replaced by the defaults
+    const uint8_t VERSION = 1;
+    const uint32_t PAGE_MAGIC = 0x50525354; // "PRST"
+
+    struct Field {
+        uint8_t field; // Schema::FieldId
+        uint8_t bits; // Size of value / scale in the packed preset
+        uint8_t menu; // GUI::MENU_*, the sync flag of this menu applies to this field
+    };
+    const int N_FIELDS = 6;
+    constexpr Field FIELDS[N_FIELDS] = {
+        {Schema::DELAY, 22, 1}, // Up to 99:59:59.9
+        {Schema::INTERVAL_N_SHOTS, 14, 2}, // Up to 9999
+        {Schema::INTERVAL_DELAY, 22, 2},
+        {Schema::TIMINGS_FOCUS_DURATION, 22, 3},
+        {Schema::TIMINGS_TRIGGER_DURATION, 22, 3},
+        {Schema::INPUT_MODE, 2, 4},
+    };
+    const int PACKED_SIZE = 13; // bytes
+    const int RECORD_SIZE = 24; // bytes, NAME_SIZE + PACKED_SIZE rounded up to a word
+
+    // Radio frame (Sync::CMD_PRESET) : mask of the menus to apply (1 << GUI::MENU_*), then the
+    // packed preset
+    const int FRAME_SIZE = 1 + PACKED_SIZE;
+
+    struct Preset {
+        char name[NAME_SIZE + 1];
+        uint32_t values[N_FIELDS];
+    };
+
+    // Load the presets from flash ; missing presets are initialized with the current settings
+    void init();
+
+    const Preset& get(int index);
+
+    // Store the current settings in a preset and save the presets in flash ; the name is kept if
+    // nullptr. Return false if the index is invalid.
+    bool store(int index, const char* name=nullptr);
+
+    // Mask of the menus containing fields of the presets (1 << GUI::MENU_*)
+    uint8_t menus();
+
+    // Copy the fields of a preset which belong to the menus in mask into the settings
+    void apply(const Preset& preset, uint8_t mask);
+
+    void pack(const Preset& preset, uint8_t* buffer);
+    void unpack(const uint8_t* buffer, Preset& preset);
+
+    // Radio frame
+    int encodeFrame(int index, uint8_t mask, uint8_t* payload);
+    bool decodeFrame(const uint8_t* payload, int size, Preset& preset, uint8_t& mask);
+
+}
+
+#endif
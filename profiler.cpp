@@ -0,0 +1,174 @@
+#include "profiler.h"
+#include <string.h>
+
+namespace Profiler {
+
+    struct Stats {
+        uint32_t count;
+        uint64_t total;
+        uint32_t min;
+        uint32_t max;
+        uint16_t histogram[N_BUCKETS];
+    };
+
+#if PROFILING
+    const bool ENABLED = true;
+#else
+    const bool ENABLED = false;
+#endif
+
+    uint32_t (*_cycles)() = nullptr;
+    uint32_t _frequency = 0;
+    Stats _stats[N_SECTIONS];
+    uint32_t _start[N_SECTIONS];
+    uint32_t _elapsed[N_SECTIONS]; // Cycles of the idle clock before the last clock switch
+    uint32_t _divider = 1; // Counted cycles per cycle of the idle clock
+    uint16_t _running = 0; // One bit per section, set by start()
+
+    // Set from the USB interrupt handler, and applied by the next record() : the table is
+    // only written from the main loop
+    volatile bool _resetPending = false;
+
+    // Internal functions
+    int bucket(uint32_t cycles);
+    void clear();
+    uint8_t* writeU32(uint8_t* buffer, uint32_t value);
+    uint8_t* writeU16(uint8_t* buffer, uint16_t value);
+
+
+    // The frequency of the cycle source is only given to the host, to convert the cycles to time
+    void init(uint32_t (*cycles)(), uint32_t frequency) {
+        _cycles = cycles;
+        _frequency = frequency;
+        _divider = 1;
+        _running = 0;
+        clear();
+    }
+
+    void start(Section section) {
+        if (_cycles == nullptr) {
+            return;
+        }
+        int i = static_cast<int>(section);
+        _elapsed[i] = 0;
+        _start[i] = _cycles();
+        _running |= 1 << i;
+    }
+
+    // Ignored if the section was not started. The difference is computed modulo 2^32, so the
+    // counter may wrap around during the section, but not twice.
+    void stop(Section section) {
+        if (_cycles == nullptr) {
+            return;
+        }
+        uint32_t now = _cycles();
+        int i = static_cast<int>(section);
+        if (!(_running & (1 << i))) {
+            return;
+        }
+        _running &= ~(1 << i);
+        record(section, _elapsed[i] + (now - _start[i]) / _divider);
+    }
+
+    // The CPU clock is switched : the cycles counted so far by the running sections are converted
+    // at the previous rate
+    void setClockDivider(uint32_t divider) {
+        if (_cycles == nullptr || divider == 0) {
+            return;
+        }
+        uint32_t now = _cycles();
+        for (int i = 0; i < N_SECTIONS; i++) {
+            if (_running & (1 << i)) {
+                _elapsed[i] += (now - _start[i]) / _divider;
+                _start[i] = now;
+            }
+        }
+        _divider = divider;
+    }
+
+    void record(Section section, uint32_t cycles) {
+        if (_resetPending) {
+            _resetPending = false;
+            clear();
+        }
+        Stats& s = _stats[static_cast<int>(section)];
+        if (s.count == 0 || cycles < s.min) {
+            s.min = cycles;
+        }
+        if (cycles > s.max) {
+            s.max = cycles;
+        }
+        s.count++;
+        s.total += cycles;
+        uint16_t& b = s.histogram[bucket(cycles)];
+        if (b < 0xFFFF) {
+            b++;
+        }
+    }
+
+    // May be called from an interrupt handler : the statistics are cleared before the next record
+    void reset() {
+        _resetPending = true;
+    }
+
+    // Write the statistics into the buffer, in big-endian :
+    //  - version, enabled (0 if the probes are compiled out), N_SECTIONS, N_BUCKETS, BUCKET_MIN_SHIFT
+    //    (1 byte each), then the frequency of the cycle counter (Hz, 4 bytes)
+    //  - for each section, in the order of Section : count (4 bytes), total (cycles, 8 bytes),
+    //    min and max (cycles, 4 bytes each), then the histogram (2 bytes per bucket)
+    // This runs in the USB interrupt handler, so the section being recorded at this time
+    // may be inconsistent. Returns the number of bytes written, or 0 if the buffer is too small.
+    int serialize(uint8_t* buffer, int size) {
+        if (size < BLOB_SIZE) {
+            return 0;
+        }
+        uint8_t* p = buffer;
+        *p++ = BLOB_VERSION;
+        *p++ = ENABLED;
+        *p++ = N_SECTIONS;
+        *p++ = N_BUCKETS;
+        *p++ = BUCKET_MIN_SHIFT;
+        p = writeU32(p, _frequency);
+        for (int i = 0; i < N_SECTIONS; i++) {
+            const Stats& s = _stats[i];
+            p = writeU32(p, s.count);
+            p = writeU32(p, s.total >> 32);
+            p = writeU32(p, s.total);
+            p = writeU32(p, s.min);
+            p = writeU32(p, s.max);
+            for (int j = 0; j < N_BUCKETS; j++) {
+                p = writeU16(p, s.histogram[j]);
+            }
+        }
+        return p - buffer;
+    }
+
+    int bucket(uint32_t cycles) {
+        int b = 0;
+        cycles >>= BUCKET_MIN_SHIFT + 1;
+        while (cycles > 0 && b < N_BUCKETS - 1) {
+            cycles >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    void clear() {
+        memset(_stats, 0, sizeof(_stats));
+    }
+
+    uint8_t* writeU32(uint8_t* buffer, uint32_t value) {
+        *buffer++ = value >> 24;
+        *buffer++ = value >> 16;
+        *buffer++ = value >> 8;
+        *buffer++ = value;
+        return buffer;
+    }
+
+    uint8_t* writeU16(uint8_t* buffer, uint16_t value) {
+        *buffer++ = value >> 8;
+        *buffer++ = value;
+        return buffer;
+    }
+
+}
@@ -0,0 +1,62 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+
+// Cycle-count profiling of the sections of the main loop, readable over USB with
+// Sync::CMD_GET_PROFILE (see tools/profile.py for the host-side decoder)
+// Each section is timed with the cycle counter of the core (see Core::cycles()) between
+// PROFILE_START() and PROFILE_STOP(), and aggregated in a static table : count, min, max, total
+// and a histogram of the durations in power-of-two buckets. The interrupts which happen during a
+// section are counted in it. The probes are compiled out unless PROFILING=true in the Makefile.
+// The counter runs at the CPU clock, which is boosted during some sections (see governor.h) : the
+// cycles counted while boosted are divided by the ratio given by PROFILE_CLOCK() at each switch,
+// so that the table is in cycles of the idle clock, which is the frequency given to the host.
+// The cycle source is given to init(), so that this module can be checked on a host.
+namespace Profiler {
+
+    const uint8_t BLOB_VERSION = 1;
+
+    enum class Section : uint8_t {
+        LOOP, // Whole iteration, except the sleep at the end
+        BUTTONS,
+        RECEIVE, // Radio and USB commands
+        DISPATCH,
+        SEQUENCING, // Focus and trigger timings, outputs and LEDs
+        BATTERY,
+        SAVE, // Settings written to the flash
+        GUI,
+        OLED_REFRESH, // Included in GUI
+    };
+    const int N_SECTIONS = 9;
+
+    // Histogram : the first bucket counts the durations shorter than 2^(BUCKET_MIN_SHIFT+1) cycles,
+    // then each bucket is twice as wide as the previous one, and the last one counts the durations
+    // longer than 2^(BUCKET_MIN_SHIFT+N_BUCKETS-1) cycles (~700ms at 12MHz)
+    const int N_BUCKETS = 16;
+    const int BUCKET_MIN_SHIFT = 8;
+
+    const int SECTION_SIZE = 4 + 8 + 4 + 4 + 2 * N_BUCKETS;
+    const int BLOB_SIZE = 1 + 1 + 1 + 1 + 1 + 4 + N_SECTIONS * SECTION_SIZE;
+
+    void init(uint32_t (*cycles)(), uint32_t frequency);
+    void start(Section section);
+    void stop(Section section);
+    void setClockDivider(uint32_t divider);
+    void record(Section section, uint32_t cycles);
+    void reset();
+    int serialize(uint8_t* buffer, int size);
+
+}
+
+#if PROFILING
+#define PROFILE_START(section) Profiler::start(Profiler::Section::section)
+#define PROFILE_STOP(section) Profiler::stop(Profiler::Section::section)
+#define PROFILE_CLOCK(divider) Profiler::setClockDivider(divider)
+#else
+#define PROFILE_START(section)
+#define PROFILE_STOP(section)
+#define PROFILE_CLOCK(divider)
+#endif
+
+#endif
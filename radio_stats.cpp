@@ -0,0 +1,204 @@
+#include "radio_stats.h"
+#include "airtime.h"
+#include <core.h>
+#include <string.h>
+
+namespace RadioStats {
+
+    struct TraceRecord {
+        uint32_t time;
+        uint8_t event;
+        uint8_t command;
+        int16_t rssi;
+        int8_t snr;
+        uint8_t length;
+    };
+
+    struct Stats {
+        // Counters
+        uint32_t rxOk;
+        uint32_t rxCRCError;
+        uint32_t rxHeaderError;
+        uint32_t rxForeign;
+        uint32_t tx;
+        uint32_t txDenied;
+        uint32_t airtimeTotalUs;
+        uint32_t airtimeTotalMs;
+        uint32_t airtimeWindowMs;
+
+        uint16_t rssiHistogram[N_RSSI_BINS];
+        uint16_t snrHistogram[N_SNR_BINS];
+
+        TraceRecord trace[N_TRACE_RECORDS];
+        int traceCursor;
+        int traceCount;
+    };
+
+    // The statistics are recorded by the main loop, and read by serialize() from the USB
+    // interrupt handler : update() copies them with interrupts masked into the snapshot, which
+    // is the only part read by the handler
+    Stats _stats = {};
+    Stats _snapshot = {};
+    bool _changed = false;
+
+    // Set from the USB interrupt handler, and applied by the next update()
+    volatile bool _resetPending = false;
+
+    // Internal functions
+    void trace(Event event, uint8_t command, int length, int rssi, int snr);
+    void clear();
+    void addToHistogram(uint16_t* histogram, int nBins, int min, int step, int value);
+    uint8_t* writeU32(uint8_t* buffer, uint32_t value);
+    uint8_t* writeU16(uint8_t* buffer, uint16_t value);
+
+
+    // Account for a received packet, valid or not. rssi is in dBm and snr in dB.
+    void recordRx(Event event, uint8_t command, int length, int rssi, int snr) {
+        if (event == Event::RX_OK) {
+            _stats.rxOk++;
+        } else if (event == Event::RX_CRC_ERROR) {
+            _stats.rxCRCError++;
+        } else if (event == Event::RX_HEADER_ERROR) {
+            _stats.rxHeaderError++;
+        } else if (event == Event::RX_FOREIGN) {
+            _stats.rxForeign++;
+        }
+        addToHistogram(_stats.rssiHistogram, N_RSSI_BINS, RSSI_HISTOGRAM_MIN, RSSI_HISTOGRAM_STEP, rssi);
+        addToHistogram(_stats.snrHistogram, N_SNR_BINS, SNR_HISTOGRAM_MIN, SNR_HISTOGRAM_STEP, snr);
+        trace(event, command, length, rssi, snr);
+    }
+
+    // Account for a transmitted packet, with its airtime in us
+    void recordTx(uint8_t command, int length, uint32_t airtime) {
+        _stats.tx++;
+        _stats.airtimeTotalUs += airtime;
+        _stats.airtimeTotalMs += _stats.airtimeTotalUs / 1000;
+        _stats.airtimeTotalUs %= 1000;
+        trace(Event::TX, command, length, 0, 0);
+    }
+
+    void recordTxDenied(uint8_t command) {
+        _stats.txDenied++;
+        trace(Event::TX_DENIED, command, 0, 0, 0);
+    }
+
+    // Called by the main loop : apply a pending reset, refresh the values computed by other
+    // modules, and publish the statistics to serialize() if they changed
+    void update() {
+        if (_resetPending) {
+            _resetPending = false;
+            clear();
+        }
+        uint32_t airtimeWindowMs = Airtime::used() / 1000;
+        if (airtimeWindowMs != _stats.airtimeWindowMs) {
+            _stats.airtimeWindowMs = airtimeWindowMs;
+            _changed = true;
+        }
+        if (_changed) {
+            Core::disableInterrupts();
+            _snapshot = _stats;
+            Core::enableInterrupts();
+            _changed = false;
+        }
+    }
+
+    // May be called from an interrupt handler : the statistics are cleared by the next update()
+    void reset() {
+        _resetPending = true;
+    }
+
+    // Write the statistics into the buffer, in big-endian :
+    //  - version (1 byte)
+    //  - counters (N_COUNTERS * 4 bytes) : rx ok, CRC errors, header errors, foreign
+    //    packets, tx, tx denied, total airtime (ms), airtime in the duty-cycle window (ms)
+    //  - RSSI then SNR histograms (2 bytes per bin)
+    //  - number of trace records (1 byte), then the records from oldest to newest :
+    //    time (ms, 4 bytes), event, command, rssi (dBm, 2 bytes), snr (dB), length
+    // The snapshot published by the last update() is written, so this may be called from an
+    // interrupt handler. Returns the number of bytes written, or 0 if the buffer is too small.
+    int serialize(uint8_t* buffer, int size) {
+        if (size < BLOB_SIZE) {
+            return 0;
+        }
+        const Stats& s = _snapshot;
+        uint8_t* p = buffer;
+        *p++ = BLOB_VERSION;
+        p = writeU32(p, s.rxOk);
+        p = writeU32(p, s.rxCRCError);
+        p = writeU32(p, s.rxHeaderError);
+        p = writeU32(p, s.rxForeign);
+        p = writeU32(p, s.tx);
+        p = writeU32(p, s.txDenied);
+        p = writeU32(p, s.airtimeTotalMs);
+        p = writeU32(p, s.airtimeWindowMs);
+        for (int i = 0; i < N_RSSI_BINS; i++) {
+            p = writeU16(p, s.rssiHistogram[i]);
+        }
+        for (int i = 0; i < N_SNR_BINS; i++) {
+            p = writeU16(p, s.snrHistogram[i]);
+        }
+        *p++ = s.traceCount;
+        for (int i = 0; i < s.traceCount; i++) {
+            const TraceRecord& r = s.trace[(s.traceCursor - s.traceCount + i + N_TRACE_RECORDS) % N_TRACE_RECORDS];
+            p = writeU32(p, r.time);
+            *p++ = r.event;
+            *p++ = r.command;
+            p = writeU16(p, static_cast<uint16_t>(r.rssi));
+            *p++ = static_cast<uint8_t>(r.snr);
+            *p++ = r.length;
+        }
+        return p - buffer;
+    }
+
+    void trace(Event event, uint8_t command, int length, int rssi, int snr) {
+        TraceRecord& r = _stats.trace[_stats.traceCursor];
+        r.time = static_cast<uint32_t>(Core::time());
+        r.event = static_cast<uint8_t>(event);
+        r.command = command;
+        r.rssi = rssi;
+        r.snr = snr;
+        r.length = length;
+        _stats.traceCursor = (_stats.traceCursor + 1) % N_TRACE_RECORDS;
+        if (_stats.traceCount < N_TRACE_RECORDS) {
+            _stats.traceCount++;
+        }
+        _changed = true;
+    }
+
+    // The airtime of the window is kept, as it doesn't depend on the statistics
+    void clear() {
+        uint32_t airtimeWindowMs = _stats.airtimeWindowMs;
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.airtimeWindowMs = airtimeWindowMs;
+        _changed = true;
+    }
+
+    // Values outside of the histogram are counted in the first or last bin
+    void addToHistogram(uint16_t* histogram, int nBins, int min, int step, int value) {
+        int bin = 0;
+        if (value >= min) {
+            bin = (value - min) / step;
+            if (bin >= nBins) {
+                bin = nBins - 1;
+            }
+        }
+        if (histogram[bin] < 0xFFFF) {
+            histogram[bin]++;
+        }
+    }
+
+    uint8_t* writeU32(uint8_t* buffer, uint32_t value) {
+        *buffer++ = value >> 24;
+        *buffer++ = value >> 16;
+        *buffer++ = value >> 8;
+        *buffer++ = value;
+        return buffer;
+    }
+
+    uint8_t* writeU16(uint8_t* buffer, uint16_t value) {
+        *buffer++ = value >> 8;
+        *buffer++ = value;
+        return buffer;
+    }
+
+}
@@ -0,0 +1,45 @@
+#ifndef _RADIO_STATS_H_
+#define _RADIO_STATS_H_
+
+#include <stdint.h>
+
+// Radio link statistics, readable over USB with Sync::CMD_GET_RADIO_STATS
+// (see tools/radio_stats.py for the host-side decoder)
+namespace RadioStats {
+
+    const uint8_t BLOB_VERSION = 1;
+
+    // Histograms
+    const int RSSI_HISTOGRAM_MIN = -140; // dBm
+    const int RSSI_HISTOGRAM_STEP = 10; // dB
+    const int N_RSSI_BINS = 12;
+    const int SNR_HISTOGRAM_MIN = -20; // dB
+    const int SNR_HISTOGRAM_STEP = 4; // dB
+    const int N_SNR_BINS = 10;
+
+    // Ring buffer of the last packets
+    const int N_TRACE_RECORDS = 16;
+    const int TRACE_RECORD_SIZE = 10;
+
+    const int N_COUNTERS = 8;
+    const int BLOB_SIZE = 1 + 4 * N_COUNTERS + 2 * N_RSSI_BINS + 2 * N_SNR_BINS + 1 + N_TRACE_RECORDS * TRACE_RECORD_SIZE;
+
+    enum class Event {
+        RX_OK,
+        RX_CRC_ERROR,
+        RX_HEADER_ERROR,
+        RX_FOREIGN, // Valid packet from another network or channel
+        TX,
+        TX_DENIED, // Not sent because of the duty-cycle budget
+    };
+
+    void recordRx(Event event, uint8_t command, int length, int rssi, int snr);
+    void recordTx(uint8_t command, int length, uint32_t airtime);
+    void recordTxDenied(uint8_t command);
+    void update();
+    void reset();
+    int serialize(uint8_t* buffer, int size);
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+#include "schema.h"
+#include "sync.h"
+
+namespace Schema {
+
+    // The formats are shared with the host tools and the other modules
+    static_assert(GUI_STATE_SIZE == 22, "the size of the GUI state has changed, update VERSION");
+    static_assert(menuPayloadSize(0, true) <= Sync::MAX_PAYLOAD_SIZE
+            && menuPayloadSize(1, true) <= Sync::MAX_PAYLOAD_SIZE
+            && menuPayloadSize(2, true) <= Sync::MAX_PAYLOAD_SIZE
+            && menuPayloadSize(3, true) <= Sync::MAX_PAYLOAD_SIZE
+            && menuPayloadSize(4, true) <= Sync::MAX_PAYLOAD_SIZE
+            && menuPayloadSize(5, true) <= Sync::MAX_PAYLOAD_SIZE, "menu payload too large");
+    static_assert(N_SAVED <= 32, "the journal is limited to 32 fields");
+
+    // Codec of the fields of a menu from the I-th one, unrolled at compile time : the function
+    // pointers of FIELDS are constants, which the compiler calls directly
+    template<int MENU, int I = 0, bool END = I == MENUS[MENU].nFields>
+    struct MenuFields {
+        static const int FIELD = MENUS[MENU].fields[I];
+        static int encode(uint8_t* payload) {
+            FIELDS[FIELD].encode(payload);
+            return FIELDS[FIELD].width + MenuFields<MENU, I + 1>::encode(payload + FIELDS[FIELD].width);
+        }
+        static void decode(const uint8_t* payload) {
+            FIELDS[FIELD].decode(payload);
+            MenuFields<MENU, I + 1>::decode(payload + FIELDS[FIELD].width);
+        }
+    };
+    template<int MENU, int I>
+    struct MenuFields<MENU, I, true> {
+        static int encode(uint8_t*) { return 0; }
+        static void decode(const uint8_t*) {}
+    };
+
+    // Sync flag of a menu, over USB
+    template<int MENU, bool SYNCED = MENUS[MENU].syncField != NONE>
+    struct MenuSync {
+        static int encode(uint8_t* payload) {
+            FIELDS[MENUS[MENU].syncField].encode(payload);
+            return FIELDS[MENUS[MENU].syncField].width;
+        }
+        static void decode(const uint8_t* payload) {
+            FIELDS[MENUS[MENU].syncField].decode(payload);
+        }
+    };
+    template<int MENU>
+    struct MenuSync<MENU, false> {
+        static int encode(uint8_t*) { return 0; }
+        static void decode(const uint8_t*) {}
+    };
+
+    template<int MENU>
+    int encodeMenu(uint8_t* payload, bool usb) {
+        int size = MenuFields<MENU>::encode(payload);
+        if (usb) {
+            size += MenuSync<MENU>::encode(payload + size);
+        }
+        return size;
+    }
+
+    template<int MENU>
+    bool decodeMenu(const uint8_t* payload, int size, bool usb) {
+        if (size < menuPayloadSize(MENU, false)) {
+            return false;
+        }
+        MenuFields<MENU>::decode(payload);
+        if (usb && size >= menuPayloadSize(MENU, true)) {
+            MenuSync<MENU>::decode(payload + menuPayloadSize(MENU, false));
+        }
+        return true;
+    }
+
+    // Menus of the GUI state from the I-th one
+    template<int I = 0, bool END = I == N_GUI_STATE_MENUS>
+    struct GUIState {
+        static int encode(uint8_t* buffer) {
+            int size = encodeMenu<GUI_STATE_MENUS[I]>(buffer, true);
+            return size + GUIState<I + 1>::encode(buffer + size);
+        }
+    };
+    template<int I>
+    struct GUIState<I, true> {
+        static int encode(uint8_t*) { return 0; }
+    };
+
+    struct MenuCodec {
+        int (*encode)(uint8_t* payload, bool usb);
+        bool (*decode)(const uint8_t* payload, int size, bool usb);
+    };
+    static_assert(N_MENUS == 6, "every menu must have a codec");
+    const MenuCodec MENU_CODECS[N_MENUS] = {
+        {encodeMenu<0>, decodeMenu<0>},
+        {encodeMenu<1>, decodeMenu<1>},
+        {encodeMenu<2>, decodeMenu<2>},
+        {encodeMenu<3>, decodeMenu<3>},
+        {encodeMenu<4>, decodeMenu<4>},
+        {encodeMenu<5>, decodeMenu<5>},
+    };
+
+
+    uint32_t get(int field) {
+        return FIELDS[field].get();
+    }
+
+    void set(int field, uint32_t value) {
+        FIELDS[field].set(value);
+    }
+
+    bool isMenuSynced(int menu) {
+        return MENUS[menu].radio && get(MENUS[menu].syncField);
+    }
+
+    uint8_t syncedMenus(uint8_t mask) {
+        uint8_t synced = 0;
+        for (int i = 0; i < N_MENUS; i++) {
+            if ((mask & (1 << i)) && isMenuSynced(i)) {
+                synced |= 1 << i;
+            }
+        }
+        return synced;
+    }
+
+    int encodeMenu(int menu, uint8_t* payload, bool usb) {
+        return MENU_CODECS[menu].encode(payload, usb);
+    }
+
+    bool decodeMenu(int menu, const uint8_t* payload, int size, bool usb) {
+        return MENU_CODECS[menu].decode(payload, size, usb);
+    }
+
+    int encodeGUIState(uint8_t* buffer, int size) {
+        uint8_t state[GUI_STATE_SIZE + 1];
+        int n = GUIState<>::encode(state);
+        state[n++] = VERSION;
+        if (size > n) {
+            size = n;
+        }
+        for (int i = 0; i < size; i++) {
+            buffer[i] = state[i];
+        }
+        return size;
+    }
+
+    void getSaved(uint32_t values[]) {
+        for (int i = 0; i < N_SAVED; i++) {
+            values[i] = get(SAVED[i]);
+        }
+    }
+
+    void setSaved(const uint32_t values[], uint32_t mask) {
+        for (int i = 0; i < N_SAVED; i++) {
+            if (mask & (1u << i)) {
+                set(SAVED[i], values[i]);
+            }
+        }
+    }
+
+}
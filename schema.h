@@ -0,0 +1,204 @@
+#ifndef _SCHEMA_H_
+#define _SCHEMA_H_
+
+#include <stdint.h>
+#include "context.h"
+
+// Description of the settings in Context and of the three formats in which they are exchanged :
+// the journal in flash, the menu payloads sent over the radio and USB, and the answer to
+// CMD_GET_GUI_STATE. Every encoder and decoder is generated at compile time from these tables
+// (see schema.cpp), so a setting only has to be described once, and the payloads are written
+// without looking up the type and the width of each field at runtime.
+namespace Schema {
+
+    // Returned after the GUI state when the host asks for more than GUI_STATE_SIZE bytes ;
+    // incremented when a format changes
+    const uint8_t VERSION = 1;
+
+    enum class Type : uint8_t {
+        BOOL,
+        INT,
+        UINT,
+    };
+
+    template<typename T> struct TypeOf;
+    template<> struct TypeOf<bool> { static const Type TYPE = Type::BOOL; };
+    template<> struct TypeOf<int> { static const Type TYPE = Type::INT; };
+    template<> struct TypeOf<unsigned int> { static const Type TYPE = Type::UINT; };
+
+    // Big-endian integer of N bytes, unrolled at compile time
+    template<int N>
+    struct Bytes {
+        static void write(uint8_t* buffer, uint32_t value) {
+            buffer[N - 1] = value & 0xFF;
+            Bytes<N - 1>::write(buffer, value >> 8);
+        }
+        static uint32_t read(const uint8_t* buffer) {
+            return Bytes<N - 1>::read(buffer) << 8 | buffer[N - 1];
+        }
+    };
+    template<>
+    struct Bytes<0> {
+        static void write(uint8_t*, uint32_t) {}
+        static uint32_t read(const uint8_t*) { return 0; }
+    };
+
+    // Accessors and payload codec of a setting
+    template<typename T, T* VALUE, int WIDTH, int SCALE>
+    struct FieldCodec {
+        static uint32_t get() {
+            return static_cast<uint32_t>(*VALUE);
+        }
+        static void set(uint32_t value) {
+            *VALUE = static_cast<T>(value);
+        }
+        static void encode(uint8_t* buffer) {
+            Bytes<WIDTH>::write(buffer, get() / SCALE);
+        }
+        static void decode(const uint8_t* buffer) {
+            set(Bytes<WIDTH>::read(buffer) * SCALE);
+        }
+    };
+
+    struct Field {
+        void* value;
+        Type type;
+        uint8_t width; // Size in the payloads, in bytes, big-endian
+        uint16_t scale; // The payloads carry value / scale
+        uint32_t (*get)();
+        void (*set)(uint32_t value);
+        void (*encode)(uint8_t* buffer);
+        void (*decode)(const uint8_t* buffer);
+    };
+
+#define SCHEMA_FIELD(value, width, scale) { \
+        &value, TypeOf<decltype(value)>::TYPE, width, scale, \
+        &FieldCodec<decltype(value), &value, width, scale>::get, \
+        &FieldCodec<decltype(value), &value, width, scale>::set, \
+        &FieldCodec<decltype(value), &value, width, scale>::encode, \
+        &FieldCodec<decltype(value), &value, width, scale>::decode }
+
+    // Index in FIELDS
+    enum FieldId : uint8_t {
+        FOCUS_HOLD,
+        TRIGGER_HOLD,
+        TRIGGER_SYNC,
+        DELAY,
+        DELAY_SYNC,
+        INTERVAL_N_SHOTS,
+        INTERVAL_DELAY,
+        INTERVAL_SYNC,
+        INPUT_MODE,
+        INPUT_SYNC,
+        TIMINGS_FOCUS_DURATION,
+        TIMINGS_TRIGGER_DURATION,
+        TIMINGS_SYNC,
+        SYNC_CHANNEL,
+        RADIO,
+        BRIGHTNESS,
+        WAKE_INTERVAL,
+        INPUT_PASSTHROUGH_DELAY,
+        INPUT_PASSTHROUGH_STRETCH,
+        CHANNEL_WAKE_INTERVAL,
+        N_FIELDS,
+        NONE = 0xFF,
+    };
+
+    constexpr Field FIELDS[N_FIELDS] = {
+        SCHEMA_FIELD(Context::_submenuFocusHold, 1, 1),
+        SCHEMA_FIELD(Context::_submenuTriggerHold, 1, 1),
+        SCHEMA_FIELD(Context::_triggerSync, 1, 1),
+        SCHEMA_FIELD(Context::_delayMs, 3, 100),
+        SCHEMA_FIELD(Context::_delaySync, 1, 1),
+        SCHEMA_FIELD(Context::_intervalNShots, 1, 1),
+        SCHEMA_FIELD(Context::_intervalDelayMs, 3, 100),
+        SCHEMA_FIELD(Context::_intervalSync, 1, 1),
+        SCHEMA_FIELD(Context::_inputMode, 1, 1),
+        SCHEMA_FIELD(Context::_inputSync, 1, 1),
+        SCHEMA_FIELD(Context::_timingsFocusDurationMs, 3, 100),
+        SCHEMA_FIELD(Context::_timingsTriggerDurationMs, 3, 100),
+        SCHEMA_FIELD(Context::_timingsSync, 1, 1),
+        SCHEMA_FIELD(Context::_syncChannel, 1, 1),
+        SCHEMA_FIELD(Context::_radio, 1, 1),
+        SCHEMA_FIELD(Context::_brightness, 1, 1),
+        SCHEMA_FIELD(Context::_wakeInterval, 1, 1),
+        SCHEMA_FIELD(Context::_inputPassthroughDelayUs, 4, 1),
+        SCHEMA_FIELD(Context::_inputPassthroughStretchUs, 4, 1),
+        SCHEMA_FIELD(Context::_channelWakeInterval, 1, 1),
+    };
+
+    // Fields saved in the journal, which identifies them by their index in this list : new
+    // fields must be appended, and a removed field must keep its slot
+    constexpr uint8_t SAVED[] = {
+        TRIGGER_SYNC, DELAY, DELAY_SYNC, INTERVAL_N_SHOTS, INTERVAL_DELAY, INTERVAL_SYNC, INPUT_MODE,
+        INPUT_SYNC, TIMINGS_FOCUS_DURATION, TIMINGS_TRIGGER_DURATION, TIMINGS_SYNC, SYNC_CHANNEL,
+        RADIO, BRIGHTNESS, WAKE_INTERVAL, INPUT_PASSTHROUGH_DELAY, INPUT_PASSTHROUGH_STRETCH,
+        CHANNEL_WAKE_INTERVAL,
+    };
+    const int N_SAVED = sizeof(SAVED);
+
+    // Payload of each menu (indexed by GUI::MENU_*) : the fields sent over the radio, followed
+    // over USB by the sync flag of the menu. Menus which are not synced over the radio are only
+    // exchanged with USB.
+    const int MAX_MENU_FIELDS = 2;
+    struct Menu {
+        uint8_t fields[MAX_MENU_FIELDS];
+        uint8_t nFields;
+        uint8_t syncField;
+        bool radio;
+    };
+    const int N_MENUS = 6;
+    constexpr Menu MENUS[N_MENUS] = {
+        {{FOCUS_HOLD, TRIGGER_HOLD}, 2, TRIGGER_SYNC, true}, // Trigger
+        {{DELAY}, 1, DELAY_SYNC, true}, // Delay
+        {{INTERVAL_N_SHOTS, INTERVAL_DELAY}, 2, INTERVAL_SYNC, true}, // Interval
+        {{TIMINGS_FOCUS_DURATION, TIMINGS_TRIGGER_DURATION}, 2, TIMINGS_SYNC, true}, // Timings
+        {{INPUT_MODE}, 1, INPUT_SYNC, true}, // Input
+        {{SYNC_CHANNEL}, 1, NONE, false}, // Settings
+    };
+
+    // Answer to CMD_GET_GUI_STATE : the USB payloads of these menus, one after the other
+    constexpr uint8_t GUI_STATE_MENUS[] = {0, 1, 2, 4, 5, 3};
+    const int N_GUI_STATE_MENUS = sizeof(GUI_STATE_MENUS);
+
+    constexpr int fieldsSize(const uint8_t* fields, int n) {
+        return n == 0 ? 0 : FIELDS[fields[0]].width + fieldsSize(fields + 1, n - 1);
+    }
+
+    constexpr int menuPayloadSize(int menu, bool usb) {
+        return fieldsSize(MENUS[menu].fields, MENUS[menu].nFields)
+            + (usb && MENUS[menu].syncField != NONE ? FIELDS[MENUS[menu].syncField].width : 0);
+    }
+
+    constexpr int guiStateSize(int i=0) {
+        return i == N_GUI_STATE_MENUS ? 0 : menuPayloadSize(GUI_STATE_MENUS[i], true) + guiStateSize(i + 1);
+    }
+
+    const int GUI_STATE_SIZE = guiStateSize();
+
+    uint32_t get(int field);
+    void set(int field, uint32_t value);
+
+    // True if changes to this menu are sent to the other modules
+    bool isMenuSynced(int menu);
+
+    // Subset of a mask of menus (1 << GUI::MENU_*) which are synced
+    uint8_t syncedMenus(uint8_t mask);
+
+    // Write the payload of a menu and return its size
+    int encodeMenu(int menu, uint8_t* payload, bool usb);
+
+    // Update the fields of a menu from a payload, and return false if it is too short. Over USB,
+    // the sync flag is only updated if it is present.
+    bool decodeMenu(int menu, const uint8_t* payload, int size, bool usb);
+
+    // Write the answer to CMD_GET_GUI_STATE, truncated to size, and return its size
+    int encodeGUIState(uint8_t* buffer, int size);
+
+    // Values of the saved fields, in the order of SAVED ; setSaved() only updates the fields in mask
+    void getSaved(uint32_t values[]);
+    void setSaved(const uint32_t values[], uint32_t mask);
+
+}
+
+#endif
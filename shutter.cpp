@@ -0,0 +1,135 @@
+#include "shutter.h"
+#include <core.h>
+#include <gpio.h>
+#include <Queue.h>
+#include "passthrough.h"
+#include "timestamp.h"
+#include "pins.h"
+
+namespace Shutter {
+
+    // Outputs requested by the main loop
+    volatile bool _focus = false;
+    volatile bool _trigger = false;
+
+    volatile bool _input = false;
+    bool _passthroughEnabled = false;
+    unsigned long _passthroughDelayUs = 0;
+    unsigned long _passthroughStretchUs = 0;
+    volatile bool _passthroughActive = false;
+
+    // Changes of the passthrough outputs, not yet handled by the main loop. They are pushed either
+    // from the timer interrupt or with the interrupts disabled, so there is a single producer at a time.
+    Queue<bool, 8> _passthroughChanges;
+
+    // Internal functions
+    void inputHandler();
+    void timerHandler();
+    void apply(const Passthrough::Action& action);
+    void updateOutputs();
+    uint32_t now();
+
+
+    void init() {
+        GPIO::enableOutput(PIN_FOCUS, GPIO::LOW);
+        GPIO::enableOutput(PIN_TRIGGER, GPIO::LOW);
+        GPIO::enableInput(PIN_INPUT, GPIO::Pulling::PULLUP);
+        _input = !GPIO::get(PIN_INPUT);
+        GPIO::enableInterrupt(PIN_INPUT, inputHandler, GPIO::Trigger::CHANGE);
+    }
+
+    // True if the input is asserted (active low)
+    bool input() {
+        return _input;
+    }
+
+    // Outputs requested by the main loop, combined with the passthrough
+    void setOutputs(bool focus, bool trigger) {
+        Core::disableInterrupts();
+        _focus = focus;
+        _trigger = trigger;
+        updateOutputs();
+        Core::enableInterrupts();
+    }
+
+    // Enable or reconfigure the passthrough, which releases its outputs if the settings changed
+    void setPassthrough(bool enabled, unsigned long delayUs, unsigned long stretchUs) {
+        if (enabled == _passthroughEnabled && delayUs == _passthroughDelayUs && stretchUs == _passthroughStretchUs) {
+            return;
+        }
+        const uint64_t frequency = Timestamp::frequency();
+        Core::disableInterrupts();
+        TC::cancelDelayed(PASSTHROUGH_COUNTER);
+        Passthrough::configure(delayUs * frequency / 1000000, stretchUs * frequency / 1000000);
+        if (_passthroughActive) {
+            _passthroughActive = false;
+            _passthroughChanges.push(false);
+        }
+        _passthroughEnabled = enabled;
+        _passthroughDelayUs = delayUs;
+        _passthroughStretchUs = stretchUs;
+        updateOutputs();
+        Core::enableInterrupts();
+    }
+
+    bool isPassthroughActive() {
+        return _passthroughActive;
+    }
+
+    // Oldest change of the passthrough outputs not yet handled, if any
+    bool passthroughChanged(bool& active) {
+        return _passthroughChanges.pop(active);
+    }
+
+    // Called on both edges of the input
+    void inputHandler() {
+        bool asserted = !FastPinInput::get();
+        if (asserted == _input) {
+            // Both edges of a glitch happened before this handler was called
+            return;
+        }
+        _input = asserted;
+        if (asserted) {
+            Timestamp::capture(Timestamp::Source::INPUT);
+        }
+        if (_passthroughEnabled) {
+            // The timer interrupt has a higher priority and also drives the state machine
+            Core::disableInterrupts();
+            apply(Passthrough::edge(asserted, now()));
+            Core::enableInterrupts();
+        }
+    }
+
+    void timerHandler() {
+        if (_passthroughEnabled) {
+            apply(Passthrough::timeout(now()));
+        }
+    }
+
+    void apply(const Passthrough::Action& action) {
+        updateOutputs();
+        if (action.timer == Passthrough::Timer::START) {
+            TC::execDelayed(PASSTHROUGH_COUNTER, timerHandler, action.timerDelay, TC::Unit::TICKS);
+        } else if (action.timer == Passthrough::Timer::CANCEL) {
+            TC::cancelDelayed(PASSTHROUGH_COUNTER);
+        }
+        if (action.outputs != _passthroughActive) {
+            _passthroughActive = action.outputs;
+            _passthroughChanges.push(action.outputs);
+        }
+    }
+
+    void updateOutputs() {
+        bool passthrough = _passthroughEnabled && Passthrough::outputs();
+        // Both outputs change in the same cycle, so that the camera never sees the trigger
+        // without the focus. This is always called with the interrupts disabled or from the
+        // timer interrupt, which don't interrupt each other.
+        FastPinsOutputs::set(_focus || _trigger || passthrough, _trigger || passthrough);
+    }
+
+    // Ticks of the timestamps, truncated : the passthrough only needs the difference between close times
+    uint32_t now() {
+        return (uint32_t)Timestamp::now();
+    }
+
+}
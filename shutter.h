@@ -0,0 +1,27 @@
+#ifndef _SHUTTER_H_
+#define _SHUTTER_H_
+
+#include <stdint.h>
+#include <tc.h>
+
+// Focus and trigger outputs, and external input
+// The outputs are asserted by the main loop (shots, holds, remote commands) and, in passthrough
+// mode, directly by the interrupt handler of the input edges, so that the latency of an external
+// sensor does not depend on what the main loop is doing. The delay and the minimum duration of
+// the passthrough pulses are timed by a TC counter (see passthrough.h). The changes of the
+// passthrough outputs are queued for the main loop, which broadcasts them over the radio.
+namespace Shutter {
+
+    // Runs from the same clock as the timestamps, so that the ticks of both are the same
+    const TC::Counter PASSTHROUGH_COUNTER = TC::TC0_1;
+
+    void init();
+    bool input();
+    void setOutputs(bool focus, bool trigger);
+    void setPassthrough(bool enabled, unsigned long delayUs, unsigned long stretchUs);
+    bool isPassthroughActive();
+    bool passthroughChanged(bool& active);
+
+}
+
+#endif
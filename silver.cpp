@@ -3,7 +3,7 @@
 #include <pm.h>
 #include <gpio.h>
 #include <spi.h>
-#include <adc.h>
+#include <timers.h>
 #include <stdio.h>
 #include "silver.h"
 #include "gui.h"
@@ -11,6 +11,15 @@
 #include "sync.h"
 #include "sync_usb.h"
 #include "context.h"
+#include "presets.h"
+#include "dispatch.h"
+#include "airtime.h"
+#include "timestamp.h"
+#include "battery.h"
+#include "shutter.h"
+#include "buttons.h"
+#include "profiler.h"
+#include "clocks.h"
 #include "pins.h"
 
 
@@ -20,7 +29,11 @@ const int OLED_TURNOFF_DELAY = 0; // 10min
 const int TURNON_DELAY = 1000;
 const int TURNOFF_DELAY = 1000;
 const int LED_BLINK_DELAY = 2000;
-const unsigned long DELAY_VBAT_MEAS = 10000;
+const int SAVE_SETTINGS_DELAY = 1000;
+
+// Set by the timer handlers, which are called from an interrupt, and handled in the main loop
+volatile bool _saveSettingsDue = false;
+volatile bool _rssiTimeout = false;
 
 
 int main() {
@@ -46,24 +59,18 @@ int main() {
     OLED::setContrast(Context::_brightness * 25);
 
     // Init the buttons
-    GPIO::enableInput(PIN_BTN_UP, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_DOWN, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_LEFT, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_RIGHT, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_OK, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_PW);
-    GPIO::enableInput(PIN_BTN_TRIGGER, GPIO::Pulling::PULLUP);
-    GPIO::enableInput(PIN_BTN_FOCUS, GPIO::Pulling::PULLUP);
+    Buttons::init();
 
     // Init the leds
     GPIO::enableOutput(PIN_LED_TRIGGER, GPIO::HIGH);
     GPIO::enableOutput(PIN_LED_FOCUS, GPIO::HIGH);
     GPIO::enableOutput(PIN_LED_INPUT, GPIO::HIGH);
 
-    // Init the battery voltage measurement
-    GPIO::enableOutput(PIN_VBAT_MEAS_CMD, GPIO::LOW);
-    ADC::setPin(ADC_VBAT, PIN_VBAT_MEAS);
-    ADC::enable(ADC_VBAT);
+    // Init the battery measurement, which runs periodically in the background
+    Battery::init();
+
+    // Init the high-resolution timestamps, used by the sync module
+    Timestamp::init();
 
     // Init the sync module
     if (!Sync::init()) {
@@ -73,17 +80,27 @@ int main() {
     // Init USB
     SyncUSB::init();
 
-    // Init input
-    GPIO::enableInput(PIN_INPUT, GPIO::Pulling::PULLUP);
-
-    // Init outputs
-    GPIO::enableOutput(PIN_FOCUS, GPIO::LOW);
-    GPIO::enableOutput(PIN_TRIGGER, GPIO::LOW);
+    // Init the external input and the focus and trigger outputs
+    Shutter::init();
 
     // Read settings
     Context::read();
+    Presets::init();
     GUI::updateBrightness();
 
+    // Boost the CPU clock while there is work to do (see governor.h), from the PLL started by the USB
+    Clocks::init();
+
+#if PROFILING
+    // Cycle-count profiling of the main loop (see profiler.h)
+    Core::enableCycleCounter();
+    Profiler::init(Core::cycles, PM::getCPUClockFrequency());
+#endif
+
+    // Periodic tasks
+    Timers::start(SAVE_SETTINGS_DELAY, saveSettingsTimerHandler, true);
+    int rssiTimer = Timers::INVALID;
+
 
     // Current state
     bool lastWaiting = false;
@@ -91,7 +108,6 @@ int main() {
     bool lastFocusHold = false;
     bool lastTrigger = false;
     bool lastTriggerHold = false;
-    bool lastBtnPw = true;
     bool lastBtnFocus = false;
     bool lastBtnTrigger = false;
     bool lastBtnOk = false;
@@ -101,19 +117,13 @@ int main() {
     Core::Time tBtnPwPressed = 0;
     Core::Time tWaitingLed = 0;
     const int REMOTE_HOLD_KEEPALIVE = 500;
+    const int REMOTE_HOLD_KEEPALIVE_MAX = 2500; // When the duty-cycle budget is low
     const int REMOTE_HOLD_TIMEOUT = 3000;
-    bool remoteFocusHold = false;
-    bool isRemoteFocusHoldFromUSB = false;
-    Core::Time tRemoteFocusHold = 0;
     Core::Time tFocusHoldKeepalive = 0;
-    bool remoteTriggerHold = false;
-    bool isRemoteTriggerHoldFromUSB = false;
-    Core::Time tRemoteTriggerHold = 0;
     Core::Time tTriggerHoldKeepalive = 0;
     Core::Time tRefreshFooter = 0;
     bool screenDimmed = false;
     bool screenOff = false;
-    Core::Time tVbatMeas = 0;
     int forceSync = 0;
     Core::Time tForceSync = 500;
     const int FORCE_SYNC_DELAY = 200;
@@ -131,18 +141,139 @@ int main() {
         bool refresh = false;
         bool refreshFooter = false;
 
-        // Power button
-        bool btnPw = GPIO::get(PIN_BTN_PW);
-        if (!lastBtnPw && btnPw) {
-            // Button pressed
-            t = Core::time();
-            tBtnPwPressed = t;
+        // Current time, read once per iteration : an iteration is short compared to the
+        // resolution needed by the timings below
+        t = Core::time();
+        PROFILE_START(LOOP);
+
+        // Buttons : the presses and releases are queued by their interrupt handler (see Buttons),
+        // and all of them are handled in order, even when several happened during the previous
+        // iteration. The shots start from the time of the press.
+        bool buttonPressed = false;
+        bool btnTrigger = lastBtnTrigger;
+        bool btnFocus = lastBtnFocus;
+        bool btnOk = lastBtnOk;
+        Buttons::Event event;
+        Core::Time tTriggerLast = Context::_tTrigger;
+        Core::Time tFocusLast = Context::_tFocus;
+        PROFILE_START(BUTTONS);
+        while (Buttons::next(event)) {
+            Clocks::boost();
+            bool pressed = event.transition == Debounce::Transition::PRESS;
+            bool released = event.transition == Debounce::Transition::RELEASE;
+
+            if (event.button == Buttons::Button::PW) {
+                // Power button
+                if (pressed) {
+                    tBtnPwPressed = t;
+                    tLastActivity = t;
+                } else if (released) {
+                    tBtnPwPressed = 0;
+                }
+
+            } else if (event.button == Buttons::Button::TRIGGER) {
+                // Trigger button
+                if (pressed) {
+                    btnTrigger = true;
+                    tLastActivity = t;
+                    refresh = true;
+                    if (Context::_tTrigger == 0) {
+                        if (Context::_submenuTriggerHold) {
+                            if (Context::_triggerSync && !Context::_inhibitTriggerHold) {
+                                Sync::send(Sync::CMD_TRIGGER_HOLD);
+                                tTriggerHoldKeepalive = t;
+                            }
+                        } else {
+                            // Start
+                            GUI::copyShadowContext();
+                            Context::_tTrigger = event.t;
+                            Context::_skipDelay = false;
+                            if (Context::_triggerSync) {
+                                Sync::send(Sync::CMD_TRIGGER);
+                            }
+                        }
+                    } else {
+                        // Stop
+                        Context::_tTrigger = 0;
+                        if (Context::_triggerSync) {
+                            Sync::send(Sync::CMD_TRIGGER_RELEASE);
+                        }
+                        if (Context::_submenuTriggerHold) {
+                            Context::_inhibitTriggerHold = true;
+                        }
+                    }
+                } else if (released) {
+                    btnTrigger = false;
+                    tLastActivity = t;
+                    refresh = true;
+                    Context::_inhibitTriggerHold = false;
+                    if (Context::_submenuTriggerHold) {
+                        if (Context::_triggerSync && !Context::_inhibitTriggerHold) {
+                            Sync::send(Sync::CMD_TRIGGER_RELEASE);
+                            tTriggerHoldKeepalive = 0;
+                        }
+                    }
+                }
+
+            } else if (event.button == Buttons::Button::FOCUS) {
+                // Focus button
+                if (pressed) {
+                    btnFocus = true;
+                }
+                if (Context::_tTrigger == 0 && pressed) {
+                    tLastActivity = t;
+                    refresh = true;
+                    if (Context::_submenuFocusHold) {
+                        if (Context::_triggerSync) {
+                            Sync::send(Sync::CMD_FOCUS_HOLD);
+                            tFocusHoldKeepalive = t;
+                        }
+                    } else {
+                        if (Context::_tFocus == 0) {
+                            // Start
+                            GUI::copyShadowContext();
+                            Context::_tFocus = event.t;
+                            if (Context::_triggerSync) {
+                                Sync::send(Sync::CMD_FOCUS);
+                            }
+                        } else {
+                            // Stop
+                            Context::_tFocus = 0;
+                            if (Context::_triggerSync) {
+                                Sync::send(Sync::CMD_FOCUS_RELEASE);
+                            }
+                        }
+                    }
+                } else if (released) {
+                    btnFocus = false;
+                    tLastActivity = t;
+                    refresh = true;
+                    if (Context::_submenuFocusHold) {
+                        if (Context::_triggerSync) {
+                            Sync::send(Sync::CMD_FOCUS_RELEASE);
+                            tFocusHoldKeepalive = 0;
+                        }
+                    }
+                }
+
+            } else {
+                // Change menu when a navigation button is pressed
+                if (event.button == Buttons::Button::OK && (pressed || released)) {
+                    btnOk = pressed;
+                }
+                if (GUI::handleButtons(&event)) {
+                    buttonPressed = true;
+                }
+            }
+        }
+        PROFILE_STOP(BUTTONS);
+        if (buttonPressed) {
             tLastActivity = t;
-        } else if (!btnPw) {
-            // Button released
-            tBtnPwPressed = 0;
         }
-        if (tBtnPwPressed > 0 && Core::time() - tBtnPwPressed >= TURNOFF_DELAY) {
+        refresh = refresh || buttonPressed;
+
+        // Shutdown when the power button is held
+        if (tBtnPwPressed > 0 && t >= tBtnPwPressed + TURNOFF_DELAY) {
             // Shutdown
 
             // Display the shutdown message on the screen
@@ -162,150 +293,61 @@ int main() {
         }
 
         // Force the synchronisation at startup
-        int forceSyncMenu = -1;
-        Core::Time t = Core::time();
         if (forceSync > -1 && t >= tForceSync + FORCE_SYNC_DELAY) {
             if (forceSync < N_MENUS_TO_SYNC) {
                 if (syncEnabled[forceSync]) {
-                    forceSyncMenu = syncMenus[forceSync];
+                    GUI::handleButtons(nullptr, syncMenus[forceSync]);
                 }
                 forceSync++;
             } else {
+                // Then the wake interval of the channel, which sizes the preamble of the frames
+                Sync::sendWakeInterval();
                 forceSync = -1;
             }
             tForceSync = t;
         }
 
-        // Change menu when the button is pressed
-        bool buttonPressed = GUI::handleButtons(forceSyncMenu);
-        if (buttonPressed) {
-            tLastActivity = Core::time();
-        }
-        refresh = refresh || buttonPressed;
-
-        // Trigger button
-        t = Core::time();
-        bool btnTrigger = !GPIO::get(PIN_BTN_TRIGGER);
-        if (!lastBtnTrigger && btnTrigger) {
-            // Pressed
-            tLastActivity = t;
-            refresh = true;
-            if (Context::_tTrigger == 0) {
-                if (Context::_submenuTriggerHold) {
-                    if (Context::_triggerSync && !Context::_inhibitTriggerHold) {
-                        Sync::send(Sync::CMD_TRIGGER_HOLD);
-                        tTriggerHoldKeepalive = Core::time();
-                    }
-                } else {
-                    // Start
-                    GUI::copyShadowContext();
-                    Context::_tTrigger = t;
-                    Context::_skipDelay = false;
-                    if (Context::_triggerSync) {
-                        Sync::send(Sync::CMD_TRIGGER);
-                    }
-                }
-            } else {
-                // Stop
-                Context::_tTrigger = 0;
-                if (Context::_triggerSync) {
-                    Sync::send(Sync::CMD_TRIGGER_RELEASE);
-                }
-                if (Context::_submenuTriggerHold) {
-                    Context::_inhibitTriggerHold = true;
-                }
-            }
-        } else if (lastBtnTrigger && !btnTrigger) {
-            // Released
-            tLastActivity = t;
-            refresh = true;
-            Context::_inhibitTriggerHold = false;
-            if (Context::_submenuTriggerHold) {
-                if (Context::_triggerSync && !Context::_inhibitTriggerHold) {
-                    Sync::send(Sync::CMD_TRIGGER_RELEASE);
-                    tTriggerHoldKeepalive = 0;
-                }
-            }
-        }
+        // Trigger and focus held down
         if (btnTrigger && Context::_submenuTriggerHold && !Context::_inhibitTriggerHold) {
-            // Hold down
             tLastActivity = t;
             triggerHold = true;
         }
-
-        // Focus button
-        t = Core::time();
-        bool btnFocus = !GPIO::get(PIN_BTN_FOCUS);
-        if (Context::_tTrigger == 0 && !lastBtnFocus && btnFocus) {
-            // Pressed
-            tLastActivity = t;
-            refresh = true;
-            if (Context::_submenuFocusHold) {
-                if (Context::_triggerSync) {
-                    Sync::send(Sync::CMD_FOCUS_HOLD);
-                    tFocusHoldKeepalive = Core::time();
-                }
-            } else {
-                if (Context::_tFocus == 0) {
-                    // Start
-                    GUI::copyShadowContext();
-                    Context::_tFocus = t;
-                    if (Context::_triggerSync) {
-                        Sync::send(Sync::CMD_FOCUS);
-                    }
-                } else {
-                    // Stop
-                    Context::_tFocus = 0;
-                    if (Context::_triggerSync) {
-                        Sync::send(Sync::CMD_FOCUS_RELEASE);
-                    }
-                }
-            }
-        } else if (lastBtnFocus && !btnFocus) {
-            // Released
-            tLastActivity = t;
-            refresh = true;
-            if (Context::_submenuFocusHold) {
-                if (Context::_triggerSync) {
-                    Sync::send(Sync::CMD_FOCUS_RELEASE);
-                    tFocusHoldKeepalive = 0;
-                }
-            }
-        }
         if (btnFocus && Context::_submenuFocusHold) {
-            // Hold down
             tLastActivity = t;
             focusHold = true;
         }
 
-        // External input
-        bool inputStatus = !GPIO::get(PIN_INPUT);
-        if (Context::_inputMode == GUI::SUBMENU_INPUT_MODE_PASSTHROUGH) {
-            if (inputStatus) {
-                // Input low
-                tLastActivity = t;
-                triggerHold = true;
-                if (!lastInput) {
-                    // Input just asserted
-                    refresh = true;
-                    if (Context::_triggerSync) {
-                        Sync::send(Sync::CMD_TRIGGER_HOLD);
-                        tTriggerHoldKeepalive = Core::time();
-                    }
-                }
-            } else if (!inputStatus && lastInput) {
-                refresh = true;
+        // External input. In passthrough mode, the outputs are driven by the interrupt handler of
+        // the input (see Shutter) : only broadcast the changes here, in the order they happened.
+        bool inputStatus = Shutter::input();
+        bool passthrough = Context::_inputMode == GUI::SUBMENU_INPUT_MODE_PASSTHROUGH;
+        Clocks::setLowLatency(passthrough);
+        Shutter::setPassthrough(passthrough, Context::_inputPassthroughDelayUs, Context::_inputPassthroughStretchUs);
+        bool passthroughActive = false;
+        while (Shutter::passthroughChanged(passthroughActive)) {
+            refresh = true;
+            if (passthroughActive) {
+                sendInputEvent(Sync::CMD_TRIGGER_HOLD);
                 if (Context::_triggerSync) {
-                    Sync::send(Sync::CMD_TRIGGER_RELEASE);
-                    tTriggerHoldKeepalive = 0;
+                    Sync::send(Sync::CMD_TRIGGER_HOLD);
+                    tTriggerHoldKeepalive = t;
                 }
+            } else if (Context::_triggerSync) {
+                Sync::send(Sync::CMD_TRIGGER_RELEASE);
+                tTriggerHoldKeepalive = 0;
             }
-        } else if (Context::_inputMode == GUI::SUBMENU_INPUT_MODE_TRIGGER && Context::_tTrigger == 0 && !lastInput && inputStatus) {
+        }
+        bool passthroughHold = Shutter::isPassthroughActive();
+        if (passthroughHold) {
+            tLastActivity = t;
+        }
+        if (Context::_inputMode == GUI::SUBMENU_INPUT_MODE_TRIGGER && Context::_tTrigger == 0 && !lastInput && inputStatus) {
             tLastActivity = t;
             refresh = true;
             GUI::copyShadowContext();
-            Context::_tTrigger = Core::time();
+            Context::_tTrigger = t;
             Context::_skipDelay = false;
+            sendInputEvent(Sync::CMD_TRIGGER);
             if (Context::_triggerSync) {
                 Sync::send(Sync::CMD_TRIGGER);
             }
@@ -313,21 +355,21 @@ int main() {
             tLastActivity = t;
             refresh = true;
             GUI::copyShadowContext();
-            Context::_tTrigger = Core::time();
+            Context::_tTrigger = t;
             Context::_skipDelay = true;
+            sendInputEvent(Sync::CMD_TRIGGER_NO_DELAY);
             if (Context::_triggerSync) {
                 Sync::send(Sync::CMD_TRIGGER_NO_DELAY);
             }
         }
 
         // Focus and trigger hold with center button
-        bool btnOk = !GPIO::get(PIN_BTN_OK);
         if (Context::_menuItemSelected == GUI::MENU_TRIGGER && Context::_submenuItemSelected == GUI::SUBMENU_TRIGGER_SHOOT && Context::_submenuTriggerHold && !Context::_inhibitTriggerHold) {
             if (btnOk) {
                 triggerHold = true;
                 if (!lastBtnOk) {
                     Sync::send(Sync::CMD_TRIGGER_HOLD);
-                    tTriggerHoldKeepalive = Core::time();
+                    tTriggerHoldKeepalive = t;
                 }
             } else if (lastBtnOk && !btnOk) {
                 Sync::send(Sync::CMD_TRIGGER_RELEASE);
@@ -338,7 +380,7 @@ int main() {
                 focusHold = true;
                 if (!lastBtnOk) {
                     Sync::send(Sync::CMD_FOCUS_HOLD);
-                    tFocusHoldKeepalive = Core::time();
+                    tFocusHoldKeepalive = t;
                 }
             } else if (lastBtnOk && !btnOk) {
                 Sync::send(Sync::CMD_FOCUS_RELEASE);
@@ -346,30 +388,48 @@ int main() {
             }
         }
 
-        // Focus and trigger hold keepalive
-        t = Core::time();
-        if (tTriggerHoldKeepalive > 0 && t >= tTriggerHoldKeepalive + REMOTE_HOLD_KEEPALIVE) {
-            Sync::send(Sync::CMD_TRIGGER_HOLD);
+        // Focus and trigger hold keepalive, sent less often when the radio duty-cycle budget is low
+        unsigned long keepaliveDelay = Airtime::keepaliveDelay(REMOTE_HOLD_KEEPALIVE, REMOTE_HOLD_KEEPALIVE_MAX);
+        if (tTriggerHoldKeepalive > 0 && t >= tTriggerHoldKeepalive + keepaliveDelay) {
+            Sync::sendKeepalive(Sync::CMD_TRIGGER_HOLD);
             tTriggerHoldKeepalive = t;
         }
-        if (tFocusHoldKeepalive > 0 && t >= tFocusHoldKeepalive + REMOTE_HOLD_KEEPALIVE) {
-            Sync::send(Sync::CMD_FOCUS_HOLD);
+        // A trigger hold also holds the focus on the receivers, which refresh their focus hold
+        // with each trigger keepalive : the focus keepalive is paused meanwhile, and sent as soon
+        // as the trigger is released
+        if (tFocusHoldKeepalive > 0 && tTriggerHoldKeepalive == 0 && t >= tFocusHoldKeepalive + keepaliveDelay) {
+            Sync::sendKeepalive(Sync::CMD_FOCUS_HOLD);
             tFocusHoldKeepalive = t;
         }
 
+        // The frames are sent in the background : start the shots of this module when the other
+        // modules receive them
+        Core::Time tTxEnd = Sync::txEnd();
+        if (Context::_tTrigger != tTriggerLast && Context::_tTrigger > 0 && tTxEnd > Context::_tTrigger) {
+            Context::_tTrigger = tTxEnd;
+        }
+        if (Context::_tFocus != tFocusLast && Context::_tFocus > 0 && tTxEnd > Context::_tFocus) {
+            Context::_tFocus = tTxEnd;
+        }
+
         // Receive data from other modules and from USB
         bool commandAvailable = false;
         uint8_t command = 0x00;
         uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
         int payloadSize = 0;
         bool isCommandFromUSB = false;
+        PROFILE_START(RECEIVE);
         if (Sync::commandAvailable()) {
             command = Sync::getCommand();
             payloadSize = Sync::getPayload(payload);
             commandAvailable = true;
             Context::_rssi = Sync::getRSSI();
-            Context::_tReceivedCommand = Core::time();
+            Context::_rxTimestamp = Sync::getRxTimestamp();
+            Context::_tReceivedCommand = t;
             refreshFooter = true;
+            Timers::cancel(rssiTimer);
+            _rssiTimeout = false;
+            rssiTimer = Timers::start(Context::RSSI_TIMEOUT, rssiTimeoutHandler);
         }
         if (!commandAvailable && SyncUSB::commandAvailable()) {
             command = SyncUSB::getCommand();
@@ -377,157 +437,46 @@ int main() {
             commandAvailable = true;
             isCommandFromUSB = true;
         }
+        PROFILE_STOP(RECEIVE);
         if (commandAvailable) {
-            if (command == GUI::MENU_TRIGGER && (isCommandFromUSB || Context::_triggerSync) && payloadSize >= 2) {
-                Context::_submenuFocusHold = payload[0];
-                Context::_submenuTriggerHold = payload[1];
-                if (isCommandFromUSB && payloadSize >= 3) {
-                    Context::_triggerSync = payload[2];
-                }
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command, payload, payloadSize);
-                }
-                if (!isCommandFromUSB && SyncUSB::isConnected()) {
-                    payload[2] = Context::_triggerSync;
-                    SyncUSB::send(command, payload, payloadSize + 1);
-                }
-            } else if (command == GUI::MENU_DELAY && (isCommandFromUSB || Context::_delaySync) && payloadSize >= 3) {
-                Context::_delayMs = ((payload[0] << 16) + (payload[1] << 8) + payload[2]) * 100;
-                if (isCommandFromUSB && payloadSize >= 4) {
-                    Context::_delaySync = payload[3];
-                }
-                if (isCommandFromUSB && Context::_delaySync) {
-                    Sync::send(command, payload, payloadSize);
-                }
-                if (!isCommandFromUSB && SyncUSB::isConnected()) {
-                    payload[3] = Context::_delaySync;
-                    SyncUSB::send(command, payload, payloadSize + 1);
-                }
-            } else if (command == GUI::MENU_INTERVAL && (isCommandFromUSB || Context::_intervalSync) && payloadSize >= 4) {
-                Context::_intervalNShots = payload[0];
-                Context::_intervalDelayMs = ((payload[1] << 16) + (payload[2] << 8) + payload[3]) * 100;
-                if (isCommandFromUSB && payloadSize >= 5) {
-                    Context::_intervalSync = payload[4];
-                }
-                if (isCommandFromUSB && Context::_intervalSync) {
-                    Sync::send(command, payload, payloadSize);
-                }
-                if (!isCommandFromUSB && SyncUSB::isConnected()) {
-                    payload[4] = Context::_intervalSync;
-                    SyncUSB::send(command, payload, payloadSize + 1);
-                }
-            } else if (command == GUI::MENU_INPUT && (isCommandFromUSB || Context::_inputSync) && payloadSize >= 1) {
-                Context::_inputMode = payload[0];
-                if (isCommandFromUSB && payloadSize >= 2) {
-                    Context::_inputSync = payload[1];
-                }
-                if (isCommandFromUSB && Context::_inputSync) {
-                    Sync::send(command, payload, payloadSize);
-                }
-                if (!isCommandFromUSB && SyncUSB::isConnected()) {
-                    payload[1] = Context::_inputSync;
-                    SyncUSB::send(command, payload, payloadSize + 1);
-                }
-            } else if (command == GUI::MENU_SETTINGS && isCommandFromUSB && payloadSize >= 1) {
-                Context::_syncChannel = payload[0];
-            } else if (command == GUI::MENU_TIMINGS && (isCommandFromUSB || Context::_timingsSync) && payloadSize >= 6) {
-                Context::_timingsFocusDurationMs = ((payload[0] << 16) + (payload[1] << 8) + payload[2]) * 100;
-                Context::_timingsTriggerDurationMs = ((payload[3] << 8) + (payload[4] << 8) + payload[5]) * 100;
-                if (isCommandFromUSB && payloadSize >= 7) {
-                    Context::_timingsSync = payload[6];
-                }
-                if (isCommandFromUSB && Context::_timingsSync) {
-                    Sync::send(command, payload, payloadSize);
-                }
-                if (!isCommandFromUSB && SyncUSB::isConnected()) {
-                    payload[6] = Context::_timingsSync;
-                    SyncUSB::send(command, payload, payloadSize + 1);
-                }
-            } else if (command == Sync::CMD_FOCUS && (isCommandFromUSB || Context::_triggerSync)) {
-                GUI::copyShadowContext();
-                Context::_tFocus = Core::time();
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_FOCUS_HOLD && (isCommandFromUSB || Context::_triggerSync)) {
-                if (!remoteFocusHold) {
-                    remoteFocusHold = true;
-                    isRemoteFocusHoldFromUSB = isCommandFromUSB;
-                }
-                tRemoteFocusHold = Core::time();
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_FOCUS_RELEASE && (isCommandFromUSB || Context::_triggerSync)) {
-                Context::_tFocus = 0;
-                remoteFocusHold = false;
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_TRIGGER && (isCommandFromUSB || Context::_triggerSync)) {
-                GUI::copyShadowContext();
-                Context::_tTrigger = Core::time();
-                Context::_skipDelay = false;
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_TRIGGER_NO_DELAY && (isCommandFromUSB || Context::_triggerSync)) {
-                GUI::copyShadowContext();
-                Context::_tTrigger = Core::time();
-                Context::_skipDelay = true;
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_TRIGGER_HOLD && (isCommandFromUSB || Context::_triggerSync)) {
-                if (!remoteTriggerHold) {
-                    remoteTriggerHold = true;
-                    isRemoteTriggerHoldFromUSB = isCommandFromUSB;
-                }
-                tRemoteTriggerHold = Core::time();
-                Context::_skipDelay = false;
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            } else if (command == Sync::CMD_TRIGGER_RELEASE && (isCommandFromUSB || Context::_triggerSync)) {
-                Context::_tTrigger = 0;
-                Context::_skipDelay = false;
-                remoteTriggerHold = false;
-                if (isCommandFromUSB && Context::_triggerSync) {
-                    Sync::send(command);
-                }
-            }
+            Clocks::boost();
 
+            // See the command table in dispatch.cpp
+            PROFILE_START(DISPATCH);
+            Dispatch::dispatch(command, payload, payloadSize, isCommandFromUSB);
+            PROFILE_STOP(DISPATCH);
             refresh = true;
         }
 
         // Remote focus and trigger hold
-        t = Core::time();
-        if (remoteTriggerHold) {
+        if (Context::_remoteTriggerHold) {
             triggerHold = true;
-            if (t >= tRemoteTriggerHold + REMOTE_HOLD_TIMEOUT) {
+            if (t >= Context::_tRemoteTriggerHold + REMOTE_HOLD_TIMEOUT) {
                 // Timeout
                 triggerHold = false;
                 Context::_tTrigger = 0;
-                remoteTriggerHold = false;
-                if (isRemoteTriggerHoldFromUSB && Context::_triggerSync) {
+                Context::_remoteTriggerHold = false;
+                if (Context::_remoteTriggerHoldFromUSB && Context::_triggerSync) {
                     Sync::send(Sync::CMD_TRIGGER_RELEASE);
                 }
             }
-        } else if (remoteFocusHold) {
+        } else if (Context::_remoteFocusHold) {
             focusHold = true;
-            if (t >= tRemoteFocusHold + REMOTE_HOLD_TIMEOUT) {
+            if (t >= Context::_tRemoteFocusHold + REMOTE_HOLD_TIMEOUT) {
                 // Timeout
                 focusHold = false;
                 Context::_tFocus = 0;
-                remoteFocusHold = false;
-                if (isRemoteFocusHoldFromUSB && Context::_triggerSync) {
+                Context::_remoteFocusHold = false;
+                if (Context::_remoteFocusHoldFromUSB && Context::_triggerSync) {
                     Sync::send(Sync::CMD_FOCUS_RELEASE);
                 }
             }
         }
 
-        // Focus and trigger timings (non-hold)
+        // Focus and trigger timings (non-hold). The time is read again because the commands
+        // handled above may have started a shot after the beginning of the iteration.
         t = Core::time();
+        PROFILE_START(SEQUENCING);
         if (Context::_tTrigger > 0) {
             // Make sure focus is disabled
             Context::_tFocus = 0;
@@ -547,7 +496,7 @@ int main() {
                 Context::_shotsLeft = Context::_shadowIntervalNShots;
                 Context::_countdown = tStart - t;
                 if (tWaitingLed == 0) {
-                    tWaitingLed = Core::time();
+                    tWaitingLed = t;
                 }
             } else {
                 if (t >= tEnd) {
@@ -574,69 +523,69 @@ int main() {
             if (t > Context::_tFocus + Context::_timingsFocusDurationMs) {
                 Context::_tFocus = 0;
                 refresh = true;
-            } else {
+            } else if (t >= Context::_tFocus) {
                 focus = true;
                 Context::_countdown = Context::_shadowTimingsFocusDurationMs - (t - Context::_tFocus);
             }
         }
 
-        // Assert the outputs
-        GPIO::set(PIN_FOCUS, focus || focusHold || trigger || triggerHold);
-        GPIO::set(PIN_TRIGGER, trigger || triggerHold);
+        // Assert the outputs, in addition to the passthrough which is only displayed from here
+        Shutter::setOutputs(focus || focusHold || trigger || triggerHold, trigger || triggerHold);
+        triggerHold = triggerHold || passthroughHold;
 
         // Input LED
         if (inputStatus) {
             // Off
-            GPIO::set(PIN_LED_INPUT, GPIO::LOW);
+            FastPinLedInput::set(GPIO::LOW);
         } else {
             // On
-            GPIO::set(PIN_LED_INPUT, GPIO::HIGH);
+            FastPinLedInput::set(GPIO::HIGH);
         }
 
         // Trigger LED
         if (trigger || triggerHold) {
             // On
-            GPIO::set(PIN_LED_TRIGGER, GPIO::LOW);
+            FastPinLedTrigger::set(GPIO::LOW);
         } else if (waiting) {
             // Blink the trigger LED while waiting
             const int DELAY = 400;
-            t = Core::time();
             if (t - tWaitingLed < DELAY / 2) {
                 // On
-                GPIO::set(PIN_LED_TRIGGER, GPIO::LOW);
+                FastPinLedTrigger::set(GPIO::LOW);
             } else if (t - tWaitingLed < DELAY) {
                 // Off
-                GPIO::set(PIN_LED_TRIGGER, GPIO::HIGH);
+                FastPinLedTrigger::set(GPIO::HIGH);
             } else {
                 tWaitingLed += DELAY;
             }
         } else {
             // Off
-            GPIO::set(PIN_LED_TRIGGER, GPIO::HIGH);
+            FastPinLedTrigger::set(GPIO::HIGH);
         }
 
         // Focus LED
         if (focus || focusHold) {
             // Off
-            GPIO::set(PIN_LED_FOCUS, GPIO::LOW);
+            FastPinLedFocus::set(GPIO::LOW);
         } else {
             // On
-            GPIO::set(PIN_LED_FOCUS, GPIO::HIGH);
+            FastPinLedFocus::set(GPIO::HIGH);
         }
 
-        // Measure battery voltage
-        t = Core::time();
-        if ((tVbatMeas == 0 && t >= 1000) || t >= tVbatMeas + DELAY_VBAT_MEAS) {
-            GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::HIGH);
-            Core::sleep(10);
-            Context::_vBat = 2 * ADC::read(ADC_VBAT);
-            GPIO::set(PIN_VBAT_MEAS_CMD, GPIO::LOW);
+        PROFILE_STOP(SEQUENCING);
+
+        // Update the battery estimates when a new measurement is available
+        PROFILE_START(BATTERY);
+        Battery::setProfile(Context::_radio * Sync::N_WAKE_INTERVALS + Context::_wakeInterval);
+        if (Battery::update(t)) {
+            Context::_vBat = Battery::voltage();
+            Context::_batteryLevel = Battery::level();
+            Context::_batteryMinutesLeft = Battery::minutesLeft();
             refreshFooter = true;
-            tVbatMeas = t;
         }
+        PROFILE_STOP(BATTERY);
 
         // Dim then turn off the screen in case of inactivity
-        t = Core::time();
         if (OLED_TURNOFF_DELAY > 0 && !screenOff && t - tLastActivity > OLED_TURNOFF_DELAY) {
             OLED::disable();
             screenOff = true;
@@ -651,12 +600,21 @@ int main() {
         }
 
         // Hide the RSSI indicator after a timeout
-        t = Core::time();
-        if (Context::_tReceivedCommand > 0 && t >= Context::_tReceivedCommand + Context::RSSI_TIMEOUT) {
+        if (_rssiTimeout) {
+            _rssiTimeout = false;
             refreshFooter = true;
             Context::_tReceivedCommand = 0;
         }
 
+        // Save the settings which changed, but not while a value is being edited nor during a
+        // shot : writing the flash stalls the CPU for a few milliseconds
+        if (_saveSettingsDue && !Context::_editingItem && !waiting && !focus && !trigger) {
+            _saveSettingsDue = false;
+            PROFILE_START(SAVE);
+            Context::save();
+            PROFILE_STOP(SAVE);
+        }
+
         // Refresh the footer when there is a change of state
         if ((waiting || focus || trigger) && t > tRefreshFooter + (Context::_countdown < 10000 ? 100 : 1000)) {
             refreshFooter = true;
@@ -667,8 +625,16 @@ int main() {
         }
 
         // Update the display
+        if (refresh || refreshFooter) {
+            Clocks::boost();
+        }
+        PROFILE_START(GUI);
         GUI::update(refresh, refreshFooter, trigger, triggerHold, focus, focusHold, waiting, inputStatus);
+        PROFILE_STOP(GUI);
+        PROFILE_STOP(LOOP);
 
+        // Back to the idle clock once the boost is no longer held
+        Clocks::update();
         Core::sleep(10);
 
         lastWaiting = waiting;
@@ -676,7 +642,6 @@ int main() {
         lastFocusHold = focusHold;
         lastTrigger = trigger;
         lastTriggerHold = triggerHold;
-        lastBtnPw = btnPw;
         lastBtnFocus = btnFocus;
         lastBtnTrigger = btnTrigger;
         lastInput = inputStatus;
@@ -685,6 +650,24 @@ int main() {
 }
 
 
+void saveSettingsTimerHandler() {
+    _saveSettingsDue = true;
+}
+
+void rssiTimeoutHandler() {
+    _rssiTimeout = true;
+}
+
+// Notify the host of the input edge which started a trigger, with the delay before the main loop handled it
+void sendInputEvent(uint8_t command) {
+    Timestamp::Counts edge = 0;
+    if (Timestamp::captured(Timestamp::Source::INPUT, edge) && SyncUSB::isConnected()) {
+        uint64_t edgeUs = Timestamp::toMicroseconds(edge);
+        uint64_t nowUs = Timestamp::toMicroseconds(Timestamp::now());
+        SyncUSB::sendInput(command, edgeUs, nowUs - edgeUs);
+    }
+}
+
 void warningHandler(Error::Module module, int userModule, Error::Code code) {
     GPIO::set(PIN_LED_TRIGGER, GPIO::LOW);
     Core::sleep(100);
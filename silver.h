@@ -2,7 +2,9 @@
 #define _SILVER_H_
 
 
-
+void saveSettingsTimerHandler();
+void rssiTimeoutHandler();
+void sendInputEvent(uint8_t command);
 void warningHandler(Error::Module module=Error::Module::CUSTOM, int userModule=0, Error::Code code=0);
 void criticalHandler(Error::Module module=Error::Module::CUSTOM, int userModule=0, Error::Code code=0);
 
@@ -3,6 +3,9 @@
 #include "gui.h"
 #include "pins.h"
 #include "context.h"
+#include "airtime.h"
+#include "radio_stats.h"
+#include "timestamp.h"
 #include "drivers/lora/lora.h"
 #include <core.h>
 #include <gpio.h>
@@ -15,6 +18,61 @@ namespace Sync {
     bool _commandAvailable = false;
     bool _rxEnabled = false;
     int _rssi = -137;
+    uint32_t _rxTimestamp = 0; // us, 0 if the RxDone edge was not captured
+    bool _explicitHeader = false;
+    Core::Time _tExplicitWindowEnd = 0;
+
+    // Frames with a payload, sent one after the other by sendPending() once the guard delay
+    // after their announce is over. The first one is the frame announced last.
+    const int N_PENDING_FRAMES = 8;
+    struct PendingFrame {
+        uint8_t buffer[HEADER_SIZE + MAX_PAYLOAD_SIZE];
+        int size;
+    };
+    PendingFrame _pending[N_PENDING_FRAMES];
+    int _nPending = 0;
+    Core::Time _tPending = 0;
+
+    // Frames being sent in the background, the first one being on the air : with the preamble
+    // of a long wake interval, this takes up to two seconds per frame
+    const int N_TX_FRAMES = 4;
+    struct TxFrame {
+        uint8_t buffer[HEADER_SIZE + MAX_PAYLOAD_SIZE];
+        int length;
+        bool explicitHeader;
+    };
+    TxFrame _txFrames[N_TX_FRAMES];
+    int _nTx = 0;
+    Core::Time _tTxEnd = 0; // Estimated
+    bool _txSleeping = false;
+
+    // Low-power reception
+    enum class SniffState {
+        SLEEP,
+        CAD,
+        RX,
+    };
+    int _wakeInterval = 0;
+    int _channelWakeInterval = 0;
+    SniffState _sniffState = SniffState::SLEEP;
+    Core::Time _tNextSniff = 0;
+    Core::Time _tSniffRxEnd = 0;
+
+    // Internal functions
+    void setExplicitHeader(bool explicitHeader);
+    void applyExplicitHeader();
+    void setWakeInterval(int wakeInterval);
+    void setChannelWakeInterval(int wakeInterval);
+    bool isListening();
+    void startListening();
+    void sniffSleep();
+    void sniff();
+    bool send(uint8_t command, uint8_t* payload, int payloadSize, Airtime::Priority priority);
+    void announce();
+    void sendPending();
+    void tx(uint8_t* buffer, int length);
+    void startTx();
+    bool txDone();
 
     bool init() {
         LoRa::setPin(LoRa::PinFunction::RESET, PIN_LORA_RESET);
@@ -26,39 +84,121 @@ namespace Sync {
         LoRa::setSpreadingFactor(8);
         LoRa::setCodingRate(LoRa::CodingRate::RATE_4_8);
         LoRa::setBandwidth(LoRa::Bandwidth::BW_125kHz);
-        LoRa::setExplicitHeader(true);
+        LoRa::setPayloadLength(FAST_FRAME_SIZE);
+        LoRa::setExplicitHeader(false);
+        _explicitHeader = false;
+        setChannelWakeInterval(Context::_channelWakeInterval);
+
+        // DIO0 rises on RxDone in the default mapping : timestamp it to measure the trigger latency
+        GPIO::enableInput(PIN_LORA_DIO0);
+        Timestamp::enableCapture(Timestamp::Source::RX_DONE, PIN_LORA_DIO0, GPIO::Trigger::RISING);
         if (Context::_radio != GUI::SUBMENU_SETTINGS_RADIO_DISABLED) {
-            LoRa::enableRx();
             _rxEnabled = true;
+            startListening();
         }
         return true;
     }
 
     bool commandAvailable() {
+        // The modem can't be reconfigured nor receive while it is sending
+        if (_nTx > 0 && !txDone()) {
+            RadioStats::update();
+            return _commandAvailable;
+        }
+
+        // Send the announced frame once the receivers had time to switch to explicit header mode
+        if (_nPending > 0 && Context::_radio != GUI::SUBMENU_SETTINGS_RADIO_ENABLED) {
+            _nPending = 0;
+            setExplicitHeader(false);
+        } else if (_nPending > 0 && !_explicitHeader) {
+            // A fast frame ended the window of the receivers (see send())
+            announce();
+        } else if (_nPending > 0 && Core::time() >= _tPending) {
+            sendPending();
+        }
+
+        // Apply the low-power reception settings
+        if (Context::_wakeInterval != _wakeInterval) {
+            setWakeInterval(Context::_wakeInterval);
+        }
+        if (Context::_channelWakeInterval != _channelWakeInterval) {
+            setChannelWakeInterval(Context::_channelWakeInterval);
+        }
+
         // Enable or disable the receiver according to the current setting
         if (_rxEnabled && Context::_radio == GUI::SUBMENU_SETTINGS_RADIO_DISABLED) {
             LoRa::disableRx();
             _rxEnabled = false;
         } else if (!_rxEnabled && Context::_radio != GUI::SUBMENU_SETTINGS_RADIO_DISABLED) {
-            LoRa::enableRx();
             _rxEnabled = true;
+            startListening();
+        }
+
+        // Go back to fast frames if the announced explicit frame was not received in time
+        if (_explicitHeader && _nPending == 0 && Core::time() > _tExplicitWindowEnd) {
+            setExplicitHeader(false);
         }
 
         // Check if some data has been received in the LoRa's FIFO
-        if (Context::_radio != GUI::SUBMENU_SETTINGS_RADIO_DISABLED && LoRa::rxAvailable()) {
+        if (_rxEnabled && isListening() && LoRa::rxAvailable()) {
             // Retreive this data
+            bool wasExplicitHeader = _explicitHeader;
             uint8_t rxBuffer2[BUFFER_RX_SIZE];
             int rxSize2 = LoRa::rx(rxBuffer2, BUFFER_RX_SIZE);
+            _rssi = LoRa::lastPacketRSSI();
+            Timestamp::Counts rxDone = 0;
+            _rxTimestamp = Timestamp::captured(Timestamp::Source::RX_DONE, rxDone) ? Timestamp::toMicroseconds(rxDone) : 0;
+
+            // Only one explicit frame is expected after an announce. The other receivers go back
+            // to implicit header mode as well, so a frame still waiting here is announced again.
+            if (wasExplicitHeader) {
+                setExplicitHeader(false);
+            }
+
             // Check that this looks like a valid frame on the same channel
-            if (rxSize2 >= HEADER_SIZE && rxBuffer2[HEADER_PREAMBLE] == SYNC_PREAMBLE && rxBuffer2[HEADER_CHANNEL] == Context::_syncChannel) {
-                // Copy the frame into the main buffer
-                memcpy(_rxBuffer, rxBuffer2, rxSize2);
-                _rxSize = rxSize2;
-                _commandAvailable = true;
+            bool valid = rxSize2 >= HEADER_SIZE && rxBuffer2[HEADER_PREAMBLE] == SYNC_PREAMBLE && rxBuffer2[HEADER_CHANNEL] == Context::_syncChannel;
+            if (rxSize2 == LoRa::INVALID_HEADER) {
+                RadioStats::recordRx(RadioStats::Event::RX_HEADER_ERROR, 0, 0, _rssi, LoRa::lastPacketSNR());
+            } else if (rxSize2 == LoRa::PAYLOAD_CRC_ERROR) {
+                RadioStats::recordRx(RadioStats::Event::RX_CRC_ERROR, 0, 0, _rssi, LoRa::lastPacketSNR());
+            } else if (rxSize2 > 0) {
+                RadioStats::recordRx(valid ? RadioStats::Event::RX_OK : RadioStats::Event::RX_FOREIGN,
+                    rxSize2 >= HEADER_SIZE ? rxBuffer2[HEADER_COMMAND] : 0, rxSize2, _rssi, LoRa::lastPacketSNR());
             }
+            if (valid) {
+                // Only follow the frequency of the modules of the same network
+                if (AFC_ENABLED) {
+                    LoRa::correctFrequency(LoRa::lastPacketFrequencyError());
+                }
 
-            _rssi = LoRa::lastPacketRSSI();
+                if (!wasExplicitHeader && rxBuffer2[HEADER_COMMAND] == CMD_EXPLICIT_FOLLOWS) {
+                    // Listen for the announced frame : the sender waits for EXPLICIT_GUARD_DELAY
+                    // before sending it, which leaves time for the main loop to get here even
+                    // during a screen refresh
+                    setExplicitHeader(true);
+                    _tExplicitWindowEnd = Core::time() + EXPLICIT_GUARD_DELAY
+                        + LoRa::timeOnAir(HEADER_SIZE + MAX_PAYLOAD_SIZE, true) / 1000 + EXPLICIT_WINDOW_MARGIN;
+                } else {
+                    // Copy the frame into the main buffer
+                    memcpy(_rxBuffer, rxBuffer2, rxSize2);
+                    _rxSize = rxSize2;
+                    _commandAvailable = true;
+                }
+            }
+
+            // Go back to sleep after a frame in low-power mode, unless another one was announced
+            if (_wakeInterval > 0 && !_explicitHeader) {
+                sniffSleep();
+            }
+        }
+
+        // Low-power reception
+        if (_rxEnabled && _wakeInterval > 0) {
+            sniff();
         }
+
+        RadioStats::update();
+
         return _commandAvailable;
     }
 
@@ -74,6 +214,11 @@ namespace Sync {
         return _rssi;
     }
 
+    // Time at which the last frame was received, in microseconds (see Timestamp)
+    uint32_t getRxTimestamp() {
+        return _rxTimestamp;
+    }
+
     int getPayload(uint8_t* buffer) {
         _commandAvailable = false;
         int payloadSize = _rxSize - HEADER_SIZE;
@@ -81,19 +226,285 @@ namespace Sync {
         return payloadSize;
     }
 
-    void send(uint8_t command, uint8_t* payload, int payloadSize) {
-        if (Context::_radio == GUI::SUBMENU_SETTINGS_RADIO_ENABLED) {
-            if (payloadSize > MAX_PAYLOAD_SIZE) {
-                payloadSize = MAX_PAYLOAD_SIZE;
+    // Send a command to the other modules, if the duty-cycle budget allows it.
+    // Commands without payload are sent as a single fast frame.
+    bool send(uint8_t command, uint8_t* payload, int payloadSize) {
+        return send(command, payload, payloadSize, (payload != nullptr && payloadSize > 0) ? Airtime::Priority::SETTINGS : Airtime::Priority::TRIGGER);
+    }
+
+    // Send a hold keepalive, which has the lowest priority
+    bool sendKeepalive(uint8_t command) {
+        return send(command, nullptr, 0, Airtime::Priority::KEEPALIVE);
+    }
+
+    // Send the wake interval of the channel to the other modules, with the current preamble : the
+    // new one is only used from the next call to commandAvailable(), so that the modules which
+    // sleep for the previous interval still receive it
+    bool sendWakeInterval() {
+        return send(CMD_WAKE_INTERVAL + Context::_channelWakeInterval, nullptr, 0, Airtime::Priority::SETTINGS);
+    }
+
+    bool send(uint8_t command, uint8_t* payload, int payloadSize, Airtime::Priority priority) {
+        if (Context::_radio != GUI::SUBMENU_SETTINGS_RADIO_ENABLED) {
+            return false;
+        }
+        if (payloadSize > MAX_PAYLOAD_SIZE) {
+            payloadSize = MAX_PAYLOAD_SIZE;
+        }
+        if (payload == nullptr) {
+            payloadSize = 0;
+        }
+        uint8_t buffer[HEADER_SIZE + MAX_PAYLOAD_SIZE];
+        buffer[HEADER_PREAMBLE] = SYNC_PREAMBLE;
+        buffer[HEADER_CHANNEL] = Context::_syncChannel;
+
+        // Check the duty-cycle budget, including the announce which follows a fast frame sent
+        // during the guard delay
+        uint32_t airtime = LoRa::timeOnAir(FAST_FRAME_SIZE, false);
+        if (payloadSize > 0) {
+            airtime += LoRa::timeOnAir(HEADER_SIZE + payloadSize, true);
+        } else if (_explicitHeader) {
+            airtime = LoRa::timeOnAir(FAST_FRAME_SIZE, true) + (_nPending > 0 ? airtime : 0);
+        }
+        if (!Airtime::allowed(airtime, priority)) {
+            RadioStats::recordTxDenied(command);
+            return false;
+        }
+
+        if (payloadSize > 0) {
+            // The frame is announced to the receivers with a fast frame, and sent by commandAvailable()
+            // after EXPLICIT_GUARD_DELAY, which gives them some time to switch to explicit header mode
+            // without blocking the main loop meanwhile. Frames sent during this delay are queued,
+            // and a newer frame for the same command replaces the one which is waiting.
+            int i = 0;
+            while (i < _nPending && _pending[i].buffer[HEADER_COMMAND] != command) {
+                i++;
             }
-            uint8_t buffer[HEADER_SIZE + MAX_PAYLOAD_SIZE];
-            buffer[HEADER_PREAMBLE] = SYNC_PREAMBLE;
-            buffer[HEADER_CHANNEL] = Context::_syncChannel;
+            if (i == N_PENDING_FRAMES) {
+                RadioStats::recordTxDenied(command);
+                return false;
+            }
+            buffer[HEADER_COMMAND] = command;
+            memcpy(_pending[i].buffer, buffer, HEADER_SIZE);
+            memcpy(_pending[i].buffer + HEADER_SIZE, payload, payloadSize);
+            _pending[i].size = HEADER_SIZE + payloadSize;
+            if (i == _nPending) {
+                _nPending++;
+            }
+            if (_nPending == 1) {
+                announce();
+            }
+
+        } else {
+            // Fast frames are sent at once, in the header mode the receivers are listening with :
+            // during the guard delay of an announce, this makes them go back to implicit header mode
+            // as soon as the frame arrives, and the frame waiting is announced again by the next
+            // call to commandAvailable()
+            bool interrupted = _explicitHeader;
             buffer[HEADER_COMMAND] = command;
-            if (payloadSize > 0 && payload != nullptr) {
-                memcpy(buffer + HEADER_SIZE, payload, payloadSize);
+            tx(buffer, FAST_FRAME_SIZE);
+            if (interrupted) {
+                setExplicitHeader(false);
             }
-            LoRa::tx(buffer, HEADER_SIZE + payloadSize);
+        }
+        return true;
+    }
+
+    // Announce the first pending frame with a fast frame, then listen in explicit header mode with
+    // the receivers until it is sent, to catch the fast frames they send meanwhile
+    void announce() {
+        if (_explicitHeader) {
+            setExplicitHeader(false);
+        }
+        uint8_t buffer[FAST_FRAME_SIZE];
+        buffer[HEADER_PREAMBLE] = SYNC_PREAMBLE;
+        buffer[HEADER_CHANNEL] = Context::_syncChannel;
+        buffer[HEADER_COMMAND] = CMD_EXPLICIT_FOLLOWS;
+        tx(buffer, FAST_FRAME_SIZE);
+        setExplicitHeader(true);
+        _tPending = _tTxEnd + EXPLICIT_GUARD_DELAY; // Updated by txDone()
+    }
+
+    // Send the frame announced last in explicit header mode, then announce the next one
+    void sendPending() {
+        if (!_explicitHeader) {
+            setExplicitHeader(true);
+        }
+        tx(_pending[0].buffer, _pending[0].size);
+        _nPending--;
+        memmove(_pending, _pending + 1, _nPending * sizeof(PendingFrame));
+        if (_nPending > 0) {
+            announce();
+        } else {
+            setExplicitHeader(false);
+        }
+    }
+
+    // Time at which the frames queued so far will be sent, or 0 if the modem is not sending
+    Core::Time txEnd() {
+        return _nTx > 0 ? _tTxEnd : 0;
+    }
+
+    // Queue a frame with the current header mode and account for its airtime. It is sent in the
+    // background, and commandAvailable() polls the end of the transmission.
+    void tx(uint8_t* buffer, int length) {
+        if (_nTx == N_TX_FRAMES) {
+            RadioStats::recordTxDenied(buffer[HEADER_COMMAND]);
+            return;
+        }
+        uint32_t airtime = LoRa::timeOnAir(length, _explicitHeader);
+        Airtime::record(airtime);
+        RadioStats::recordTx(buffer[HEADER_COMMAND], length, airtime);
+
+        TxFrame& frame = _txFrames[_nTx];
+        memcpy(frame.buffer, buffer, length);
+        frame.length = length;
+        frame.explicitHeader = _explicitHeader;
+        Core::Time t = Core::time();
+        _tTxEnd = (_nTx > 0 && _tTxEnd > t ? _tTxEnd : t) + (airtime + 999) / 1000;
+        _nTx++;
+        if (_nTx == 1) {
+            // The FIFO is not accessible in sleep mode
+            _txSleeping = _rxEnabled && _wakeInterval > 0 && _sniffState != SniffState::RX;
+            if (_txSleeping) {
+                // A CAD in progress is aborted : run it again as soon as the frames are sent
+                if (_sniffState == SniffState::CAD) {
+                    _tNextSniff = t;
+                }
+                LoRa::setMode(LoRa::Mode::STANDBY);
+                _sniffState = SniffState::SLEEP;
+            }
+            startTx();
+        }
+    }
+
+    // Send the first frame of the queue in its header mode
+    void startTx() {
+        const TxFrame& frame = _txFrames[0];
+        LoRa::setMode(LoRa::Mode::STANDBY);
+        LoRa::setExplicitHeader(frame.explicitHeader);
+        LoRa::startTx(const_cast<uint8_t*>(frame.buffer), frame.length);
+    }
+
+    // Check if the frame on the air is sent, and start the next one. Once they are all sent, the
+    // modem is put back in the state it was receiving with.
+    bool txDone() {
+        if (!LoRa::txDone()) {
+            return false;
+        }
+        bool announce = !_txFrames[0].explicitHeader && _txFrames[0].buffer[HEADER_COMMAND] == CMD_EXPLICIT_FOLLOWS;
+        if (announce) {
+            // The receivers switch to explicit header mode from now
+            _tPending = Core::time() + EXPLICIT_GUARD_DELAY;
+        }
+        _nTx--;
+        memmove(_txFrames, _txFrames + 1, _nTx * sizeof(TxFrame));
+        if (_nTx > 0) {
+            startTx();
+            return false;
+        }
+        applyExplicitHeader();
+        if (_txSleeping) {
+            LoRa::setMode(LoRa::Mode::SLEEP);
+        }
+        return true;
+    }
+
+    // Select continuous (0) or low-power reception with the given index in WAKE_INTERVALS
+    void setWakeInterval(int wakeInterval) {
+        if (wakeInterval < 0 || wakeInterval >= N_WAKE_INTERVALS) {
+            wakeInterval = 0;
+        }
+        _wakeInterval = wakeInterval;
+        if (_rxEnabled) {
+            LoRa::disableRx();
+            startListening();
+        }
+    }
+
+    // Use a preamble which spans the longest wake interval of the modules of the channel
+    void setChannelWakeInterval(int wakeInterval) {
+        if (wakeInterval < 0 || wakeInterval >= N_WAKE_INTERVALS) {
+            wakeInterval = 0;
+        }
+        _channelWakeInterval = wakeInterval;
+        int preambleLength = LoRa::DEFAULT_PREAMBLE_LENGTH;
+        if (_channelWakeInterval > 0) {
+            preambleLength = WAKE_INTERVALS[_channelWakeInterval] * 1000 / LoRa::symbolDuration() + WAKE_PREAMBLE_MARGIN;
+        }
+        bool listening = _rxEnabled && isListening();
+        if (listening) {
+            LoRa::disableRx();
+        }
+        LoRa::setPreambleLength(preambleLength);
+        if (listening) {
+            LoRa::enableRx();
+        }
+    }
+
+    // Check if the receiver is currently able to receive a frame
+    bool isListening() {
+        return _wakeInterval == 0 || _sniffState == SniffState::RX;
+    }
+
+    void startListening() {
+        if (_wakeInterval == 0) {
+            LoRa::enableRx();
+        } else {
+            sniffSleep();
+            _tNextSniff = Core::time();
+        }
+    }
+
+    void sniffSleep() {
+        LoRa::disableRx();
+        LoRa::setMode(LoRa::Mode::SLEEP);
+        _sniffState = SniffState::SLEEP;
+    }
+
+    // Low-power reception state machine, called periodically by commandAvailable()
+    void sniff() {
+        Core::Time t = Core::time();
+        if (_sniffState == SniffState::SLEEP && t >= _tNextSniff) {
+            LoRa::setMode(LoRa::Mode::STANDBY);
+            LoRa::startCAD();
+            _sniffState = SniffState::CAD;
+            _tNextSniff = t + WAKE_INTERVALS[_wakeInterval];
+
+        } else if (_sniffState == SniffState::CAD && LoRa::cadDone()) {
+            if (LoRa::cadDetected()) {
+                // A preamble is on the air : listen until the end of the frame
+                LoRa::enableRx();
+                _sniffState = SniffState::RX;
+                _tSniffRxEnd = t + LoRa::timeOnAir(HEADER_SIZE + MAX_PAYLOAD_SIZE, true) / 1000 + SNIFF_RX_MARGIN;
+            } else {
+                sniffSleep();
+            }
+
+        } else if (_sniffState == SniffState::RX && !_explicitHeader && t >= _tSniffRxEnd) {
+            // False detection or lost frame
+            sniffSleep();
+        }
+    }
+
+    // Switch between fast frames (implicit header) and normal frames (explicit header). The
+    // frames being sent keep their own mode, and the modem follows once they are sent.
+    void setExplicitHeader(bool explicitHeader) {
+        _explicitHeader = explicitHeader;
+        if (_nTx == 0) {
+            applyExplicitHeader();
+        }
+    }
+
+    void applyExplicitHeader() {
+        // The modem configuration must not be changed while receiving
+        bool listening = _rxEnabled && isListening();
+        if (listening) {
+            LoRa::disableRx();
+        }
+        LoRa::setExplicitHeader(_explicitHeader);
+        if (listening) {
+            LoRa::enableRx();
         }
     }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define _SYNC_H_
 
 #include <stdint.h>
+#include <core.h>
 
 namespace Sync {
 
@@ -14,10 +15,57 @@ namespace Sync {
     const uint8_t HEADER_PREAMBLE = 0;
     const uint8_t HEADER_CHANNEL = 1;
     const uint8_t HEADER_COMMAND = 2;
-    const int MAX_PAYLOAD_SIZE = 10;
+    const int MAX_PAYLOAD_SIZE = 16; // Enough for a preset (see presets.h)
+
+    // Follow the frequency of the other modules to compensate for crystal drift
+    const bool AFC_ENABLED = true;
+
+    // Commands without payload (trigger, focus...) are sent as fixed-length frames in
+    // implicit header mode, which is the default receiving mode. Frames with a payload
+    // (settings sync) are announced by a CMD_EXPLICIT_FOLLOWS fast frame, after which
+    // the receivers switch to explicit header mode for a short window. The sender keeps
+    // running its main loop during EXPLICIT_GUARD_DELAY before sending the frame, so the
+    // delay can cover a slow iteration of the receivers (screen refresh, fast frame sent).
+    // Fast frames are never delayed : during this window, they are sent in explicit header
+    // mode, which the whole channel is listening with, and any frame received in this mode
+    // ends the window. The sender then announces its frame again.
+    // Up to SF12, the preamble byte fits in the same symbols as the two other bytes of
+    // the header, so it is kept in fast frames to filter noise at no cost.
+    const int FAST_FRAME_SIZE = HEADER_SIZE;
+    const int EXPLICIT_GUARD_DELAY = 100; // ms
+    const int EXPLICIT_WINDOW_MARGIN = 100; // ms
+
+    // Low-power reception : instead of listening continuously, the receiver sleeps
+    // and wakes up every WAKE_INTERVALS[Context::_wakeInterval] to run a Channel
+    // Activity Detection. Senders use a preamble long enough to span the longest interval
+    // of the channel, Context::_channelWakeInterval, so it is always caught by a CAD. This
+    // setting is sent with CMD_WAKE_INTERVAL at startup and when it is changed, and a
+    // module never sleeps longer than it (see GUI and Dispatch). Even a module in continuous
+    // reception uses this preamble to reach the others. Figures at SF8/125kHz, with a CAD
+    // of 2 symbols (~4.1ms at ~11.5mA)
+    // followed by standby (~1.6mA) until the main loop puts the modem back to sleep,
+    // checked by tools/silver_sim/scenarios/wake.sim :
+    //   interval   preamble   latency   CAD duty   awake duty   mean RX current
+    //   250ms      130 sym    ~316ms    1.64%      4.0%         ~230uA
+    //   500ms      252 sym    ~560ms    0.82%      2.0%         ~115uA
+    //   1s         496 sym    ~1.07s    0.41%      1.0%         ~57uA
+    //   2s         984 sym    ~2.06s    0.20%      0.5%         ~28uA
+    // (compared to ~11.5mA in continuous reception). The long preamble also counts
+    // against the duty-cycle budget of the sender for every frame.
+    const int N_WAKE_INTERVALS = 5;
+    const unsigned int WAKE_INTERVALS[N_WAKE_INTERVALS] = {0, 250, 500, 1000, 2000}; // ms, 0 : continuous
+    const int WAKE_PREAMBLE_MARGIN = 8; // symbols
+    const int SNIFF_RX_MARGIN = 50; // ms
 
     const uint8_t CMD_GET_GUI_STATE = 0x80;
     const uint8_t CMD_GET_GUI_UPDATE = 0x81;
+    const uint8_t CMD_GET_RADIO_STATS = 0x82;
+    const uint8_t CMD_GET_PRESETS = 0x83; // USB : VERSION, N_PRESETS, then the name and the packed preset of each one
+    const uint8_t CMD_RECALL_PRESET = 0x84; // USB : index
+    const uint8_t CMD_STORE_PRESET = 0x85; // USB : index, then an optional name
+    const uint8_t CMD_SET_PASSTHROUGH = 0x86; // USB : delay and minimum duration of the input passthrough pulses, in us (BE32)
+    const uint8_t CMD_GET_PROFILE = 0x87; // USB : cycle counts of the main loop sections (see Profiler::serialize())
+    const uint8_t CMD_PRESET = 0x10; // Radio : preset recalled on another module (see Presets::encodeFrame())
     const uint8_t CMD_FOCUS = 0x90;
     const uint8_t CMD_FOCUS_HOLD = 0x91;
     const uint8_t CMD_FOCUS_RELEASE = 0x92;
@@ -25,14 +73,20 @@ namespace Sync {
     const uint8_t CMD_TRIGGER_NO_DELAY = 0x94;
     const uint8_t CMD_TRIGGER_HOLD = 0x95;
     const uint8_t CMD_TRIGGER_RELEASE = 0x96;
+    const uint8_t CMD_EXPLICIT_FOLLOWS = 0xA0;
+    const uint8_t CMD_WAKE_INTERVAL = 0xB0; // Radio : + wake interval of the channel (index in WAKE_INTERVALS)
 
 
     bool init();
     bool commandAvailable();
     uint8_t getCommand();
     int getRSSI();
+    uint32_t getRxTimestamp();
     int getPayload(uint8_t* buffer);
-    void send(uint8_t command, uint8_t* payload=nullptr, int payloadSize=0);
+    bool send(uint8_t command, uint8_t* payload=nullptr, int payloadSize=0);
+    bool sendKeepalive(uint8_t command);
+    bool sendWakeInterval();
+    Core::Time txEnd();
 
 }
 
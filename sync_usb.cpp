@@ -1,22 +1,48 @@
 #include "sync_usb.h"
 #include "sync.h"
+#include "schema.h"
+#include "presets.h"
 #include "context.h"
+#include "radio_stats.h"
+#include "profiler.h"
+#include <Queue.h>
 #include <string.h>
 
 namespace SyncUSB {
 
-    enum class Request {
-        FOCUS,
-        TRIGGER,
+    struct Command {
+        uint8_t command;
+        uint8_t payloadSize;
+        uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+    };
+
+    struct Record {
+        uint8_t data[RECORD_MAX_SIZE]; // data[0] is the size of the record
     };
 
     volatile bool _connected = false;
-    bool _commandAvailable = false;
-    Request _command = Request::FOCUS;
-    uint8_t _payload[Sync::MAX_PAYLOAD_SIZE];
-    volatile int _payloadSize = 0;
-    uint8_t _sendingBuffer[Sync::MAX_PAYLOAD_SIZE + 1];
-    volatile int _sendingBufferSize = 0;
+    volatile bool _hostPolling = false;
+
+    // Commands received from the host : produced by the control handler, consumed by the main loop
+    Queue<Command, N_COMMANDS> _commands;
+
+    // GUI updates waiting to be fetched with CMD_GET_GUI_UPDATE : produced by the main loop,
+    // consumed by the control handler
+    Queue<Command, N_UPDATES> _updates;
+
+    // Records waiting to be pushed on the events endpoint : produced by the main loop,
+    // consumed by the IN handler
+    uint8_t _bankEvents[EP_EVENTS_SIZE];
+    USB::Endpoint _epEvents = USB::EP_ERROR;
+    Queue<Record, N_RECORDS> _records;
+
+    // Command popped by commandAvailable(), until it is read by getCommand() or getPayload()
+    Command _current;
+    bool _currentAvailable = false;
+
+    // Internal functions
+    void pushRecord(uint8_t type, uint8_t command, const uint8_t* payload, int payloadSize);
+    int eventsINHandler(int unused);
 
 
     void init() {
@@ -27,48 +53,135 @@ namespace SyncUSB {
         USB::setConnectedHandler(usbConnectedHandler);
         USB::setDisconnectedHandler(usbDisconnectedHandler);
         USB::setControlHandler(usbControlHandler);
+
+        // Interrupt endpoint used to push updates to the host
+        _epEvents = USB::newEndpoint(USB::EPType::INTERRUPT, USB::EPDir::IN, USB::EPBanks::SINGLE, USB::EPSize::SIZE64, _bankEvents);
+        USB::setEndpointHandler(_epEvents, USB::EPHandlerType::IN, eventsINHandler);
     }
 
     bool commandAvailable() {
-        return _commandAvailable;
+        if (!_currentAvailable) {
+            _currentAvailable = _commands.pop(_current);
+        }
+        return _currentAvailable;
     }
 
     uint8_t getCommand() {
-        _commandAvailable = false;
-        return static_cast<uint8_t>(_command);
+        _currentAvailable = false;
+        return _current.command;
     }
 
     int getPayload(uint8_t* buffer) {
-        _commandAvailable = false;
-        memcpy(buffer, _payload, _payloadSize);
-        return _payloadSize;
+        _currentAvailable = false;
+        memcpy(buffer, _current.payload, _current.payloadSize);
+        return _current.payloadSize;
     }
 
+    // Never blocks : if the host does not fetch the updates fast enough, the oldest ones are kept
+    // and the new ones are dropped and counted in nOverflows()
     void send(uint8_t command, uint8_t* payload, int payloadSize) {
-        for (int i = 0; i < 500; i++) {
-            if (_sendingBufferSize == 0) {
-                break;
-            }
-            if (!_connected) {
-                return;
-            }
-            Core::sleep(1);
-        }
         if (payloadSize > Sync::MAX_PAYLOAD_SIZE) {
             payloadSize = Sync::MAX_PAYLOAD_SIZE;
         }
-        _sendingBuffer[0] = command;
-        memcpy(_sendingBuffer + 1, payload, payloadSize);
-        _sendingBufferSize = payloadSize + 1;
+        pushRecord(RECORD_GUI_UPDATE, command, payload, payloadSize);
+
+        // Hosts which only use the events endpoint never fetch the update with CMD_GET_GUI_UPDATE
+        if (!_hostPolling) {
+            return;
+        }
+        Command update;
+        update.command = command;
+        update.payloadSize = payloadSize;
+        if (payloadSize > 0 && payload != nullptr) {
+            memcpy(update.payload, payload, payloadSize);
+        }
+        _updates.push(update);
+    }
+
+    // Push an event record to the host
+    void sendEvent(uint8_t command, int rssi, uint32_t rxTimestamp) {
+        uint8_t payload[] = {
+            static_cast<uint8_t>(static_cast<int8_t>(rssi)),
+            static_cast<uint8_t>(rxTimestamp >> 24),
+            static_cast<uint8_t>(rxTimestamp >> 16),
+            static_cast<uint8_t>(rxTimestamp >> 8),
+            static_cast<uint8_t>(rxTimestamp),
+        };
+        pushRecord(RECORD_EVENT, command, payload, sizeof(payload));
+    }
+
+    // Push an input record to the host
+    void sendInput(uint8_t command, uint32_t timestamp, uint32_t latency) {
+        uint8_t payload[] = {
+            static_cast<uint8_t>(timestamp >> 24),
+            static_cast<uint8_t>(timestamp >> 16),
+            static_cast<uint8_t>(timestamp >> 8),
+            static_cast<uint8_t>(timestamp),
+            static_cast<uint8_t>(latency >> 24),
+            static_cast<uint8_t>(latency >> 16),
+            static_cast<uint8_t>(latency >> 8),
+            static_cast<uint8_t>(latency),
+        };
+        pushRecord(RECORD_INPUT, command, payload, sizeof(payload));
+    }
+
+    // Commands refused because the queue was full, and updates and records dropped
+    unsigned int nOverflows() {
+        return _commands.overflows() + _updates.overflows() + _records.overflows();
+    }
+
+    void pushRecord(uint8_t type, uint8_t command, const uint8_t* payload, int payloadSize) {
+        if (!_connected || _epEvents == USB::EP_ERROR) {
+            return;
+        }
+        if (payloadSize > RECORD_MAX_SIZE - RECORD_HEADER_SIZE) {
+            payloadSize = RECORD_MAX_SIZE - RECORD_HEADER_SIZE;
+        }
+
+        Record record;
+        uint32_t t = Core::time();
+        record.data[0] = RECORD_HEADER_SIZE + payloadSize;
+        record.data[1] = type;
+        record.data[2] = t >> 24;
+        record.data[3] = t >> 16;
+        record.data[4] = t >> 8;
+        record.data[5] = t;
+        record.data[6] = command;
+        if (payloadSize > 0 && payload != nullptr) {
+            memcpy(record.data + RECORD_HEADER_SIZE, payload, payloadSize);
+        }
+        if (_records.push(record)) {
+            USB::enableINInterrupt(_epEvents);
+        }
+    }
+
+    // Called when the events endpoint bank is ready to be filled : pack as many whole records as possible
+    int eventsINHandler(int unused) {
+        int size = 0;
+        while (!_records.isEmpty() && size + _records.front().data[0] <= EP_EVENTS_SIZE) {
+            memcpy(_bankEvents + size, _records.front().data, _records.front().data[0]);
+            size += _records.front().data[0];
+            _records.pop();
+        }
+        if (_records.isEmpty()) {
+            // Stop sending empty packets, unless a record was pushed in the meantime
+            USB::disableINInterrupt(_epEvents);
+            if (!_records.isEmpty()) {
+                USB::enableINInterrupt(_epEvents);
+            }
+        }
+        return size;
     }
 
     bool isConnected() {
         return _connected;
     }
 
+    // Called from the USB interrupt : only the queues consumed in interrupt context can be cleared here
     void resetState() {
-        _sendingBufferSize = 0;
-        _commandAvailable = false;
+        _hostPolling = false;
+        _updates.clear();
+        _records.clear();
     }
 
     void usbConnectedHandler() {
@@ -83,59 +196,72 @@ namespace SyncUSB {
 
     // Handler called when a CONTROL packet is sent over USB
     int usbControlHandler(USB::SetupPacket &lastSetupPacket, uint8_t* data, int size) {
-        // Get command
-        _command = static_cast<Request>(lastSetupPacket.bRequest);
-
         if (lastSetupPacket.direction == USB::EPDir::OUT) {
-            // Get payload
-            _payloadSize = size;
-            if (_payloadSize > Sync::MAX_PAYLOAD_SIZE) {
-                _payloadSize = Sync::MAX_PAYLOAD_SIZE;
+            // Queue the command and its payload for the main loop. If the queue is full, the
+            // request is stalled rather than acknowledged, so the host knows it must send it again.
+            Command command;
+            command.command = lastSetupPacket.bRequest;
+            command.payloadSize = size;
+            if (size > Sync::MAX_PAYLOAD_SIZE) {
+                command.payloadSize = Sync::MAX_PAYLOAD_SIZE;
             }
-            memcpy(_payload, data, _payloadSize);
-
-            _commandAvailable = true;
-            lastSetupPacket.handled = true;
+            memcpy(command.payload, data, command.payloadSize);
+            lastSetupPacket.handled = _commands.push(command);
         } else { // IN
             if (lastSetupPacket.bRequest == Sync::CMD_GET_GUI_STATE) {
                 lastSetupPacket.handled = true;
-                uint8_t buffer[] = {
-                    static_cast<uint8_t>(Context::_submenuFocusHold),
-                    static_cast<uint8_t>(Context::_submenuTriggerHold),
-                    static_cast<uint8_t>(Context::_triggerSync),
-                    static_cast<uint8_t>(Context::_delayMs / 100 >> 16),
-                    static_cast<uint8_t>(Context::_delayMs / 100 >> 8),
-                    static_cast<uint8_t>(Context::_delayMs / 100),
-                    static_cast<uint8_t>(Context::_delaySync),
-                    static_cast<uint8_t>(Context::_intervalNShots),
-                    static_cast<uint8_t>(Context::_intervalDelayMs / 100 >> 16),
-                    static_cast<uint8_t>(Context::_intervalDelayMs / 100 >> 8),
-                    static_cast<uint8_t>(Context::_intervalDelayMs / 100),
-                    static_cast<uint8_t>(Context::_intervalSync),
-                    static_cast<uint8_t>(Context::_inputMode),
-                    static_cast<uint8_t>(Context::_inputSync),
-                    static_cast<uint8_t>(Context::_syncChannel),
-                    static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100 >> 16),
-                    static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100 >> 8),
-                    static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100),
-                    static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100 >> 16),
-                    static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100 >> 8),
-                    static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100),
-                    static_cast<uint8_t>(Context::_timingsSync)
-                };
-                int payloadSize = sizeof(buffer);
+                return Schema::encodeGUIState(data, size);
+
+            } else if (lastSetupPacket.bRequest == Sync::CMD_GET_PRESETS) {
+                lastSetupPacket.handled = true;
+                uint8_t buffer[2 + Presets::N_PRESETS * (Presets::NAME_SIZE + Presets::PACKED_SIZE)];
+                int n = 0;
+                buffer[n++] = Presets::VERSION;
+                buffer[n++] = Presets::N_PRESETS;
+                for (int i = 0; i < Presets::N_PRESETS; i++) {
+                    memcpy(buffer + n, Presets::get(i).name, Presets::NAME_SIZE);
+                    n += Presets::NAME_SIZE;
+                    Presets::pack(Presets::get(i), buffer + n);
+                    n += Presets::PACKED_SIZE;
+                }
+                if (size < n) {
+                    n = size;
+                }
+                memcpy(data, buffer, n);
+                return n;
+
+            } else if (lastSetupPacket.bRequest == Sync::CMD_GET_GUI_UPDATE) {
+                lastSetupPacket.handled = true;
+                _hostPolling = true;
+                Command update;
+                if (!_updates.pop(update)) {
+                    return 0;
+                }
+                int payloadSize = update.payloadSize + 1;
                 if (size < payloadSize) {
                     payloadSize = size;
                 }
-                memcpy(data, buffer, payloadSize);
+                data[0] = update.command;
+                memcpy(data + 1, update.payload, payloadSize - 1);
                 return payloadSize;
 
-            } else if (lastSetupPacket.bRequest == Sync::CMD_GET_GUI_UPDATE) {
+            } else if (lastSetupPacket.bRequest == Sync::CMD_GET_RADIO_STATS) {
+                // A non-zero wValue resets the statistics after reading them
                 lastSetupPacket.handled = true;
-                int size = _sendingBufferSize;
-                memcpy(data, _sendingBuffer, size);
-                _sendingBufferSize = 0;
-                return size;
+                int payloadSize = RadioStats::serialize(data, size);
+                if (lastSetupPacket.wValue != 0) {
+                    RadioStats::reset();
+                }
+                return payloadSize;
+
+            } else if (lastSetupPacket.bRequest == Sync::CMD_GET_PROFILE) {
+                // A non-zero wValue resets the profile after reading it
+                lastSetupPacket.handled = true;
+                int payloadSize = Profiler::serialize(data, size);
+                if (lastSetupPacket.wValue != 0) {
+                    Profiler::reset();
+                }
+                return payloadSize;
             }
         }
 
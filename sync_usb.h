@@ -3,6 +3,7 @@
 
 #include <usb.h>
 #include "context.h"
+#include "sync.h"
 
 namespace SyncUSB {
 
@@ -14,11 +15,37 @@ namespace SyncUSB {
 
     const uint8_t REQUEST_START_BOOTLOADER = 0x00;
 
+    // Records pushed to the host on the interrupt IN endpoint (see tools/usb_events.py).
+    // Each packet contains one or more whole records, in big-endian :
+    //  - record size in bytes, including this field (1 byte)
+    //  - record type (1 byte)
+    //  - time (ms, 4 bytes)
+    //  - command (1 byte)
+    //  - payload (up to Sync::MAX_PAYLOAD_SIZE bytes)
+    // A GUI_UPDATE record carries the same command and payload as CMD_GET_GUI_UPDATE. An EVENT
+    // record is sent when a trigger or focus command is received from the radio, with the RSSI
+    // of the packet (dBm, signed, 1 byte) and the time of its RxDone edge (us, 4 bytes) as payload.
+    // An INPUT record is sent when the external input starts a trigger, with the command it
+    // produced, the time of the edge (us, 4 bytes) and the delay until the main loop handled it
+    // (us, 4 bytes). Microsecond times come from Timestamp and wrap around every ~71 minutes.
+    const uint8_t RECORD_GUI_UPDATE = 0x01;
+    const uint8_t RECORD_EVENT = 0x02;
+    const uint8_t RECORD_INPUT = 0x03;
+    const int RECORD_HEADER_SIZE = 7;
+    const int RECORD_MAX_SIZE = RECORD_HEADER_SIZE + Sync::MAX_PAYLOAD_SIZE;
+    const int EP_EVENTS_SIZE = 64;
+    const int N_RECORDS = 8; // Must be a power of two
+    const int N_COMMANDS = 8; // Must be a power of two
+    const int N_UPDATES = 4; // Must be a power of two
+
     void init();
     bool commandAvailable();
     uint8_t getCommand();
     int getPayload(uint8_t* buffer);
     void send(uint8_t command, uint8_t* payload=nullptr, int payloadSize=0);
+    void sendEvent(uint8_t command, int rssi, uint32_t rxTimestamp);
+    void sendInput(uint8_t command, uint32_t timestamp, uint32_t latency);
+    unsigned int nOverflows();
     bool isConnected();
     void usbConnectedHandler();
     void usbDisconnectedHandler();
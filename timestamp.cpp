@@ -0,0 +1,93 @@
+#include "timestamp.h"
+#include <core.h>
+
+namespace Timestamp {
+
+    const Core::Interrupt INTERRUPT = static_cast<Core::Interrupt>(static_cast<int>(Core::Interrupt::TC00) + COUNTER.tc * TC::N_COUNTERS_PER_TC + COUNTER.n);
+
+    volatile uint32_t _overflows = 0;
+    unsigned long _frequency = 0;
+
+    // Last edge captured on each source, until it is read by captured()
+    volatile Counts _captures[N_SOURCES];
+    volatile bool _captured[N_SOURCES] = {false};
+
+    // Internal functions
+    void overflowHandler();
+    void rxDoneHandler();
+    void inputHandler();
+
+    void (*const CAPTURE_HANDLERS[N_SOURCES])() = {
+        rxDoneHandler,
+        inputHandler,
+    };
+
+
+    void init() {
+        TC::enableFreeRunningCounter(COUNTER, overflowHandler);
+        _frequency = TC::sourceClockFrequency(COUNTER);
+    }
+
+    // Safe to call from any context, including with interrupts disabled
+    Counts now() {
+        uint32_t overflows = 0;
+        uint16_t value = 0;
+        bool pending = false;
+        do {
+            overflows = _overflows;
+            value = TC::counterValue(COUNTER);
+            pending = Core::isInterruptPending(INTERRUPT);
+        } while (overflows != _overflows);
+        return extend(overflows, value, pending);
+    }
+
+    unsigned long frequency() {
+        return _frequency;
+    }
+
+    uint64_t toMicroseconds(Counts counts) {
+        return toMicroseconds(counts, _frequency);
+    }
+
+    // Timestamp the edges of the given pin, which must already be configured as an input
+    void enableCapture(Source source, const GPIO::Pin& pin, GPIO::Trigger trigger) {
+        _captured[static_cast<int>(source)] = false;
+        GPIO::enableInterrupt(pin, CAPTURE_HANDLERS[static_cast<int>(source)], trigger);
+    }
+
+    void disableCapture(Source source, const GPIO::Pin& pin) {
+        GPIO::disableInterrupt(pin);
+        _captured[static_cast<int>(source)] = false;
+    }
+
+    // Get the timestamp of the last edge captured on this source since the previous call, if any
+    bool captured(Source source, Counts& counts) {
+        int i = static_cast<int>(source);
+        Core::disableInterrupts();
+        bool available = _captured[i];
+        counts = _captures[i];
+        _captured[i] = false;
+        Core::enableInterrupts();
+        return available;
+    }
+
+    void overflowHandler() {
+        _overflows = _overflows + 1;
+    }
+
+    // Timestamp an edge now, from the interrupt handler of its pin
+    void capture(Source source) {
+        int i = static_cast<int>(source);
+        _captures[i] = now();
+        _captured[i] = true;
+    }
+
+    void rxDoneHandler() {
+        capture(Source::RX_DONE);
+    }
+
+    void inputHandler() {
+        capture(Source::INPUT);
+    }
+
+}
@@ -0,0 +1,62 @@
+#ifndef _TIMESTAMP_H_
+#define _TIMESTAMP_H_
+
+#include <stdint.h>
+#include <gpio.h>
+#include <tc.h>
+
+// High-resolution timestamps for the sync-critical paths. Core::time() is cheap but only has a
+// resolution of one AST tick (~61us) rounded to milliseconds, which is not enough to measure the
+// trigger latency between modules. A TC counter runs freely at PBA/8 (0.67us at 12MHz) and its
+// overflows are counted in software to extend it to 64 bits.
+// Edges on selected pins can be captured from their GPIO interrupt : the TC interrupt has a higher
+// priority than the GPIO one, so the overflow count is always up to date in the capture handler.
+// A module which already handles the interrupt of a pin can call capture() from its own handler.
+namespace Timestamp {
+
+    using Counts = uint64_t;
+
+    const TC::Counter COUNTER = TC::TC0_0;
+    const int COUNTER_BITS = 16;
+    const uint32_t COUNTER_MAX = (1 << COUNTER_BITS) - 1;
+
+    // Edges which can be captured
+    enum class Source {
+        RX_DONE,
+        INPUT,
+    };
+    const int N_SOURCES = 2;
+
+    void init();
+    Counts now();
+    unsigned long frequency();
+    uint64_t toMicroseconds(Counts counts);
+    void enableCapture(Source source, const GPIO::Pin& pin, GPIO::Trigger trigger);
+    void disableCapture(Source source, const GPIO::Pin& pin);
+    void capture(Source source);
+    bool captured(Source source, Counts& counts);
+
+    // Extend a counter value with the number of overflows already counted. If the counter has
+    // wrapped around but the overflow interrupt is still pending, the value read is necessarily
+    // small, whereas a large value means that it was read just before the overflow.
+    inline Counts extend(uint32_t overflows, uint16_t value, bool overflowPending) {
+        if (overflowPending && value <= COUNTER_MAX / 2) {
+            overflows++;
+        }
+        return (Counts)overflows << COUNTER_BITS | value;
+    }
+
+    // Split the conversion to avoid overflowing 64 bits for large counts
+    inline uint64_t toMicroseconds(Counts counts, unsigned long frequency) {
+        return (counts / frequency) * 1000000 + (counts % frequency) * 1000000 / frequency;
+    }
+
+    // Elapsed microseconds between two timestamps truncated to 32 bits (as sent over USB),
+    // correct across the wrap-around as long as they are less than ~71 minutes apart
+    inline uint32_t elapsedMicroseconds(uint32_t from, uint32_t to) {
+        return to - from;
+    }
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <deque>
+#include <core.h>
+#include "airtime.h"
+
+// Host check of the radio duty-cycle accounting (airtime.h) with a virtual clock, under synthetic
+// traffic : triggers, settings and hold keepalives are sent as the firmware would, and the airtime
+// accounted by the module is compared with the exact airtime of the sliding hour. The airtime
+// actually sent must never exceed the budget over any hour, frames other than triggers must leave
+// the trigger reserve untouched, and the keepalives paced by keepaliveDelay() must keep a remote
+// hold alive as long as the budget allows them.
+
+namespace Core {
+    Time _time = 0;
+}
+
+using Time = Core::Time;
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld) at %.3fs\n", what, value, Core::_time / 1000.0);
+        }
+    }
+}
+
+// Airtime of the frames of Sync at SF8/125kHz/CR4-8 (see tools/lora_check), in us
+const uint32_t FAST_FRAME = 57856;
+const uint32_t SETTINGS_FRAME = FAST_FRAME + 139776; // Announce, then the largest payload
+const uint32_t WAKE_FAST_FRAME = 2056704; // With the preamble of a 2s wake interval (see sync.h)
+
+// Hold keepalives, as in silver.cpp
+const unsigned long KEEPALIVE = 500; // ms
+const unsigned long KEEPALIVE_MAX = 2500; // ms
+const unsigned long HOLD_TIMEOUT = 3000; // ms
+
+// Frames actually sent
+struct Sent {
+    Time t;
+    uint32_t airtime;
+};
+std::deque<Sent> _sent;
+long _nSent[3] = {0};
+long _nDenied[3] = {0};
+
+// Exact airtime sent during the given duration before now
+uint64_t sentDuring(Time duration) {
+    uint64_t total = 0;
+    for (const Sent& s : _sent) {
+        if (s.t + duration > Core::_time) {
+            total += s.airtime;
+        }
+    }
+    return total;
+}
+
+void checkAccounting() {
+    while (!_sent.empty() && _sent.front().t + Airtime::WINDOW + Airtime::SLOT_DURATION <= Core::_time) {
+        _sent.pop_front();
+    }
+    uint64_t hour = sentDuring(Airtime::WINDOW);
+    uint32_t used = Airtime::used();
+
+    // The slots may count up to one slot of traffic older than the window, never less than the window
+    check(used >= hour, "airtime of the last hour missed", hour - used);
+    check(used <= sentDuring(Airtime::WINDOW + Airtime::SLOT_DURATION), "airtime older than the window counted", used);
+    check(hour <= Airtime::BUDGET, "duty-cycle budget exceeded", hour);
+    check(Airtime::remaining() == (used >= Airtime::BUDGET ? 0 : Airtime::BUDGET - used), "remaining airtime", Airtime::remaining());
+}
+
+// Send a frame as Sync::send() does
+bool send(uint32_t airtime, Airtime::Priority priority) {
+    uint32_t remaining = Airtime::remaining();
+    bool allowed = Airtime::allowed(airtime, priority);
+    uint32_t available = priority == Airtime::Priority::TRIGGER ? remaining
+        : remaining > Airtime::TRIGGER_RESERVE ? remaining - Airtime::TRIGGER_RESERVE : 0;
+    check(allowed == (airtime <= available), "admission", airtime);
+    int p = static_cast<int>(priority);
+    if (!allowed) {
+        _nDenied[p]++;
+        return false;
+    }
+    Airtime::record(airtime);
+    _sent.push_back({Core::_time, airtime});
+    _nSent[p]++;
+    return true;
+}
+
+void checkKeepaliveDelay() {
+    // Bounds and monotonicity over the whole range of the remaining airtime
+    unsigned long last = 0;
+    for (uint32_t r = Airtime::BUDGET; ; r -= r >= 1000 ? 1000 : r) {
+        // Only used() is injected : fill the slots of a fresh window through record()
+        Core::_time += Airtime::WINDOW + Airtime::SLOT_DURATION;
+        _sent.clear();
+        Airtime::record(Airtime::BUDGET - r);
+        unsigned long delay = Airtime::keepaliveDelay(KEEPALIVE, KEEPALIVE_MAX);
+        check(delay >= KEEPALIVE && delay <= KEEPALIVE_MAX, "keepalive delay out of bounds", delay);
+        check(delay >= last, "keepalive delay decreases with the budget", delay);
+        if (r >= Airtime::THROTTLE_THRESHOLD) {
+            check(delay == KEEPALIVE, "keepalive delay above the throttle threshold", delay);
+        } else if (r <= Airtime::TRIGGER_RESERVE) {
+            check(delay == KEEPALIVE_MAX, "keepalive delay under the trigger reserve", delay);
+        } else {
+            // Linear between the two, rounded down
+            double expected = KEEPALIVE + (double)(KEEPALIVE_MAX - KEEPALIVE) * (Airtime::THROTTLE_THRESHOLD - r)
+                / (Airtime::THROTTLE_THRESHOLD - Airtime::TRIGGER_RESERVE);
+            check(delay + 2 > expected && delay <= expected, "keepalive delay interpolation", delay);
+        }
+        last = delay;
+        if (r == 0) {
+            break;
+        }
+    }
+    Core::_time += Airtime::WINDOW + Airtime::SLOT_DURATION;
+    _sent.clear();
+}
+
+// A hold is kept for the given duration while other traffic is sent, and the keepalives are paced
+// like in the main loop of silver.cpp, which runs every 10ms. The receiver would release the hold
+// after HOLD_TIMEOUT without a frame.
+void hold(Time duration, uint32_t keepaliveAirtime, int settingsPerMinute, int triggersPerMinute) {
+    const Time LOOP = 10;
+    Time tStart = Core::_time;
+    Time tKeepalive = Core::_time;
+    Time tLastReceived = Core::_time;
+    bool denied = false;
+    send(keepaliveAirtime, Airtime::Priority::TRIGGER); // The hold command itself
+    while (Core::_time < tStart + duration) {
+        Core::_time += LOOP;
+        if (rand() % (60000 / LOOP) < (unsigned) settingsPerMinute) {
+            send(SETTINGS_FRAME, Airtime::Priority::SETTINGS);
+        }
+        if (rand() % (60000 / LOOP) < (unsigned) triggersPerMinute) {
+            uint32_t remaining = Airtime::remaining();
+            bool sent = send(FAST_FRAME, Airtime::Priority::TRIGGER);
+            check(sent || remaining < FAST_FRAME, "trigger denied", remaining);
+            check(sent || _nSent[static_cast<int>(Airtime::Priority::TRIGGER)] > 0, "trigger reserve used by other frames", remaining);
+        }
+        unsigned long delay = Airtime::keepaliveDelay(KEEPALIVE, KEEPALIVE_MAX);
+        if (Core::_time >= tKeepalive + delay) {
+            uint32_t remaining = Airtime::remaining();
+            if (send(keepaliveAirtime, Airtime::Priority::KEEPALIVE)) {
+                tLastReceived = Core::_time;
+                denied = false;
+            } else {
+                // Only denied when the frame would eat into the trigger reserve
+                check(remaining < Airtime::TRIGGER_RESERVE + keepaliveAirtime, "keepalive denied", remaining);
+                denied = true;
+            }
+            tKeepalive = Core::_time;
+        }
+        // The hold only times out on the receiver after a keepalive was denied
+        if (Core::_time >= tLastReceived + HOLD_TIMEOUT) {
+            check(denied, "remote hold timed out", Core::_time - tLastReceived);
+            tLastReceived = Core::_time;
+        }
+        checkAccounting();
+    }
+}
+
+int main() {
+    srand(0);
+
+    checkKeepaliveDelay();
+
+    // Random traffic, with idle periods which let the window slide past whole slots and past the
+    // whole window
+    for (long step = 0; step < 200000; step++) {
+        int r = rand() % 100;
+        if (r < 2) {
+            Core::_time += Airtime::WINDOW + rand() % Airtime::WINDOW;
+        } else if (r < 10) {
+            Core::_time += rand() % (2 * Airtime::SLOT_DURATION);
+        } else {
+            Core::_time += rand() % 2000;
+        }
+        int kind = rand() % 10;
+        if (kind < 4) {
+            send(rand() % 8 == 0 ? WAKE_FAST_FRAME : FAST_FRAME, Airtime::Priority::TRIGGER);
+        } else if (kind < 7) {
+            send(SETTINGS_FRAME, Airtime::Priority::SETTINGS);
+        } else {
+            send(rand() % 8 == 0 ? WAKE_FAST_FRAME : FAST_FRAME, Airtime::Priority::KEEPALIVE);
+        }
+        checkAccounting();
+    }
+
+    // Long holds : with fast frames, the keepalives alone use ~11.6% at the nominal pace, so they
+    // are throttled then denied, while the triggers keep their reserve. With the preamble of the
+    // low-power reception, the budget runs out within a few minutes.
+    Core::_time += 2 * Airtime::WINDOW;
+    hold(3 * Airtime::WINDOW, FAST_FRAME, 2, 1);
+    Core::_time += 2 * Airtime::WINDOW;
+    hold(Airtime::WINDOW, WAKE_FAST_FRAME, 0, 2);
+    Core::_time += 2 * Airtime::WINDOW;
+    hold(Airtime::WINDOW / 4, FAST_FRAME, 0, 0);
+
+    printf("sent %ld triggers (%ld denied), %ld settings (%ld denied), %ld keepalives (%ld denied)\n",
+        _nSent[0], _nDenied[0], _nSent[1], _nDenied[1], _nSent[2], _nDenied[2]);
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef _CORE_H_
+#define _CORE_H_
+
+// Minimal replacement of libtungsten/sam4l/core.h : the time is set by the check
+namespace Core {
+
+    using Time = unsigned long long;
+
+    extern Time _time;
+    inline Time time() { return _time; }
+
+}
+
+#endif
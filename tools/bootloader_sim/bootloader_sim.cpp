@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "flash.h"
+#include "upload.h"
+#include "lz_compress.h"
+
+// Host simulation of a firmware upload through the bootloader over USB, to measure the end-to-end
+// throughput of the binary protocol (libtungsten/bootloader/upload.cpp, compiled as is against a
+// simulated flash) and compare it with the legacy Intel HEX protocol, with and without compression.
+// Usage : bootloader_sim [options] [FIRMWARE.hex|FIRMWARE.bin]
+//   --size N           use N bytes of generated data instead of a firmware file (default 100000)
+//   --random           generate random data, which doesn't compress, instead of code-like data
+//   --erase US         page erase time (default 4500)
+//   --program US       page program time (default 4500)
+//   --transfer US      duration of a control transfer, without its data stage (default 1000)
+//   --byte NS          duration of each byte in a data stage (default 700)
+//   --base FILE        firmware already in flash before the upload, for the differential upload
+//                      (default with generated data : the same image with a few pages modified,
+//                      and only these pages must be sent and programmed)
+//   --erased           start from an erased flash instead of the default base
+//   --isr-in-ram       assume the USB handler runs from RAM, so it isn't stalled while the flash is busy
+
+// Must match bootloader.cpp. N_RESERVED_FLASH_PAGES is taken from the Makefile of the bootloader.
+const int BOOTLOADER_N_FLASH_PAGES = 32;
+const int N_USER_FLASH_PAGES = Flash::FLASH_PAGES - N_RESERVED_FLASH_PAGES;
+const uint32_t IMAGE_BASE = BOOTLOADER_N_FLASH_PAGES * Flash::FLASH_PAGE_SIZE_BYTES;
+const int HEX_BYTES_PER_LINE = 16;
+const int HEX_LINE_SIZE = 1 + 2 + 4 + 2 + 2 * HEX_BYTES_PER_LINE + 2;
+const int FINISH_PAYLOAD_SIZE = 8;
+const int STATUS_SIZE = 4;
+const int MAX_HASHES_PER_REQUEST = 128; // 512 bytes, the size of the control endpoint bank
+
+const uint64_t TICK = 5; // us
+
+unsigned int _transferTime = 1000;
+unsigned int _byteTime = 700;
+unsigned int _crcTime = 2000; // ns per byte, nibble-table CRC-32 at 12MHz
+unsigned int _hashTime = 150; // us per page, FNV-1a at 12MHz
+bool _isrInRam = false;
+std::vector<int> _pagesSent; // By the last simulateBinary()
+
+// Pages of the generated image modified in the default base
+const int MODIFIED_PAGES[] = {2, 3, 150};
+
+struct Stats {
+    uint64_t time; // us
+    int nTransfers;
+    int nStalls;
+    int nPagesSent;
+    int nPagesWritten;
+    int nBytesSent; // Page data or compressed chunks
+};
+
+uint64_t transferDuration(int dataSize) {
+    return _transferTime + (uint64_t)dataSize * _byteTime / 1000;
+}
+
+// The USB handler runs from flash : it can't execute while an erase or program command is running
+bool handlerCanRun() {
+    return _isrInRam || Flash::isReady();
+}
+
+// Erase the simulated flash, then put the base image (the firmware currently installed) in it
+void resetFlash(const std::vector<uint8_t>& base) {
+    Flash::_now = 0;
+    Flash::_readyAt = 0;
+    Flash::_nErases = 0;
+    Flash::_nPrograms = 0;
+    memset(Flash::memory(), 0xFF, Flash::FLASH_PAGES * Flash::FLASH_PAGE_SIZE_BYTES);
+    memcpy(Flash::memory() + IMAGE_BASE, base.data(), base.size());
+    Flash::writeFuse(Flash::FUSE_BOOTLOADER_FW_READY, false);
+    Flash::_readyAt = 0;
+}
+
+// Legacy protocol : one control transfer per Intel HEX line followed by a GET_STATUS poll,
+// each page being erased and programmed synchronously (unless it is unchanged) when the first
+// line of the next one arrives
+Stats simulateHex(const std::vector<uint8_t>& image, const std::vector<uint8_t>& base) {
+    Stats stats = {0, 0, 0, 0, 0, 0};
+    resetFlash(base);
+    int nLines = (image.size() + HEX_BYTES_PER_LINE - 1) / HEX_BYTES_PER_LINE + 1; // + End Of File
+    int linesPerPage = Flash::FLASH_PAGE_SIZE_BYTES / HEX_BYTES_PER_LINE;
+    uint64_t t = 0;
+    for (int line = 0; line < nLines; line++) {
+        // Send the line
+        t += transferDuration(HEX_LINE_SIZE);
+        stats.nTransfers++;
+
+        // The main loop writes the previous page when a new one starts, and the last one at End Of File
+        if ((line > 0 && line % linesPerPage == 0) || line == nLines - 1) {
+            int index = (line - 1) / linesPerPage;
+            uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+            memset(page, 0, sizeof(page)); // The legacy path fills the page buffer with 0
+            memcpy(page, image.data() + index * Flash::FLASH_PAGE_SIZE_BYTES, std::min((size_t)Flash::FLASH_PAGE_SIZE_BYTES, image.size() - index * Flash::FLASH_PAGE_SIZE_BYTES));
+            stats.nPagesSent++;
+            stats.nBytesSent += Flash::FLASH_PAGE_SIZE_BYTES;
+            if (!Upload::isPageUnchanged(BOOTLOADER_N_FLASH_PAGES + index, page)) {
+                t += Flash::_eraseTime + Flash::_programTime;
+                stats.nPagesWritten++;
+            }
+        }
+
+        // Poll the status until READY ; the answer is delayed until the flash is ready again
+        t += transferDuration(1);
+        stats.nTransfers++;
+    }
+    t += Flash::_fuseTime;
+    stats.time = t;
+    return stats;
+}
+
+// Binary protocol, see bootloader.cpp : in differential mode the host first reads the hashes
+// of the pages currently in flash and only sends those which differ. It sends a page whenever
+// the last GET_STATUS reported a free buffer, then FINISH with the CRC-32 of the image, then
+// polls until DONE. In compressed mode, each run of consecutive pages to send is compressed
+// as one stream, sent in chunks whenever the last GET_STATUS reported the chunk buffer free,
+// unless the stream is not smaller than the pages, which are then sent as is (see upload.py).
+Stats simulateBinary(const std::vector<uint8_t>& image, const std::vector<uint8_t>& base, bool differential, bool compressed, bool& success) {
+    enum class Op { NONE, GET_PAGE_HASHES, WRITE_PAGE, WRITE_COMPRESSED, GET_STATUS, FINISH };
+    Stats stats = {0, 0, 0, 0, 0, 0};
+    resetFlash(base);
+    Upload::init(BOOTLOADER_N_FLASH_PAGES, N_USER_FLASH_PAGES - 1);
+
+    int nPages = (image.size() + Flash::FLASH_PAGE_SIZE_BYTES - 1) / Flash::FLASH_PAGE_SIZE_BYTES;
+    std::vector<std::vector<uint32_t>> pages(nPages, std::vector<uint32_t>(Flash::FLASH_PAGE_SIZE_WORDS));
+    uint32_t crc = 0;
+    for (int i = 0; i < nPages; i++) {
+        uint8_t* page = reinterpret_cast<uint8_t*>(pages[i].data());
+        memset(page, 0xFF, Flash::FLASH_PAGE_SIZE_BYTES);
+        memcpy(page, image.data() + i * Flash::FLASH_PAGE_SIZE_BYTES, std::min((size_t)Flash::FLASH_PAGE_SIZE_BYTES, image.size() - i * Flash::FLASH_PAGE_SIZE_BYTES));
+        crc = Upload::crc32(crc, page, Flash::FLASH_PAGE_SIZE_BYTES);
+    }
+
+    // Host state
+    std::vector<int> toSend; // Indexes of the pages to send
+    if (!differential) {
+        for (int i = 0; i < nPages; i++) {
+            toSend.push_back(i);
+        }
+    }
+    int nHashesRead = differential ? 0 : nPages;
+    unsigned int nextPage = 0;
+    unsigned int rawEnd = compressed ? 0 : nPages; // The pages before this one in toSend are sent as is
+    int credits = Upload::N_BUFFERS;
+    bool chunkFree = true;
+    std::vector<std::vector<uint8_t>> chunks; // Compressed chunks of the current run
+    int firstPage = 0; // First page of the current run
+    unsigned int nextChunk = 0;
+    bool finishSent = false;
+    Op op = Op::NONE;
+    uint64_t opDone = 0;
+
+    // Device state
+    bool finishRequested = false;
+    uint64_t doneAt = 0; // When the CRC check is finished
+    bool done = false;
+
+    for (uint64_t t = 0; ; t += TICK) {
+        Flash::_now = t;
+
+        // End of the data stage of the current transfer : call the handler as soon as it can run
+        if (op != Op::NONE && t >= opDone && handlerCanRun()) {
+            if (op == Op::GET_PAGE_HASHES) {
+                uint8_t hashes[MAX_HASHES_PER_REQUEST * 4];
+                int n = std::min(MAX_HASHES_PER_REQUEST, nPages - nHashesRead);
+                Upload::getPageHashes(BOOTLOADER_N_FLASH_PAGES + nHashesRead, hashes, 4 * n);
+                for (int i = 0; i < n; i++) {
+                    uint32_t hash = hashes[4 * i] << 24 | hashes[4 * i + 1] << 16 | hashes[4 * i + 2] << 8 | hashes[4 * i + 3];
+                    if (hash != Upload::pageHash(pages[nHashesRead + i].data())) {
+                        toSend.push_back(nHashesRead + i);
+                    }
+                }
+                nHashesRead += n;
+            } else if (op == Op::WRITE_PAGE) {
+                int index = toSend[nextPage];
+                Upload::Result result = Upload::receivePage(BOOTLOADER_N_FLASH_PAGES + index, reinterpret_cast<uint8_t*>(pages[index].data()), Flash::FLASH_PAGE_SIZE_BYTES);
+                if (result == Upload::Result::OK) {
+                    nextPage++;
+                    credits--;
+                } else if (result == Upload::Result::BUSY) {
+                    stats.nStalls++;
+                    credits = 0;
+                } else {
+                    fprintf(stderr, "Page rejected\n");
+                    exit(1);
+                }
+            } else if (op == Op::WRITE_COMPRESSED) {
+                Upload::Result result = Upload::receiveCompressed(nextChunk, BOOTLOADER_N_FLASH_PAGES + firstPage, chunks[nextChunk].data(), chunks[nextChunk].size());
+                if (result == Upload::Result::OK) {
+                    nextChunk++;
+                } else if (result == Upload::Result::BUSY) {
+                    stats.nStalls++;
+                } else {
+                    fprintf(stderr, "Chunk rejected\n");
+                    exit(1);
+                }
+                chunkFree = false;
+            } else if (op == Op::GET_STATUS) {
+                credits = Upload::freeBuffers();
+                chunkFree = Upload::canReceiveCompressed();
+                if (finishSent && doneAt > 0 && t >= doneAt) {
+                    done = true;
+                }
+            } else if (op == Op::FINISH) {
+                finishRequested = true;
+                finishSent = true;
+            }
+            op = Op::NONE;
+            if (done) {
+                stats.time = t;
+                break;
+            }
+        }
+
+        // Compress the next run of consecutive pages to send
+        if (op == Op::NONE && compressed && nHashesRead == nPages && nextChunk == chunks.size() && nextPage >= rawEnd && nextPage < toSend.size()) {
+            unsigned int end = nextPage + 1;
+            while (end < toSend.size() && toSend[end] == toSend[end - 1] + 1) {
+                end++;
+            }
+            std::vector<uint8_t> run;
+            for (unsigned int i = nextPage; i < end; i++) {
+                const uint8_t* page = reinterpret_cast<const uint8_t*>(pages[toSend[i]].data());
+                run.insert(run.end(), page, page + Flash::FLASH_PAGE_SIZE_BYTES);
+            }
+            std::vector<uint8_t> stream = LZ::compress(run.data(), run.size());
+            chunks.clear();
+            nextChunk = 0;
+            if (stream.size() < run.size()) {
+                for (size_t i = 0; i < stream.size(); i += Upload::COMPRESSED_CHUNK_SIZE) {
+                    chunks.push_back(std::vector<uint8_t>(stream.begin() + i, stream.begin() + std::min(stream.size(), i + Upload::COMPRESSED_CHUNK_SIZE)));
+                }
+                firstPage = toSend[nextPage];
+                nextPage = end;
+            } else {
+                rawEnd = end;
+            }
+        }
+
+        // Next transfer
+        if (op == Op::NONE) {
+            if (nHashesRead < nPages) {
+                int n = std::min(MAX_HASHES_PER_REQUEST, nPages - nHashesRead);
+                op = Op::GET_PAGE_HASHES;
+                opDone = t + transferDuration(4 * n) + (uint64_t)n * _hashTime;
+            } else if (compressed && nextChunk < chunks.size() && chunkFree) {
+                op = Op::WRITE_COMPRESSED;
+                opDone = t + transferDuration(chunks[nextChunk].size());
+                stats.nBytesSent += chunks[nextChunk].size();
+            } else if (nextPage < rawEnd && nextPage < toSend.size() && credits > 0) {
+                op = Op::WRITE_PAGE;
+                opDone = t + transferDuration(Flash::FLASH_PAGE_SIZE_BYTES);
+                stats.nBytesSent += Flash::FLASH_PAGE_SIZE_BYTES;
+            } else if (nextPage == toSend.size() && nextChunk == chunks.size() && !finishSent) {
+                op = Op::FINISH;
+                opDone = t + transferDuration(FINISH_PAYLOAD_SIZE);
+            } else {
+                op = Op::GET_STATUS;
+                opDone = t + transferDuration(STATUS_SIZE);
+            }
+            stats.nTransfers++;
+        }
+
+        // Device main loop
+        Upload::process();
+        if (finishRequested) {
+            Upload::flush();
+        }
+        if (finishRequested && Upload::isIdle()) {
+            finishRequested = false;
+            success = Upload::checkImageRange(BOOTLOADER_N_FLASH_PAGES, nPages) == Upload::Result::OK
+                    && Upload::flashCRC32(BOOTLOADER_N_FLASH_PAGES, nPages) == crc;
+            doneAt = t + (uint64_t)nPages * Flash::FLASH_PAGE_SIZE_BYTES * _crcTime / 1000;
+            if (success) {
+                Flash::writeFuse(Flash::FUSE_BOOTLOADER_FW_READY, true);
+            }
+        }
+    }
+
+    // Check the flash content, and that FINISH would reject a range reaching into the bootloader or
+    // into the reserved pages, or missing the last page sent, and that the reserved pages can't be written
+    success = success && Flash::getFuse(Flash::FUSE_BOOTLOADER_FW_READY)
+            && memcmp(Flash::memory() + IMAGE_BASE, image.data(), image.size()) == 0
+            && Upload::checkImageRange(0, BOOTLOADER_N_FLASH_PAGES + nPages) == Upload::Result::PROTECTED_AREA
+            && Upload::checkImageRange(BOOTLOADER_N_FLASH_PAGES, N_USER_FLASH_PAGES - BOOTLOADER_N_FLASH_PAGES + 1) == Upload::Result::PROTECTED_AREA
+            && Upload::receivePage(N_USER_FLASH_PAGES, image.data(), 0) == Upload::Result::PROTECTED_AREA
+            && (toSend.empty() || Upload::checkImageRange(BOOTLOADER_N_FLASH_PAGES, toSend.back()) == Upload::Result::INCOMPLETE);
+    stats.nPagesSent = toSend.size();
+    stats.nPagesWritten = Upload::nPagesWritten();
+    _pagesSent = toSend;
+    return stats;
+}
+
+void printStats(const char* title, const Stats& stats, size_t size, uint64_t reference) {
+    printf("%-13s : %8.3f s  %6.1f KB/s  %5.1fx  %6d transfers  %4d pages sent  %7d bytes sent  %4d pages written\n",
+        title, stats.time / 1e6, size / 1024.0 / (stats.time / 1e6), (double)reference / stats.time,
+        stats.nTransfers, stats.nPagesSent, stats.nBytesSent, stats.nPagesWritten);
+}
+
+int parseHexDigits(const std::string& line, int pos, int n) {
+    return strtol(line.substr(pos, n).c_str(), nullptr, 16);
+}
+
+// Load an Intel HEX or raw binary firmware, as the bytes to write from IMAGE_BASE
+bool loadImage(const char* filename, std::vector<uint8_t>& image) {
+    FILE* f = fopen(filename, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> content;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        content.insert(content.end(), buffer, buffer + n);
+    }
+    fclose(f);
+
+    std::string name = filename;
+    if (name.size() < 4 || name.substr(name.size() - 4) != ".hex") {
+        image = content;
+        return true;
+    }
+
+    uint32_t extended = 0;
+    std::string text(content.begin(), content.end());
+    size_t pos = 0;
+    while ((pos = text.find(':', pos)) != std::string::npos) {
+        size_t end = text.find_first_of("\r\n", pos);
+        std::string line = text.substr(pos, end - pos);
+        pos = end;
+        int nBytes = parseHexDigits(line, 1, 2);
+        uint32_t address = parseHexDigits(line, 3, 4);
+        int type = parseHexDigits(line, 7, 2);
+        if (type == 0x00) {
+            address += extended;
+            if (address < IMAGE_BASE) {
+                fprintf(stderr, "The firmware overlaps the bootloader, was it linked for the bootloader?\n");
+                return false;
+            }
+            address -= IMAGE_BASE;
+            if (image.size() < address + nBytes) {
+                image.resize(address + nBytes, 0xFF);
+            }
+            for (int i = 0; i < nBytes; i++) {
+                image[address + i] = parseHexDigits(line, 9 + 2 * i, 2);
+            }
+        } else if (type == 0x02) {
+            extended = parseHexDigits(line, 9, 4) << 4;
+        } else if (type == 0x04) {
+            extended = parseHexDigits(line, 9, 4) << 16;
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::vector<uint8_t> image;
+    std::vector<uint8_t> base;
+    int size = 100000;
+    bool random = false;
+    bool erased = false;
+    const char* filename = nullptr;
+    const char* baseFilename = nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            size = atoi(argv[++i]);
+        } else if (arg == "--erase" && i + 1 < argc) {
+            Flash::_eraseTime = atoi(argv[++i]);
+        } else if (arg == "--program" && i + 1 < argc) {
+            Flash::_programTime = atoi(argv[++i]);
+        } else if (arg == "--transfer" && i + 1 < argc) {
+            _transferTime = atoi(argv[++i]);
+        } else if (arg == "--byte" && i + 1 < argc) {
+            _byteTime = atoi(argv[++i]);
+        } else if (arg == "--base" && i + 1 < argc) {
+            baseFilename = argv[++i];
+        } else if (arg == "--erased") {
+            erased = true;
+        } else if (arg == "--random") {
+            random = true;
+        } else if (arg == "--isr-in-ram") {
+            _isrInRam = true;
+        } else if (arg[0] != '-') {
+            filename = argv[i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (filename != nullptr) {
+        if (!loadImage(filename, image)) {
+            fprintf(stderr, "Unable to load %s\n", filename);
+            return 1;
+        }
+    } else {
+        // Same generated data as lz_check
+        srand(0);
+        image.resize(size);
+        for (size_t i = 0; i < image.size(); i++) {
+            image[i] = random || i % 7 == 0 ? rand() : i / 64;
+        }
+    }
+    if (baseFilename != nullptr && !loadImage(baseFilename, base)) {
+        fprintf(stderr, "Unable to load %s\n", baseFilename);
+        return 1;
+    }
+
+    // Default base of the generated image : a small change of the code, in two consecutive pages
+    // and in a third one further away
+    std::vector<int> modified;
+    if (filename == nullptr && baseFilename == nullptr && !erased) {
+        base = image;
+        for (int page : MODIFIED_PAGES) {
+            size_t offset = (size_t)page * Flash::FLASH_PAGE_SIZE_BYTES + 100;
+            if (offset < base.size()) {
+                base[offset] ^= 0x5A;
+                modified.push_back(page);
+            }
+        }
+    }
+    if (std::max(image.size(), base.size()) > (size_t)(N_USER_FLASH_PAGES - BOOTLOADER_N_FLASH_PAGES) * Flash::FLASH_PAGE_SIZE_BYTES) {
+        fprintf(stderr, "The firmware is too large\n");
+        return 1;
+    }
+
+    printf("Image : %u bytes, erase %uus, program %uus, transfer %uus + %uns/byte%s\n",
+        (unsigned int)image.size(), Flash::_eraseTime, Flash::_programTime, _transferTime, _byteTime,
+        _isrInRam ? ", handler in RAM" : "");
+
+    Stats hex = simulateHex(image, base);
+    printStats("Intel HEX", hex, image.size(), hex.time);
+    bool success = false;
+    Stats binary = simulateBinary(image, base, false, false, success);
+    printStats("Binary", binary, image.size(), hex.time);
+    if (success) {
+        Stats differential = simulateBinary(image, base, true, false, success);
+        printStats("Differential", differential, image.size(), hex.time);
+        if (!modified.empty() && (_pagesSent != modified || differential.nPagesWritten != (int)modified.size())) {
+            fprintf(stderr, "The differential upload didn't send and program only the modified pages\n");
+            return 1;
+        }
+    }
+    if (success) {
+        Stats compressed = simulateBinary(image, base, false, true, success);
+        printStats("Compressed", compressed, image.size(), hex.time);
+        if (compressed.nBytesSent > binary.nBytesSent) {
+            fprintf(stderr, "The compressed upload sent more bytes than the pages\n");
+            return 1;
+        }
+    }
+    if (success) {
+        Stats both = simulateBinary(image, base, true, true, success);
+        printStats("Diff+LZ", both, image.size(), hex.time);
+        if (!modified.empty() && (_pagesSent != modified || both.nPagesWritten != (int)modified.size())) {
+            fprintf(stderr, "The differential upload didn't send and program only the modified pages\n");
+            return 1;
+        }
+    }
+
+    if (!success) {
+        fprintf(stderr, "The simulated flash doesn't contain the expected image\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "flash.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace Flash {
+
+    uint64_t _now = 0;
+    unsigned int _eraseTime = 4500;
+    unsigned int _programTime = 4500;
+    unsigned int _fuseTime = 1000;
+    uint64_t _readyAt = 0;
+    int _nErases = 0;
+    int _nPrograms = 0;
+
+    uint8_t _memory[FLASH_PAGES * FLASH_PAGE_SIZE_BYTES];
+    uint8_t _pageBuffer[FLASH_PAGE_SIZE_BYTES];
+    bool _erased[FLASH_PAGES];
+    uint16_t _fuses = 0xFFFF; // Erased fuses read as 0 (see the real getFuse())
+
+    // Issuing a command while the flash is busy is a bug in the code under test
+    void checkReady(const char* command) {
+        if (!isReady()) {
+            fprintf(stderr, "Flash::%s() called while the flash is busy\n", command);
+            exit(1);
+        }
+    }
+
+    bool isReady() {
+        return _now >= _readyAt;
+    }
+
+    uint32_t read(uint32_t address) {
+        checkReady("read");
+        uint32_t word;
+        memcpy(&word, _memory + address, 4);
+        return word;
+    }
+
+    void readPage(int page, uint32_t data[]) {
+        checkReady("readPage");
+        memcpy(data, _memory + page * FLASH_PAGE_SIZE_BYTES, FLASH_PAGE_SIZE_BYTES);
+    }
+
+    void erasePage(int page) {
+        checkReady("erasePage");
+        memset(_memory + page * FLASH_PAGE_SIZE_BYTES, 0xFF, FLASH_PAGE_SIZE_BYTES);
+        _erased[page] = true;
+        _readyAt = _now + _eraseTime;
+        _nErases++;
+    }
+
+    void programPage(int page, const uint32_t data[]) {
+        checkReady("programPage");
+        if (!_erased[page]) {
+            fprintf(stderr, "Flash::programPage() : page %d was not erased\n", page);
+            exit(1);
+        }
+        memcpy(_memory + page * FLASH_PAGE_SIZE_BYTES, data, FLASH_PAGE_SIZE_BYTES);
+        _erased[page] = false;
+        _readyAt = _now + _programTime;
+        _nPrograms++;
+    }
+
+    void writeFuse(Fuse fuse, bool state) {
+        checkReady("writeFuse");
+        if (state) {
+            _fuses &= ~(1 << fuse);
+        } else {
+            _fuses |= 1 << fuse;
+        }
+        _readyAt = _now + _fuseTime;
+    }
+
+    bool getFuse(Fuse fuse) {
+        return !((_fuses >> fuse) & 0x01);
+    }
+
+    uint8_t* memory() {
+        return _memory;
+    }
+
+}
@@ -0,0 +1,42 @@
+#ifndef _FLASH_H_
+#define _FLASH_H_
+
+#include <stdint.h>
+
+// Simulated replacement of libtungsten/sam4l/flash.h, used to compile the bootloader's
+// upload module on the host. Erase and program commands keep the flash busy for a
+// configurable duration of simulated time.
+namespace Flash {
+
+    const int FLASH_PAGE_SIZE_BYTES = 512; // bytes
+    const int FLASH_PAGE_SIZE_WORDS = 128; // words
+    const int FLASH_PAGES = 512; // pages
+
+    using Fuse = uint8_t;
+    const int N_FUSES = 16;
+    const Fuse FUSE_BOOTLOADER_FW_READY = 0;
+    const Fuse FUSE_BOOTLOADER_FORCE = 1;
+    const Fuse FUSE_BOOTLOADER_SKIP_TIMEOUT = 2;
+
+    // Module API, same as the real one
+    bool isReady();
+    uint32_t read(uint32_t address);
+    void readPage(int page, uint32_t data[]);
+    void erasePage(int page);
+    void programPage(int page, const uint32_t data[]);
+    void writeFuse(Fuse fuse, bool state);
+    bool getFuse(Fuse fuse);
+
+    // Simulation
+    extern uint64_t _now; // us
+    extern unsigned int _eraseTime; // us
+    extern unsigned int _programTime; // us
+    extern unsigned int _fuseTime; // us
+    extern uint64_t _readyAt; // us
+    extern int _nErases;
+    extern int _nPrograms;
+    uint8_t* memory();
+
+}
+
+#endif
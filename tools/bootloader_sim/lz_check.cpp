@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "lz.h"
+#include "lz_compress.h"
+
+// Round-trip check of the firmware compressor against the decompressor of the bootloader
+// Usage : lz_check [FILE]...
+//   Without arguments, check a set of generated inputs ; otherwise, check the given files.
+//   lz_check --decode COMPRESSED ORIGINAL checks a stream produced by another compressor (upload.py).
+
+// Decompress the stream, fed in chunks of inputChunk bytes into an output of outputChunk bytes,
+// as the bootloader does with USB frames and pages
+std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed, int inputChunk, int outputChunk) {
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> buffer(outputChunk);
+    LZ::reset();
+    size_t pos = 0;
+    while (pos < compressed.size() || LZ::hasPendingOutput()) {
+        int inputSize = std::min((size_t)inputChunk, compressed.size() - pos);
+        int consumed = 0;
+        int n = LZ::decompress(compressed.data() + pos, inputSize, consumed, buffer.data(), outputChunk);
+        if (n == 0 && consumed == 0) {
+            break;
+        }
+        pos += consumed;
+        output.insert(output.end(), buffer.begin(), buffer.begin() + n);
+    }
+    return output;
+}
+
+bool check(const char* name, const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> compressed = LZ::compress(data.data(), data.size());
+    const int CHUNKS[][2] = {{512, 512}, {1, 1}, {1, 512}, {512, 1}, {7, 13}, {64, 37}, {100000, 100000}};
+    for (const int* chunk : CHUNKS) {
+        if (decompress(compressed, chunk[0], chunk[1]) != data) {
+            printf("FAIL %-24s with chunks of %d/%d bytes\n", name, chunk[0], chunk[1]);
+            return false;
+        }
+    }
+    printf("ok   %-24s %7u -> %7u bytes (%5.1f%%)\n", name, (unsigned int)data.size(), (unsigned int)compressed.size(),
+        data.empty() ? 100.0 : 100.0 * compressed.size() / data.size());
+    return true;
+}
+
+bool readFile(const char* filename, std::vector<uint8_t>& content) {
+    FILE* f = fopen(filename, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        content.insert(content.end(), buffer, buffer + n);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool success = true;
+
+    if (argc == 4 && strcmp(argv[1], "--decode") == 0) {
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> original;
+        if (!readFile(argv[2], compressed) || !readFile(argv[3], original)) {
+            fprintf(stderr, "Unable to read the files\n");
+            return 1;
+        }
+        success = decompress(compressed, 512, 512) == original && decompress(compressed, 3, 5) == original;
+        printf("%s  %s decodes to %s\n", success ? "ok  " : "FAIL", argv[2], argv[3]);
+        return success ? 0 : 1;
+
+    } else if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            std::vector<uint8_t> data;
+            if (!readFile(argv[i], data)) {
+                fprintf(stderr, "Unable to read %s\n", argv[i]);
+                return 1;
+            }
+            success &= check(argv[i], data);
+        }
+        return success ? 0 : 1;
+    }
+
+    srand(0);
+    std::vector<uint8_t> data;
+    success &= check("empty", data);
+    data.assign(1, 0x42);
+    success &= check("one byte", data);
+    data.assign(100000, 0xFF);
+    success &= check("erased flash", data);
+    data.resize(100000);
+    for (uint8_t& byte : data) {
+        byte = rand();
+    }
+    success &= check("random", data);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (i % 7 == 0 ? rand() : i / 64);
+    }
+    success &= check("structured", data);
+
+    // Matches of every length at every offset up to the window size
+    data.clear();
+    for (int offset = 1; offset <= LZ::WINDOW_SIZE + 1; offset += 97) {
+        for (int length = 1; length <= LZ::MAX_MATCH + 2; length++) {
+            size_t start = data.size();
+            for (int i = 0; i < offset; i++) {
+                data.push_back(rand());
+            }
+            for (int i = 0; i < length; i++) {
+                data.push_back(data[start + i]);
+            }
+        }
+    }
+    success &= check("all offsets and lengths", data);
+
+    // Text-like content with many repetitions
+    data.clear();
+    const char* words[] = {"trigger", "focus", "delay", "interval", "sync", "channel", " ", "\n"};
+    while (data.size() < 50000) {
+        const char* word = words[rand() % 8];
+        data.insert(data.end(), word, word + strlen(word));
+    }
+    success &= check("text", data);
+
+    return success ? 0 : 1;
+}
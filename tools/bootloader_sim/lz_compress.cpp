@@ -0,0 +1,77 @@
+#include "lz_compress.h"
+#include "lz.h"
+
+namespace LZ {
+
+    const int HASH_BITS = 12;
+    const int MAX_CHAIN = 64; // Maximum number of candidates examined for each position
+
+    int hash3(const uint8_t* p) {
+        return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Greedy matching, with hash chains to find the candidates
+    std::vector<uint8_t> compress(const uint8_t* data, int size) {
+        std::vector<uint8_t> output;
+        std::vector<int> head(1 << HASH_BITS, -1);
+        std::vector<int> prev(size, -1);
+        int flagsPos = -1;
+        int nItems = 8;
+
+        auto insert = [&](int pos) {
+            if (pos + MIN_MATCH <= size) {
+                int h = hash3(data + pos);
+                prev[pos] = head[h];
+                head[h] = pos;
+            }
+        };
+
+        int pos = 0;
+        while (pos < size) {
+            if (nItems == 8) {
+                flagsPos = output.size();
+                output.push_back(0);
+                nItems = 0;
+            }
+
+            // Look for the longest match in the window
+            int bestLength = 0;
+            int bestOffset = 0;
+            if (pos + MIN_MATCH <= size) {
+                int maxLength = size - pos < MAX_MATCH ? size - pos : MAX_MATCH;
+                int candidate = head[hash3(data + pos)];
+                for (int chain = 0; candidate >= 0 && pos - candidate <= WINDOW_SIZE && chain < MAX_CHAIN; chain++) {
+                    int length = 0;
+                    while (length < maxLength && data[candidate + length] == data[pos + length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestOffset = pos - candidate;
+                        if (length == maxLength) {
+                            break;
+                        }
+                    }
+                    candidate = prev[candidate];
+                }
+            }
+
+            if (bestLength >= MIN_MATCH) {
+                output[flagsPos] |= 1 << nItems;
+                output.push_back((bestOffset - 1) & 0xFF);
+                output.push_back(((bestOffset - 1) >> 8) << 5 | (bestLength - MIN_MATCH));
+                for (int i = 0; i < bestLength; i++) {
+                    insert(pos + i);
+                }
+                pos += bestLength;
+            } else {
+                output.push_back(data[pos]);
+                insert(pos);
+                pos++;
+            }
+            nItems++;
+        }
+        return output;
+    }
+
+}
@@ -0,0 +1,15 @@
+#ifndef _LZ_COMPRESS_H_
+#define _LZ_COMPRESS_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Host-side compressor for the format decoded by libtungsten/bootloader/lz.cpp
+// (tools/upload.py contains the same algorithm in Python)
+namespace LZ {
+
+    std::vector<uint8_t> compress(const uint8_t* data, int size);
+
+}
+
+#endif
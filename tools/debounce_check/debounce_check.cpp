@@ -0,0 +1,354 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "debounce.h"
+
+// Host check of the debouncing and auto-repeat of the buttons (debounce.h).
+// Scripted cases check the transitions and the repeat schedule exactly. Then random sequences of
+// presses, each with contact bounce at both ends, are replayed the way the Buttons driver runs
+// them : an edge interrupt served with some latency, which reads the pin when it runs (both edges
+// of a short bounce can be seen as no change at all), and a periodic poll which runs while the
+// button is not idle. Every press must be reported once, on time, with the expected repeats.
+
+using Transition = Debounce::Transition;
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+const uint32_t POLL_PERIOD = 5; // ms, as in buttons.h
+const uint32_t BOUNCE = 8; // ms, at most at each end of a press
+const uint64_t US = 1000;
+
+// A physical press, from the first contact to the first opening, in us from the start of the trace
+struct Press {
+    uint64_t down;
+    uint64_t up;
+};
+
+struct Reported {
+    Transition transition;
+    uint32_t t; // ms
+};
+
+// Times of the repeats of a press reported at tPress if polled every ms, up to tEnd (ms, relative)
+std::vector<uint32_t> repeatSchedule(uint32_t tEnd) {
+    std::vector<uint32_t> schedule;
+    uint32_t t = Debounce::REPEAT_DELAY;
+    uint32_t period = Debounce::REPEAT_PERIOD;
+    while (t <= tEnd) {
+        schedule.push_back(t);
+        t += period;
+        period -= period >> Debounce::REPEAT_ACCELERATION_SHIFT;
+        if (period < Debounce::REPEAT_PERIOD_MIN) {
+            period = Debounce::REPEAT_PERIOD_MIN;
+        }
+    }
+    return schedule;
+}
+
+uint64_t randomRange(uint64_t min, uint64_t max) {
+    return min + (uint64_t)rand() % (max - min + 1);
+}
+
+// Simulated pin : the level toggles at each of the given times (us)
+struct Pin {
+    std::vector<uint64_t> toggles;
+    bool level(uint64_t t) const {
+        bool l = false;
+        for (uint64_t toggle : toggles) {
+            if (toggle > t) {
+                break;
+            }
+            l = !l;
+        }
+        return l;
+    }
+};
+
+// Replay a pin through the edge interrupt and the periodic poll, as in buttons.cpp
+std::vector<Reported> replay(const Pin& pin, bool repeat, uint32_t offset, uint64_t maxLatency, uint64_t maxPollLatency) {
+    std::vector<Reported> reported;
+    Debounce::Button button;
+    Debounce::init(button, false, repeat, offset);
+    auto ms = [offset](uint64_t t) { return (uint32_t)(t / US) + offset; };
+    auto report = [&reported](Transition transition, uint32_t t) {
+        if (transition != Transition::NONE) {
+            reported.push_back({transition, t});
+        }
+    };
+
+    const uint64_t NEVER = ~0ULL;
+    size_t nextToggle = 0;
+    uint64_t irq = NEVER; // Pending edge interrupt, served at this time
+    uint64_t poll = NEVER; // Next poll, while the timer is running
+    uint64_t pollBase = 0;
+    int steps = 0;
+    while (steps++ < 100000) {
+        uint64_t toggle = nextToggle < pin.toggles.size() ? pin.toggles[nextToggle] : NEVER;
+        if (toggle == NEVER && irq == NEVER && poll == NEVER) {
+            break;
+        }
+        if (toggle <= irq && toggle <= poll) {
+            // The interrupt flag is set once for several edges until it is served
+            if (irq == NEVER) {
+                irq = toggle + randomRange(0, maxLatency);
+            }
+            nextToggle++;
+
+        } else if (irq <= poll) {
+            uint64_t t = irq;
+            irq = NEVER;
+            bool pressed = pin.level(t);
+            if (pressed != button.level) {
+                report(Debounce::edge(button, pressed, ms(t)), ms(t));
+            }
+            if (poll == NEVER) {
+                pollBase = t + POLL_PERIOD * US;
+                poll = pollBase + randomRange(0, maxPollLatency);
+            }
+
+        } else {
+            uint64_t t = poll;
+            bool pressed = pin.level(t);
+            if (pressed != button.level) {
+                report(Debounce::edge(button, pressed, ms(t)), ms(t));
+            }
+            report(Debounce::poll(button, ms(t)), ms(t));
+            if (Debounce::isIdle(button, ms(t))) {
+                poll = NEVER;
+            } else {
+                // The poll can be delayed by higher priority interrupts
+                pollBase += POLL_PERIOD * US;
+                poll = pollBase + randomRange(0, maxPollLatency);
+                if (poll <= t) {
+                    poll = t + 1;
+                }
+            }
+        }
+    }
+    check(steps < 100000, "replay did not end", offset);
+    return reported;
+}
+
+// Build the toggles of a sequence of presses, with bounces of up to maxBounce us at each end
+Pin bouncingPin(const std::vector<Press>& presses, uint64_t maxBounce) {
+    Pin pin;
+    for (size_t i = 0; i < presses.size(); i++) {
+        const Press& p = presses[i];
+        uint64_t nextDown = i + 1 < presses.size() ? presses[i + 1].down : p.up + 1000 * US;
+        uint64_t bounceDown = std::min(maxBounce, (p.up - p.down) / 2);
+        uint64_t bounceUp = std::min(maxBounce, (nextDown - p.up) / 2);
+
+        // Each bounce is a pair of toggles after the first contact (or opening)
+        pin.toggles.push_back(p.down);
+        int nBounces = bounceDown > 2 ? rand() % 6 : 0;
+        std::vector<uint64_t> times;
+        for (int b = 0; b < 2 * nBounces; b++) {
+            times.push_back(p.down + randomRange(1, bounceDown - 1));
+        }
+        std::sort(times.begin(), times.end());
+        for (uint64_t t : times) {
+            pin.toggles.push_back(t > pin.toggles.back() ? t : pin.toggles.back() + 1);
+        }
+
+        pin.toggles.push_back(std::max(p.up, pin.toggles.back() + 1));
+        nBounces = bounceUp > 2 ? rand() % 6 : 0;
+        times.clear();
+        for (int b = 0; b < 2 * nBounces; b++) {
+            times.push_back(p.up + randomRange(1, bounceUp - 1));
+        }
+        std::sort(times.begin(), times.end());
+        for (uint64_t t : times) {
+            pin.toggles.push_back(t > pin.toggles.back() ? t : pin.toggles.back() + 1);
+        }
+    }
+    return pin;
+}
+
+// Scripted cases, with the transitions applied directly
+void checkScripted() {
+    Debounce::Button b;
+
+    // Clean press and release
+    Debounce::init(b, false, false, 1000);
+    check(Debounce::isIdle(b, 1000), "idle after init", 0);
+    check(Debounce::edge(b, true, 1000) == Transition::PRESS, "press", 0);
+    check(!Debounce::isIdle(b, 1010), "lockout not idle", 0);
+    check(Debounce::isIdle(b, 1020), "idle after lockout", 0);
+    check(Debounce::edge(b, false, 1100) == Transition::RELEASE, "release", 0);
+
+    // Bounces during the lockout are ignored, and the final level is reported at its end
+    Debounce::init(b, false, false, 0);
+    check(Debounce::edge(b, true, 100) == Transition::PRESS, "bounce press", 0);
+    check(Debounce::edge(b, false, 102) == Transition::NONE, "bounce 1", 0);
+    check(Debounce::edge(b, true, 103) == Transition::NONE, "bounce 2", 0);
+    check(Debounce::poll(b, 110) == Transition::NONE, "poll during lockout", 0);
+    check(Debounce::poll(b, 120) == Transition::NONE, "settled pressed", 0);
+    check(b.pressed, "still pressed", 0);
+
+    // Tap shorter than the lockout : the release is reported by the poll at its end
+    Debounce::init(b, false, false, 0);
+    check(Debounce::edge(b, true, 100) == Transition::PRESS, "tap press", 0);
+    check(Debounce::edge(b, false, 105) == Transition::NONE, "tap release in lockout", 0);
+    check(!Debounce::isIdle(b, 119), "tap not idle", 0);
+    check(Debounce::poll(b, 119) == Transition::NONE, "tap poll in lockout", 0);
+    check(Debounce::poll(b, 120) == Transition::RELEASE, "tap release", 0);
+    check(!Debounce::isIdle(b, 139) && Debounce::isIdle(b, 140), "tap idle after the lockout of the release", 0);
+
+    // Edge with the level already known (both edges of a glitch seen as one)
+    Debounce::init(b, false, false, 0);
+    check(Debounce::edge(b, false, 100) == Transition::NONE, "no change", 0);
+
+    // A button pressed at init is not reported
+    Debounce::init(b, true, false, 0);
+    check(b.pressed && Debounce::poll(b, 100) == Transition::NONE, "pressed at init", 0);
+    check(Debounce::edge(b, false, 100) == Transition::RELEASE, "release after init", 0);
+
+    // Repeat schedule, polled every ms, up to the minimum period
+    Debounce::init(b, false, true, 0);
+    check(Debounce::edge(b, true, 0) == Transition::PRESS, "repeat press", 0);
+    std::vector<uint32_t> expected = repeatSchedule(5000);
+    std::vector<uint32_t> repeats;
+    for (uint32_t t = 1; t <= 5000; t++) {
+        Transition transition = Debounce::poll(b, t);
+        check(transition == Transition::NONE || transition == Transition::REPEAT, "repeat transition", t);
+        if (transition == Transition::REPEAT) {
+            repeats.push_back(t);
+        }
+        check(!Debounce::isIdle(b, t), "not idle while repeating", t);
+    }
+    check(repeats == expected, "repeat schedule", repeats.size());
+    check(repeats.size() > 3 && repeats[0] == Debounce::REPEAT_DELAY, "first repeat", repeats.empty() ? 0 : repeats[0]);
+    for (size_t i = 2; i < repeats.size(); i++) {
+        check(repeats[i] - repeats[i - 1] <= repeats[i - 1] - repeats[i - 2], "repeats accelerate", i);
+    }
+    check(repeats.back() - repeats[repeats.size() - 2] == Debounce::REPEAT_PERIOD_MIN, "minimum period", repeats.back());
+    check(Debounce::edge(b, false, 5001) == Transition::RELEASE, "repeat release", 0);
+    check(Debounce::poll(b, 6000) == Transition::NONE, "no repeat after release", 0);
+
+    // The repeats start again at the first delay on the next press
+    check(Debounce::edge(b, true, 7000) == Transition::PRESS, "second press", 0);
+    check(Debounce::poll(b, 7000 + Debounce::REPEAT_DELAY - 1) == Transition::NONE, "second press delay", 0);
+    check(Debounce::poll(b, 7000 + Debounce::REPEAT_DELAY) == Transition::REPEAT, "second press repeat", 0);
+    check(Debounce::poll(b, 7000 + Debounce::REPEAT_DELAY + 1) == Transition::NONE, "second press period", 0);
+
+    // A long gap between two polls gives a single repeat, not a burst
+    Debounce::init(b, false, true, 0);
+    Debounce::edge(b, true, 0);
+    check(Debounce::poll(b, 3000) == Transition::REPEAT, "late repeat", 0);
+    check(Debounce::poll(b, 3001) == Transition::NONE, "no burst", 0);
+
+    // No repeat without auto-repeat : a held button is idle after the lockout
+    Debounce::init(b, false, false, 0);
+    Debounce::edge(b, true, 0);
+    check(Debounce::isIdle(b, Debounce::LOCKOUT), "held without repeat idle", 0);
+    check(Debounce::poll(b, 10000) == Transition::NONE, "no repeat", 0);
+
+    // Across the wrap-around of the 32-bit milliseconds
+    Debounce::init(b, false, true, 0xFFFFFFF0);
+    check(Debounce::edge(b, true, 0xFFFFFFF8) == Transition::PRESS, "press before wrap", 0);
+    check(Debounce::edge(b, false, 0x00000002) == Transition::NONE, "bounce across wrap", 0);
+    check(Debounce::poll(b, 0x0000000B) == Transition::NONE, "lockout across wrap", 0);
+    check(Debounce::poll(b, 0x0000000C) == Transition::RELEASE, "release across wrap", 0);
+}
+
+// Random sequences of bouncing presses
+int checkRandom(bool repeat, uint32_t offset, int nRuns) {
+    int nPresses = 0;
+    for (int run = 0; run < nRuns; run++) {
+        // The edge interrupt is usually served within a few us, but can wait for a few ms while
+        // the interrupts are masked (flash write...) : a tap must then last longer than the bounces
+        // and the latency, otherwise both of its edges can happen before the interrupt is served.
+        uint64_t maxLatency = rand() % 2 == 0 ? 50 : 2 * US;
+        uint64_t minTap = maxLatency > US ? BOUNCE + 2 * maxLatency / US : 2;
+
+        // Presses from a short tap to a long hold. They are far enough apart for the release of
+        // a tap, which is only seen at the end of the lockout, to be over before the next press.
+        std::vector<Press> presses;
+        uint64_t t = randomRange(0, 50) * US;
+        int n = 1 + rand() % 6;
+        for (int i = 0; i < n; i++) {
+            t += randomRange(2 * Debounce::LOCKOUT + 20, 800) * US + randomRange(0, 999);
+            uint64_t duration = rand() % 4 == 0 ? randomRange(minTap, Debounce::LOCKOUT) * US : randomRange(Debounce::LOCKOUT, 3000) * US;
+            presses.push_back({t, t + duration + randomRange(0, 999)});
+            t = presses.back().up;
+        }
+        Pin pin = bouncingPin(presses, BOUNCE * US);
+        std::vector<Reported> reported = replay(pin, repeat, offset, maxLatency, 2 * US);
+
+        // Each press gives a PRESS, repeats if held long enough, then a RELEASE. The interrupt can
+        // see the pin back to its previous level while it bounces, which delays the transition.
+        size_t r = 0;
+        for (const Press& p : presses) {
+            nPresses++;
+            uint32_t down = (uint32_t)(p.down / US) + offset;
+            uint32_t up = (uint32_t)(p.up / US) + offset;
+            check(r < reported.size() && reported[r].transition == Transition::PRESS, "PRESS missing", run);
+            if (r >= reported.size()) {
+                break;
+            }
+            uint32_t tPress = reported[r].t;
+            check((int32_t)(tPress - down) >= 0 && (int32_t)(tPress - down) <= (int32_t)BOUNCE + 3, "PRESS late", (int32_t)(tPress - down));
+            r++;
+
+            std::vector<uint32_t> repeats;
+            while (r < reported.size() && reported[r].transition == Transition::REPEAT) {
+                repeats.push_back(reported[r].t - tPress);
+                r++;
+            }
+            check(r < reported.size() && reported[r].transition == Transition::RELEASE, "RELEASE missing", run);
+            if (r >= reported.size()) {
+                break;
+            }
+            uint32_t tRelease = reported[r].t;
+            uint32_t lockoutEnd = tPress + Debounce::LOCKOUT;
+            uint32_t bound = ((int32_t)(up - lockoutEnd) > 0 ? up : lockoutEnd) + BOUNCE + POLL_PERIOD + 3;
+            check((int32_t)(tRelease - up) >= 0, "RELEASE early", (int32_t)(tRelease - up));
+            check((int32_t)(tRelease - bound) <= 0, "RELEASE late", (int32_t)(tRelease - up));
+            r++;
+
+            // The repeats are on schedule, delayed by the poll period at most
+            if (repeat) {
+                std::vector<uint32_t> expected = repeatSchedule(tRelease - tPress);
+                check(repeats.size() <= expected.size() && repeats.size() + 1 >= expected.size(), "number of repeats", (long long)repeats.size() - (long long)expected.size());
+                for (size_t i = 0; i < repeats.size() && i < expected.size(); i++) {
+                    check(repeats[i] >= expected[i] && repeats[i] <= expected[i] + POLL_PERIOD + 3, "repeat time", (long long)repeats[i] - expected[i]);
+                }
+            } else {
+                check(repeats.empty(), "repeat without auto-repeat", run);
+            }
+        }
+        check(r == reported.size(), "spurious transitions", (long long)reported.size() - r);
+    }
+    return nPresses;
+}
+
+int main() {
+    checkScripted();
+
+    int nPresses = 0;
+    const uint32_t OFFSETS[] = {0, 123456, 0xFFFFFFFF - 20000, 0xFFFFFFFF - 500};
+    for (uint32_t offset : OFFSETS) {
+        srand(offset);
+        nPresses += checkRandom(false, offset, 3000);
+        nPresses += checkRandom(true, offset, 3000);
+    }
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d bouncing presses\n", _nChecks, nPresses);
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "discharge.h"
+
+// Host check of the battery state of charge and runtime estimator (discharge.h).
+// Without arguments, discharge traces are simulated : a cell with its own open-circuit curve
+// (close to, but not the same as, the one of the estimator), an internal resistance, a load
+// which depends on the power profile and a noisy measurement every 10s like on the target.
+// Recorded traces can also be given as CSV files of "seconds,mV[,profile]" lines, measured
+// until the cell is empty with a constant load : the remaining runtime is then known at every
+// point of the trace. In simulated traces, it is the runtime at the current load.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, double value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%g)\n", what, value);
+        }
+    }
+}
+
+struct Point {
+    unsigned long t; // ms
+    int voltage; // mV
+    int profile;
+    double trueSoc; // permil, or < 0 if unknown
+    double trueRemaining; // minutes at the current load, or < 0 to use the end of the trace
+};
+
+// Statistics of the estimates along a trace
+struct Result {
+    int nEstimates = 0;
+    double maxSocError = 0; // permil
+    double maxRuntimeError = 0; // relative
+    double sumRuntimeError = 0;
+    bool monotonic = true;
+};
+
+// The remaining runtime is compared between 85% and 15% of charge, two hours after the last
+// profile change : the curve is too steep at both ends to extrapolate, and the history too short before
+Result run(const std::vector<Point>& trace) {
+    Result result;
+    Discharge::reset();
+    unsigned long tEnd = trace.back().t;
+    unsigned long tProfile = 0;
+    int lastProfile = trace.front().profile;
+    int lastSoc = Discharge::UNKNOWN;
+    for (const Point& p : trace) {
+        if (p.profile != lastProfile) {
+            tProfile = p.t;
+            lastProfile = p.profile;
+        }
+        Discharge::setProfile(p.profile);
+        Discharge::update(p.t, p.voltage);
+        int soc = Discharge::stateOfCharge();
+
+        // The state of charge never goes up while discharging on the same profile
+        if (lastSoc != Discharge::UNKNOWN && soc > lastSoc && p.t != tProfile) {
+            result.monotonic = false;
+        }
+        lastSoc = soc;
+
+        if (p.trueSoc >= 0 && p.t > 60000) {
+            double error = fabs(soc - p.trueSoc);
+            if (error > result.maxSocError) {
+                result.maxSocError = error;
+            }
+        }
+
+        long remaining = Discharge::remainingMinutes();
+        double actual = p.trueRemaining >= 0 ? p.trueRemaining : (tEnd - p.t) / 60000.0;
+        bool inRange = p.trueSoc >= 0 ? p.trueSoc >= 150 && p.trueSoc <= 850 : soc >= 150 && soc <= 850;
+        if (remaining != Discharge::UNKNOWN && inRange && p.t - tProfile >= 2 * 3600000) {
+            double error = fabs(remaining - actual) / actual;
+            result.nEstimates++;
+            result.sumRuntimeError += error;
+            if (error > result.maxRuntimeError) {
+                result.maxRuntimeError = error;
+            }
+        }
+    }
+    return result;
+}
+
+// Simulated cell
+const double CAPACITY = 800; // mAh
+const double RESISTANCE = 0.15; // ohm
+const int N_CELL_POINTS = 21;
+const double CELL_CURVE[N_CELL_POINTS] = { // mV every 5%
+    3270, 3520, 3660, 3700, 3722, 3740, 3758, 3775, 3790, 3804,
+    3822, 3842, 3868, 3905, 3948, 3990, 4030, 4072, 4115, 4158, 4195
+};
+
+double cellVoltage(double soc) { // permil
+    if (soc <= 0) {
+        return CELL_CURVE[0];
+    }
+    double x = soc / 50.0;
+    int i = (int)x;
+    if (i >= N_CELL_POINTS - 1) {
+        return CELL_CURVE[N_CELL_POINTS - 1];
+    }
+    return CELL_CURVE[i] + (x - i) * (CELL_CURVE[i + 1] - CELL_CURVE[i]);
+}
+
+double noise(double amplitude) {
+    return (rand() / (double)RAND_MAX * 2 - 1) * amplitude;
+}
+
+// Discharge from startSoc with the current (mA) of each profile, switching to the next profile
+// at each of the given times (ms), until the cell is empty. A negative current charges the cell.
+std::vector<Point> simulate(double startSoc, const std::vector<double>& currents, const std::vector<unsigned long>& switches, double noiseAmplitude) {
+    std::vector<Point> trace;
+    double soc = startSoc;
+    int profile = 0;
+    const unsigned long PERIOD = 10000; // ms
+    for (unsigned long t = 0; soc > 0 && t < 1000UL * 3600 * 1000; t += PERIOD) {
+        while (profile + 1 < (int)currents.size() && profile < (int)switches.size() && t >= switches[profile]) {
+            profile++;
+        }
+        double current = currents[profile];
+        double v = cellVoltage(soc) - current * RESISTANCE + noise(noiseAmplitude);
+        trace.push_back({t, (int)lround(v), profile, soc, current > 0 ? soc / 1000 * CAPACITY / current * 60 : -1});
+        soc -= current * PERIOD / 3600000.0 / CAPACITY * 1000;
+        if (soc > 1000) {
+            soc = 1000;
+        }
+    }
+    return trace;
+}
+
+std::vector<Point> readTrace(const char* filename) {
+    std::vector<Point> trace;
+    FILE* f = fopen(filename, "r");
+    if (f == nullptr) {
+        return trace;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        double seconds = 0;
+        int voltage = 0;
+        int profile = 0;
+        if (sscanf(line, "%lf,%d,%d", &seconds, &voltage, &profile) >= 2) {
+            trace.push_back({(unsigned long)(seconds * 1000), voltage, profile, -1, -1});
+        }
+    }
+    fclose(f);
+    return trace;
+}
+
+void print(const char* name, const Result& r, double hours) {
+    printf("     %-24s %6.1fh  soc error max %5.1f%%  runtime error mean %5.1f%% max %5.1f%% (%d estimates)\n",
+        name, hours, r.maxSocError / 10, r.nEstimates > 0 ? r.sumRuntimeError / r.nEstimates * 100 : 0.0,
+        r.maxRuntimeError * 100, r.nEstimates);
+}
+
+int main(int argc, char** argv) {
+    // Recorded traces
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            std::vector<Point> trace = readTrace(argv[i]);
+            check(trace.size() > 1, "empty trace", i);
+            if (trace.size() > 1) {
+                Result r = run(trace);
+                print(argv[i], r, trace.back().t / 3600000.0);
+                check(r.nEstimates == 0 || r.sumRuntimeError / r.nEstimates < 0.2, "mean runtime error", r.sumRuntimeError / r.nEstimates);
+            }
+        }
+        if (_nFailures > 0) {
+            printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+            return 1;
+        }
+        printf("ok   %d checks\n", _nChecks);
+        return 0;
+    }
+
+    // Voltage to state of charge on the curve of the estimator
+    for (int i = 0; i < Discharge::N_CURVE_POINTS; i++) {
+        check(Discharge::socFromVoltage(Discharge::CURVE[i]) == i * Discharge::CURVE_STEP, "curve point", i);
+    }
+    check(Discharge::socFromVoltage(0) == 0, "empty", 0);
+    check(Discharge::socFromVoltage(5000) == Discharge::SOC_MAX, "full", 0);
+    for (int v = 3000; v < 4400; v++) {
+        check(Discharge::socFromVoltage(v + 1) >= Discharge::socFromVoltage(v), "curve not monotonic", v);
+    }
+
+    // Nothing is known before the first measurement, and the runtime needs some history
+    Discharge::reset();
+    check(Discharge::stateOfCharge() == Discharge::UNKNOWN, "unknown state of charge", 0);
+    Discharge::update(0, 3800);
+    check(Discharge::stateOfCharge() == 400, "first measurement", Discharge::stateOfCharge());
+    check(Discharge::remainingMinutes() == Discharge::UNKNOWN, "runtime without history", 0);
+
+    // Constant loads, from continuous reception to low-power reception
+    struct Scenario {
+        const char* name;
+        double startSoc;
+        std::vector<double> currents;
+        std::vector<unsigned long> switches;
+    };
+    const unsigned long H = 3600000;
+    const Scenario SCENARIOS[] = {
+        {"continuous rx 14mA", 1000, {14}, {}},
+        {"low-power rx 3mA", 1000, {3}, {}},
+        {"radio off 1.5mA", 1000, {1.5}, {}},
+        {"half charged 14mA", 500, {14}, {}},
+        {"14mA then 3mA", 1000, {14, 3}, {15 * H}},
+        {"3mA then 14mA", 1000, {3, 14}, {60 * H}},
+        {"alternating", 1000, {14, 3, 14, 3}, {10 * H, 40 * H, 50 * H}},
+    };
+    for (const Scenario& s : SCENARIOS) {
+        for (int seed = 0; seed < 5; seed++) {
+            srand(seed);
+            std::vector<Point> trace = simulate(s.startSoc, s.currents, s.switches, 3);
+            Result r = run(trace);
+            if (seed == 0) {
+                print(s.name, r, trace.back().t / 3600000.0);
+            }
+            check(r.monotonic, "state of charge went up while discharging", seed);
+            check(r.maxSocError <= 60, "state of charge error", r.maxSocError);
+            check(r.nEstimates > 0, "no runtime estimate", seed);
+            check(r.nEstimates == 0 || r.sumRuntimeError / r.nEstimates < 0.2, "mean runtime error", r.sumRuntimeError / r.nEstimates);
+            check(r.maxRuntimeError < 0.5, "max runtime error", r.maxRuntimeError);
+        }
+    }
+
+    // Charging : the state of charge goes up, and no runtime is given
+    srand(0);
+    std::vector<Point> charging = simulate(200, {-400}, {}, 3);
+    charging.resize(charging.size() < 360 ? charging.size() : 360); // 1 hour
+    Discharge::reset();
+    for (const Point& p : charging) {
+        Discharge::update(p.t, p.voltage);
+    }
+    check(Discharge::stateOfCharge() > 400, "charging", Discharge::stateOfCharge());
+    check(Discharge::remainingMinutes() == Discharge::UNKNOWN, "runtime while charging", Discharge::remainingMinutes());
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d simulated traces\n", _nChecks, (int)(sizeof(SCENARIOS) / sizeof(SCENARIOS[0])) * 5);
+    return 0;
+}
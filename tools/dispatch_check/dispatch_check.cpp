@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "dispatch.h"
+#include "gui.h"
+#include "sync.h"
+#include "sync_usb.h"
+#include "schema.h"
+#include "presets.h"
+#include "context.h"
+
+// Host check of the command dispatcher (dispatch.cpp, compiled as is) : random frames from the
+// radio and from USB are fed both to the dispatcher and to the if/else chain of main() it
+// replaced, and the resulting state and the frames sent to each side are compared.
+
+// Stubs of the modules the handlers call, which log what they are asked to do
+std::string _log;
+
+void log(const char* format, int a, const uint8_t* payload=nullptr, int payloadSize=0) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), format, a);
+    _log += buffer;
+    for (int i = 0; i < payloadSize; i++) {
+        snprintf(buffer, sizeof(buffer), " %02x", payload[i]);
+        _log += buffer;
+    }
+    _log += ";";
+}
+
+Core::Time Core::_time = 1;
+bool _usbConnected = false;
+
+bool Sync::send(uint8_t command, uint8_t* payload, int payloadSize) {
+    log(payload != nullptr ? "radio %02x" : "radio %02x fast", command, payload, payloadSize);
+    return true;
+}
+
+void SyncUSB::send(uint8_t command, uint8_t* payload, int payloadSize) {
+    log("usb %02x", command, payload, payloadSize);
+}
+
+void SyncUSB::sendEvent(uint8_t command, int rssi, uint32_t rxTimestamp) {
+    log("event %02x", command);
+    log("rssi %d", rssi);
+    log("rx %u", (unsigned)rxTimestamp);
+}
+
+bool SyncUSB::isConnected() {
+    return _usbConnected;
+}
+
+void GUI::copyShadowContext() {
+    log("shadow", 0);
+}
+
+void GUI::recallPreset(int index) {
+    log("recall %d", index);
+}
+
+void GUI::sendMenusUSB(uint8_t mask) {
+    log("menus %02x", mask);
+}
+
+// Definitions normally in context.cpp which are not in ../schema_check/context_stub.cpp
+int Context::_presetSelected = 0;
+Core::Time Context::_tFocus = 0;
+Core::Time Context::_tTrigger = 0;
+bool Context::_skipDelay = false;
+int Context::_rssi = 0;
+uint32_t Context::_rxTimestamp = 0;
+bool Context::_remoteFocusHold = false;
+bool Context::_remoteFocusHoldFromUSB = false;
+Core::Time Context::_tRemoteFocusHold = 0;
+bool Context::_remoteTriggerHold = false;
+bool Context::_remoteTriggerHoldFromUSB = false;
+Core::Time Context::_tRemoteTriggerHold = 0;
+
+// The command handling of main() before the dispatcher, with the remote hold state moved to Context.
+// The only intended difference : unknown commands above CMD_FOCUS are not notified to the host anymore.
+void legacyDispatch(uint8_t command, uint8_t* payload, int payloadSize, bool isCommandFromUSB) {
+    // Notify the host immediately of remote triggers
+    if (!isCommandFromUSB && command >= Sync::CMD_FOCUS && command <= Sync::CMD_TRIGGER_RELEASE && SyncUSB::isConnected()) {
+        SyncUSB::sendEvent(command, Context::_rssi, Context::_rxTimestamp);
+    }
+
+    if (command < Schema::N_MENUS) {
+        if ((isCommandFromUSB || Schema::isMenuSynced(command)) && Schema::decodeMenu(command, payload, payloadSize, isCommandFromUSB)) {
+            if (isCommandFromUSB && Schema::isMenuSynced(command)) {
+                Sync::send(command, payload, Schema::encodeMenu(command, payload, false));
+            }
+            if (!isCommandFromUSB && SyncUSB::isConnected()) {
+                SyncUSB::send(command, payload, Schema::encodeMenu(command, payload, true));
+            }
+        }
+    } else if (command == Sync::CMD_PRESET && !isCommandFromUSB) {
+        Presets::Preset preset;
+        uint8_t mask = 0;
+        if (Presets::decodeFrame(payload, payloadSize, preset, mask)) {
+            mask = Schema::syncedMenus(mask);
+            Presets::apply(preset, mask);
+            GUI::sendMenusUSB(mask);
+        }
+    } else if (command == Sync::CMD_RECALL_PRESET && isCommandFromUSB && payloadSize >= 1 && payload[0] < Presets::N_PRESETS) {
+        Context::_presetSelected = payload[0];
+        GUI::recallPreset(payload[0]);
+    } else if (command == Sync::CMD_STORE_PRESET && isCommandFromUSB && payloadSize >= 1) {
+        char name[Presets::NAME_SIZE + 1] = "";
+        for (int i = 1; i < payloadSize && i <= Presets::NAME_SIZE; i++) {
+            name[i - 1] = payload[i];
+        }
+        Presets::store(payload[0], payloadSize > 1 ? name : nullptr);
+    } else if (command == Sync::CMD_SET_PASSTHROUGH && isCommandFromUSB && payloadSize >= 8) {
+        Context::_inputPassthroughDelayUs = (uint32_t)payload[0] << 24 | payload[1] << 16 | payload[2] << 8 | payload[3];
+        Context::_inputPassthroughStretchUs = (uint32_t)payload[4] << 24 | payload[5] << 16 | payload[6] << 8 | payload[7];
+    } else if (command == Sync::CMD_FOCUS && (isCommandFromUSB || Context::_triggerSync)) {
+        GUI::copyShadowContext();
+        Context::_tFocus = Core::time();
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_FOCUS_HOLD && (isCommandFromUSB || Context::_triggerSync)) {
+        if (!Context::_remoteFocusHold) {
+            Context::_remoteFocusHold = true;
+            Context::_remoteFocusHoldFromUSB = isCommandFromUSB;
+        }
+        Context::_tRemoteFocusHold = Core::time();
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_FOCUS_RELEASE && (isCommandFromUSB || Context::_triggerSync)) {
+        Context::_tFocus = 0;
+        Context::_remoteFocusHold = false;
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_TRIGGER && (isCommandFromUSB || Context::_triggerSync)) {
+        GUI::copyShadowContext();
+        Context::_tTrigger = Core::time();
+        Context::_skipDelay = false;
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_TRIGGER_NO_DELAY && (isCommandFromUSB || Context::_triggerSync)) {
+        GUI::copyShadowContext();
+        Context::_tTrigger = Core::time();
+        Context::_skipDelay = true;
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_TRIGGER_HOLD && (isCommandFromUSB || Context::_triggerSync)) {
+        if (!Context::_remoteTriggerHold) {
+            Context::_remoteTriggerHold = true;
+            Context::_remoteTriggerHoldFromUSB = isCommandFromUSB;
+        }
+        Context::_tRemoteTriggerHold = Core::time();
+        Context::_skipDelay = false;
+        // The trigger keepalives also refresh a focus hold
+        if (Context::_remoteFocusHold) {
+            Context::_tRemoteFocusHold = Context::_tRemoteTriggerHold;
+        }
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command == Sync::CMD_TRIGGER_RELEASE && (isCommandFromUSB || Context::_triggerSync)) {
+        Context::_tTrigger = 0;
+        Context::_skipDelay = false;
+        Context::_remoteTriggerHold = false;
+        if (isCommandFromUSB && Context::_triggerSync) {
+            Sync::send(command);
+        }
+    } else if (command >= Sync::CMD_WAKE_INTERVAL && command < Sync::CMD_WAKE_INTERVAL + Sync::N_WAKE_INTERVALS && !isCommandFromUSB) {
+        Context::_channelWakeInterval = command - Sync::CMD_WAKE_INTERVAL;
+        if (Context::_wakeInterval > Context::_channelWakeInterval) {
+            Context::_wakeInterval = Context::_channelWakeInterval;
+        }
+    }
+}
+
+// Everything the handlers can change
+struct State {
+    uint32_t fields[Schema::N_FIELDS];
+    Presets::Preset presets[Presets::N_PRESETS];
+    int presetSelected;
+    Core::Time tFocus;
+    Core::Time tTrigger;
+    bool skipDelay;
+    bool remoteFocusHold;
+    bool remoteFocusHoldFromUSB;
+    Core::Time tRemoteFocusHold;
+    bool remoteTriggerHold;
+    bool remoteTriggerHoldFromUSB;
+    Core::Time tRemoteTriggerHold;
+};
+
+void save(State& state) {
+    memset(&state, 0, sizeof(state));
+    for (int i = 0; i < Schema::N_FIELDS; i++) {
+        state.fields[i] = Schema::get(i);
+    }
+    for (int i = 0; i < Presets::N_PRESETS; i++) {
+        state.presets[i] = Presets::get(i);
+    }
+    state.presetSelected = Context::_presetSelected;
+    state.tFocus = Context::_tFocus;
+    state.tTrigger = Context::_tTrigger;
+    state.skipDelay = Context::_skipDelay;
+    state.remoteFocusHold = Context::_remoteFocusHold;
+    state.remoteFocusHoldFromUSB = Context::_remoteFocusHoldFromUSB;
+    state.tRemoteFocusHold = Context::_tRemoteFocusHold;
+    state.remoteTriggerHold = Context::_remoteTriggerHold;
+    state.remoteTriggerHoldFromUSB = Context::_remoteTriggerHoldFromUSB;
+    state.tRemoteTriggerHold = Context::_tRemoteTriggerHold;
+}
+
+void restore(const State& state) {
+    for (int i = 0; i < Schema::N_FIELDS; i++) {
+        Schema::set(i, state.fields[i]);
+    }
+    Context::_presetSelected = state.presetSelected;
+    Context::_tFocus = state.tFocus;
+    Context::_tTrigger = state.tTrigger;
+    Context::_skipDelay = state.skipDelay;
+    Context::_remoteFocusHold = state.remoteFocusHold;
+    Context::_remoteFocusHoldFromUSB = state.remoteFocusHoldFromUSB;
+    Context::_tRemoteFocusHold = state.tRemoteFocusHold;
+    Context::_remoteTriggerHold = state.remoteTriggerHold;
+    Context::_remoteTriggerHoldFromUSB = state.remoteTriggerHoldFromUSB;
+    Context::_tRemoteTriggerHold = state.tRemoteTriggerHold;
+}
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, int command, bool fromUSB) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (command %02x from %s)\n", what, command, fromUSB ? "USB" : "radio");
+        }
+    }
+}
+
+const uint8_t COMMANDS[] = {
+    0, 1, 2, 3, 4, 5, Sync::CMD_PRESET,
+    Sync::CMD_GET_GUI_STATE, Sync::CMD_GET_GUI_UPDATE, Sync::CMD_GET_RADIO_STATS, Sync::CMD_GET_PRESETS,
+    Sync::CMD_RECALL_PRESET, Sync::CMD_STORE_PRESET, Sync::CMD_SET_PASSTHROUGH,
+    Sync::CMD_FOCUS, Sync::CMD_FOCUS_HOLD, Sync::CMD_FOCUS_RELEASE,
+    Sync::CMD_TRIGGER, Sync::CMD_TRIGGER_NO_DELAY, Sync::CMD_TRIGGER_HOLD, Sync::CMD_TRIGGER_RELEASE,
+    Sync::CMD_EXPLICIT_FOLLOWS, Sync::CMD_WAKE_INTERVAL, Sync::CMD_WAKE_INTERVAL + 2,
+    Sync::CMD_WAKE_INTERVAL + Sync::N_WAKE_INTERVALS - 1, Sync::CMD_WAKE_INTERVAL + Sync::N_WAKE_INTERVALS,
+};
+const int N_COMMANDS = sizeof(COMMANDS);
+
+int main() {
+    srand(0);
+    Presets::init();
+
+    // Entries of the table
+    for (int c = 0; c < 256; c++) {
+        const Dispatch::Command* command = Dispatch::find(c);
+        check(command == nullptr || command->id == c, "entry at the wrong index", c, false);
+    }
+    check(Dispatch::find(Sync::CMD_GET_GUI_STATE) == nullptr, "GET request dispatched", Sync::CMD_GET_GUI_STATE, true);
+    check(Dispatch::find(Sync::CMD_EXPLICIT_FOLLOWS) == nullptr, "unknown command dispatched", Sync::CMD_EXPLICIT_FOLLOWS, false);
+
+    int nAccepted = 0;
+    const int N_FRAMES = 1000000;
+    for (int n = 0; n < N_FRAMES; n++) {
+        // Random settings and state
+        for (int i = 0; i < Schema::N_FIELDS; i++) {
+            if (Schema::FIELDS[i].type == Schema::Type::BOOL) {
+                Schema::set(i, rand() % 2);
+            }
+        }
+        Context::_remoteFocusHold = rand() % 2;
+        Context::_remoteFocusHoldFromUSB = rand() % 2;
+        Context::_remoteTriggerHold = rand() % 2;
+        Context::_remoteTriggerHoldFromUSB = rand() % 2;
+        Context::_skipDelay = rand() % 2;
+        Context::_wakeInterval = rand() % Sync::N_WAKE_INTERVALS;
+        Context::_rssi = -(rand() % 140);
+        Context::_rxTimestamp = rand();
+        Core::_time = n + 1;
+        _usbConnected = rand() % 2;
+
+        // Random frame, mostly of a known command
+        bool fromUSB = rand() % 2;
+        uint8_t command = rand() % 4 == 0 ? rand() % 256 : COMMANDS[rand() % N_COMMANDS];
+        uint8_t frame[Sync::MAX_PAYLOAD_SIZE];
+        int frameSize = rand() % (Sync::MAX_PAYLOAD_SIZE + 1);
+        for (int i = 0; i < Sync::MAX_PAYLOAD_SIZE; i++) {
+            frame[i] = rand() % 4 == 0 ? rand() % 256 : rand() % 8;
+        }
+        if (command == Sync::CMD_PRESET && rand() % 2) {
+            frameSize = Presets::encodeFrame(rand() % Presets::N_PRESETS, rand() % 256, frame);
+        }
+        if (command == Sync::CMD_STORE_PRESET && rand() % 64 != 0) {
+            // Keep the number of writes to the simulated flash reasonable
+            frameSize = 0;
+        }
+
+        State before;
+        save(before);
+
+        uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+        memcpy(payload, frame, sizeof(frame));
+        _log.clear();
+        legacyDispatch(command, payload, frameSize, fromUSB);
+        std::string expectedLog = _log;
+        State expected;
+        save(expected);
+
+        restore(before);
+        memcpy(payload, frame, sizeof(frame));
+        _log.clear();
+        if (Dispatch::dispatch(command, payload, frameSize, fromUSB)) {
+            nAccepted++;
+        }
+        State result;
+        save(result);
+
+        check(_log == expectedLog, "frames sent", command, fromUSB);
+        check(memcmp(&result, &expected, sizeof(State)) == 0, "state", command, fromUSB);
+        if (_log != expectedLog && _nFailures <= 20) {
+            fprintf(stderr, "     expected %s\n     got      %s\n", expectedLog.c_str(), _log.c_str());
+        }
+    }
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d frames of which %d accepted\n", _nChecks, N_FRAMES, nAccepted);
+    return 0;
+}
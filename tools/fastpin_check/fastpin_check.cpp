@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <core.h>
+#include <error.h>
+#include <gpio.h>
+#include "pins.h"
+
+// Host check of the compile-time pins of the GPIO module (GPIO::FastPin and GPIO::FastPins in
+// libtungsten/sam4l/gpio.h), against GPIO::set() and GPIO::get() from gpio.cpp which is compiled
+// as is for the host (x86-64 Linux). The registers of the GPIO controller are mapped at their real
+// address but protected : each access faults, is executed step by step and applied to a model of
+// the set/clear/toggle registers, which records every write. The instructions executed by each
+// function are counted the same way, as an estimate of their cost on the target.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+const uint32_t REGISTERS_SIZE = 0x1000; // The 3 ports
+
+// Model of the GPIO controller : OVR and PVR of each port, the other registers are plain memory.
+// The set, clear and toggle registers read as a value which is never written, so that every write
+// to them is seen.
+struct Controller {
+    uint32_t ovr[GPIO::N_PORTS] = {0};
+    uint32_t pvr[GPIO::N_PORTS] = {0}; // Pin inputs, set by the test
+    int nReads = 0;
+    int nWrites = 0;
+    uint32_t changes[16]; // Bits of OVR changed by each write
+    int nChanges = 0;
+};
+Controller _ctrl;
+
+volatile uint32_t* const REGISTERS = (volatile uint32_t*) (uintptr_t) GPIO::GPIO_BASE;
+uint32_t _shadow[REGISTERS_SIZE / 4]; // Content before the access being stepped
+uint32_t _accessOffset = 0;
+const uint32_t UNWRITTEN = 0xA5A5A5A5;
+bool _pendingAccess = false;
+bool _counting = false;
+int _nInstructions = 0;
+
+uint32_t& reg(uint32_t offset) {
+    return *(uint32_t*) &REGISTERS[offset / 4];
+}
+
+// Values read by the next access
+void prepareRead() {
+    for (int port = 0; port < GPIO::N_PORTS; port++) {
+        uint32_t base = port * GPIO::PORT_REG_SIZE;
+        reg(base + GPIO::OFFSET_OVR) = _ctrl.ovr[port];
+        reg(base + GPIO::OFFSET_OVR + 4) = UNWRITTEN;
+        reg(base + GPIO::OFFSET_OVR + 8) = UNWRITTEN;
+        reg(base + GPIO::OFFSET_OVR + 12) = UNWRITTEN;
+        reg(base + GPIO::OFFSET_PVR) = _ctrl.pvr[port];
+    }
+}
+
+// Effect of the access which has just been executed
+void applyAccess(uint32_t offset) {
+    uint32_t value = reg(offset);
+    int port = offset / GPIO::PORT_REG_SIZE;
+    uint32_t local = offset % GPIO::PORT_REG_SIZE;
+    bool rsct = local >= GPIO::OFFSET_OVR + 4 && local <= GPIO::OFFSET_OVR + 12;
+    if (rsct ? value == UNWRITTEN : value == _shadow[offset / 4]) {
+        _ctrl.nReads++;
+        return;
+    }
+    _ctrl.nWrites++;
+    uint32_t before = _ctrl.ovr[port];
+    if (local == GPIO::OFFSET_OVR) {
+        _ctrl.ovr[port] = value;
+    } else if (local == GPIO::OFFSET_OVR + 4) {
+        _ctrl.ovr[port] |= value;
+    } else if (local == GPIO::OFFSET_OVR + 8) {
+        _ctrl.ovr[port] &= ~value;
+    } else if (local == GPIO::OFFSET_OVR + 12) {
+        _ctrl.ovr[port] ^= value;
+    }
+    if (_ctrl.nChanges < 16) {
+        _ctrl.changes[_ctrl.nChanges++] = before ^ _ctrl.ovr[port];
+    }
+}
+
+// An access to the registers faults : open them for this instruction only, and trap after it
+void handlerSegv(int, siginfo_t* info, void* context) {
+    uintptr_t address = (uintptr_t) info->si_addr;
+    if (address < GPIO::GPIO_BASE || address >= GPIO::GPIO_BASE + REGISTERS_SIZE) {
+        signal(SIGSEGV, SIG_DFL);
+        return; // Crash on the access again
+    }
+    _accessOffset = (address - GPIO::GPIO_BASE) & ~3u;
+    _pendingAccess = true;
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ | PROT_WRITE);
+    prepareRead();
+    memcpy(_shadow, (const void*) REGISTERS, REGISTERS_SIZE);
+    ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] |= 0x100; // Trap flag
+}
+
+void handlerTrap(int, siginfo_t*, void* context) {
+    if (_pendingAccess) {
+        _pendingAccess = false;
+        applyAccess(_accessOffset);
+        mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    }
+    if (_counting) {
+        _nInstructions++;
+    } else {
+        ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    }
+}
+
+// Count the instructions executed until stopCounting()
+void startCounting() {
+    _nInstructions = 0;
+    _counting = true;
+    __asm__ volatile("pushf\n\torl $0x100, (%%rsp)\n\tpopf" ::: "memory", "cc");
+}
+
+int stopCounting() {
+    _counting = false;
+    return _nInstructions;
+}
+
+// The model is changed by the signal handlers, behind the back of the compiler
+inline void barrier() {
+    __asm__ volatile("" ::: "memory");
+}
+
+void resetAccesses() {
+    _ctrl.nReads = 0;
+    _ctrl.nWrites = 0;
+    _ctrl.nChanges = 0;
+    barrier();
+}
+
+// Dependencies of gpio.cpp
+namespace GPIO {
+    uint8_t INTERRUPT_PRIORITY = 50;
+}
+namespace Core {
+    void setInterruptHandler(Interrupt, void (*)()) {}
+    void enableInterrupt(Interrupt, uint8_t) {}
+    void disableInterrupt(Interrupt) {}
+    Interrupt currentInterrupt() { return Interrupt::GPIO0; }
+}
+namespace Error {
+    void happened(Module, Code, Severity) {}
+}
+
+// Every pin of every port, against GPIO::set() and GPIO::get()
+template<GPIO::Port PORT, uint8_t COUNT>
+struct CheckPin {
+    static const uint8_t NUMBER = COUNT - 1;
+
+    static void run() {
+        using Fast = GPIO::FastPin<PORT, NUMBER>;
+        const GPIO::Pin pin = {PORT, NUMBER};
+        const int port = static_cast<int>(PORT);
+        const int id = port * 32 + NUMBER;
+        check(Fast::pin().port == PORT && Fast::pin().number == NUMBER, "pin()", id);
+
+        for (int i = 0; i < 8; i++) {
+            bool value = rand() % 2;
+            for (int p = 0; p < GPIO::N_PORTS; p++) {
+                _ctrl.ovr[p] = rand() ^ (uint32_t) rand() << 16;
+            }
+            Controller expected = _ctrl;
+            GPIO::set(pin, value);
+            barrier();
+            uint32_t reference[GPIO::N_PORTS];
+            memcpy(reference, _ctrl.ovr, sizeof(reference));
+            memcpy(_ctrl.ovr, expected.ovr, sizeof(reference));
+
+            resetAccesses();
+            Fast::set(value);
+            barrier();
+            check(memcmp(reference, _ctrl.ovr, sizeof(reference)) == 0, "set() differs from GPIO::set()", id);
+            check(_ctrl.nWrites == 1 && _ctrl.nReads == 0, "set() is not a single write", id);
+
+            _ctrl.pvr[port] = rand() ^ (uint32_t) rand() << 16;
+            resetAccesses();
+            bool fast = Fast::get();
+            barrier();
+            check(fast == GPIO::get(pin), "get() differs from GPIO::get()", id);
+            barrier();
+            check(_ctrl.nReads == 2 && _ctrl.nWrites == 0, "get() is not a single read", id);
+        }
+        Fast::setHigh();
+        barrier();
+        check(_ctrl.ovr[port] & (1u << NUMBER), "setHigh()", id);
+        Fast::setLow();
+        barrier();
+        check(!(_ctrl.ovr[port] & (1u << NUMBER)), "setLow()", id);
+
+        CheckPin<PORT, COUNT - 1>::run();
+    }
+};
+
+template<GPIO::Port PORT>
+struct CheckPin<PORT, 0> {
+    static void run() {}
+};
+
+// The outputs of the shutter : both edges in the same write, whatever the other pins of the port
+void checkOutputs() {
+    const int port = static_cast<int>(PIN_FOCUS.port);
+    check(PIN_FOCUS.port == PIN_TRIGGER.port, "outputs on different ports", 0);
+    check(FastPinsOutputs::MASK == (1u << PIN_FOCUS.number | 1u << PIN_TRIGGER.number), "mask of the outputs", FastPinsOutputs::MASK);
+    for (int i = 0; i < 4000; i++) {
+        bool focus = rand() % 2;
+        bool trigger = rand() % 2;
+        uint32_t others = (rand() ^ (uint32_t) rand() << 16) & ~FastPinsOutputs::MASK;
+        uint32_t before = others | (rand() % 2) << PIN_FOCUS.number | (rand() % 2) << PIN_TRIGGER.number;
+        _ctrl.ovr[port] = before;
+
+        resetAccesses();
+        FastPinsOutputs::set(focus, trigger);
+        barrier();
+        uint32_t expected = others | focus << PIN_FOCUS.number | trigger << PIN_TRIGGER.number;
+        check(_ctrl.ovr[port] == expected, "outputs", i);
+        check(_ctrl.nWrites <= 1, "outputs changed by several writes", _ctrl.nWrites);
+        check(_ctrl.nWrites == 1 || before == expected, "outputs not written", i);
+        check(_ctrl.nChanges == 0 || _ctrl.changes[0] == (before ^ expected), "outputs changed in the same write", i);
+        check(_ctrl.nReads == 1, "outputs read once", _ctrl.nReads);
+    }
+}
+
+// Instructions executed by each function for the focus output, and for both outputs
+void checkCost() {
+    const int N = 64;
+    int slow = 0;
+    int fast = 0;
+    int slowBoth = 0;
+    int fastBoth = 0;
+    for (int i = 0; i < N; i++) {
+        bool focus = i % 2;
+        bool trigger = i / 2 % 2;
+        startCounting();
+        GPIO::set(PIN_FOCUS, focus);
+        slow += stopCounting();
+        startCounting();
+        FastPinFocus::set(focus);
+        fast += stopCounting();
+        startCounting();
+        GPIO::set(PIN_FOCUS, focus);
+        GPIO::set(PIN_TRIGGER, trigger);
+        slowBoth += stopCounting();
+        startCounting();
+        FastPinsOutputs::set(focus, trigger);
+        fastBoth += stopCounting();
+    }
+    check(fast < slow, "FastPin::set() is not cheaper than GPIO::set()", fast);
+    check(fastBoth < slowBoth, "FastPins::set() is not cheaper than GPIO::set() twice", fastBoth);
+    printf("instructions per call (host) : GPIO::set() %.1f, FastPin::set() %.1f, "
+        "GPIO::set() x2 %.1f, FastPins::set() %.1f\n", double(slow) / N, double(fast) / N,
+        double(slowBoth) / N, double(fastBoth) / N);
+}
+
+int main() {
+    srand(1);
+
+    void* registers = mmap((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (registers != (void*) REGISTERS) {
+        fprintf(stderr, "unable to map the registers at their address\n");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = handlerSegv;
+    sigaction(SIGSEGV, &action, nullptr);
+    action.sa_sigaction = handlerTrap;
+    sigaction(SIGTRAP, &action, nullptr);
+
+    CheckPin<GPIO::Port::A, 32>::run();
+    CheckPin<GPIO::Port::B, 32>::run();
+    CheckPin<GPIO::Port::C, 32>::run();
+    checkOutputs();
+    checkCost();
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
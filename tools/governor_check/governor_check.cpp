@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include "governor.h"
+
+// Host check of the clock governor (governor.h). The switch sequences are applied step by step to
+// a model of the clock tree of the SAM4L, which checks the limits of the power scaling modes and
+// of the flash, that the PBA clock used by the SPI, the TC timebases and the ADC is never faster
+// than 12MHz and only slower with the interrupts disabled, and that the clocks of the USB and of
+// the AST are not touched, nor the power scaling between IDLE_PS2 and BOOST. Then the policy is
+// driven by a simulated main loop with random work, across the wrap-around of the time.
+
+using Governor::Level;
+using Governor::Step;
+
+int _nChecks = 0;
+int _nFailures = 0;
+bool _quiet = false; // While looking for the other valid orders of the sequences
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+// Model of the clock tree (see datasheet §42.8 and §10 Power Manager)
+struct ClockTree {
+    int ps = 0;
+    bool highSpeed = false;
+    bool waitState = false;
+    bool mainPLL = false;
+    unsigned long pbaDivider = 0;
+    bool interrupts = true;
+    bool valid = true;
+
+    // Never changed by the governor : the PLL drives the USB and uses RCFAST as reference
+    const unsigned long RCFAST = 12000000;
+    const unsigned long PLL = 48000000;
+    const unsigned long PBA = 12000000;
+
+    unsigned long cpu() const {
+        return mainPLL ? PLL : RCFAST;
+    }
+
+    unsigned long pba() const {
+        return cpu() >> pbaDivider;
+    }
+
+    unsigned long cpuMax() const {
+        return ps == 2 ? 48000000 : ps == 1 ? 12000000 : 36000000;
+    }
+
+    unsigned long flashMax() const {
+        if (highSpeed) {
+            return waitState ? 48000000 : 24000000;
+        }
+        return waitState ? 36000000 : 18000000;
+    }
+
+    void require(bool condition, const char* what, int step) {
+        if (!condition) {
+            valid = false;
+        }
+        if (!_quiet) {
+            check(condition, what, step);
+        }
+    }
+
+    void apply(Step step) {
+        int s = static_cast<int>(step);
+        switch (step) {
+            case Step::DISABLE_INTERRUPTS:
+                require(interrupts, "interrupts already disabled", s);
+                interrupts = false;
+                break;
+
+            case Step::ENABLE_INTERRUPTS:
+                require(!interrupts, "interrupts already enabled", s);
+                interrupts = true;
+                break;
+
+            case Step::POWER_SCALING_PS0:
+                // BPM::setPowerScaling() waits for the regulator with the interrupts masked by itself
+                require(interrupts, "power scaling in a critical section", s);
+                require(cpu() <= 36000000, "PS0 with a CPU too fast", s);
+                if (ps == 2) {
+                    highSpeed = false;
+                }
+                ps = 0;
+                break;
+
+            case Step::POWER_SCALING_PS2:
+                require(interrupts, "power scaling in a critical section", s);
+                highSpeed = true;
+                ps = 2;
+                break;
+
+            case Step::FLASH_NO_WAIT_STATE:
+                waitState = false;
+                break;
+
+            case Step::FLASH_WAIT_STATE:
+                waitState = true;
+                break;
+
+            case Step::PBA_UNDIVIDED:
+                require(!interrupts, "PBA changed with the interrupts enabled", s);
+                pbaDivider = 0;
+                break;
+
+            case Step::PBA_DIVIDED:
+                require(!interrupts, "PBA changed with the interrupts enabled", s);
+                pbaDivider = Governor::PBA_DIVIDER_BOOST;
+                break;
+
+            case Step::MAIN_CLOCK_IDLE:
+                require(!interrupts, "main clock changed with the interrupts enabled", s);
+                mainPLL = false;
+                break;
+
+            case Step::MAIN_CLOCK_BOOST:
+                require(!interrupts, "main clock changed with the interrupts enabled", s);
+                mainPLL = true;
+                break;
+        }
+
+        // Limits which must hold after every step
+        require(cpu() <= cpuMax(), "CPU faster than the power scaling allows", s);
+        require(cpu() <= flashMax(), "CPU faster than the flash allows", s);
+        require(ps != 2 || highSpeed, "PS2 without the flash high speed mode", s);
+        require(pba() <= PBA, "PBA faster than 12MHz", s);
+        require(pba() == PBA || !interrupts, "PBA slower than 12MHz with the interrupts enabled", s);
+    }
+
+    // State once a sequence is complete
+    void requireLevel(Level level) {
+        bool boost = level == Level::BOOST;
+        bool scaled = level != Level::IDLE;
+        require(interrupts, "interrupts left disabled", 0);
+        require(cpu() == (boost ? Governor::BOOST_FREQUENCY : Governor::IDLE_FREQUENCY), "CPU frequency", cpu());
+        require(pba() == PBA, "PBA frequency", pba());
+        require(ps == (scaled ? 2 : 0), "power scaling", ps);
+        require(waitState == scaled, "flash wait state", waitState);
+        require(highSpeed == scaled, "flash high speed mode", highSpeed);
+    }
+};
+
+// Apply a whole sequence to a tree, and return whether it stayed valid
+bool run(ClockTree& tree, const Step* steps, int nSteps, Level level) {
+    for (int i = 0; i < nSteps; i++) {
+        tree.apply(steps[i]);
+    }
+    tree.requireLevel(level);
+    return tree.valid;
+}
+
+// Apply the sequence of the governor between two levels. Between IDLE_PS2 and BOOST, only the
+// PBA divider and the main clock may change, in the critical section.
+bool run(ClockTree& tree, Level from, Level to) {
+    int nSteps = 0;
+    const Step* steps = Governor::sequence(from, to, nSteps);
+    if (from != Level::IDLE && to != Level::IDLE) {
+        for (int i = 0; i < nSteps; i++) {
+            bool clock = steps[i] == Step::PBA_DIVIDED || steps[i] == Step::PBA_UNDIVIDED
+                || steps[i] == Step::MAIN_CLOCK_BOOST || steps[i] == Step::MAIN_CLOCK_IDLE;
+            bool critical = steps[i] == Step::DISABLE_INTERRUPTS || steps[i] == Step::ENABLE_INTERRUPTS;
+            check(clock || critical, "power scaling or flash changed in low latency", static_cast<int>(steps[i]));
+        }
+    }
+    return run(tree, steps, nSteps, to);
+}
+
+void checkSequences() {
+    // The sequences of the governor, back and forth
+    ClockTree tree;
+    tree.requireLevel(Level::IDLE);
+    for (int i = 0; i < 3; i++) {
+        check(run(tree, Level::IDLE, Level::BOOST), "boost sequence", i);
+        check(run(tree, Level::BOOST, Level::IDLE), "idle sequence", i);
+    }
+    int nSteps = 0;
+    check(std::equal(Governor::BOOST_SEQUENCE, Governor::BOOST_SEQUENCE + Governor::N_STEPS, Governor::sequence(Level::IDLE, Level::BOOST, nSteps)), "boost table", 0);
+    check(std::equal(Governor::IDLE_SEQUENCE, Governor::IDLE_SEQUENCE + Governor::N_STEPS, Governor::sequence(Level::BOOST, Level::IDLE, nSteps)), "idle table", 0);
+
+    // Every switch between the three levels
+    const Level LEVELS[] = {Level::IDLE, Level::IDLE_PS2, Level::BOOST};
+    for (Level from : LEVELS) {
+        for (Level to : LEVELS) {
+            if (from == to) {
+                continue;
+            }
+            ClockTree t;
+            if (from != Level::IDLE) {
+                run(t, Level::IDLE, from);
+            }
+            check(run(t, from, to), "switch between levels", static_cast<int>(from) * 10 + static_cast<int>(to));
+        }
+    }
+
+    // Every order of the same steps : the model must reject most of them, including the
+    // sequences in reverse, otherwise it would not be checking much
+    _quiet = true;
+    for (int s = 0; s < 2; s++) {
+        Level level = s == 0 ? Level::BOOST : Level::IDLE;
+        const Step* sequence = s == 0 ? Governor::BOOST_SEQUENCE : Governor::IDLE_SEQUENCE;
+        Step steps[Governor::N_STEPS];
+        std::copy(sequence, sequence + Governor::N_STEPS, steps);
+        std::sort(steps, steps + Governor::N_STEPS);
+        int nOrders = 0;
+        int nValid = 0;
+        do {
+            ClockTree t;
+            if (level == Level::IDLE) {
+                run(t, Governor::BOOST_SEQUENCE, Governor::N_STEPS, Level::BOOST);
+            }
+            nOrders++;
+            if (run(t, steps, Governor::N_STEPS, level)) {
+                nValid++;
+            }
+        } while (std::next_permutation(steps, steps + Governor::N_STEPS));
+
+        Step reversed[Governor::N_STEPS];
+        std::reverse_copy(sequence, sequence + Governor::N_STEPS, reversed);
+        ClockTree t;
+        if (level == Level::IDLE) {
+            run(t, Governor::BOOST_SEQUENCE, Governor::N_STEPS, Level::BOOST);
+        }
+        run(t, reversed, Governor::N_STEPS, level);
+        check(!t.valid, "reversed sequence accepted", s);
+        check(nValid > 0 && nValid * 10 <= nOrders, "too many valid orders", nValid);
+        printf("%s : %d valid orders out of %d\n", s == 0 ? "boost" : "idle ", nValid, nOrders);
+    }
+    _quiet = false;
+}
+
+// Simulated main loop : random work (button events, commands, screen refreshes) arrives in bursts,
+// and each iteration sleeps 10ms like the firmware. The work runs faster when boosted.
+struct LoopStats {
+    int nDemands = 0;
+    int nBoosts = 0;
+    int nExpectedBoosts = 0;
+    double workMs = 0;
+    double boostedMs = 0;
+    double totalMs = 0;
+};
+
+void checkPolicy(uint32_t t0, bool toggleEnabled, bool toggleLowLatency, LoopStats& stats) {
+    Governor::reset();
+    ClockTree tree;
+    uint32_t t = t0;
+    bool enabled = true;
+    bool lowLatency = false;
+    bool demanded = false;
+    bool held = false; // Expected level at the end of the previous iteration
+    uint32_t tLastDemand = 0;
+    for (int n = 0; n < 200000; n++) {
+        if (toggleEnabled && rand() % 500 == 0) {
+            enabled = !enabled;
+            Governor::setEnabled(enabled);
+        }
+        if (toggleLowLatency && rand() % 300 == 0) {
+            lowLatency = !lowLatency;
+            Governor::setLowLatency(lowLatency);
+        }
+        Level idle = lowLatency ? Level::IDLE_PS2 : Level::IDLE;
+
+        // Work in this iteration, more likely right after other work
+        bool work = rand() % (demanded && t - tLastDemand < 100 ? 3 : 40) == 0;
+        double workMs = 0;
+        if (work) {
+            if (enabled && !held) {
+                stats.nExpectedBoosts++;
+            }
+            Governor::demand(t);
+            stats.nDemands++;
+            Level from;
+            Level to;
+            if (Governor::change(t, from, to)) {
+                check(run(tree, from, to), "switch on a demand", n);
+                if (to == Level::BOOST) {
+                    stats.nBoosts++;
+                }
+            }
+            check(Governor::level() == (enabled ? Level::BOOST : idle), "work not boosted", n);
+            check(tree.cpu() == (enabled ? Governor::BOOST_FREQUENCY : Governor::IDLE_FREQUENCY), "clock tree out of sync", n);
+            demanded = true;
+            tLastDemand = t;
+
+            // ~20ms of CPU work at 12MHz (a full screen rendering)
+            workMs = (1 + rand() % 20) * double(Governor::IDLE_FREQUENCY) / tree.cpu();
+            stats.workMs += workMs;
+        }
+        uint32_t tEnd = t + uint32_t(workMs);
+
+        // End of the iteration, before the sleep
+        Level from;
+        Level to;
+        if (Governor::change(tEnd, from, to)) {
+            check(run(tree, from, to), "switch at the end of an iteration", n);
+            if (to == Level::BOOST) {
+                stats.nBoosts++;
+            }
+        }
+        held = enabled && demanded && tEnd - tLastDemand < Governor::HOLD;
+        check(Governor::level() == (held ? Level::BOOST : idle), "level after the hold", n);
+        check(tree.cpu() == (held ? Governor::BOOST_FREQUENCY : Governor::IDLE_FREQUENCY), "clock tree out of sync", n);
+
+        uint32_t iteration = uint32_t(workMs) + 10 + rand() % 2;
+        if (Governor::level() == Level::BOOST) {
+            stats.boostedMs += iteration;
+        }
+        stats.totalMs += iteration;
+        t += iteration;
+    }
+}
+
+int main() {
+    srand(1);
+
+    checkSequences();
+
+    // Policy, with the boost always enabled : one switch for each demand after the hold
+    LoopStats stats;
+    checkPolicy(0, false, false, stats);
+    check(stats.nBoosts == stats.nExpectedBoosts, "number of boosts", stats.nBoosts);
+    printf("policy : %d demands, %d boosts, boosted %.1f%% of the time\n", stats.nDemands, stats.nBoosts, 100.0 * stats.boostedMs / stats.totalMs);
+
+    // Across the wrap-around of the time, in and out of passthrough mode, and disabled from time
+    // to time
+    LoopStats wrapStats;
+    checkPolicy(0xFFFFFFFF - 500000, false, false, wrapStats);
+    check(wrapStats.nBoosts == wrapStats.nExpectedBoosts, "number of boosts across the wrap-around", wrapStats.nBoosts);
+    LoopStats lowLatencyStats;
+    checkPolicy(0, false, true, lowLatencyStats);
+    check(lowLatencyStats.nBoosts == lowLatencyStats.nExpectedBoosts, "number of boosts in low latency", lowLatencyStats.nBoosts);
+    LoopStats disabledStats;
+    checkPolicy(0, true, true, disabledStats);
+
+    // A demand long ago does not come back after the time wraps around
+    Governor::reset();
+    Governor::demand(1000);
+    Level from;
+    Level to;
+    check(Governor::change(1000, from, to) && to == Level::BOOST, "boost", 0);
+    check(Governor::change(1000 + Governor::HOLD, from, to) && to == Level::IDLE, "end of the hold", 0);
+    check(!Governor::change(1000 + 0xFFFFFFFFu, from, to), "demand back after the wrap-around", 0);
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "flash.h"
+#include <string.h>
+#include <stdlib.h>
+
+namespace Flash {
+
+    int _commandsBeforeCut = -1;
+    int _nErases[FLASH_PAGES];
+    int _nPrograms = 0;
+
+    uint32_t _memory[FLASH_PAGES * FLASH_PAGE_SIZE_WORDS];
+
+    // Internal functions
+    bool isCut();
+    uint32_t randomWord();
+
+
+    // Return true if the power is cut during the current command
+    bool isCut() {
+        if (_commandsBeforeCut < 0) {
+            return false;
+        }
+        return _commandsBeforeCut-- == 0;
+    }
+
+    uint32_t randomWord() {
+        return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+    }
+
+    bool isReady() {
+        return true;
+    }
+
+    uint32_t read(uint32_t address) {
+        return _memory[address / 4];
+    }
+
+    void readPage(int page, uint32_t data[]) {
+        memcpy(data, _memory + page * FLASH_PAGE_SIZE_WORDS, FLASH_PAGE_SIZE_BYTES);
+    }
+
+    void erasePage(int page) {
+        uint32_t* p = _memory + page * FLASH_PAGE_SIZE_WORDS;
+        _nErases[page]++;
+        if (isCut()) {
+            // Interrupted erase : some bits are already set, the others keep their value, unless the
+            // power was lost just after the end of the command
+            bool done = rand() % 4 == 0;
+            for (int i = 0; i < FLASH_PAGE_SIZE_WORDS; i++) {
+                p[i] |= done ? 0xFFFFFFFF : randomWord() & randomWord();
+            }
+            throw PowerCut();
+        }
+        memset(p, 0xFF, FLASH_PAGE_SIZE_BYTES);
+    }
+
+    void programPage(int page, const uint32_t data[]) {
+        // The flash only allows 1-to-0 transitions
+        uint32_t* p = _memory + page * FLASH_PAGE_SIZE_WORDS;
+        _nPrograms++;
+        if (isCut()) {
+            // Interrupted program : only some of the bits are cleared, unless the power was lost
+            // just after the end of the command
+            bool done = rand() % 4 == 0;
+            for (int i = 0; i < FLASH_PAGE_SIZE_WORDS; i++) {
+                p[i] &= data[i] | (done ? 0 : randomWord() | randomWord());
+            }
+            throw PowerCut();
+        }
+        for (int i = 0; i < FLASH_PAGE_SIZE_WORDS; i++) {
+            p[i] &= data[i];
+        }
+    }
+
+    uint32_t* memory() {
+        return _memory;
+    }
+
+}
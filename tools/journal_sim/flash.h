@@ -0,0 +1,31 @@
+#ifndef _FLASH_H_
+#define _FLASH_H_
+
+#include <stdint.h>
+
+// Simulated replacement of libtungsten/sam4l/flash.h, used to test the settings journal on the
+// host. Commands complete immediately, but a power cut can be scheduled : the command which
+// triggers it is only partially applied, then PowerCut is thrown.
+namespace Flash {
+
+    const int FLASH_PAGE_SIZE_BYTES = 512; // bytes
+    const int FLASH_PAGE_SIZE_WORDS = 128; // words
+    const int FLASH_PAGES = 512; // pages
+
+    // Module API, same as the real one
+    bool isReady();
+    uint32_t read(uint32_t address);
+    void readPage(int page, uint32_t data[]);
+    void erasePage(int page);
+    void programPage(int page, const uint32_t data[]);
+
+    // Simulation
+    struct PowerCut {};
+    extern int _commandsBeforeCut; // -1 : no power cut scheduled
+    extern int _nErases[FLASH_PAGES];
+    extern int _nPrograms;
+    uint32_t* memory();
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "flash.h"
+#include "journal.h"
+
+// Host check of the settings journal (journal.cpp, compiled as is against a simulated flash) :
+// random saves, with power cuts injected during some of them. After each cut the journal is
+// read back as on boot, and must contain either the state before the interrupted save or the
+// state after it.
+// Usage : journal_check [--saves N] [--fields N] [--seed N]
+
+const int DEFAULT_VALUE = 0x5A5A5A5A; // Value of the fields not found in the journal
+
+int _nFields = 15;
+uint32_t _committed[Journal::MAX_FIELDS];
+bool _hasCommitted = false;
+
+// Read the journal as on boot, and return true if it contains the expected state
+bool reboot(const uint32_t expected[], bool& matches) {
+    uint32_t values[Journal::MAX_FIELDS];
+    for (int i = 0; i < _nFields; i++) {
+        values[i] = DEFAULT_VALUE;
+    }
+    uint32_t mask = Journal::init(values, _nFields);
+    uint32_t all = _nFields < Journal::MAX_FIELDS ? (1u << _nFields) - 1 : 0xFFFFFFFF;
+    if (mask == 0) {
+        matches = false;
+        return true;
+    }
+    if (mask != all) {
+        return false;
+    }
+    matches = memcmp(values, expected, _nFields * 4) == 0;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int nSaves = 200000;
+    unsigned int seed = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--saves" && i + 1 < argc) {
+            nSaves = atoi(argv[++i]);
+        } else if (arg == "--fields" && i + 1 < argc) {
+            _nFields = atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (_nFields < 1 || _nFields > Journal::MAX_FIELDS) {
+        fprintf(stderr, "The number of fields must be between 1 and %d\n", Journal::MAX_FIELDS);
+        return 1;
+    }
+    srand(seed);
+
+    // The journal pages start with random content, as if they had been used by something else
+    uint32_t* memory = Flash::memory();
+    for (int i = 0; i < Journal::N_PAGES * Flash::FLASH_PAGE_SIZE_WORDS; i++) {
+        memory[Journal::FIRST_PAGE * Flash::FLASH_PAGE_SIZE_WORDS + i] = rand() % 4 == 0 ? 0xFFFFFFFF : (uint32_t)rand();
+    }
+    uint32_t values[Journal::MAX_FIELDS];
+    Journal::init(values, _nFields);
+
+    int nCuts = 0;
+    int nInterruptedSaves = 0;
+    int nWritten = 0;
+    for (int s = 0; s < nSaves; s++) {
+        // Change a few fields, like a user editing the settings
+        uint32_t next[Journal::MAX_FIELDS];
+        memcpy(next, _committed, sizeof(next));
+        int nChanges = rand() % 20 == 0 ? _nFields : rand() % 4;
+        for (int i = 0; i < nChanges; i++) {
+            next[rand() % _nFields] = rand() % 8 == 0 ? 0xFFFFFFFF : rand() % 1000;
+        }
+        if (!_hasCommitted) {
+            // Every field of the first save is written
+            next[0] ^= 1;
+        }
+
+        bool cut = rand() % 4 == 0;
+        Flash::_commandsBeforeCut = cut ? rand() % 2 : -1;
+        try {
+            nWritten += Journal::save(next, _nFields);
+            Flash::_commandsBeforeCut = -1;
+            memcpy(_committed, next, sizeof(_committed));
+            _hasCommitted = true;
+        } catch (Flash::PowerCut&) {
+            nCuts++;
+            bool isNew = false;
+            bool isOld = false;
+            if (!reboot(next, isNew) || !reboot(_committed, isOld) || (!isNew && !isOld && _hasCommitted)) {
+                fprintf(stderr, "FAIL : inconsistent state after a power cut during save %d\n", s);
+                return 1;
+            }
+            if (isNew) {
+                memcpy(_committed, next, sizeof(_committed));
+                _hasCommitted = true;
+            } else {
+                nInterruptedSaves++;
+            }
+            continue;
+        }
+
+        // A save which wasn't interrupted must survive a reboot
+        if (cut || rand() % 16 == 0) {
+            bool matches = false;
+            if (!reboot(_committed, matches) || !matches) {
+                fprintf(stderr, "FAIL : state lost after save %d\n", s);
+                return 1;
+            }
+        }
+    }
+
+    int minErases = Flash::_nErases[Journal::FIRST_PAGE];
+    int maxErases = minErases;
+    int totalErases = 0;
+    for (int i = 0; i < Journal::N_PAGES; i++) {
+        int n = Flash::_nErases[Journal::FIRST_PAGE + i];
+        minErases = n < minErases ? n : minErases;
+        maxErases = n > maxErases ? n : maxErases;
+        totalErases += n;
+    }
+    printf("ok   %d saves (%d fields written), %d power cuts (%d saves lost)\n", nSaves, nWritten, nCuts, nInterruptedSaves);
+    printf("     %d page programs, %d page erases over %d pages (%d to %d per page), %.1f saves per erase\n",
+        Flash::_nPrograms, totalErases, Journal::N_PAGES, minErases, maxErases, (double)nSaves / totalErases);
+    return 0;
+}
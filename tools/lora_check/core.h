@@ -0,0 +1,11 @@
+#ifndef _CORE_H_
+#define _CORE_H_
+
+// Minimal replacement of libtungsten/sam4l/core.h : the driver only waits for the modem
+namespace Core {
+
+    inline void sleep(unsigned long length) {}
+
+}
+
+#endif
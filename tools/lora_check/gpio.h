@@ -0,0 +1,31 @@
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+#include <stdint.h>
+
+// Minimal replacement of libtungsten/sam4l/gpio.h : the reset pin of the modem is not modelled
+namespace GPIO {
+
+    enum class Port {
+        A,
+        B,
+        C,
+    };
+
+    struct Pin {
+        Port port;
+        uint8_t number;
+    };
+
+    constexpr Pin PA00 = {Port::A, 0};
+
+    using PinState = bool;
+    const PinState LOW = false;
+    const PinState HIGH = true;
+
+    inline void enableOutput(const Pin& pin, PinState value) {}
+    inline void set(const Pin& pin, PinState value) {}
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "drivers/lora/lora.h"
+
+// Host check of the LoRa driver (drivers/lora) against a register file standing for the modem :
+// the time on air computed by the driver is compared with the formula of the datasheet (§4.1.1.7)
+// evaluated in floating point from the configuration actually written to the registers, over
+// every spreading factor, bandwidth, coding rate and header mode, and with values given by the
+// Semtech calculator. The frequency error read from the FEI registers is compared with the formula
+// of §4.1.5 over the whole 20-bit range, and the automatic frequency correction is run between
+// modelled modules with drifting crystals and noisy measurements : they must converge toward each
+// other without walking together toward the limit of the offset.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, double value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%g)\n", what, value);
+        }
+    }
+}
+
+// Register file of the modem. The FIFO is not modelled : its bytes are discarded and read as 0.
+const int N_REGISTERS = 0x80;
+uint8_t _registers[N_REGISTERS];
+bool _fifoSelected = false;
+
+namespace SPI {
+
+    uint8_t transfer(Peripheral peripheral, uint8_t tx, bool next) {
+        return _registers[tx & 0x7F];
+    }
+
+    void transfer(Peripheral peripheral, uint8_t* txBuffer, int txBufferSize, uint8_t* rxBuffer, int rxBufferSize, bool partial) {
+        if (_fifoSelected) {
+            _fifoSelected = false;
+            if (rxBuffer != nullptr) {
+                memset(rxBuffer, 0, rxBufferSize);
+            }
+            return;
+        }
+        uint8_t address = txBuffer[0] & 0x7F;
+        if (address == LoRa::REG_FIFO) {
+            _fifoSelected = partial;
+        } else if (txBufferSize == 2 && (txBuffer[0] & 0x80)) {
+            if (address == LoRa::REG_IRQ_FLAGS) {
+                _registers[address] &= ~txBuffer[1];
+            } else {
+                _registers[address] = txBuffer[1];
+            }
+        }
+    }
+
+}
+
+// Datasheet formula, from the registers
+double referenceTimeOnAir(int length) {
+    const int sf = _registers[LoRa::REG_MODEM_CONFIG_2] >> 4;
+    const int crc = (_registers[LoRa::REG_MODEM_CONFIG_2] >> LoRa::REG_MODEM_CONFIG_2_RX_PAYLOAD_CRC_ON) & 1;
+    const int ih = (_registers[LoRa::REG_MODEM_CONFIG_1] >> LoRa::REG_MODEM_CONFIG_1_IMPLICIT_HEADER_MODE) & 1;
+    const int cr = (_registers[LoRa::REG_MODEM_CONFIG_1] >> LoRa::REG_MODEM_CONFIG_1_CODING_RATE) & 0x07;
+    const double bw = LoRa::BANDWIDTH_HZ[_registers[LoRa::REG_MODEM_CONFIG_1] >> LoRa::REG_MODEM_CONFIG_1_BW];
+    const int de = (_registers[LoRa::REG_MODEM_CONFIG_3] >> LoRa::REG_MODEM_CONFIG_3_LOW_DATA_RATE_OPTIMIZE) & 1;
+    const int preambleLength = _registers[LoRa::REG_PREAMBLE_MSB] << 8 | _registers[LoRa::REG_PREAMBLE_LSB];
+
+    double tSymbol = pow(2, sf) / bw;
+    double nPayloadSymbols = 8 + fmax(ceil((8.0 * length - 4 * sf + 28 + 16 * crc - 20 * ih) / (4.0 * (sf - 2 * de))) * (cr + 4), 0);
+    return (preambleLength + 4.25 + nPayloadSymbols) * tSymbol * 1e6;
+}
+
+void configure(int sf, LoRa::Bandwidth bw, LoRa::CodingRate cr, int preambleLength) {
+    LoRa::setSpreadingFactor(sf);
+    LoRa::setBandwidth(bw);
+    LoRa::setCodingRate(cr);
+    LoRa::setPreambleLength(preambleLength);
+}
+
+// Datasheet formula of the frequency error, from the registers
+double referenceFrequencyError() {
+    int32_t fei = (_registers[LoRa::REG_FEI_MSB] & 0x0F) << 16 | _registers[LoRa::REG_FEI_MID] << 8 | _registers[LoRa::REG_FEI_LSB];
+    if (fei >= 0x80000) {
+        fei -= 0x100000;
+    }
+    const double bw = LoRa::BANDWIDTH_HZ[_registers[LoRa::REG_MODEM_CONFIG_1] >> LoRa::REG_MODEM_CONFIG_1_BW];
+    return fei * pow(2, 24) / LoRa::XOSC_FREQUENCY * bw / 500000;
+}
+
+void setFEI(int32_t fei) {
+    _registers[LoRa::REG_FEI_MSB] = (fei >> 16) & 0x0F;
+    _registers[LoRa::REG_FEI_MID] = (fei >> 8) & 0xFF;
+    _registers[LoRa::REG_FEI_LSB] = fei & 0xFF;
+}
+
+// A module running the frequency correction of the driver, whose state is swapped in and out of
+// the driver around each packet it receives
+struct Module {
+    double crystalError; // Hz, at the carrier frequency
+    int32_t offset; // Hz, corrected by the driver
+
+    // Error of the carrier to the nominal frequency
+    double carrier() const {
+        return crystalError + offset;
+    }
+};
+
+// Gaussian noise of the FEI measurement
+double noise(double sigma) {
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        sum += (double) rand() / RAND_MAX;
+    }
+    return (sum - 6) * sigma;
+}
+
+// The receiver measures the error of the sender, then corrects its own frequency
+void receive(Module& receiver, const Module& sender, double sigma) {
+    LoRa::setFrequencyOffset(receiver.offset);
+    double error = sender.carrier() - receiver.carrier() + noise(sigma);
+    LoRa::correctFrequency(static_cast<int32_t>(error));
+    receiver.offset = LoRa::getFrequencyOffset();
+}
+
+struct AFCStats {
+    double maxCommonOffset; // After convergence
+    double maxResidual; // After convergence
+};
+
+// Packets are exchanged between the two modules : both ways if bidirectional, from b to a otherwise
+AFCStats runAFC(double crystalA, double crystalB, bool bidirectional, double sigma, int nPackets) {
+    Module a = {crystalA, 0};
+    Module b = {crystalB, 0};
+    AFCStats stats = {0, 0};
+    for (int i = 0; i < nPackets; i++) {
+        if (bidirectional && rand() % 2) {
+            receive(b, a, sigma);
+        } else {
+            receive(a, b, sigma);
+        }
+        check(a.offset <= LoRa::AFC_MAX_OFFSET && a.offset >= -LoRa::AFC_MAX_OFFSET, "offset out of range", a.offset);
+        if (i >= nPackets / 10) {
+            stats.maxCommonOffset = fmax(stats.maxCommonOffset, fabs(a.offset + b.offset) / 2);
+            stats.maxResidual = fmax(stats.maxResidual, fabs(a.carrier() - b.carrier()));
+        }
+    }
+    return stats;
+}
+
+void checkFrequencyCorrection() {
+    // FEI over the whole range of the register, at every bandwidth
+    for (int bw = 0; bw <= static_cast<int>(LoRa::Bandwidth::BW_500kHz); bw++) {
+        LoRa::setBandwidth(static_cast<LoRa::Bandwidth>(bw));
+        for (int32_t fei = -0x80000; fei < 0x80000; fei += 37) {
+            setFEI(fei);
+            double reference = referenceFrequencyError();
+            check(fabs(LoRa::lastPacketFrequencyError() - reference) < 1, "frequency error", reference);
+        }
+        setFEI(-1);
+        check(fabs(LoRa::lastPacketFrequencyError() - referenceFrequencyError()) < 1, "frequency error of -1", -1);
+    }
+    LoRa::setBandwidth(LoRa::Bandwidth::BW_125kHz);
+
+    // The offset is limited, and small corrections are ignored
+    LoRa::setFrequencyOffset(10 * LoRa::AFC_MAX_OFFSET);
+    check(LoRa::getFrequencyOffset() == LoRa::AFC_MAX_OFFSET, "offset limit", LoRa::getFrequencyOffset());
+    LoRa::setFrequencyOffset(0);
+    LoRa::correctFrequency(LoRa::AFC_MIN_CORRECTION * (1 << LoRa::AFC_GAIN_SHIFT) - 1);
+    check(LoRa::getFrequencyOffset() == 0, "correction under the minimum", LoRa::getFrequencyOffset());
+
+    // Crystals of +/-10ppm and +/-20ppm at 868MHz, and a measurement noise of 300Hz
+    const double SIGMA = 300;
+    const double CRYSTALS[][2] = {{8680, -8680}, {17360, -17360}, {17360, 17360}, {-17360, 5000}, {0, 0}};
+    const double LEAK = 1.0 / (1 << LoRa::AFC_LEAK_SHIFT);
+    const double GAIN = 1.0 / (1 << LoRa::AFC_GAIN_SHIFT);
+    for (const auto& c : CRYSTALS) {
+        double difference = fabs(c[0] - c[1]);
+        double deadband = LoRa::AFC_MIN_CORRECTION / GAIN;
+
+        // One-way : only the receiver corrects, and stays close to the sender unless the offset
+        // needed is beyond the limit
+        AFCStats oneWay = runAFC(c[0], c[1], false, SIGMA, 20000);
+        double oneWayResidual = fmax(difference * LEAK / (GAIN + LEAK), difference - LoRa::AFC_MAX_OFFSET);
+        check(oneWay.maxResidual <= oneWayResidual + deadband + 4 * SIGMA, "one-way residual error", oneWay.maxResidual);
+
+        // Both ways : the modules stay closer than their crystals, and their common offset is
+        // pulled back to zero, so that it only shows the noise of the corrections (its standard
+        // deviation is ~GAIN * SIGMA / sqrt(2 * LEAK)). Without the leak, it would walk by
+        // ~GAIN * SIGMA / 2 * sqrt(nPackets), up to the limit.
+        AFCStats twoWays = runAFC(c[0], c[1], true, SIGMA, 200000);
+        check(twoWays.maxCommonOffset <= 6 * GAIN * SIGMA / sqrt(2 * LEAK) + deadband, "common offset walks", twoWays.maxCommonOffset);
+        check(twoWays.maxResidual <= difference * LEAK / (2 * GAIN + LEAK) + deadband + 4 * SIGMA, "two-way residual error", twoWays.maxResidual);
+        printf("afc : crystals %+6.0fHz %+6.0fHz, one-way residual %5.0fHz, two-way residual %5.0fHz, common offset %5.0fHz\n",
+            c[0], c[1], oneWay.maxResidual, twoWays.maxResidual, twoWays.maxCommonOffset);
+    }
+}
+
+int main() {
+    _registers[LoRa::REG_VERSION] = 0x12;
+    check(LoRa::init(0), "init", 0);
+
+    // Every configuration, with the preamble lengths used by the low-power reception (see sync.h)
+    const int PREAMBLE_LENGTHS[] = {6, 8, 130, 252, 496, 984};
+    double maxError = 0;
+    for (int sf = 6; sf <= 12; sf++) {
+        for (int bw = 0; bw <= static_cast<int>(LoRa::Bandwidth::BW_500kHz); bw++) {
+            for (int cr = 1; cr <= 4; cr++) {
+                for (int preambleLength : PREAMBLE_LENGTHS) {
+                    configure(sf, static_cast<LoRa::Bandwidth>(bw), static_cast<LoRa::CodingRate>(cr), preambleLength);
+
+                    // The low data rate optimization follows the symbol duration
+                    double tSymbol = pow(2, sf) / LoRa::BANDWIDTH_HZ[bw] * 1e6;
+                    bool ldro = (_registers[LoRa::REG_MODEM_CONFIG_3] >> LoRa::REG_MODEM_CONFIG_3_LOW_DATA_RATE_OPTIMIZE) & 1;
+                    check(ldro == (tSymbol > 16000), "low data rate optimization", tSymbol);
+                    check(fabs(LoRa::symbolDuration() - tSymbol) < 1, "symbol duration", tSymbol);
+
+                    for (int explicitHeader = 0; explicitHeader <= 1; explicitHeader++) {
+                        LoRa::setExplicitHeader(explicitHeader);
+                        for (int length = 1; length <= LoRa::MAX_TX_LENGTH; length++) {
+                            double reference = referenceTimeOnAir(length);
+                            double error = reference - LoRa::timeOnAir(length, explicitHeader);
+                            // The driver rounds down to the microsecond
+                            check(error >= -1e-3 && error < 1, "time on air", reference);
+                            maxError = fmax(maxError, fabs(error));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Values of the Semtech LoRa calculator, and the frames of Sync at the default settings
+    struct Case {
+        int sf;
+        LoRa::CodingRate cr;
+        bool explicitHeader;
+        int length;
+        uint32_t timeOnAir; // us
+    };
+    const Case CASES[] = {
+        {7, LoRa::CodingRate::RATE_4_5, true, 10, 41216},
+        {12, LoRa::CodingRate::RATE_4_5, true, 10, 991232}, // Low data rate optimization
+        {8, LoRa::CodingRate::RATE_4_8, false, 3, 57856}, // Fast frame
+        {8, LoRa::CodingRate::RATE_4_8, true, 19, 139776}, // Settings frame with the largest payload
+    };
+    for (const Case& c : CASES) {
+        configure(c.sf, LoRa::Bandwidth::BW_125kHz, c.cr, LoRa::DEFAULT_PREAMBLE_LENGTH);
+        check(LoRa::timeOnAir(c.length, c.explicitHeader) == c.timeOnAir, "reference time on air", c.timeOnAir);
+    }
+
+    // The header mode given to timeOnAir() doesn't depend on the current configuration
+    configure(8, LoRa::Bandwidth::BW_125kHz, LoRa::CodingRate::RATE_4_8, LoRa::DEFAULT_PREAMBLE_LENGTH);
+    LoRa::setExplicitHeader(false);
+    check(LoRa::timeOnAir(19, true) == 139776, "explicit frame in implicit mode", LoRa::timeOnAir(19, true));
+
+    checkFrequencyCorrection();
+
+    printf("time on air : max error %.3fus\n", maxError);
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
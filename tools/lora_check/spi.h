@@ -0,0 +1,19 @@
+#ifndef _SPI_H_
+#define _SPI_H_
+
+#include <stdint.h>
+#include "gpio.h"
+
+// Minimal replacement of libtungsten/sam4l/spi.h, connected to the register file of the modem
+// in lora_check.cpp
+namespace SPI {
+
+    using Peripheral = uint8_t;
+
+    inline bool addPeripheral(Peripheral peripheral) { return true; }
+    uint8_t transfer(Peripheral peripheral, uint8_t tx=0, bool next=false);
+    void transfer(Peripheral peripheral, uint8_t* txBuffer, int txBufferSize, uint8_t* rxBuffer=nullptr, int rxBufferSize=-1, bool partial=false);
+
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include "passthrough.h"
+
+// Host check of the input passthrough state machine (passthrough.h) with scripted edge sequences.
+// A simulated timer executes the actions returned by the state machine, optionally with some
+// interrupt latency and with spurious expirations (a timer cancelled too late), and the resulting
+// output pulses are compared with a model : each input pulse [a, r) gives an output pulse
+// [a + delay, max(a + delay + stretch, r + delay)), and a pulse which is asserted before the end of
+// the previous output pulse is merged with it. The times start close to the wrap-around of 32 bits.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+struct Pulse {
+    uint64_t start;
+    uint64_t end;
+};
+
+const uint64_t NEVER = ~0ULL;
+
+// Simulated timer interrupt
+struct Simulation {
+    uint32_t base; // Time 0 of the simulation, in ticks of the state machine
+    uint64_t latency; // Of the timer interrupt
+    bool spurious; // Fire the timer at random times as well
+    uint64_t timer = NEVER;
+    bool outputs = false;
+    std::vector<Pulse> pulses;
+    bool valid = true;
+
+    void apply(const Passthrough::Action& action, uint64_t now) {
+        if (action.outputs != outputs) {
+            outputs = action.outputs;
+            if (outputs) {
+                pulses.push_back({now, NEVER});
+            } else {
+                pulses.back().end = now;
+            }
+        }
+        if (action.timer == Passthrough::Timer::START) {
+            valid = valid && action.timerDelay > 0 && action.timerDelay < 0x80000000;
+            timer = now + action.timerDelay + latency;
+        } else if (action.timer == Passthrough::Timer::CANCEL) {
+            timer = NEVER;
+        }
+    }
+
+    // Run the edges of the given input pulses, then until the outputs are released
+    void run(const std::vector<Pulse>& input) {
+        std::vector<std::pair<uint64_t, bool>> edges;
+        for (const Pulse& p : input) {
+            edges.push_back({p.start, true});
+            edges.push_back({p.end, false});
+        }
+        size_t i = 0;
+        uint64_t last = 0;
+        for (int step = 0; i < edges.size() || timer != NEVER; step++) {
+            if (step > 1000) {
+                // The timer keeps being restarted
+                valid = false;
+                break;
+            }
+            uint64_t tEdge = i < edges.size() ? edges[i].first : NEVER;
+            if (spurious && rand() % 4 == 0) {
+                // Spurious expiration somewhere before the next event
+                uint64_t next = tEdge < timer ? tEdge : timer;
+                uint64_t t = last + (next > last ? rand() % (next - last) : 0);
+                apply(Passthrough::timeout(base + (uint32_t)t), t);
+                last = t;
+                continue;
+            }
+            // The timer first when both happen at the same time
+            if (timer != NEVER && timer <= tEdge) {
+                uint64_t t = timer;
+                timer = NEVER;
+                apply(Passthrough::timeout(base + (uint32_t)t), t);
+                last = t;
+            } else {
+                apply(Passthrough::edge(edges[i].second, base + (uint32_t)tEdge), tEdge);
+                last = tEdge;
+                i++;
+            }
+        }
+    }
+};
+
+// Output pulses expected for the given input pulses
+std::vector<Pulse> model(const std::vector<Pulse>& input, uint64_t delay, uint64_t stretch) {
+    std::vector<Pulse> output;
+    for (const Pulse& p : input) {
+        uint64_t end = p.end + delay;
+        if (p.start + delay + stretch > end) {
+            end = p.start + delay + stretch;
+        }
+        if (!output.empty() && p.start < output.back().end) {
+            if (end > output.back().end) {
+                output.back().end = end;
+            }
+        } else {
+            output.push_back({p.start + delay, end});
+        }
+    }
+    return output;
+}
+
+std::vector<Pulse> simulate(const std::vector<Pulse>& input, uint32_t delay, uint32_t stretch, uint32_t base, uint64_t latency=0, bool spurious=false) {
+    Passthrough::configure(delay, stretch);
+    Simulation sim;
+    sim.base = base;
+    sim.latency = latency;
+    sim.spurious = spurious;
+    sim.run(input);
+    check(sim.valid, "invalid timer delay", delay);
+    check(!sim.outputs && Passthrough::state() == Passthrough::State::IDLE, "outputs not released", delay);
+    return sim.pulses;
+}
+
+bool same(const std::vector<Pulse>& a, const std::vector<Pulse>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].start != b[i].start || a[i].end != b[i].end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void print(const char* name, const std::vector<Pulse>& pulses) {
+    fprintf(stderr, "     %s :", name);
+    for (const Pulse& p : pulses) {
+        fprintf(stderr, " [%llu, %llu)", (unsigned long long)p.start, (unsigned long long)p.end);
+    }
+    fprintf(stderr, "\n");
+}
+
+// A scripted sequence, with the expected outputs written by hand
+void scripted(const char* name, const std::vector<Pulse>& input, uint32_t delay, uint32_t stretch, const std::vector<Pulse>& expected) {
+    std::vector<Pulse> output = simulate(input, delay, stretch, 0xFFFFFF00);
+    check(same(output, expected), name, delay);
+    check(same(model(input, delay, stretch), expected), "model differs from the script", delay);
+    if (!same(output, expected)) {
+        fprintf(stderr, "     %s\n", name);
+        print("expected", expected);
+        print("got", output);
+    }
+}
+
+std::vector<Pulse> randomPulses(int n, uint64_t maxGap, uint64_t maxWidth) {
+    std::vector<Pulse> pulses;
+    uint64_t t = 1 + rand() % maxGap;
+    for (int i = 0; i < n; i++) {
+        uint64_t width = 1 + rand() % maxWidth;
+        pulses.push_back({t, t + width});
+        t += width + 1 + rand() % maxGap;
+    }
+    return pulses;
+}
+
+int main() {
+    // Scripted sequences
+    scripted("mirror", {{100, 200}, {300, 301}}, 0, 0, {{100, 200}, {300, 301}});
+    scripted("short pulse stretched", {{100, 110}}, 0, 1000, {{100, 1100}});
+    scripted("long pulse not stretched", {{100, 3000}}, 0, 1000, {{100, 3000}});
+    scripted("asserted again during the stretch", {{100, 110}, {500, 2000}}, 0, 1000, {{100, 2000}});
+    scripted("stretch of the second pulse", {{100, 110}, {900, 910}}, 0, 1000, {{100, 1900}});
+    scripted("asserted at the end of the stretch", {{100, 110}, {1100, 1110}}, 0, 1000, {{100, 1100}, {1100, 2100}});
+    scripted("delayed", {{100, 200}}, 500, 0, {{600, 700}});
+    scripted("held during the delay", {{100, 2000}}, 500, 0, {{600, 2500}});
+    scripted("delayed and stretched", {{100, 110}}, 500, 300, {{600, 900}});
+    scripted("pulses during the delay merged", {{100, 110}, {300, 310}}, 500, 0, {{600, 810}});
+    scripted("pulses during the delay stretched", {{100, 110}, {300, 310}}, 500, 1000, {{600, 1800}});
+    scripted("separate delayed pulses", {{100, 110}, {2000, 2500}}, 500, 300, {{600, 900}, {2500, 3000}});
+
+    // Random sequences, compared with the model, across the wrap-around of the ticks
+    const uint32_t DELAYS[] = {0, 1, 50, 1000, 100000};
+    const uint32_t STRETCHES[] = {0, 1, 70, 1000, 100000};
+    int nSequences = 0;
+    for (uint32_t delay : DELAYS) {
+        for (uint32_t stretch : STRETCHES) {
+            for (int n = 0; n < 2000; n++) {
+                uint64_t scale = rand() % 3 == 0 ? 10 : (delay + stretch) / 4 + 10;
+                std::vector<Pulse> input = randomPulses(1 + rand() % 10, scale, scale);
+                uint32_t base = n % 2 == 0 ? (uint32_t)rand() : 0xFFFFFFFF - rand() % 1000000;
+                std::vector<Pulse> expected = model(input, delay, stretch);
+                std::vector<Pulse> output = simulate(input, delay, stretch, base);
+                check(same(output, expected), "random sequence differs from the model", n);
+                nSequences++;
+
+                // Spurious timer expirations do not change anything
+                check(same(simulate(input, delay, stretch, base, 0, true), expected), "spurious timer expiration", n);
+
+                // With some interrupt latency, the pulses start late but end on time when they
+                // still can, and each input pulse still gives an output pulse
+                const uint64_t LATENCY = 3;
+                output = simulate(input, delay, stretch, base, LATENCY);
+                bool late = output.size() == expected.size();
+                for (size_t i = 0; late && i < output.size(); i++) {
+                    late = output[i].start >= expected[i].start && output[i].start <= expected[i].start + LATENCY
+                        && output[i].end >= expected[i].end && output[i].end <= expected[i].end + LATENCY
+                        && output[i].end > output[i].start;
+                }
+                check(late || delay > 0, "interrupt latency without delay", n);
+                if (delay > 0) {
+                    // The merges can differ when the edges fall within the latency
+                    check(output.size() <= expected.size() && !output.empty(), "interrupt latency", n);
+                }
+            }
+        }
+    }
+
+    // Reconfiguring releases the outputs
+    Passthrough::configure(0, 1000);
+    Passthrough::edge(true, 0);
+    check(Passthrough::outputs(), "outputs asserted", 0);
+    Passthrough::configure(0, 1000);
+    check(!Passthrough::outputs() && Passthrough::state() == Passthrough::State::IDLE, "outputs released by configure()", 0);
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d random sequences\n", _nChecks, nSequences);
+    return 0;
+}
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "flash.h"
+#include "pm.h"
+
+// Host check of the PicoCache management of the Flash module (libtungsten/sam4l/flash.cpp), which
+// is compiled as is for the host (x86-64 Linux). The registers of the FLASHCALW are mapped at their
+// real address but protected : each access faults, is executed step by step, and is applied to a
+// model of the controller. The model marks the cache as stale when the flash is written, and the
+// check is that an enabled cache is never left stale by the module, and never enabled while stale.
+// The flash array is mapped for a few pages and for the user page, with the page buffer collapsed
+// into the array, so that the content read back can be checked too.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+// Mapped pages of the flash array : the first pages are below the lowest address Linux allows
+const int FIRST_PAGE = 128;
+const int N_PAGES = 16;
+const uint32_t REGISTERS_SIZE = 0x1000;
+
+// Model of the FLASHCALW and of its PicoCache
+struct Controller {
+    bool hsbClock = false;
+    bool pbbClock = false;
+    bool stale = false; // The cache may hold lines of a content which has been changed since
+    int nAccesses = 0; // To the PicoCache registers
+    int nInvalidations = 0;
+    int nCommands = 0;
+    uint32_t lastCommand = 0;
+    int lastPage = -1;
+    int nMonitorResets = 0;
+    uint32_t events = 0; // Counted by the monitor, set by the test
+    bool failed = false; // An access was rejected : reported after the call
+    const char* failure = "";
+};
+Controller _ctrl;
+
+volatile uint32_t* const REGISTERS = (volatile uint32_t*) (uintptr_t) Flash::FLASH_BASE;
+uint32_t _shadow[REGISTERS_SIZE / 4]; // Content before the access being stepped
+uint32_t _accessOffset = 0;
+
+uint32_t reg(uint32_t offset) {
+    return REGISTERS[offset / 4];
+}
+
+void setReg(uint32_t offset, uint32_t value) {
+    REGISTERS[offset / 4] = value;
+}
+
+void reject(const char* what) {
+    if (!_ctrl.failed) {
+        _ctrl.failed = true;
+        _ctrl.failure = what;
+    }
+}
+
+uint8_t* pageAddress(int page) {
+    return (uint8_t*) (uintptr_t) (Flash::FLASH_ARRAY_BASE + page * Flash::FLASH_PAGE_SIZE_BYTES);
+}
+
+uint8_t* userPageAddress() {
+    return (uint8_t*) (uintptr_t) Flash::USER_PAGE_BASE;
+}
+
+// Values read by the next access
+void prepareRead(uint32_t offset) {
+    setReg(Flash::OFFSET_FSR, 1 << Flash::FSR_FRDY | 1 << Flash::FSR_HSMODE);
+    setReg(Flash::OFFSET_SR, (reg(Flash::OFFSET_CTRL) & (1 << Flash::CTRL_CEN)) ? 1 << Flash::SR_CSTS : 0);
+    setReg(Flash::OFFSET_MSR, _ctrl.events);
+    if (offset >= Flash::OFFSET_CTRL) {
+        _ctrl.nAccesses++;
+        if (!_ctrl.hsbClock || !_ctrl.pbbClock) {
+            reject("PicoCache register accessed without its clocks");
+        }
+    }
+}
+
+// Side effects of the access which has just been executed
+void applyWrite(uint32_t offset) {
+    uint32_t value = reg(offset);
+    bool written = value != _shadow[offset / 4];
+    if (offset == Flash::OFFSET_FCMD && written) {
+        _ctrl.nCommands++;
+        if ((value & 0xFF000000) != Flash::FCMD_KEY) {
+            reject("command without the key");
+        }
+        uint32_t command = (value >> Flash::FCMD_CMD) & 0x3F;
+        int page = (value >> Flash::FCMD_PAGEN) & 0xFFFF;
+        _ctrl.lastCommand = command;
+        _ctrl.lastPage = page;
+        if (command == Flash::FCMD_CMD_EP || command == Flash::FCMD_CMD_WP) {
+            if (page < FIRST_PAGE || page >= FIRST_PAGE + N_PAGES) {
+                reject("command on a page which is not mapped");
+            } else if (command == Flash::FCMD_CMD_EP) {
+                memset(pageAddress(page), 0xFF, Flash::FLASH_PAGE_SIZE_BYTES);
+            }
+            _ctrl.stale = true;
+        } else if (command == Flash::FCMD_CMD_EUP) {
+            memset(userPageAddress(), 0xFF, Flash::FLASH_PAGE_SIZE_BYTES);
+            _ctrl.stale = true;
+        } else if (command == Flash::FCMD_CMD_WUP) {
+            _ctrl.stale = true;
+        }
+        setReg(offset, 0); // Write-only
+
+    } else if (offset == Flash::OFFSET_CTRL) {
+        bool enabled = value & (1 << Flash::CTRL_CEN);
+        bool wasEnabled = _shadow[offset / 4] & (1 << Flash::CTRL_CEN);
+        if (enabled && !wasEnabled && _ctrl.stale) {
+            reject("cache enabled with stale lines");
+        }
+
+    } else if (offset == Flash::OFFSET_MAINT0 && written) {
+        if (value & (1 << Flash::MAINT0_INVALL)) {
+            _ctrl.nInvalidations++;
+            _ctrl.stale = false;
+        }
+        setReg(offset, 0); // Write-only
+
+    } else if (offset == Flash::OFFSET_MCFG && written) {
+        if (reg(Flash::OFFSET_MEN) & (1 << Flash::MEN_MENABLE)) {
+            reject("monitor mode changed while enabled");
+        }
+
+    } else if (offset == Flash::OFFSET_MCTRL && written) {
+        if (value & (1 << Flash::MCTRL_SWRST)) {
+            _ctrl.nMonitorResets++;
+            _ctrl.events = 0;
+        }
+        setReg(offset, 0); // Write-only
+
+    } else if (offset == Flash::OFFSET_FSR || offset == Flash::OFFSET_SR || offset == Flash::OFFSET_MSR) {
+        if (written) {
+            reject("status register written");
+        }
+    }
+}
+
+// An access to the registers faults : open them for this instruction only, and trap after it
+void handlerSegv(int, siginfo_t* info, void* context) {
+    uintptr_t address = (uintptr_t) info->si_addr;
+    if (address < Flash::FLASH_BASE || address >= Flash::FLASH_BASE + REGISTERS_SIZE) {
+        signal(SIGSEGV, SIG_DFL);
+        return; // Crash on the access again
+    }
+    _accessOffset = (address - Flash::FLASH_BASE) & ~3u;
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ | PROT_WRITE);
+    prepareRead(_accessOffset);
+    memcpy(_shadow, (const void*) REGISTERS, REGISTERS_SIZE);
+    ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] |= 0x100; // Trap flag
+}
+
+void handlerTrap(int, siginfo_t*, void* context) {
+    applyWrite(_accessOffset);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+}
+
+// Clocks of the peripherals, normally in the PM module
+namespace PM {
+    void enablePeripheralClock(uint8_t peripheral, bool enabled) {
+        if (peripheral == CLK_PICOCACHE) {
+            _ctrl.hsbClock = enabled;
+        } else if (peripheral == CLK_PICOCACHE_REGS) {
+            _ctrl.pbbClock = enabled;
+        }
+    }
+
+    void disablePeripheralClock(uint8_t peripheral) {
+        enablePeripheralClock(peripheral, false);
+    }
+}
+
+// After each call to the module
+void checkState(const char* what, long long value) {
+    check(!_ctrl.failed, _ctrl.failure, value);
+    _ctrl.failed = false;
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ);
+    bool enabled = reg(Flash::OFFSET_CTRL) & (1 << Flash::CTRL_CEN);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    check(!(enabled && _ctrl.stale), what, value);
+    check(enabled == Flash::isCacheEnabled(), "cache state out of sync", value);
+}
+
+void fillRandom(uint32_t* data) {
+    for (int i = 0; i < Flash::FLASH_PAGE_SIZE_WORDS; i++) {
+        data[i] = rand() ^ (uint32_t) rand() << 16;
+    }
+}
+
+// Write the page with one of the write paths of the module, and check the content read back
+void writeAndVerify(int op, int page, long long step) {
+    uint32_t data[Flash::FLASH_PAGE_SIZE_WORDS];
+    uint32_t readBack[Flash::FLASH_PAGE_SIZE_WORDS];
+    fillRandom(data);
+    int nInvalidations = _ctrl.nInvalidations;
+    bool enabled = Flash::isCacheEnabled();
+    switch (op) {
+        case 0:
+            Flash::writePage(page, data);
+            checkState("stale cache after writePage()", step);
+            break;
+
+        case 1:
+            Flash::erasePage(page);
+            checkState("stale cache after erasePage()", step);
+            memset(data, 0xFF, sizeof(data));
+            break;
+
+        case 2:
+            Flash::erasePage(page);
+            Flash::programPage(page, data);
+            checkState("stale cache after programPage()", step);
+            break;
+
+        case 3:
+            Flash::eraseUserPage();
+            checkState("stale cache after eraseUserPage()", step);
+            Flash::writeUserPage(data);
+            checkState("stale cache after writeUserPage()", step);
+            break;
+    }
+    if (op == 3) {
+        Flash::readUserPage(readBack);
+    } else {
+        Flash::readPage(page, readBack);
+        check(Flash::read((page * Flash::FLASH_PAGE_SIZE_WORDS + 3) * 4) == data[3], "read()", step);
+    }
+    check(memcmp(data, readBack, sizeof(data)) == 0, "content read back", step);
+
+    // Invalidating a disabled cache is useless : it is done when it is enabled again
+    check(enabled || _ctrl.nInvalidations == nInvalidations, "invalidation of a disabled cache", step);
+}
+
+void checkEnable() {
+    // The flash is written before the cache is first enabled, like by the bootloader
+    writeAndVerify(0, FIRST_PAGE, 0);
+    check(_ctrl.nAccesses == 0, "PicoCache register accessed while disabled", _ctrl.nAccesses);
+    check(!Flash::isCacheEnabled(), "cache enabled at reset", 0);
+    check(Flash::cacheMonitorCount() == 0, "monitor count while disabled", 0);
+    Flash::startCacheMonitor(Flash::CacheMonitor::CYCLES);
+    Flash::stopCacheMonitor();
+    Flash::invalidateCache();
+    check(_ctrl.nAccesses == 0, "PicoCache register accessed while disabled", _ctrl.nAccesses);
+
+    Flash::enableCache();
+    checkState("stale cache after enableCache()", 0);
+    check(Flash::isCacheEnabled(), "cache not enabled", 0);
+    check(_ctrl.hsbClock && _ctrl.pbbClock, "clocks of the cache", 0);
+    int nAccesses = _ctrl.nAccesses;
+    Flash::enableCache();
+    checkState("stale cache after enableCache() twice", 0);
+    check(_ctrl.nAccesses == nAccesses, "cache enabled twice", _ctrl.nAccesses - nAccesses);
+
+    // Every write path, on every mapped page
+    for (int op = 0; op < 4; op++) {
+        for (int i = 0; i < N_PAGES; i++) {
+            writeAndVerify(op, FIRST_PAGE + i, op * 100 + i);
+        }
+    }
+
+    // Written while disabled, then enabled again
+    Flash::disableCache();
+    checkState("stale cache after disableCache()", 0);
+    check(!Flash::isCacheEnabled(), "cache not disabled", 0);
+    writeAndVerify(2, FIRST_PAGE + 1, 0);
+    check(_ctrl.stale, "model of the cache", 0);
+    Flash::enableCache();
+    checkState("stale cache enabled again", 0);
+}
+
+void checkMonitor() {
+    Flash::startCacheMonitor(Flash::CacheMonitor::INSTRUCTION_HITS);
+    checkState("stale cache after startCacheMonitor()", 0);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ);
+    check(reg(Flash::OFFSET_MCFG) == 1, "monitor mode", reg(Flash::OFFSET_MCFG));
+    check(reg(Flash::OFFSET_MEN) & (1 << Flash::MEN_MENABLE), "monitor not enabled", 0);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    check(_ctrl.nMonitorResets == 1, "monitor not reset", _ctrl.nMonitorResets);
+
+    _ctrl.events = 1234;
+    check(Flash::cacheMonitorCount() == 1234, "monitor count", Flash::cacheMonitorCount());
+    Flash::stopCacheMonitor();
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ);
+    check(!(reg(Flash::OFFSET_MEN) & (1 << Flash::MEN_MENABLE)), "monitor not disabled", 0);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    check(Flash::cacheMonitorCount() == 1234, "monitor count kept", Flash::cacheMonitorCount());
+
+    // Started again in another mode, while running
+    Flash::startCacheMonitor(Flash::CacheMonitor::DATA_HITS);
+    Flash::startCacheMonitor(Flash::CacheMonitor::CYCLES);
+    checkState("monitor restarted", 0);
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ);
+    check(reg(Flash::OFFSET_MCFG) == 0, "monitor mode", reg(Flash::OFFSET_MCFG));
+    mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+    check(Flash::cacheMonitorCount() == 0, "monitor count after a restart", Flash::cacheMonitorCount());
+    Flash::stopCacheMonitor();
+    checkState("monitor stopped", 0);
+}
+
+// Random writes, enables and disables, like a firmware using the journal while a debug
+// session measures the cache
+void checkRandom() {
+    for (int step = 0; step < 20000; step++) {
+        int r = rand() % 20;
+        if (r == 0) {
+            Flash::disableCache();
+            checkState("stale cache after disableCache()", step);
+        } else if (r == 1) {
+            Flash::enableCache();
+            checkState("stale cache after enableCache()", step);
+        } else if (r == 2) {
+            Flash::invalidateCache();
+            checkState("stale cache after invalidateCache()", step);
+        } else {
+            writeAndVerify(rand() % 4, FIRST_PAGE + rand() % N_PAGES, step);
+        }
+    }
+}
+
+int main() {
+    srand(1);
+
+    // Register block and flash array at their real addresses
+    void* registers = mmap((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    void* array = mmap(pageAddress(FIRST_PAGE), N_PAGES * Flash::FLASH_PAGE_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    void* userPage = mmap(userPageAddress(), 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (registers != (void*) REGISTERS || array != pageAddress(FIRST_PAGE) || userPage != userPageAddress()) {
+        fprintf(stderr, "unable to map the registers and the flash array at their address\n");
+        return 1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = handlerSegv;
+    sigaction(SIGSEGV, &action, nullptr);
+    action.sa_sigaction = handlerTrap;
+    sigaction(SIGTRAP, &action, nullptr);
+
+    checkEnable();
+    checkMonitor();
+    checkRandom();
+    printf("%d register accesses, %d commands, %d invalidations\n", _ctrl.nAccesses, _ctrl.nCommands, _ctrl.nInvalidations);
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash.h"
+#include "presets.h"
+#include "sync.h"
+
+// Host check of the presets (presets.cpp, compiled as is against the simulated flash of
+// tools/journal_sim) : packing of every field over its whole range, radio frames, and storage
+// in flash with power cuts injected while storing.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, int a=0, uint32_t b=0) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%d, %u)\n", what, a, b);
+        }
+    }
+}
+
+uint32_t scale(int i) {
+    return Schema::FIELDS[Presets::FIELDS[i].field].scale;
+}
+
+uint32_t maxValue(int i) {
+    return ((1u << Presets::FIELDS[i].bits) - 1) * scale(i);
+}
+
+uint32_t randomValue(int i) {
+    return (uint32_t)rand() % (maxValue(i) / scale(i) + 1) * scale(i);
+}
+
+bool samePreset(const Presets::Preset& a, const Presets::Preset& b) {
+    return strcmp(a.name, b.name) == 0 && memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+void checkPacking() {
+    for (int i = 0; i < Presets::N_FIELDS; i++) {
+        // Each value alone, with the other fields at 0 then at their maximum
+        for (int others = 0; others < 2; others++) {
+            for (int n = 0; n < 20000; n++) {
+                Presets::Preset preset = {};
+                for (int j = 0; j < Presets::N_FIELDS; j++) {
+                    preset.values[j] = others ? maxValue(j) : 0;
+                }
+                uint32_t value = n < 2 ? n * maxValue(i) : randomValue(i);
+                preset.values[i] = value;
+                uint8_t packed[Presets::PACKED_SIZE];
+                Presets::pack(preset, packed);
+                Presets::Preset unpacked = {};
+                Presets::unpack(packed, unpacked);
+                check(memcmp(preset.values, unpacked.values, sizeof(preset.values)) == 0, "pack round trip", i, value);
+            }
+        }
+
+        // Out of range values are clamped
+        Presets::Preset preset = {};
+        preset.values[i] = maxValue(i) + scale(i);
+        uint8_t packed[Presets::PACKED_SIZE];
+        Presets::pack(preset, packed);
+        Presets::Preset unpacked = {};
+        Presets::unpack(packed, unpacked);
+        check(unpacked.values[i] == maxValue(i), "clamping", i, preset.values[i]);
+    }
+}
+
+void checkFrames() {
+    check(Presets::FRAME_SIZE <= Sync::MAX_PAYLOAD_SIZE, "frame size");
+    for (int n = 0; n < 1000; n++) {
+        int index = rand() % Presets::N_PRESETS;
+        for (int i = 0; i < Presets::N_FIELDS; i++) {
+            Schema::set(Presets::FIELDS[i].field, randomValue(i));
+        }
+        Presets::store(index);
+        uint8_t mask = rand() & 0xFF;
+        uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+        int size = Presets::encodeFrame(index, mask, payload);
+        Presets::Preset preset = {};
+        uint8_t decodedMask = 0;
+        check(size == Presets::FRAME_SIZE, "frame size", index);
+        check(!Presets::decodeFrame(payload, size - 1, preset, decodedMask), "short frame accepted", index);
+        check(Presets::decodeFrame(payload, size, preset, decodedMask), "frame rejected", index);
+        check(decodedMask == (mask & Presets::menus()), "frame mask", index, mask);
+        check(memcmp(preset.values, Presets::get(index).values, sizeof(preset.values)) == 0, "frame round trip", index);
+
+        // Only the fields of the menus in the mask are applied
+        uint32_t before[Presets::N_FIELDS];
+        for (int i = 0; i < Presets::N_FIELDS; i++) {
+            before[i] = randomValue(i);
+            Schema::set(Presets::FIELDS[i].field, before[i]);
+        }
+        Presets::apply(preset, decodedMask);
+        for (int i = 0; i < Presets::N_FIELDS; i++) {
+            uint32_t expected = decodedMask & (1 << Presets::FIELDS[i].menu) ? preset.values[i] : before[i];
+            check(Schema::get(Presets::FIELDS[i].field) == expected, "apply", i, decodedMask);
+        }
+    }
+}
+
+// Store random presets, with power cuts injected during some of them, and read them back as on boot
+void checkStorage(int nStores) {
+    uint32_t* memory = Flash::memory();
+    memset(memory + Presets::FIRST_PAGE * Flash::FLASH_PAGE_SIZE_WORDS, 0xFF, Presets::N_PAGES * Flash::FLASH_PAGE_SIZE_BYTES);
+    Presets::init();
+    check(strcmp(Presets::get(0).name, "Preset 1") == 0, "default name");
+
+    Presets::Preset model[Presets::N_PRESETS];
+    for (int i = 0; i < Presets::N_PRESETS; i++) {
+        model[i] = Presets::get(i);
+    }
+    int nCuts = 0;
+    int nLost = 0;
+    for (int s = 0; s < nStores; s++) {
+        int index = rand() % Presets::N_PRESETS;
+        for (int i = 0; i < Presets::N_FIELDS; i++) {
+            Schema::set(Presets::FIELDS[i].field, randomValue(i));
+        }
+        char name[Presets::NAME_SIZE + 4];
+        snprintf(name, sizeof(name), "P%d", rand() % 100000000);
+        bool rename = rand() % 2;
+
+        Presets::Preset next[Presets::N_PRESETS];
+        memcpy(next, model, sizeof(next));
+        for (int i = 0; i < Presets::N_FIELDS; i++) {
+            next[index].values[i] = Schema::get(Presets::FIELDS[i].field);
+        }
+        if (rename) {
+            memset(next[index].name, 0, sizeof(next[index].name));
+            for (int i = 0; i < Presets::NAME_SIZE && name[i] != 0; i++) {
+                next[index].name[i] = name[i];
+            }
+        }
+
+        bool cut = rand() % 4 == 0;
+        Flash::_commandsBeforeCut = cut ? rand() % 2 : -1;
+        try {
+            Presets::store(index, rename ? name : nullptr);
+            Flash::_commandsBeforeCut = -1;
+            memcpy(model, next, sizeof(model));
+        } catch (Flash::PowerCut&) {
+            nCuts++;
+        }
+
+        if (cut || rand() % 8 == 0) {
+            // Reboot : the settings at boot are unrelated to the stored presets
+            Presets::init();
+            bool isOld = true;
+            bool isNew = true;
+            for (int i = 0; i < Presets::N_PRESETS; i++) {
+                isOld = isOld && samePreset(Presets::get(i), model[i]);
+                isNew = isNew && samePreset(Presets::get(i), next[i]);
+            }
+            check(isOld || isNew, "presets after a reboot", s);
+            if (isNew) {
+                memcpy(model, next, sizeof(model));
+            } else {
+                nLost++;
+            }
+        }
+    }
+    printf("     %d stores, %d power cuts (%d stores lost), %d and %d erases of the two pages\n", nStores, nCuts, nLost,
+        Flash::_nErases[Presets::FIRST_PAGE], Flash::_nErases[Presets::FIRST_PAGE + 1]);
+
+    // Presets stored with another version of the format are replaced by the defaults
+    uint32_t page[Flash::FLASH_PAGE_SIZE_WORDS];
+    for (int i = 0; i < Presets::N_PAGES; i++) {
+        Flash::readPage(Presets::FIRST_PAGE + i, page);
+        page[3] += 1 << 24;
+        int size = 4 + Presets::N_PRESETS * Presets::RECORD_SIZE / 4;
+        page[size] = Journal::crc32(page, size);
+        memcpy(memory + (Presets::FIRST_PAGE + i) * Flash::FLASH_PAGE_SIZE_WORDS, page, Flash::FLASH_PAGE_SIZE_BYTES);
+    }
+    Presets::init();
+    check(strcmp(Presets::get(Presets::N_PRESETS - 1).name, "Preset 4") == 0, "presets of another version");
+}
+
+int main() {
+    srand(0);
+    checkPacking();
+    checkFrames();
+    checkStorage(100000);
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d presets of %d bytes packed, radio frame of %d bytes\n",
+        _nChecks, Presets::N_PRESETS, Presets::PACKED_SIZE, Presets::FRAME_SIZE);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Read and decode the main loop profile of a Silver module connected over USB
+# (the firmware must be built with PROFILING=true, see profiler.h)
+# Usage : profile.py [--reset] [--raw FILE]
+#   --reset     reset the profile on the module after reading it
+#   --raw FILE  decode a blob previously saved to FILE instead of reading the module
+
+import struct
+import sys
+
+USB_VENDOR_ID = 0x03eb
+USB_PRODUCT_ID = 0xcbd0
+CMD_GET_PROFILE = 0x87
+
+# Must match profiler.h
+BLOB_VERSION = 1
+SECTIONS = ["loop", "buttons", "receive", "dispatch", "sequencing", "battery", "save", "gui", "oled_refresh"]
+N_BUCKETS = 16
+BLOB_SIZE = 9 + len(SECTIONS) * (20 + 2 * N_BUCKETS)
+
+
+def decode(blob):
+    if len(blob) < 9 or blob[0] != BLOB_VERSION:
+        raise ValueError("unsupported profile blob version")
+    enabled, n_sections, n_buckets, bucket_shift, frequency = struct.unpack_from(">BBBBI", blob, 1)
+    profile = {
+        "enabled": enabled != 0,
+        "bucket_shift": bucket_shift,
+        "frequency": frequency,
+        "sections": [],
+    }
+    offset = 9
+    for i in range(n_sections):
+        count, total_hi, total_lo, minimum, maximum = struct.unpack_from(">IIIII", blob, offset)
+        offset += 20
+        histogram = list(struct.unpack_from(">%dH" % n_buckets, blob, offset))
+        offset += 2 * n_buckets
+        profile["sections"].append({
+            "name": SECTIONS[i] if i < len(SECTIONS) else str(i),
+            "count": count,
+            "total": total_hi << 32 | total_lo,
+            "min": minimum,
+            "max": maximum,
+            "histogram": histogram,
+        })
+    return profile
+
+
+def read_from_device(reset):
+    import usb.core
+    dev = usb.core.find(idVendor=USB_VENDOR_ID, idProduct=USB_PRODUCT_ID)
+    if dev is None:
+        raise IOError("device not found")
+    bmRequestType = 1 << 7 | 2 << 5 # IN, vendor
+    return bytes(dev.ctrl_transfer(bmRequestType, CMD_GET_PROFILE, 1 if reset else 0, 0, BLOB_SIZE))
+
+
+def main():
+    args = sys.argv[1:]
+    if "--raw" in args:
+        with open(args[args.index("--raw") + 1], "rb") as f:
+            blob = f.read()
+    else:
+        blob = read_from_device("--reset" in args)
+    profile = decode(blob)
+
+    if not profile["enabled"]:
+        print("Profiling is disabled in this firmware (build it with PROFILING=true)")
+        return
+    # The cycles counted while the CPU is boosted are converted by the firmware to this frequency
+    us = 1e6 / profile["frequency"]
+    print("%-14s %8s %10s %10s %10s %12s" % ("section", "count", "min (us)", "mean (us)", "max (us)", "total (ms)"))
+    for s in profile["sections"]:
+        if s["count"] == 0:
+            print("%-14s %8d" % (s["name"], 0))
+            continue
+        print("%-14s %8d %10.1f %10.1f %10.1f %12.1f" % (s["name"], s["count"], s["min"] * us, s["total"] * us / s["count"], s["max"] * us, s["total"] * us / 1000))
+    print()
+    shift = profile["bucket_shift"]
+    for s in profile["sections"]:
+        if s["count"] == 0:
+            continue
+        print(s["name"])
+        total = max(sum(s["histogram"]), 1)
+        for i, count in enumerate(s["histogram"]):
+            if count == 0:
+                continue
+            low = 0 if i == 0 else (1 << (shift + i)) * us
+            high = (1 << (shift + i + 1)) * us
+            label = ("< %.0f" % high) if i == 0 else (">= %.0f" % low) if i == len(s["histogram"]) - 1 else "%.0f..%.0f" % (low, high)
+            print("  %16s us : %6d %s" % (label, count, "#" * (40 * count // total)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "profiler.h"
+
+// Host check of the main loop profiler (profiler.h), with an injected cycle counter : the
+// sections are timed from scripted and random durations, including across the wrap-around of
+// the counter, and the serialized table is decoded and compared with a reference computed here.
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, double value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%g)\n", what, value);
+        }
+    }
+}
+
+// Injected cycle source : each read returns the current value, then advances it by the cost of a
+// read, like the real counter which keeps counting between the reads
+uint32_t _counter = 0;
+uint32_t _readCost = 0;
+
+uint32_t fakeCycles() {
+    uint32_t value = _counter;
+    _counter += _readCost;
+    return value;
+}
+
+// Reference statistics of a section
+struct Reference {
+    uint32_t count = 0;
+    uint64_t total = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    uint32_t histogram[Profiler::N_BUCKETS] = {0};
+
+    void add(uint32_t cycles) {
+        if (count == 0 || cycles < min) {
+            min = cycles;
+        }
+        if (cycles > max) {
+            max = cycles;
+        }
+        count++;
+        total += cycles;
+        // Lower bound of bucket i > 0 : 2^(BUCKET_MIN_SHIFT+i)
+        int b = Profiler::N_BUCKETS - 1;
+        while (b > 0 && cycles < (uint64_t(1) << (Profiler::BUCKET_MIN_SHIFT + b))) {
+            b--;
+        }
+        histogram[b]++;
+    }
+};
+
+Reference _reference[Profiler::N_SECTIONS];
+
+// Decoded blob
+struct Section {
+    uint32_t count;
+    uint64_t total;
+    uint32_t min;
+    uint32_t max;
+    uint16_t histogram[Profiler::N_BUCKETS];
+};
+
+uint32_t readU32(const uint8_t* p) {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+uint16_t readU16(const uint8_t* p) {
+    return p[0] << 8 | p[1];
+}
+
+bool decode(Section* sections, uint32_t& frequency) {
+    uint8_t blob[Profiler::BLOB_SIZE + 16];
+    check(Profiler::serialize(blob, Profiler::BLOB_SIZE - 1) == 0, "buffer too small", 0);
+    int size = Profiler::serialize(blob, sizeof(blob));
+    check(size == Profiler::BLOB_SIZE, "blob size", size);
+    if (size != Profiler::BLOB_SIZE) {
+        return false;
+    }
+    check(blob[0] == Profiler::BLOB_VERSION, "version", blob[0]);
+    check(blob[1] == 1, "enabled", blob[1]);
+    check(blob[2] == Profiler::N_SECTIONS, "number of sections", blob[2]);
+    check(blob[3] == Profiler::N_BUCKETS, "number of buckets", blob[3]);
+    check(blob[4] == Profiler::BUCKET_MIN_SHIFT, "bucket shift", blob[4]);
+    frequency = readU32(blob + 5);
+    const uint8_t* p = blob + 9;
+    for (int i = 0; i < Profiler::N_SECTIONS; i++) {
+        Section& s = sections[i];
+        s.count = readU32(p);
+        s.total = uint64_t(readU32(p + 4)) << 32 | readU32(p + 8);
+        s.min = readU32(p + 12);
+        s.max = readU32(p + 16);
+        p += 20;
+        for (int j = 0; j < Profiler::N_BUCKETS; j++) {
+            s.histogram[j] = readU16(p);
+            p += 2;
+        }
+    }
+    return true;
+}
+
+void compare(const char* what) {
+    Section sections[Profiler::N_SECTIONS];
+    uint32_t frequency = 0;
+    if (!decode(sections, frequency)) {
+        return;
+    }
+    check(frequency == 12000000, "frequency", frequency);
+    for (int i = 0; i < Profiler::N_SECTIONS; i++) {
+        const Section& s = sections[i];
+        const Reference& r = _reference[i];
+        bool ok = s.count == r.count && s.total == r.total && s.min == r.min && s.max == r.max;
+        for (int j = 0; j < Profiler::N_BUCKETS; j++) {
+            uint32_t expected = r.histogram[j] < 0xFFFF ? r.histogram[j] : 0xFFFF;
+            ok = ok && s.histogram[j] == expected;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s, section %d : count %u/%u total %llu/%llu min %u/%u max %u/%u\n", what, i,
+                s.count, r.count, (unsigned long long)s.total, (unsigned long long)r.total, s.min, r.min, s.max, r.max);
+        }
+        check(ok, what, i);
+    }
+}
+
+void clearReference() {
+    for (int i = 0; i < Profiler::N_SECTIONS; i++) {
+        _reference[i] = Reference();
+    }
+}
+
+// Time a section of the given duration between its probes
+void timeSection(Profiler::Section section, uint32_t cycles) {
+    Profiler::start(section);
+    _counter += cycles;
+    Profiler::stop(section);
+    _reference[static_cast<int>(section)].add(cycles + _readCost);
+}
+
+int main() {
+    Profiler::init(fakeCycles, 12000000);
+
+    // Empty table
+    compare("empty");
+
+    // Bucket boundaries
+    const uint32_t durations[] = {0, 1, 511, 512, 1023, 1024, 65535, 65536, (1u << 22) - 1, 1u << 22, (1u << 23) - 1, 1u << 23, 0xFFFFFFFF};
+    for (uint32_t d : durations) {
+        timeSection(Profiler::Section::GUI, d);
+    }
+    compare("bucket boundaries");
+
+    // Across the wrap-around of the counter
+    _counter = 0xFFFFFF00;
+    timeSection(Profiler::Section::SAVE, 0x200);
+    compare("wrap-around");
+
+    // A stop without a start, or a second stop, is ignored
+    Profiler::stop(Profiler::Section::BATTERY);
+    timeSection(Profiler::Section::BATTERY, 1000);
+    Profiler::stop(Profiler::Section::BATTERY);
+    compare("stop without start");
+
+    // Nested and overlapping sections, with the cost of the reads
+    _readCost = 7;
+    Profiler::start(Profiler::Section::LOOP);
+    _counter += 100;
+    timeSection(Profiler::Section::OLED_REFRESH, 5000);
+    Profiler::start(Profiler::Section::DISPATCH);
+    _counter += 300;
+    Profiler::stop(Profiler::Section::LOOP);
+    _counter += 50;
+    Profiler::stop(Profiler::Section::DISPATCH);
+    _reference[static_cast<int>(Profiler::Section::LOOP)].add(7 + 100 + 7 + 5000 + 7 + 7 + 300);
+    _reference[static_cast<int>(Profiler::Section::DISPATCH)].add(7 + 300 + 7 + 50);
+    compare("nested sections");
+
+    // Boosted during a section : the cycles counted at 48MHz are converted to the 12MHz given to
+    // the host, in the sections which are running at each switch only
+    _readCost = 0;
+    Profiler::start(Profiler::Section::LOOP);
+    _counter += 1000;
+    Profiler::setClockDivider(4);
+    _counter += 8000;
+    Profiler::start(Profiler::Section::GUI);
+    _counter += 4003;
+    Profiler::stop(Profiler::Section::GUI);
+    Profiler::setClockDivider(1);
+    _counter += 500;
+    Profiler::stop(Profiler::Section::LOOP);
+    _reference[static_cast<int>(Profiler::Section::LOOP)].add(1000 + (8000 + 4003) / 4 + 500);
+    _reference[static_cast<int>(Profiler::Section::GUI)].add(1000);
+    compare("boosted sections");
+
+    // The reset is applied on the next record, as it is requested from the USB interrupt
+    Profiler::reset();
+    compare("reset pending");
+    clearReference();
+    timeSection(Profiler::Section::RECEIVE, 42);
+    compare("reset");
+
+    // Random durations, enough to saturate the most used buckets and to overflow a 32-bit total
+    srand(1);
+    for (int n = 0; n < 200000; n++) {
+        Profiler::Section section = static_cast<Profiler::Section>(rand() % Profiler::N_SECTIONS);
+        uint32_t cycles = uint32_t(rand()) >> (rand() % 31);
+        _readCost = rand() % 16;
+        timeSection(section, cycles);
+    }
+    compare("random durations");
+    uint64_t total = 0;
+    for (int i = 0; i < Profiler::N_SECTIONS; i++) {
+        total += _reference[i].total;
+    }
+    check(total > 0xFFFFFFFFull, "total overflows 32 bits", total);
+
+    // Without a cycle source, the probes do nothing
+    Profiler::init(nullptr, 12000000);
+    clearReference();
+    Profiler::start(Profiler::Section::GUI);
+    Profiler::stop(Profiler::Section::GUI);
+    Profiler::init(fakeCycles, 12000000);
+    compare("no cycle source");
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
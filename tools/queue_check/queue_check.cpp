@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+#include <Queue.h>
+
+// Host stress check of the single-producer/single-consumer queue (libtungsten/utils/Queue.h) with
+// two threads, standing for the main loop and an interrupt handler, on a host whose cores reorder
+// memory accesses more freely than the Cortex-M4. The producer pushes numbered items as fast as it
+// can, and retries most of those refused by a full queue, while the consumer pops them with both
+// flavours of pop(), and sometimes clears the queue. Each item must be received whole, once and in
+// order, and no accepted item may be lost except by a clear(). Every refused push must be counted
+// in overflows(). On a single core, a fast timer signal makes the running thread yield at any
+// point, such as in the middle of copying an item, and the items are large enough for the copy to
+// be caught often. The random pauses of both threads let the queue go through its full and empty
+// states.
+
+const unsigned int SIZE = 8;
+const uint32_t N_ITEMS = 1000000;
+const int N_WORDS = 255;
+
+struct Item {
+    uint32_t seq;
+    uint32_t data[N_WORDS]; // Derived from seq, to detect an item read while it is being written
+};
+
+Queue<Item, SIZE> _queue;
+
+// Written by the producer only
+std::vector<uint32_t> _accepted; // Items accepted by push(), in order
+unsigned int _refused = 0; // Refused pushes, retries included
+unsigned int _dropped = 0;
+
+// Written by the consumer only
+struct Received {
+    uint32_t seq;
+    bool afterClear; // Items may be missing before this one
+};
+std::vector<Received> _received;
+unsigned long _nCorrupted = 0;
+unsigned long _nOversized = 0;
+unsigned long _nClears = 0;
+bool _clearedLast = false; // Accepted items may be missing after the last one received
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld)\n", what, value);
+        }
+    }
+}
+
+// Each thread has its own generator, as rand() is not thread-safe
+uint32_t xorshift(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+void pause(uint32_t& state) {
+    for (volatile uint32_t i = xorshift(state) % 200; i > 0; i--);
+}
+
+uint32_t word(uint32_t seq, int i) {
+    return seq * 2654435761u + i * 40503u;
+}
+
+// The timer signal is delivered to the running thread, which yields the core in the middle of
+// whatever it was doing, like an interrupt would
+void preempt(int) {
+    sched_yield();
+}
+
+void allowPreemption() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+}
+
+void produce() {
+    uint32_t state = 0x12345678;
+    allowPreemption();
+    for (uint32_t seq = 0; seq < N_ITEMS; seq++) {
+        Item item;
+        item.seq = seq;
+        for (int i = 0; i < N_WORDS; i++) {
+            item.data[i] = word(seq, i);
+        }
+        // Most refused items are retried once the consumer made room, the others are dropped
+        bool accepted = _queue.push(item);
+        while (!accepted) {
+            _refused++;
+            std::this_thread::yield();
+            if (xorshift(state) % 8 == 0) {
+                break;
+            }
+            accepted = _queue.push(item);
+        }
+        if (accepted) {
+            _accepted.push_back(seq);
+        } else {
+            _dropped++;
+        }
+        if (xorshift(state) % 64 == 0) {
+            pause(state);
+        }
+    }
+}
+
+void receive(const Item& item, bool afterClear) {
+    for (int i = 0; i < N_WORDS; i++) {
+        if (item.data[i] != word(item.seq, i)) {
+            _nCorrupted++;
+            break;
+        }
+    }
+    _received.push_back({item.seq, afterClear});
+}
+
+void consume(const bool& producerDone) {
+    uint32_t state = 0x9abcdef0;
+    allowPreemption();
+    bool afterClear = false;
+    while (true) {
+        // Read the flag before trying to pop, so that the queue is known to be drained when it is set
+        bool done = producerDone;
+        __sync_synchronize();
+        if (_queue.size() > SIZE) {
+            _nOversized++;
+        }
+        uint32_t r = xorshift(state) % 1000;
+        bool popped = false;
+        if (r < 500) {
+            Item item;
+            if (_queue.pop(item)) {
+                receive(item, afterClear);
+                afterClear = false;
+                popped = true;
+            }
+        } else if (r < 999) {
+            if (!_queue.isEmpty()) {
+                receive(_queue.front(), afterClear);
+                _queue.pop();
+                afterClear = false;
+                popped = true;
+            }
+        } else {
+            _queue.clear();
+            _nClears++;
+            afterClear = true;
+        }
+        if (!popped) {
+            std::this_thread::yield();
+        } else if (xorshift(state) % 64 == 0) {
+            pause(state);
+        }
+        if (done && !popped && _queue.isEmpty()) {
+            break;
+        }
+    }
+    _clearedLast = afterClear;
+}
+
+int main() {
+    // Only the two threads handle the timer signal
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+    signal(SIGALRM, preempt);
+    struct itimerval timer = {{0, 20}, {0, 20}};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+    _accepted.reserve(N_ITEMS);
+    _received.reserve(N_ITEMS);
+    volatile bool producerDone = false;
+    std::thread consumer(consume, std::cref(const_cast<const bool&>(producerDone)));
+    std::thread producer(produce);
+    producer.join();
+    __sync_synchronize();
+    producerDone = true;
+    consumer.join();
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, nullptr);
+
+    check(_nCorrupted == 0, "items corrupted", _nCorrupted);
+    check(_nOversized == 0, "queue size above its capacity", _nOversized);
+    check(_queue.overflows() == _refused, "overflows", _queue.overflows());
+    check(_accepted.size() + _dropped == N_ITEMS, "pushes", _accepted.size());
+
+    // Every item received was accepted, in order, and only a clear() may skip accepted items
+    size_t a = 0;
+    for (const Received& r : _received) {
+        size_t next = a;
+        while (a < _accepted.size() && _accepted[a] != r.seq) {
+            a++;
+        }
+        check(a < _accepted.size(), "item received out of order or twice", r.seq);
+        if (a >= _accepted.size()) {
+            break;
+        }
+        check(a == next || r.afterClear, "item lost", _accepted[next]);
+        a++;
+    }
+    check(a == _accepted.size() || _clearedLast, "items left in the queue", _accepted.size() - a);
+
+    printf("%zu items accepted, %u dropped (%u refused pushes), %zu received, %lu clears\n",
+        _accepted.size(), _dropped, _refused, _received.size(), _nClears);
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+# Read and decode the radio link statistics of a Silver module connected over USB
+# Usage : radio_stats.py [--reset] [--raw FILE]
+#   --reset     reset the statistics on the module after reading them
+#   --raw FILE  decode a blob previously saved to FILE instead of reading the module
+
+import struct
+import sys
+
+USB_VENDOR_ID = 0x03eb
+USB_PRODUCT_ID = 0xcbd0
+CMD_GET_RADIO_STATS = 0x82
+
+# Must match radio_stats.h
+BLOB_VERSION = 1
+RSSI_HISTOGRAM_MIN = -140
+RSSI_HISTOGRAM_STEP = 10
+N_RSSI_BINS = 12
+SNR_HISTOGRAM_MIN = -20
+SNR_HISTOGRAM_STEP = 4
+N_SNR_BINS = 10
+N_TRACE_RECORDS = 16
+COUNTERS = ["rx_ok", "rx_crc_error", "rx_header_error", "rx_foreign", "tx", "tx_denied", "airtime_total_ms", "airtime_window_ms"]
+EVENTS = ["RX_OK", "RX_CRC_ERROR", "RX_HEADER_ERROR", "RX_FOREIGN", "TX", "TX_DENIED"]
+BLOB_SIZE = 1 + 4 * len(COUNTERS) + 2 * N_RSSI_BINS + 2 * N_SNR_BINS + 1 + N_TRACE_RECORDS * 10
+
+
+def decode(blob):
+    if len(blob) < 1 or blob[0] != BLOB_VERSION:
+        raise ValueError("unsupported stats blob version")
+    offset = 1
+    stats = {}
+    for name in COUNTERS:
+        stats[name], = struct.unpack_from(">I", blob, offset)
+        offset += 4
+    stats["rssi_histogram"] = list(struct.unpack_from(">%dH" % N_RSSI_BINS, blob, offset))
+    offset += 2 * N_RSSI_BINS
+    stats["snr_histogram"] = list(struct.unpack_from(">%dH" % N_SNR_BINS, blob, offset))
+    offset += 2 * N_SNR_BINS
+    n_records = blob[offset]
+    offset += 1
+    stats["trace"] = []
+    for i in range(n_records):
+        time, event, command, rssi, snr, length = struct.unpack_from(">IBBhbB", blob, offset)
+        offset += 10
+        stats["trace"].append({
+            "time": time,
+            "event": EVENTS[event] if event < len(EVENTS) else event,
+            "command": command,
+            "rssi": rssi,
+            "snr": snr,
+            "length": length,
+        })
+    return stats
+
+
+def read_from_device(reset):
+    import usb.core
+    dev = usb.core.find(idVendor=USB_VENDOR_ID, idProduct=USB_PRODUCT_ID)
+    if dev is None:
+        raise IOError("device not found")
+    bmRequestType = 1 << 7 | 2 << 5 # IN, vendor
+    return bytes(dev.ctrl_transfer(bmRequestType, CMD_GET_RADIO_STATS, 1 if reset else 0, 0, BLOB_SIZE))
+
+
+def print_histogram(title, histogram, minimum, step, unit):
+    print(title)
+    total = max(sum(histogram), 1)
+    for i, count in enumerate(histogram):
+        low = minimum + i * step
+        label = ("< %d" % (low + step)) if i == 0 else (">= %d" % low) if i == len(histogram) - 1 else "%d..%d" % (low, low + step - 1)
+        print("  %12s %s : %6d %s" % (label, unit, count, "#" * (40 * count // total)))
+
+
+def main():
+    args = sys.argv[1:]
+    if "--raw" in args:
+        with open(args[args.index("--raw") + 1], "rb") as f:
+            blob = f.read()
+    else:
+        blob = read_from_device("--reset" in args)
+    stats = decode(blob)
+
+    for name in COUNTERS:
+        print("%-18s %d" % (name, stats[name]))
+    n_rx = stats["rx_ok"] + stats["rx_crc_error"] + stats["rx_header_error"]
+    if n_rx > 0:
+        print("%-18s %.1f%%" % ("packet error rate", 100.0 * (n_rx - stats["rx_ok"]) / n_rx))
+    print()
+    print_histogram("RSSI", stats["rssi_histogram"], RSSI_HISTOGRAM_MIN, RSSI_HISTOGRAM_STEP, "dBm")
+    print_histogram("SNR", stats["snr_histogram"], SNR_HISTOGRAM_MIN, SNR_HISTOGRAM_STEP, "dB")
+    print()
+    print("Last packets")
+    for r in stats["trace"]:
+        if r["event"] in ("TX", "TX_DENIED"):
+            print("  %10d ms  %-15s cmd=0x%02x len=%d" % (r["time"], r["event"], r["command"], r["length"]))
+        else:
+            print("  %10d ms  %-15s cmd=0x%02x len=%d rssi=%ddBm snr=%ddB" % (r["time"], r["event"], r["command"], r["length"], r["rssi"], r["snr"]))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,23 @@
+#include "context.h"
+
+// Definitions normally in context.cpp, which depends on the whole firmware
+bool Context::_submenuFocusHold = false;
+bool Context::_submenuTriggerHold = false;
+bool Context::_triggerSync = true;
+unsigned int Context::_delayMs = 0;
+bool Context::_delaySync = true;
+int Context::_intervalNShots = 1;
+unsigned int Context::_intervalDelayMs = 1000;
+bool Context::_intervalSync = true;
+int Context::_inputMode = 0;
+bool Context::_inputSync = true;
+unsigned int Context::_inputPassthroughDelayUs = 0;
+unsigned int Context::_inputPassthroughStretchUs = 0;
+unsigned int Context::_timingsFocusDurationMs = 0;
+unsigned int Context::_timingsTriggerDurationMs = 100;
+bool Context::_timingsSync = true;
+int Context::_syncChannel = 0;
+int Context::_radio = 0;
+int Context::_wakeInterval = 0;
+int Context::_channelWakeInterval = 0;
+int Context::_brightness = 3;
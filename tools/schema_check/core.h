@@ -0,0 +1,11 @@
+#ifndef _CORE_H_
+#define _CORE_H_
+
+// Minimal replacement of libtungsten/sam4l/core.h, for the declarations of context.h
+namespace Core {
+
+    using Time = unsigned long long;
+
+}
+
+#endif
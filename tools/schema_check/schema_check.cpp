@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "schema.h"
+#include "sync.h"
+
+// Host check of the settings schema (schema.cpp, compiled as is) : every field is round-tripped
+// through the three formats over its whole range of values, and the payloads are compared
+// byte for byte with the hand-written encoders used before the schema.
+
+const int MENU_TRIGGER = 0;
+const int MENU_DELAY = 1;
+const int MENU_INTERVAL = 2;
+const int MENU_TIMINGS = 3;
+const int MENU_INPUT = 4;
+const int MENU_SETTINGS = 5;
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, int field, uint32_t value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (field %d, value %u)\n", what, field, value);
+        }
+    }
+}
+
+// Largest value of a field which fits in its payload encoding
+uint32_t maxValue(int field) {
+    const Schema::Field& f = Schema::FIELDS[field];
+    if (f.type == Schema::Type::BOOL) {
+        return 1;
+    }
+    return (uint32_t)((1ull << (8 * f.width)) - 1) * f.scale;
+}
+
+// Random value of a field which fits in its encoding
+uint32_t randomValue(int field) {
+    uint64_t n = (uint64_t)maxValue(field) / Schema::FIELDS[field].scale + 1;
+    uint32_t r = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+    return (uint32_t)(r % n) * Schema::FIELDS[field].scale;
+}
+
+// Set every field to a random value
+void randomize() {
+    for (int i = 0; i < Schema::N_FIELDS; i++) {
+        Schema::set(i, randomValue(i));
+    }
+}
+
+// Encoders used by gui.cpp before the schema
+int legacyMenuPayload(int menu, uint8_t* payload, bool usb) {
+    int payloadSize = 0;
+    int payloadSizeUSB = 0;
+    if (menu == MENU_TRIGGER) {
+        payload[0] = Context::_submenuFocusHold;
+        payload[1] = Context::_submenuTriggerHold;
+        payload[2] = Context::_triggerSync;
+        payloadSize = 2;
+        payloadSizeUSB = 3;
+    } else if (menu == MENU_DELAY) {
+        payload[0] = ((Context::_delayMs / 100) >> 16) & 0xFF;
+        payload[1] = ((Context::_delayMs / 100) >> 8) & 0xFF;
+        payload[2] = (Context::_delayMs / 100) & 0xFF;
+        payload[3] = Context::_delaySync;
+        payloadSize = 3;
+        payloadSizeUSB = 4;
+    } else if (menu == MENU_INTERVAL) {
+        payload[0] = Context::_intervalNShots & 0xFF;
+        payload[1] = ((Context::_intervalDelayMs / 100) >> 16) & 0xFF;
+        payload[2] = ((Context::_intervalDelayMs / 100) >> 8) & 0xFF;
+        payload[3] = (Context::_intervalDelayMs / 100) & 0xFF;
+        payload[4] = Context::_intervalSync;
+        payloadSize = 4;
+        payloadSizeUSB = 5;
+    } else if (menu == MENU_TIMINGS) {
+        payload[0] = ((Context::_timingsFocusDurationMs / 100) >> 16) & 0xFF;
+        payload[1] = ((Context::_timingsFocusDurationMs / 100) >> 8) & 0xFF;
+        payload[2] = (Context::_timingsFocusDurationMs / 100) & 0xFF;
+        payload[3] = ((Context::_timingsTriggerDurationMs / 100) >> 16) & 0xFF;
+        payload[4] = ((Context::_timingsTriggerDurationMs / 100) >> 8) & 0xFF;
+        payload[5] = (Context::_timingsTriggerDurationMs / 100) & 0xFF;
+        payload[6] = Context::_timingsSync;
+        payloadSize = 6;
+        payloadSizeUSB = 7;
+    } else if (menu == MENU_INPUT) {
+        payload[0] = Context::_inputMode & 0xFF;
+        payload[1] = Context::_inputSync;
+        payloadSize = 1;
+        payloadSizeUSB = 2;
+    } else if (menu == MENU_SETTINGS) {
+        payload[0] = Context::_syncChannel;
+        payloadSizeUSB = 1;
+    }
+    return usb ? payloadSizeUSB : payloadSize;
+}
+
+// Answer to CMD_GET_GUI_STATE built by sync_usb.cpp before the schema
+int legacyGUIState(uint8_t* buffer) {
+    uint8_t state[] = {
+        static_cast<uint8_t>(Context::_submenuFocusHold),
+        static_cast<uint8_t>(Context::_submenuTriggerHold),
+        static_cast<uint8_t>(Context::_triggerSync),
+        static_cast<uint8_t>(Context::_delayMs / 100 >> 16),
+        static_cast<uint8_t>(Context::_delayMs / 100 >> 8),
+        static_cast<uint8_t>(Context::_delayMs / 100),
+        static_cast<uint8_t>(Context::_delaySync),
+        static_cast<uint8_t>(Context::_intervalNShots),
+        static_cast<uint8_t>(Context::_intervalDelayMs / 100 >> 16),
+        static_cast<uint8_t>(Context::_intervalDelayMs / 100 >> 8),
+        static_cast<uint8_t>(Context::_intervalDelayMs / 100),
+        static_cast<uint8_t>(Context::_intervalSync),
+        static_cast<uint8_t>(Context::_inputMode),
+        static_cast<uint8_t>(Context::_inputSync),
+        static_cast<uint8_t>(Context::_syncChannel),
+        static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100 >> 16),
+        static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100 >> 8),
+        static_cast<uint8_t>(Context::_timingsFocusDurationMs / 100),
+        static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100 >> 16),
+        static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100 >> 8),
+        static_cast<uint8_t>(Context::_timingsTriggerDurationMs / 100),
+        static_cast<uint8_t>(Context::_timingsSync)
+    };
+    memcpy(buffer, state, sizeof(state));
+    return sizeof(state);
+}
+
+// Order of the fields saved by Context::save() before the schema
+void legacySaved(uint32_t values[]) {
+    int i = 0;
+    values[i++] = Context::_triggerSync;
+    values[i++] = Context::_delayMs;
+    values[i++] = Context::_delaySync;
+    values[i++] = Context::_intervalNShots;
+    values[i++] = Context::_intervalDelayMs;
+    values[i++] = Context::_intervalSync;
+    values[i++] = Context::_inputMode;
+    values[i++] = Context::_inputSync;
+    values[i++] = Context::_timingsFocusDurationMs;
+    values[i++] = Context::_timingsTriggerDurationMs;
+    values[i++] = Context::_timingsSync;
+    values[i++] = Context::_syncChannel;
+    values[i++] = Context::_radio;
+    values[i++] = Context::_brightness;
+    values[i++] = Context::_wakeInterval;
+    values[i++] = Context::_inputPassthroughDelayUs;
+    values[i++] = Context::_inputPassthroughStretchUs;
+    values[i++] = Context::_channelWakeInterval;
+}
+
+// Find the menu of a field and round-trip it through the payload of this menu
+void checkMenuRoundTrip(int field, uint32_t value) {
+    for (int menu = 0; menu < Schema::N_MENUS; menu++) {
+        const Schema::Menu& m = Schema::MENUS[menu];
+        bool isSync = m.syncField == field;
+        bool inMenu = isSync;
+        for (int i = 0; i < m.nFields; i++) {
+            inMenu = inMenu || m.fields[i] == field;
+        }
+        if (!inMenu) {
+            continue;
+        }
+        for (int usb = 0; usb <= 1; usb++) {
+            if ((isSync || !m.radio) && !usb) {
+                continue;
+            }
+            uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+            randomize();
+            Schema::set(field, value);
+            int size = Schema::encodeMenu(menu, payload, usb);
+            check(size == Schema::menuPayloadSize(menu, usb), "payload size", field, value);
+
+            uint8_t legacy[Sync::MAX_PAYLOAD_SIZE];
+            int legacySize = legacyMenuPayload(menu, legacy, usb);
+            check(size == legacySize && memcmp(payload, legacy, size) == 0, "payload differs from the legacy encoder", field, value);
+
+            Schema::set(field, value == 0 ? maxValue(field) : 0);
+            check(Schema::decodeMenu(menu, payload, size, usb), "payload rejected", field, value);
+            check(Schema::get(field) == value, "menu round trip", field, value);
+            check(!Schema::decodeMenu(menu, payload, Schema::menuPayloadSize(menu, false) - 1, usb) || Schema::menuPayloadSize(menu, false) == 0,
+                "short payload accepted", field, value);
+        }
+    }
+}
+
+void checkField(int field, uint32_t value) {
+    // Menu payloads
+    checkMenuRoundTrip(field, value);
+
+    // Journal
+    uint32_t values[Schema::N_SAVED];
+    uint32_t legacy[Schema::N_SAVED];
+    randomize();
+    Schema::set(field, value);
+    Schema::getSaved(values);
+    legacySaved(legacy);
+    check(memcmp(values, legacy, sizeof(values)) == 0, "saved fields differ from the legacy order", field, value);
+    randomize();
+    Schema::setSaved(values, 0xFFFFFFFF);
+    check(Schema::get(field) == value || memchr(Schema::SAVED, field, Schema::N_SAVED) == nullptr, "journal round trip", field, value);
+
+    // GUI state
+    uint8_t state[Schema::GUI_STATE_SIZE + 1];
+    uint8_t legacyState[Schema::GUI_STATE_SIZE];
+    randomize();
+    Schema::set(field, value);
+    int size = Schema::encodeGUIState(state, sizeof(state));
+    int legacySize = legacyGUIState(legacyState);
+    check(size == Schema::GUI_STATE_SIZE + 1 && state[size - 1] == Schema::VERSION, "GUI state version", field, value);
+    check(legacySize == Schema::GUI_STATE_SIZE && memcmp(state, legacyState, legacySize) == 0, "GUI state differs from the legacy encoder", field, value);
+    check(Schema::encodeGUIState(state, Schema::GUI_STATE_SIZE) == Schema::GUI_STATE_SIZE, "truncated GUI state", field, value);
+}
+
+int main() {
+    srand(0);
+    for (int field = 0; field < Schema::N_FIELDS; field++) {
+        const Schema::Field& f = Schema::FIELDS[field];
+        uint32_t max = maxValue(field);
+        if (f.width == 1) {
+            // Every value
+            for (uint32_t value = 0; value <= max; value += f.scale) {
+                checkField(field, value);
+            }
+        } else {
+            // Each byte through all its values, the edges, and random values
+            for (int byte = 0; byte < f.width; byte++) {
+                for (uint32_t b = 0; b < 256; b++) {
+                    checkField(field, (b << (8 * byte)) * f.scale);
+                }
+            }
+            checkField(field, max);
+            checkField(field, max - f.scale);
+            for (int i = 0; i < 10000; i++) {
+                checkField(field, randomValue(field));
+            }
+        }
+    }
+
+    // Decoding over USB without the sync flag leaves it untouched
+    for (int menu = 0; menu < Schema::N_MENUS; menu++) {
+        const Schema::Menu& m = Schema::MENUS[menu];
+        if (m.syncField == Schema::NONE) {
+            continue;
+        }
+        uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+        Schema::set(m.syncField, 0);
+        int size = Schema::encodeMenu(menu, payload, false);
+        Schema::set(m.syncField, 1);
+        Schema::decodeMenu(menu, payload, size, true);
+        check(Schema::get(m.syncField) == 1, "sync flag updated without being present", m.syncField, 1);
+    }
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks over %d fields, %d menus, GUI state of %d bytes (version %d)\n",
+        _nChecks, Schema::N_FIELDS, Schema::N_MENUS, Schema::GUI_STATE_SIZE, Schema::VERSION);
+    return 0;
+}
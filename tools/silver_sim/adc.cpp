@@ -0,0 +1,72 @@
+#include <adc.h>
+#include <core.h>
+#include <dma.h>
+#include "sim.h"
+
+namespace DMA {
+    extern uint8_t INTERRUPT_PRIORITY;
+}
+
+// Simulated replacement of libtungsten/sam4l/adc.cpp, for the acquisitions of the battery
+// voltage (see Battery) : the samples are taken from the voltage set with Sim::setBattery()
+namespace ADC {
+
+    const int VREF = 3300 / 2; // VCC_OVER_2, the default reference
+    const int VBAT_DIVIDER = 2; // Resistor divider of the board
+
+    int _battery = 3900; // mV
+    bool _running = false;
+    void (*_handler)() = nullptr;
+
+    // Internal functions
+    void acquisitionHandler();
+
+
+    void enable(Channel channel) {
+    }
+
+    void setPin(Channel channel, GPIO::Pin pin) {
+    }
+
+    // The acquisition is done by the DMA, which interrupts at the end
+    bool startAcquisition(Channel channel, uint16_t* buffer, int nSamples, unsigned long frequency, void (*handler)(), Gain gain) {
+        if (_running) {
+            return false;
+        }
+        _running = true;
+        _handler = handler;
+        int value = _battery / VBAT_DIVIDER * 4095 / (2 * VREF);
+        for (int i = 0; i < nSamples; i++) {
+            buffer[i] = value;
+        }
+        Sim::schedule(Sim::now() + (Sim::Time) nSamples * Sim::S / frequency, [] () {
+            Sim::raise(Core::Interrupt::DMA0, DMA::INTERRUPT_PRIORITY, acquisitionHandler);
+        });
+        return true;
+    }
+
+    bool isAcquisitionRunning() {
+        return _running;
+    }
+
+    // Gain X05 only, single-ended
+    int toMillivolts(int value, Gain gain, bool differential) {
+        return value * 2 * VREF / 4095;
+    }
+
+    void acquisitionHandler() {
+        _running = false;
+        if (_handler != nullptr) {
+            _handler();
+        }
+    }
+
+}
+
+namespace Sim {
+
+    void setBattery(int millivolts) {
+        ADC::_battery = millivolts;
+    }
+
+}
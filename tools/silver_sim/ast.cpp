@@ -0,0 +1,68 @@
+#include <ast.h>
+#include <core.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/ast.cpp. The counter value is written by the
+// simulation into the CV register, which is read by the inline AST::ticks().
+namespace AST {
+
+    extern uint8_t INTERRUPT_PRIORITY;
+
+    Time _currentTimeHighBytes = 0;
+
+    void (*_alarmHandler)() = nullptr;
+    Sim::Event _alarm = Sim::NO_EVENT;
+
+    // Internal functions
+    void alarmHandlerWrapper();
+
+
+    // Same conversions as the real one : the alarm fires when the low 32 bits of the counter
+    // reach AR0
+    void enableAlarm(Time time, bool relative, void (*handler)(), bool wake) {
+        Core::disableInterrupts();
+        _alarmHandler = handler;
+        Sim::cancel(_alarm);
+
+        Ticks t = (time * (32768 / 2)) / 1000;
+        if (t > 2) {
+            t -= 2;
+        } else {
+            t = 0;
+        }
+        Ticks now = ticks();
+        if (relative) {
+            if (t < 2) {
+                t = 2;
+            }
+            t += (uint32_t) now;
+        }
+        uint32_t ar0 = (uint32_t) t;
+
+        // First tick at or after now whose low bits are AR0, as the comparison is done at each tick
+        Ticks at = (now & ~(Ticks)0xFFFFFFFF) | ar0;
+        if (at < now) {
+            at += (Ticks)1 << 32;
+        }
+        Sim::Time when = (at * Sim::S + TICKS_PER_SECOND - 1) / TICKS_PER_SECOND;
+        _alarm = Sim::schedule(when, [] () {
+            _alarm = Sim::NO_EVENT;
+            Sim::raise(Core::Interrupt::AST_ALARM, INTERRUPT_PRIORITY, alarmHandlerWrapper);
+        });
+
+        Core::enableInterrupts();
+    }
+
+    // An alarm interrupt already pending is still delivered, as on the chip
+    void disableAlarm() {
+        Sim::cancel(_alarm);
+    }
+
+    void alarmHandlerWrapper() {
+        disableAlarm();
+        if (_alarmHandler != nullptr) {
+            _alarmHandler();
+        }
+    }
+
+}
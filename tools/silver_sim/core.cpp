@@ -0,0 +1,51 @@
+#include <core.h>
+#include <timers.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/core.cpp
+namespace Core {
+
+    // The simulation is set up before the firmware starts (see silver_sim.cpp)
+    void init() {
+    }
+
+    void enableInterrupts() {
+        Sim::setInterruptsEnabled(true);
+    }
+
+    void disableInterrupts() {
+        Sim::setInterruptsEnabled(false);
+    }
+
+    bool isInterruptPending(Interrupt interrupt) {
+        return Sim::isPending(interrupt);
+    }
+
+    // Same as the real one, with WFI waiting for the next simulated interrupt
+    void sleep(unsigned long length, TimeUnit unit) {
+        if (length == 0) {
+            Sim::waitForInterrupt();
+            return;
+        }
+        if (unit == TimeUnit::SECONDS) {
+            length *= 1000;
+        }
+        Time end = time() + length;
+        int timer = Timers::start(length);
+        if (timer == Timers::INVALID) {
+            while (time() < end) {
+                Sim::advance(Sim::US);
+            }
+            return;
+        }
+        do {
+            Sim::waitForInterrupt();
+        } while (Timers::isRunning(timer) && time() < end);
+        Timers::cancel(timer);
+    }
+
+    void enableCycleCounter() {
+        Sim::resetCycles();
+    }
+
+}
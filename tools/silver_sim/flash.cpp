@@ -0,0 +1,81 @@
+#include <flash.h>
+#include <string.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/flash.cpp. The CPU is stalled while a page is
+// erased or programmed, as it executes from the flash.
+namespace Flash {
+
+    const Sim::Time ERASE_TIME = 4500 * Sim::US;
+    const Sim::Time PROGRAM_TIME = 4500 * Sim::US;
+
+    uint32_t _pages[FLASH_PAGES][FLASH_PAGE_SIZE_WORDS];
+    uint32_t _userPage[FLASH_PAGE_SIZE_WORDS];
+    bool _initialized = false;
+    bool _waitState = false;
+    Sim::FlashStats _stats;
+
+    // Internal functions
+    void init();
+
+
+    void readPage(int page, uint32_t data[]) {
+        init();
+        if (page < 0 || page >= FLASH_PAGES) {
+            return;
+        }
+        memcpy(data, _pages[page], sizeof(_pages[page]));
+    }
+
+    void erasePage(int page) {
+        init();
+        if (page < 0 || page >= FLASH_PAGES) {
+            return;
+        }
+        memset(_pages[page], 0xFF, sizeof(_pages[page]));
+        _stats.nErases++;
+        _stats.stalled += ERASE_TIME;
+        Sim::stall(ERASE_TIME);
+    }
+
+    // Programming can only clear bits
+    void programPage(int page, const uint32_t data[]) {
+        init();
+        if (page < 0 || page >= FLASH_PAGES) {
+            return;
+        }
+        for (int i = 0; i < FLASH_PAGE_SIZE_WORDS; i++) {
+            _pages[page][i] &= data[i];
+        }
+        _stats.nPrograms++;
+        _stats.stalled += PROGRAM_TIME;
+        Sim::stall(PROGRAM_TIME);
+    }
+
+    void readUserPage(uint32_t data[]) {
+        init();
+        memcpy(data, _userPage, sizeof(_userPage));
+    }
+
+    void setWaitState(bool enabled) {
+        _waitState = enabled;
+    }
+
+    // The flash of a new chip is erased
+    void init() {
+        if (!_initialized) {
+            memset(_pages, 0xFF, sizeof(_pages));
+            memset(_userPage, 0xFF, sizeof(_userPage));
+            _initialized = true;
+        }
+    }
+
+}
+
+namespace Sim {
+
+    const FlashStats& flashStats() {
+        return Flash::_stats;
+    }
+
+}
@@ -0,0 +1,258 @@
+#include <gpio.h>
+#include <core.h>
+#include <string.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <vector>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/gpio.cpp. Each pin reads the level driven by the
+// chip when it is an output, or else by the simulated hardware connected to it (see
+// Sim::drivePin()), or else its pulling resistor.
+// The compile-time pins (GPIO::FastPin) access the registers directly : the registers are mapped
+// at their real address but protected, and each access is applied to the model, as in
+// tools/fastpin_check (x86-64 Linux only).
+namespace GPIO {
+
+    extern uint8_t INTERRUPT_PRIORITY;
+
+    struct PortModel {
+        uint32_t oder = 0;
+        uint32_t ovr = 0;
+        uint32_t puer = 0;
+        uint32_t pder = 0;
+        uint32_t driven = 0; // Pins driven by the simulated hardware
+        uint32_t drive = 0;
+        uint32_t pvr = 0;
+        uint32_t ier = 0;
+        uint32_t rising = 0;
+        uint32_t falling = 0;
+        uint32_t ifr = 0;
+        void (*handlers[32])() = {nullptr};
+    };
+    PortModel _ports[N_PORTS];
+
+    struct Watcher {
+        Pin pin;
+        std::function<void(bool level)> watcher;
+    };
+    std::vector<Watcher> _watchers;
+
+    // Register trap
+    const uint32_t REGISTERS_SIZE = 0x1000;
+    volatile uint32_t* const REGISTERS = (volatile uint32_t*)(uintptr_t) GPIO_BASE;
+    const uint32_t UNWRITTEN = 0xA5A5A5A5; // Read from the set/clear/toggle registers
+    uint32_t _shadow[REGISTERS_SIZE / 4];
+    uint32_t _accessOffset = 0;
+    bool _pendingAccess = false;
+
+    // Internal functions
+    void update(int port);
+    void dispatch(int group);
+    template<int GROUP> void groupHandler() { dispatch(GROUP); }
+    void (*const GROUP_HANDLERS[N_PORTS * 4])() = {
+        groupHandler<0>, groupHandler<1>, groupHandler<2>, groupHandler<3>,
+        groupHandler<4>, groupHandler<5>, groupHandler<6>, groupHandler<7>,
+        groupHandler<8>, groupHandler<9>, groupHandler<10>, groupHandler<11>,
+    };
+
+
+    void enableInput(const Pin& pin, Pulling pulling) {
+        PortModel& p = _ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.oder &= ~mask;
+        p.puer = pulling == Pulling::PULLUP ? p.puer | mask : p.puer & ~mask;
+        p.pder = pulling == Pulling::PULLDOWN ? p.pder | mask : p.pder & ~mask;
+        update(static_cast<int>(pin.port));
+    }
+
+    void enableOutput(const Pin& pin, PinState value) {
+        PortModel& p = _ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.ovr = value ? p.ovr | mask : p.ovr & ~mask;
+        p.oder |= mask;
+        update(static_cast<int>(pin.port));
+    }
+
+    PinState get(const Pin& pin) {
+        return (_ports[static_cast<int>(pin.port)].pvr >> pin.number) & 1;
+    }
+
+    void set(const Pin& pin, PinState value) {
+        PortModel& p = _ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.ovr = value ? p.ovr | mask : p.ovr & ~mask;
+        update(static_cast<int>(pin.port));
+    }
+
+    // The glitch filter is not simulated : the pulses are never shorter than a cycle
+    void enableInterrupt(const Pin& pin, void (*handler)(), Trigger trigger, bool filter) {
+        PortModel& p = _ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.handlers[pin.number] = handler;
+        p.rising = trigger != Trigger::FALLING ? p.rising | mask : p.rising & ~mask;
+        p.falling = trigger != Trigger::RISING ? p.falling | mask : p.falling & ~mask;
+        p.ifr &= ~mask;
+        p.ier |= mask;
+    }
+
+    void disableInterrupt(const Pin& pin) {
+        PortModel& p = _ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.ier &= ~mask;
+        p.ifr &= ~mask;
+    }
+
+    // Compute the levels of the pins, and detect their edges
+    void update(int port) {
+        PortModel& p = _ports[port];
+        uint32_t undriven = ~p.oder & ~p.driven;
+        uint32_t pvr = (p.ovr & p.oder) | (p.drive & p.driven & ~p.oder)
+                | (p.puer & undriven) | (p.pvr & undriven & ~p.puer & ~p.pder);
+        uint32_t changed = pvr ^ p.pvr;
+        p.pvr = pvr;
+        if (changed == 0) {
+            return;
+        }
+        uint32_t edges = ((changed & pvr & p.rising) | (changed & ~pvr & p.falling)) & p.ier;
+        for (int n = 0; n < 32; n++) {
+            if (edges & (1u << n)) {
+                p.ifr |= 1u << n;
+                int group = port * 4 + n / 8;
+                Sim::raise(static_cast<Core::Interrupt>(static_cast<int>(Core::Interrupt::GPIO0) + group),
+                        INTERRUPT_PRIORITY, GROUP_HANDLERS[group]);
+            }
+        }
+        for (const Watcher& w : _watchers) {
+            if (static_cast<int>(w.pin.port) == port && (changed & (1u << w.pin.number))) {
+                w.watcher((pvr >> w.pin.number) & 1);
+            }
+        }
+    }
+
+    // Interrupt handler of a group of 8 pins
+    void dispatch(int group) {
+        PortModel& p = _ports[group / 4];
+        for (int n = (group % 4) * 8; n < (group % 4 + 1) * 8; n++) {
+            uint32_t mask = 1u << n;
+            if (p.ifr & p.ier & mask) {
+                p.ifr &= ~mask;
+                if (p.handlers[n] != nullptr) {
+                    p.handlers[n]();
+                }
+            }
+        }
+    }
+
+    uint32_t& reg(uint32_t offset) {
+        return *(uint32_t*) &REGISTERS[offset / 4];
+    }
+
+    // Values read by the next access
+    void prepareRead() {
+        for (int port = 0; port < N_PORTS; port++) {
+            uint32_t base = port * PORT_REG_SIZE;
+            reg(base + OFFSET_ODER) = _ports[port].oder;
+            reg(base + OFFSET_OVR) = _ports[port].ovr;
+            reg(base + OFFSET_OVR + 4) = UNWRITTEN;
+            reg(base + OFFSET_OVR + 8) = UNWRITTEN;
+            reg(base + OFFSET_OVR + 12) = UNWRITTEN;
+            reg(base + OFFSET_PVR) = _ports[port].pvr;
+        }
+    }
+
+    // Effect of the access which has just been executed. Only the output values can be written
+    // this way : the other registers are configured by the functions above.
+    void applyAccess(uint32_t offset) {
+        uint32_t value = reg(offset);
+        int port = offset / PORT_REG_SIZE;
+        uint32_t local = offset % PORT_REG_SIZE;
+        if (port >= N_PORTS) {
+            return;
+        }
+        PortModel& p = _ports[port];
+        if (local == OFFSET_OVR && value != _shadow[offset / 4]) {
+            p.ovr = value;
+        } else if (local == OFFSET_OVR + 4 && value != UNWRITTEN) {
+            p.ovr |= value;
+        } else if (local == OFFSET_OVR + 8 && value != UNWRITTEN) {
+            p.ovr &= ~value;
+        } else if (local == OFFSET_OVR + 12 && value != UNWRITTEN) {
+            p.ovr ^= value;
+        } else {
+            return;
+        }
+        update(port);
+    }
+
+    // An access to the registers faults : open them for this instruction only, and trap after it
+    void handlerSegv(int, siginfo_t* info, void* context) {
+        uintptr_t address = (uintptr_t) info->si_addr;
+        if (address < GPIO_BASE || address >= GPIO_BASE + REGISTERS_SIZE) {
+            signal(SIGSEGV, SIG_DFL);
+            return; // Crash on the access again
+        }
+        _accessOffset = (address - GPIO_BASE) & ~3u;
+        _pendingAccess = true;
+        mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_READ | PROT_WRITE);
+        prepareRead();
+        memcpy(_shadow, (const void*) REGISTERS, REGISTERS_SIZE);
+        ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] |= 0x100; // Trap flag
+    }
+
+    void handlerTrap(int, siginfo_t*, void* context) {
+        if (_pendingAccess) {
+            _pendingAccess = false;
+            applyAccess(_accessOffset);
+            mprotect((void*) REGISTERS, REGISTERS_SIZE, PROT_NONE);
+        }
+        ((ucontext_t*) context)->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    }
+
+}
+
+namespace Sim {
+
+    bool trapGPIORegisters() {
+        void* registers = mmap((void*) GPIO::REGISTERS, GPIO::REGISTERS_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (registers != (void*) GPIO::REGISTERS) {
+            return false;
+        }
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_flags = SA_SIGINFO;
+        action.sa_sigaction = GPIO::handlerSegv;
+        sigaction(SIGSEGV, &action, nullptr);
+        action.sa_sigaction = GPIO::handlerTrap;
+        sigaction(SIGTRAP, &action, nullptr);
+        return true;
+    }
+
+    bool pinLevel(const GPIO::Pin& pin) {
+        return GPIO::get(pin);
+    }
+
+    bool isOutput(const GPIO::Pin& pin) {
+        return (GPIO::_ports[static_cast<int>(pin.port)].oder >> pin.number) & 1;
+    }
+
+    void drivePin(const GPIO::Pin& pin, bool level) {
+        GPIO::PortModel& p = GPIO::_ports[static_cast<int>(pin.port)];
+        uint32_t mask = 1u << pin.number;
+        p.driven |= mask;
+        p.drive = level ? p.drive | mask : p.drive & ~mask;
+        GPIO::update(static_cast<int>(pin.port));
+    }
+
+    void releasePin(const GPIO::Pin& pin) {
+        GPIO::_ports[static_cast<int>(pin.port)].driven &= ~(1u << pin.number);
+        GPIO::update(static_cast<int>(pin.port));
+    }
+
+    // The watcher is called at each change of the level of the pin
+    void watchPin(const GPIO::Pin& pin, std::function<void(bool level)> watcher) {
+        GPIO::_watchers.push_back({pin, watcher});
+    }
+
+}
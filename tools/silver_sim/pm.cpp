@@ -0,0 +1,73 @@
+#include <pm.h>
+#include <scif.h>
+#include <bpm.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/pm.cpp, scif.cpp and bpm.cpp : only the
+// frequencies of the clocks are simulated
+namespace PM {
+
+    unsigned long _mainClockFrequency = RCSYS_FREQUENCY;
+    unsigned long _cpuClockFrequency = RCSYS_FREQUENCY;
+    unsigned long _pbaDivider = 0;
+
+    void setMainClockSource(MainClockSource clockSource, unsigned long cpudiv) {
+        unsigned long frequency = RCSYS_FREQUENCY;
+        if (clockSource == MainClockSource::RCFAST) {
+            frequency = SCIF::getRCFASTFrequency();
+        } else if (clockSource == MainClockSource::PLL) {
+            frequency = SCIF::getPLLFrequency();
+        }
+        _mainClockFrequency = frequency;
+        _cpuClockFrequency = cpudiv > 0 ? frequency >> cpudiv : frequency;
+        Sim::setCPUFrequency(_cpuClockFrequency);
+    }
+
+    // 0 : undivided, otherwise PBA = main clock / 2^pbadiv
+    void setPBADivider(unsigned long pbadiv) {
+        _pbaDivider = pbadiv;
+    }
+
+    // Only the PBA peripherals are used
+    unsigned long getModuleClockFrequency(uint8_t peripheral) {
+        return _mainClockFrequency >> _pbaDivider;
+    }
+
+}
+
+namespace SCIF {
+
+    const unsigned long RCFAST_FREQUENCIES[] = {4000000, 8000000, 12000000};
+    const unsigned long USB_PLL_FREQUENCY = 48000000;
+
+    unsigned long _rcfastFrequency = 0;
+    unsigned long _pllFrequency = 0;
+
+    void enableRCFAST(RCFASTFrequency frequency) {
+        _rcfastFrequency = RCFAST_FREQUENCIES[static_cast<int>(frequency)];
+    }
+
+    unsigned long getRCFASTFrequency() {
+        return _rcfastFrequency;
+    }
+
+    // Started by USB::initDevice()
+    void enablePLL(int mul, int div, GCLKSource referenceClock, unsigned long referenceFrequency) {
+        _pllFrequency = USB_PLL_FREQUENCY;
+    }
+
+    unsigned long getPLLFrequency() {
+        return _pllFrequency;
+    }
+
+}
+
+namespace BPM {
+
+    PowerScaling _powerScaling = PowerScaling::PS0;
+
+    void setPowerScaling(PowerScaling ps) {
+        _powerScaling = ps;
+    }
+
+}
@@ -0,0 +1,517 @@
+#include "scenario.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include "sim.h"
+#include "sx127x.h"
+#include "ssd1306.h"
+#include "pins.h"
+#include "sync_usb.h"
+
+namespace Scenario {
+
+    struct Step {
+        int line;
+        std::vector<std::string> args;
+    };
+
+    struct NamedPin {
+        const char* name;
+        GPIO::Pin pin;
+        bool activeHigh;
+    };
+
+    struct Record {
+        uint8_t type;
+        uint8_t command;
+    };
+
+    struct Latency {
+        long n = 0;
+        Sim::Time min = 0;
+        Sim::Time max = 0;
+        Sim::Time sum = 0;
+    };
+
+    const NamedPin BUTTONS[] = {
+        {"up", PIN_BTN_UP, false},
+        {"down", PIN_BTN_DOWN, false},
+        {"left", PIN_BTN_LEFT, false},
+        {"right", PIN_BTN_RIGHT, false},
+        {"ok", PIN_BTN_OK, false},
+        {"pw", PIN_BTN_PW, true},
+        {"focus", PIN_BTN_FOCUS, false},
+        {"trigger", PIN_BTN_TRIGGER, false},
+    };
+    const NamedPin OUTPUTS[] = {
+        {"trigger", PIN_TRIGGER, true},
+        {"focus", PIN_FOCUS, true},
+        {"led_trigger", PIN_LED_TRIGGER, false},
+        {"led_focus", PIN_LED_FOCUS, false},
+        {"led_input", PIN_LED_INPUT, false},
+        {"pw_en", PIN_PW_EN, true},
+    };
+    const int N_OUTPUTS_TIMED = 2; // trigger and focus
+    const int OUTPUT_TX = N_OUTPUTS_TIMED; // Start of the next frame sent, also timed
+    const int N_TIMED = N_OUTPUTS_TIMED + 1;
+    const int CLICK_DURATION = 100; // ms
+    const int DEFAULT_RSSI = -60; // dBm
+    const int DEFAULT_USB_LENGTH = 64;
+    const char* const RECORD_TYPES[] = {"", "gui", "event", "input"};
+
+    const char* _path = nullptr;
+    std::vector<Step> _steps;
+    unsigned int _next = 0;
+    int _nChecks = 0;
+    int _nFailures = 0;
+
+    // Stimuli and latencies
+    std::string _stimulus; // Kind of the last stimulus
+    Sim::Time _tStimulus = 0;
+    bool _waitingOutput[N_TIMED] = {false};
+    Sim::Time _lastLatency[N_TIMED] = {0};
+    bool _hasLatency[N_TIMED] = {false};
+    std::map<std::string, Latency> _latencies;
+
+    // Traffic
+    std::deque<SX127x::Frame> _txFrames; // Not checked yet
+    std::map<int, int> _txCommands;
+    std::deque<Record> _records; // Not checked yet
+    int _nRecords = 0;
+    int _nPackets = 0;
+
+    // Time spent by the modem in each mode, and by the CPU boosted, since the last measure
+    Sim::Time _tMeasure = 0;
+    Sim::Time _measureModeTime[SX127x::N_MODES] = {0};
+    Sim::Time _measureBoosted = 0;
+
+    // Internal functions
+    void run();
+    bool execute(const Step& step);
+    void finish();
+    void check(bool condition, const Step& step, const char* what, long long value);
+    const NamedPin* find(const NamedPin* pins, int n, const std::string& name);
+    void setButton(const NamedPin& button, bool pressed);
+    void stimulus(const char* kind);
+    void outputChanged(int output, bool level);
+    bool parseBytes(const std::vector<std::string>& args, unsigned int first, std::vector<int>& bytes);
+    bool match(const std::vector<int>& expected, const uint8_t* data, int size);
+    void usbPacket(const uint8_t* data, int size);
+    void report();
+
+
+    // Split the lines into words, a quoted text is a single word
+    bool load(const char* path) {
+        _path = path;
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            fprintf(stderr, "unable to open %s\n", path);
+            return false;
+        }
+        char buffer[256];
+        int line = 0;
+        while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+            line++;
+            Step step;
+            step.line = line;
+            const char* p = buffer;
+            while (*p != 0 && *p != '#') {
+                if (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+                    p++;
+                } else if (*p == '"') {
+                    const char* end = strchr(p + 1, '"');
+                    if (end == nullptr) {
+                        fprintf(stderr, "%s:%d: unterminated text\n", path, line);
+                        fclose(file);
+                        return false;
+                    }
+                    step.args.push_back(std::string(p + 1, end));
+                    p = end + 1;
+                } else {
+                    const char* end = p;
+                    while (*end != 0 && *end != ' ' && *end != '\t' && *end != '\r' && *end != '\n' && *end != '#') {
+                        end++;
+                    }
+                    step.args.push_back(std::string(p, end));
+                    p = end;
+                }
+            }
+            if (!step.args.empty()) {
+                _steps.push_back(step);
+            }
+        }
+        fclose(file);
+        return true;
+    }
+
+    // Connect the host side of the pins and of the buses, then run the steps from the power-on
+    void start() {
+        for (const NamedPin& button : BUTTONS) {
+            setButton(button, false);
+        }
+        Sim::drivePin(PIN_INPUT, GPIO::HIGH);
+        for (int i = 0; i < N_OUTPUTS_TIMED; i++) {
+            Sim::watchPin(OUTPUTS[i].pin, [i] (bool level) {
+                outputChanged(i, level);
+            });
+        }
+        SX127x::onTx([] (const SX127x::Frame& frame) {
+            _txFrames.push_back(frame);
+            _txCommands[frame.data.size() > 2 ? frame.data[2] : -1]++;
+            outputChanged(OUTPUT_TX, true);
+        });
+        Sim::usbOnPacket(usbPacket);
+        Sim::schedule(0, run);
+    }
+
+    // Execute the steps until the next wait. A stimulus also yields to the firmware, so that
+    // the interrupts it raised are served before the next step.
+    void run() {
+        while (_next < _steps.size()) {
+            const Step& step = _steps[_next++];
+            if (!execute(step)) {
+                return;
+            }
+        }
+        finish();
+    }
+
+    // Return false when the next steps must be executed later
+    bool execute(const Step& step) {
+        const std::vector<std::string>& a = step.args;
+        const std::string& command = a[0];
+        unsigned int n = a.size();
+
+        if (command == "wait" && n == 2) {
+            Sim::schedule(Sim::now() + (Sim::Time)(atof(a[1].c_str()) * Sim::MS), run);
+            return false;
+
+        } else if ((command == "press" || command == "release" || command == "click") && n >= 2) {
+            const NamedPin* button = find(BUTTONS, sizeof(BUTTONS) / sizeof(BUTTONS[0]), a[1]);
+            if (button == nullptr) {
+                check(false, step, "unknown button", 0);
+                return true;
+            }
+            if (command != "release") {
+                std::string kind = "button " + a[1];
+                stimulus(kind.c_str());
+            }
+            setButton(*button, command != "release");
+            if (command == "click") {
+                int duration = n >= 3 ? atoi(a[2].c_str()) : CLICK_DURATION;
+                Sim::schedule(Sim::now() + duration * Sim::MS, [button] () {
+                    setButton(*button, false);
+                });
+            }
+
+        } else if (command == "input" && n == 2) {
+            bool on = a[1] == "on";
+            if (on) {
+                stimulus("input");
+            }
+            Sim::drivePin(PIN_INPUT, on ? GPIO::LOW : GPIO::HIGH);
+
+        } else if (command == "radio" && n >= 2) {
+            std::vector<uint8_t> data;
+            int rssi = DEFAULT_RSSI;
+            int preamble = 8;
+            bool explicitHeader = false;
+            for (unsigned int i = 1; i < n; i++) {
+                if (a[i].compare(0, 5, "rssi=") == 0) {
+                    rssi = atoi(a[i].c_str() + 5);
+                } else if (a[i].compare(0, 9, "preamble=") == 0) {
+                    preamble = atoi(a[i].c_str() + 9);
+                } else if (a[i] == "explicit") {
+                    explicitHeader = true;
+                } else {
+                    data.push_back(strtol(a[i].c_str(), nullptr, 16));
+                }
+            }
+            stimulus("radio");
+            SX127x::receive(data, explicitHeader, rssi, preamble);
+
+        } else if (command == "battery" && n == 2) {
+            Sim::setBattery(atoi(a[1].c_str()));
+
+        } else if (command == "usb" && n >= 2) {
+            if (a[1] == "connect" || a[1] == "disconnect") {
+                Sim::usbConnect(a[1] == "connect");
+            } else if (a[1] == "out" && n >= 3) {
+                std::vector<int> bytes;
+                parseBytes(a, 3, bytes);
+                std::vector<uint8_t> data(bytes.begin(), bytes.end());
+                Sim::usbControl(false, strtol(a[2].c_str(), nullptr, 16), 0, data.data(), data.size());
+            } else if (a[1] == "in" && n >= 3) {
+                int value = n >= 4 ? strtol(a[3].c_str(), nullptr, 0) : 0;
+                int length = n >= 5 ? strtol(a[4].c_str(), nullptr, 0) : DEFAULT_USB_LENGTH;
+                Sim::usbControl(true, strtol(a[2].c_str(), nullptr, 16), value, nullptr, length);
+            } else {
+                check(false, step, "invalid usb command", 0);
+                return true;
+            }
+
+        } else if (command == "measure" && n == 1) {
+            _tMeasure = Sim::now();
+            const SX127x::Stats& radio = SX127x::stats();
+            for (int i = 0; i < SX127x::N_MODES; i++) {
+                _measureModeTime[i] = radio.modeTime[i];
+            }
+            _measureBoosted = Sim::boostedTime();
+            return true;
+
+        } else if (command == "dump" && n == 2 && a[1] == "screen") {
+            printf("%s:%d: screen at %.3fs\n", _path, step.line, (double) Sim::now() / Sim::S);
+            SSD1306::dump(stdout);
+            return true;
+
+        } else if (command == "expect" && n >= 3) {
+            const std::string& what = a[1];
+            if (what == "pin" && n == 4) {
+                const NamedPin* pin = find(OUTPUTS, sizeof(OUTPUTS) / sizeof(OUTPUTS[0]), a[2]);
+                if (pin == nullptr) {
+                    check(false, step, "unknown pin", 0);
+                } else {
+                    bool level = Sim::pinLevel(pin->pin);
+                    check(level == (a[3] == "high"), step, "pin level", level);
+                }
+
+            } else if (what == "tx") {
+                if (a[2] == "none") {
+                    check(_txFrames.empty(), step, "unexpected frame sent", _txFrames.size());
+                } else {
+                    // The header mode and the preamble length are optionally given after the bytes
+                    int headerMode = -1;
+                    int preamble = -1;
+                    unsigned int nBytes = n;
+                    while (nBytes > 3 && (a[nBytes - 1] == "implicit" || a[nBytes - 1] == "explicit" || a[nBytes - 1].compare(0, 9, "preamble=") == 0)) {
+                        if (a[nBytes - 1].compare(0, 9, "preamble=") == 0) {
+                            preamble = atoi(a[nBytes - 1].c_str() + 9);
+                        } else {
+                            headerMode = a[nBytes - 1] == "explicit";
+                        }
+                        nBytes--;
+                    }
+                    std::vector<int> expected;
+                    parseBytes(std::vector<std::string>(a.begin(), a.begin() + nBytes), 2, expected);
+                    bool found = false;
+                    while (!_txFrames.empty() && !found) {
+                        const SX127x::Frame& frame = _txFrames.front();
+                        found = match(expected, frame.data.data(), frame.data.size())
+                            && (headerMode < 0 || frame.explicitHeader == (headerMode == 1))
+                            && (preamble < 0 || frame.preambleLength == preamble);
+                        _txFrames.pop_front();
+                    }
+                    check(found, step, "frame not sent", expected.size() > 2 ? expected[2] : -1);
+                }
+
+            } else if (what == "usb") {
+                uint8_t response[512];
+                int size = 0;
+                bool handled = Sim::usbResponse(response, size);
+                if (a[2] == "stall") {
+                    check(!handled, step, "request not stalled", size);
+                } else {
+                    std::vector<int> expected;
+                    parseBytes(a, 2, expected);
+                    check(handled && match(expected, response, size), step, "usb response", size);
+                }
+
+            } else if (what == "record" && n == 4) {
+                int type = 0;
+                for (int i = 1; i < 4; i++) {
+                    if (a[2] == RECORD_TYPES[i]) {
+                        type = i;
+                    }
+                }
+                int command = strtol(a[3].c_str(), nullptr, 16);
+                bool found = false;
+                while (!_records.empty() && !found) {
+                    found = _records.front().type == type && _records.front().command == command;
+                    _records.pop_front();
+                }
+                check(found, step, "record", command);
+
+            } else if (what == "screen" || (what == "no" && n == 4 && a[2] == "screen")) {
+                bool expected = what == "screen";
+                const std::string& text = a[n - 1];
+                check(SSD1306::find(text.c_str()) == expected, step, expected ? "text not on the screen" : "text on the screen", 0);
+
+            } else if (what == "latency" && n == 4) {
+                int output = a[2] == "trigger" ? 0 : a[2] == "focus" ? 1 : a[2] == "tx" ? OUTPUT_TX : -1;
+                if (output < 0) {
+                    check(false, step, "unknown output", 0);
+                } else {
+                    Sim::Time max = (Sim::Time)(atof(a[3].c_str()) * Sim::MS);
+                    check(_hasLatency[output] && _lastLatency[output] <= max, step, "latency (us)",
+                        _hasLatency[output] ? (long long)(_lastLatency[output] / Sim::US) : -1);
+                }
+
+            } else if (what == "duty" && n == 4) {
+                // Awake : any mode other than sleep, in which the modem draws at least ~1.6mA
+                const SX127x::Stats& radio = SX127x::stats();
+                Sim::Time time = 0;
+                for (int i = 0; i < SX127x::N_MODES; i++) {
+                    const char* name = SX127x::MODE_NAMES[i];
+                    if ((a[2] == "awake" && strcmp(name, "sleep") != 0) || (a[2] == "rx" && strncmp(name, "rx", 2) == 0) || a[2] == name) {
+                        time += radio.modeTime[i] - _measureModeTime[i];
+                    }
+                }
+                double duty = Sim::now() > _tMeasure ? 100.0 * time / (Sim::now() - _tMeasure) : 0;
+                printf("%s:%d: %s %.3f%% of %.3fs\n", _path, step.line, a[2].c_str(), duty, (double) (Sim::now() - _tMeasure) / Sim::S);
+                check(duty <= atof(a[3].c_str()), step, "duty cycle (permil)", (long long)(duty * 10));
+
+            } else if (what == "boosted" && n == 3) {
+                Sim::Time boosted = Sim::boostedTime() - _measureBoosted;
+                check(boosted >= (Sim::Time)(atof(a[2].c_str()) * Sim::MS), step, "boosted time (us)", (long long)(boosted / Sim::US));
+
+            } else {
+                check(false, step, "invalid expect", 0);
+            }
+            return true;
+
+        } else {
+            check(false, step, "invalid command", 0);
+            return true;
+        }
+
+        Sim::schedule(Sim::now(), run);
+        return false;
+    }
+
+    void finish() {
+        report();
+        if (_nFailures > 0) {
+            printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+            exit(1);
+        }
+        printf("ok   %d checks\n", _nChecks);
+        exit(0);
+    }
+
+    void check(bool condition, const Step& step, const char* what, long long value) {
+        _nChecks++;
+        if (!condition) {
+            _nFailures++;
+            if (_nFailures <= 20) {
+                fprintf(stderr, "FAIL : %s:%d: %s (%lld)\n", _path, step.line, what, value);
+            }
+        }
+    }
+
+    const NamedPin* find(const NamedPin* pins, int n, const std::string& name) {
+        for (int i = 0; i < n; i++) {
+            if (name == pins[i].name) {
+                return &pins[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // The buttons are driven in both states : the pull-ups are only enabled by the firmware
+    void setButton(const NamedPin& button, bool pressed) {
+        Sim::drivePin(button.pin, pressed == button.activeHigh);
+    }
+
+    // The next assertion of each output is measured from this time
+    void stimulus(const char* kind) {
+        _stimulus = kind;
+        _tStimulus = Sim::now();
+        for (int i = 0; i < N_TIMED; i++) {
+            _waitingOutput[i] = true;
+            _hasLatency[i] = false;
+        }
+    }
+
+    void outputChanged(int output, bool level) {
+        if (!level || !_waitingOutput[output]) {
+            return;
+        }
+        _waitingOutput[output] = false;
+        Sim::Time latency = Sim::now() - _tStimulus;
+        _lastLatency[output] = latency;
+        _hasLatency[output] = true;
+        Latency& l = _latencies[_stimulus + " > " + (output == OUTPUT_TX ? "tx" : OUTPUTS[output].name)];
+        if (l.n == 0 || latency < l.min) {
+            l.min = latency;
+        }
+        if (latency > l.max) {
+            l.max = latency;
+        }
+        l.sum += latency;
+        l.n++;
+    }
+
+    // 'xx' is stored as -1
+    bool parseBytes(const std::vector<std::string>& args, unsigned int first, std::vector<int>& bytes) {
+        for (unsigned int i = first; i < args.size(); i++) {
+            bytes.push_back(args[i] == "xx" ? -1 : strtol(args[i].c_str(), nullptr, 16));
+        }
+        return true;
+    }
+
+    bool match(const std::vector<int>& expected, const uint8_t* data, int size) {
+        if ((int) expected.size() > size) {
+            return false;
+        }
+        for (unsigned int i = 0; i < expected.size(); i++) {
+            if (expected[i] >= 0 && expected[i] != data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Split the packets of the IN endpoint into records (see sync_usb.h)
+    void usbPacket(const uint8_t* data, int size) {
+        _nPackets++;
+        int i = 0;
+        while (i + SyncUSB::RECORD_HEADER_SIZE <= size && data[i] >= SyncUSB::RECORD_HEADER_SIZE) {
+            _records.push_back({data[i + 1], data[i + 6]});
+            _nRecords++;
+            i += data[i];
+        }
+    }
+
+    void report() {
+        const double ms = Sim::MS;
+        printf("%s : %.3fs simulated\n", _path, (double) Sim::now() / Sim::S);
+
+        for (const auto& it : _latencies) {
+            const Latency& l = it.second;
+            printf("  latency   %-24s n=%-3ld min %8.3fms  avg %8.3fms  max %8.3fms\n", it.first.c_str(), l.n,
+                l.min / ms, l.sum / l.n / ms, l.max / ms);
+        }
+
+        const Sim::SPIStats& oled = Sim::spiStats(SPI_SLAVE_OLED);
+        if (oled.nBursts > 0) {
+            printf("  screen    %d updates, avg %ld bytes %.3fms, max %ld bytes %.3fms\n", oled.nBursts,
+                oled.nBytes / oled.nBursts, oled.busy / oled.nBursts / ms, oled.burstBytesMax, oled.burstTimeMax / ms);
+        }
+
+        const SX127x::Stats& radio = SX127x::stats();
+        printf("  radio     tx %d frames, %ld bytes, %.3fms on air", radio.nTx, radio.txBytes, radio.txAirtime / ms);
+        for (const auto& it : _txCommands) {
+            printf(", %02X x%d", it.first, it.second);
+        }
+        printf("\n            rx %d frames, %d missed, modes", radio.nRx, radio.nMissed);
+        for (int i = 0; i < SX127x::N_MODES; i++) {
+            if (radio.modeTime[i] > 0) {
+                printf(" %s %.1f%%", SX127x::MODE_NAMES[i], 100.0 * radio.modeTime[i] / Sim::now());
+            }
+        }
+        printf("\n");
+
+        if (_nPackets > 0) {
+            printf("  usb       %d packets, %d records\n", _nPackets, _nRecords);
+        }
+
+        const Sim::FlashStats& flash = Sim::flashStats();
+        printf("  flash     %d erases, %d programs, CPU stalled %.3fms\n", flash.nErases, flash.nPrograms, flash.stalled / ms);
+        printf("  cpu       boosted %.1f%% of the time\n", 100.0 * Sim::boostedTime() / Sim::now());
+    }
+
+}
@@ -0,0 +1,43 @@
+#ifndef _SCENARIO_H_
+#define _SCENARIO_H_
+
+// Scripted scenario run against the simulated firmware : one command per line, executed in
+// virtual time from the power-on, '#' starts a comment.
+//   wait MS                              let the firmware run
+//   press|release|click BUTTON [MS]      up, down, left, right, ok, pw, focus, trigger
+//   input on|off                         external input (PB13, active low)
+//   radio HEX... [rssi=N] [preamble=N] [explicit]
+//                                        frame sent by another module, starting now
+//   battery MV                           battery voltage
+//   usb connect|disconnect
+//   usb out REQUEST [HEX...]             vendor request with data
+//   usb in REQUEST [VALUE] [LENGTH]      vendor request, the response is kept
+//   measure                              start measuring the time spent by the modem in each mode,
+//                                        and by the CPU boosted
+//   dump screen
+// Assertions ('xx' matches any byte) :
+//   expect pin NAME high|low             trigger, focus, led_trigger, led_focus, led_input, pw_en
+//   expect tx HEX...|none [implicit|explicit] [preamble=N]
+//                                        next frame sent by the modem which begins with these bytes,
+//                                        in this header mode and with this preamble length (symbols),
+//                                        or no frame since the previous expect tx
+//   expect usb HEX...|stall              beginning of the response to the last usb in
+//   expect record gui|event|input CMD    next record with this type and command on the IN endpoint
+//   expect [no] screen "TEXT"            text printed on the screen in any font
+//   expect latency trigger|focus|tx MAX_MS
+//                                        from the last stimulus to the assertion of the output, or to
+//                                        the start of the next frame sent
+//   expect duty awake|rx|cad MAX_PERCENT share of the time since the last measure spent by the modem
+//                                        in these modes (awake : any mode but sleep)
+//   expect boosted MIN_MS                time spent by the CPU at the boost frequency since the
+//                                        last measure
+// A report of the timings (latencies, screen updates, radio traffic, flash writes) is printed
+// at the end, followed by the result of the assertions.
+namespace Scenario {
+
+    bool load(const char* path);
+    void start();
+
+}
+
+#endif
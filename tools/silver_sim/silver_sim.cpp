@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include "sim.h"
+#include "sx127x.h"
+#include "ssd1306.h"
+#include "scenario.h"
+#include "pins.h"
+
+// Host simulation of the whole firmware : the sources of the application are compiled unmodified
+// (with main() renamed to firmwareMain()) and linked with the simulated back-ends of the library
+// in this directory, the screen and the LoRa modem on the SPI bus, and a USB host. The scenario
+// given as argument (see scenario.h) drives the inputs and checks the outputs in virtual time.
+//   ./silver_sim scenarios/trigger.sim
+
+int firmwareMain();
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage : %s SCENARIO\n", argv[0]);
+        return 2;
+    }
+
+    // The registers read by the inline functions of the library are mapped at their real
+    // address, which needs a 64-bit Linux host
+    if (!Sim::mapRegisters()) {
+        fprintf(stderr, "unable to map the registers of the microcontroller\n");
+        return 2;
+    }
+
+    SSD1306::connect(SPI_SLAVE_OLED, PIN_OLED_DC, PIN_OLED_RES);
+    SX127x::connect(SPI_SLAVE_LORA, PIN_LORA_RESET, PIN_LORA_DIO0);
+    if (!Scenario::load(argv[1])) {
+        return 2;
+    }
+    Scenario::start();
+
+    // Never returns : the scenario exits at its end
+    firmwareMain();
+    return 2;
+}
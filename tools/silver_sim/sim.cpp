@@ -0,0 +1,248 @@
+#include "sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <sys/mman.h>
+#include <ast.h>
+#include <pm.h>
+#include "governor.h"
+
+namespace Sim {
+
+    struct Entry {
+        Event id;
+        Time t;
+        std::function<void()> action;
+    };
+
+    struct Pending {
+        bool pending = false;
+        uint8_t priority = 0;
+        void (*handler)() = nullptr;
+    };
+
+    const int THREAD_LEVEL = 256; // Lower than any interrupt priority
+
+    Time _now = 0;
+    std::vector<Entry> _events;
+    Event _nextId = 0;
+
+    Pending _interrupts[Core::N_EXTERNAL_INTERRUPTS];
+    bool _primask = false;
+    int _level = THREAD_LEVEL;
+    bool _sleeping = false;
+
+    // DWT cycle counter, which doesn't count while the core sleeps
+    unsigned long _cpuFrequency = PM::RCSYS_FREQUENCY;
+    uint32_t _cycles = 0;
+    uint64_t _cyclesRemainder = 0; // ns * Hz
+    Time _boosted = 0;
+
+    const uint32_t AST_PAGE = AST::BASE & ~0xFFFu;
+    const uint32_t DWT_PAGE = Core::DWT_CTRL & ~0xFFFu;
+    const uint32_t PAGE_SIZE = 0x1000;
+
+    // Internal functions
+    void setNow(Time t);
+    int next();
+    void runNext(bool serve);
+    bool isInterruptEligible();
+    void serveInterrupts();
+
+
+    Time now() {
+        return _now;
+    }
+
+    // Call the action at the given time, from the next wait of the firmware
+    Event schedule(Time t, std::function<void()> action) {
+        if (t < _now) {
+            t = _now;
+        }
+        Event id = _nextId++;
+        _events.push_back({id, t, action});
+        return id;
+    }
+
+    void cancel(Event& event) {
+        for (unsigned int i = 0; i < _events.size(); i++) {
+            if (_events[i].id == event) {
+                _events.erase(_events.begin() + i);
+                break;
+            }
+        }
+        event = NO_EVENT;
+    }
+
+    // The CPU is busy for the given duration, e.g. waiting for the end of a transfer :
+    // the interrupts are served as they happen
+    void advance(Time duration) {
+        Time target = _now + duration;
+        int i = next();
+        while (i >= 0 && _events[i].t <= target) {
+            runNext(true);
+            i = next();
+        }
+        setNow(target);
+    }
+
+    // The CPU is stalled for the given duration, e.g. by a flash write : the interrupts
+    // raised in the meantime are only served at the end
+    void stall(Time duration) {
+        Time target = _now + duration;
+        int i = next();
+        while (i >= 0 && _events[i].t <= target) {
+            runNext(false);
+            i = next();
+        }
+        setNow(target);
+        serveInterrupts();
+    }
+
+    // WFI : sleep until an interrupt with a sufficient priority is pending, even if the
+    // interrupts are disabled, in which case it is served later
+    void waitForInterrupt() {
+        _sleeping = true;
+        while (!isInterruptEligible()) {
+            if (next() < 0) {
+                fprintf(stderr, "the firmware waits for an interrupt but nothing is scheduled\n");
+                exit(2);
+            }
+            runNext(false);
+        }
+        _sleeping = false;
+        serveInterrupts();
+    }
+
+    void raise(Core::Interrupt interrupt, uint8_t priority, void (*handler)()) {
+        Pending& p = _interrupts[static_cast<int>(interrupt)];
+        p.pending = true;
+        p.priority = priority;
+        p.handler = handler;
+    }
+
+    void clearPending(Core::Interrupt interrupt) {
+        _interrupts[static_cast<int>(interrupt)].pending = false;
+    }
+
+    bool isPending(Core::Interrupt interrupt) {
+        return _interrupts[static_cast<int>(interrupt)].pending;
+    }
+
+    // PRIMASK
+    void setInterruptsEnabled(bool enabled) {
+        _primask = !enabled;
+        if (enabled) {
+            serveInterrupts();
+        }
+    }
+
+    bool interruptsEnabled() {
+        return !_primask;
+    }
+
+    void setCPUFrequency(unsigned long frequency) {
+        _cpuFrequency = frequency;
+    }
+
+    void resetCycles() {
+        _cycles = 0;
+        _cyclesRemainder = 0;
+        *(volatile uint32_t*) Core::DWT_CYCCNT = 0;
+    }
+
+    // Time spent with the CPU clock faster than the idle one (see Governor)
+    Time boostedTime() {
+        return _boosted;
+    }
+
+    // The AST counter and the DWT cycle counter are read by inline functions : their pages
+    // are mapped at their real address and kept up to date by setNow()
+    bool mapRegisters() {
+        const uint32_t pages[] = {AST_PAGE, DWT_PAGE};
+        for (uint32_t page : pages) {
+            void* p = mmap((void*)(uintptr_t) page, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+            if (p != (void*)(uintptr_t) page) {
+                return false;
+            }
+        }
+        setNow(_now);
+        return trapGPIORegisters();
+    }
+
+    void setNow(Time t) {
+        if (t > _now) {
+            Time elapsed = t - _now;
+            if (!_sleeping) {
+                _cyclesRemainder += elapsed * _cpuFrequency;
+                _cycles += _cyclesRemainder / S;
+                _cyclesRemainder %= S;
+            }
+            if (_cpuFrequency > Governor::IDLE_FREQUENCY) {
+                _boosted += elapsed;
+            }
+            _now = t;
+        }
+        AST::Ticks ticks = (_now / S) * AST::TICKS_PER_SECOND + (_now % S) * AST::TICKS_PER_SECOND / S;
+        AST::_currentTimeHighBytes = ticks & ~(AST::Ticks)0xFFFFFFFF;
+        *(volatile uint32_t*)(uintptr_t)(AST::BASE + AST::OFFSET_CV) = (uint32_t) ticks;
+        *(volatile uint32_t*)(uintptr_t) Core::DWT_CYCCNT = _cycles;
+    }
+
+    // Index of the next event, in time then in order of scheduling
+    int next() {
+        int best = -1;
+        for (unsigned int i = 0; i < _events.size(); i++) {
+            if (best < 0 || _events[i].t < _events[best].t || (_events[i].t == _events[best].t && _events[i].id < _events[best].id)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void runNext(bool serve) {
+        int i = next();
+        Entry entry = _events[i];
+        _events.erase(_events.begin() + i);
+        setNow(entry.t);
+        entry.action();
+        if (serve) {
+            serveInterrupts();
+        }
+    }
+
+    bool isInterruptEligible() {
+        for (int i = 0; i < Core::N_EXTERNAL_INTERRUPTS; i++) {
+            if (_interrupts[i].pending && _interrupts[i].priority < _level) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Call the handlers of the pending interrupts which have a higher priority than the
+    // current one, highest first, as long as the interrupts are enabled
+    void serveInterrupts() {
+        while (!_primask) {
+            int best = -1;
+            for (int i = 0; i < Core::N_EXTERNAL_INTERRUPTS; i++) {
+                if (_interrupts[i].pending && _interrupts[i].priority < _level
+                        && (best < 0 || _interrupts[i].priority < _interrupts[best].priority)) {
+                    best = i;
+                }
+            }
+            if (best < 0) {
+                return;
+            }
+            Pending& p = _interrupts[best];
+            p.pending = false;
+            int level = _level;
+            _level = p.priority;
+            if (p.handler != nullptr) {
+                p.handler();
+            }
+            _level = level;
+        }
+    }
+
+}
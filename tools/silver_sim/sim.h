@@ -0,0 +1,95 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include <functional>
+#include <core.h>
+#include <gpio.h>
+#include <spi.h>
+
+// Host simulation of the microcontroller, on which the firmware runs unmodified. The simulated
+// back-ends in this directory replace the modules of the library (core.cpp, ast.cpp, gpio.cpp...)
+// and share the virtual time and the interrupt controller below.
+// The computation of the firmware takes no simulated time : the time only advances when the
+// firmware waits (sleep, SPI transfers, flash writes, polling of the radio), and the events due
+// in the meantime (alarms, counters, pin changes, frames on the air) raise their interrupts then.
+// The interrupt handlers are called from these points, with the same priorities and masking
+// rules as the NVIC.
+namespace Sim {
+
+    using Time = uint64_t; // ns
+    const Time US = 1000;
+    const Time MS = 1000 * US;
+    const Time S = 1000 * MS;
+
+    using Event = int;
+    const Event NO_EVENT = -1;
+
+    // Virtual time
+    Time now();
+    Event schedule(Time t, std::function<void()> action);
+    void cancel(Event& event);
+    void advance(Time duration);
+    void stall(Time duration);
+    void waitForInterrupt();
+
+    // Interrupt controller
+    void raise(Core::Interrupt interrupt, uint8_t priority, void (*handler)());
+    void clearPending(Core::Interrupt interrupt);
+    bool isPending(Core::Interrupt interrupt);
+    void setInterruptsEnabled(bool enabled);
+    bool interruptsEnabled();
+
+    // CPU clock (see PM), for the cycle counter
+    void setCPUFrequency(unsigned long frequency);
+    void resetCycles();
+    Time boostedTime();
+
+    // Registers accessed directly by the inline functions of the library
+    bool mapRegisters();
+
+    // Pins (see gpio.cpp)
+    bool trapGPIORegisters();
+    bool pinLevel(const GPIO::Pin& pin);
+    bool isOutput(const GPIO::Pin& pin);
+    void drivePin(const GPIO::Pin& pin, bool level);
+    void releasePin(const GPIO::Pin& pin);
+    void watchPin(const GPIO::Pin& pin, std::function<void(bool level)> watcher);
+
+    // Devices on the SPI bus (see spi.cpp)
+    struct SPIDevice {
+        std::function<void(const uint8_t* tx, uint8_t* rx, int n)> exchange;
+        std::function<void()> deselect;
+    };
+    struct SPIStats {
+        int nTransfers = 0;
+        long nBytes = 0;
+        Time busy = 0;
+        int nBursts = 0; // Transfers separated by less than BURST_GAP
+        long burstBytesMax = 0;
+        Time burstTimeMax = 0;
+    };
+    const Time SPI_BURST_GAP = 1 * MS;
+    void connectSPI(SPI::Peripheral peripheral, const SPIDevice& device);
+    const SPIStats& spiStats(SPI::Peripheral peripheral);
+
+    // Flash (see flash.cpp)
+    struct FlashStats {
+        int nErases = 0;
+        int nPrograms = 0;
+        Time stalled = 0;
+    };
+    const FlashStats& flashStats();
+
+    // USB host (see usb.cpp)
+    void usbConnect(bool connected);
+    void usbControl(bool in, uint8_t request, uint16_t value, const uint8_t* data, int size);
+    bool usbResponse(uint8_t* data, int& size); // false if the last request was stalled
+    void usbOnPacket(std::function<void(const uint8_t* data, int size)> handler);
+
+    // Battery voltage seen by the ADC (see adc.cpp)
+    void setBattery(int millivolts);
+
+}
+
+#endif
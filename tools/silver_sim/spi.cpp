@@ -0,0 +1,125 @@
+#include <spi.h>
+#include <pm.h>
+#include <string.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/spi.cpp, in master mode. Each transfer keeps the
+// CPU busy for its duration on the bus, plus the setup of the controller, then exchanges its
+// bytes with the simulated device selected, which is deselected at the end unless the transfer
+// is partial.
+namespace SPI {
+
+    const int N_PERIPHERALS = 4;
+    const unsigned long CLOCK_DIVIDER = 4; // SCBR, see addPeripheral() in the real module
+    const unsigned long SETUP_CYCLES = 60; // Programming of the controller and of the DMA
+
+    bool _enabled = false;
+    bool _csaat[N_PERIPHERALS] = {false};
+    Sim::SPIDevice _devices[N_PERIPHERALS];
+    Sim::SPIStats _stats[N_PERIPHERALS];
+    Sim::Time _lastTransferEnd[N_PERIPHERALS] = {0};
+    long _burstBytes[N_PERIPHERALS] = {0};
+    Sim::Time _burstTime[N_PERIPHERALS] = {0};
+
+    // Internal functions
+    void exchange(Peripheral peripheral, const uint8_t* tx, uint8_t* rx, int n);
+
+
+    void enableMaster() {
+        _enabled = true;
+    }
+
+    bool addPeripheral(Peripheral peripheral, Mode mode) {
+        if (!_enabled) {
+            enableMaster();
+        }
+        return peripheral < N_PERIPHERALS;
+    }
+
+    void setPin(PinFunction function, GPIO::Pin pin) {
+    }
+
+    uint8_t transfer(Peripheral peripheral, uint8_t tx, bool next) {
+        uint8_t txBuffer[] = {tx, 0};
+        uint8_t rxBuffer[] = {0, 0};
+        int n = next ? 2 : 1;
+        exchange(peripheral, txBuffer, rxBuffer, n);
+        if (!_csaat[peripheral] && _devices[peripheral].deselect) {
+            _devices[peripheral].deselect();
+        }
+        return rxBuffer[n - 1];
+    }
+
+    // When more bytes are received than sent, dummy bytes are sent after the data
+    void transfer(Peripheral peripheral, uint8_t* txBuffer, int txBufferSize, uint8_t* rxBuffer, int rxBufferSize, bool partial) {
+        _csaat[peripheral] = partial;
+        if (rxBuffer == nullptr || rxBufferSize < 0) {
+            rxBufferSize = 0;
+        }
+        if (txBuffer == nullptr) {
+            txBufferSize = 0;
+        }
+        int n = txBufferSize > rxBufferSize ? txBufferSize : rxBufferSize;
+        uint8_t tx[n];
+        uint8_t rx[n];
+        memset(tx, 0, n);
+        memcpy(tx, txBuffer, txBufferSize);
+        exchange(peripheral, tx, rx, n);
+        if (rxBufferSize > 0) {
+            memcpy(rxBuffer, rx, rxBufferSize);
+        }
+        if (!partial && _devices[peripheral].deselect) {
+            _devices[peripheral].deselect();
+        }
+    }
+
+    void exchange(Peripheral peripheral, const uint8_t* tx, uint8_t* rx, int n) {
+        if (!_enabled || peripheral >= N_PERIPHERALS) {
+            Error::happened(Error::Module::SPI, ERR_NOT_MASTER_MODE, Error::Severity::CRITICAL);
+            return;
+        }
+        unsigned long pba = PM::getModuleClockFrequency(PM::CLK_SPI);
+        Sim::Time duration = SETUP_CYCLES * Sim::S / PM::getCPUClockFrequency()
+                + (Sim::Time) n * 8 * CLOCK_DIVIDER * Sim::S / pba;
+
+        // Transfers closer than SPI_BURST_GAP are part of the same burst, e.g. a screen update
+        Sim::SPIStats& stats = _stats[peripheral];
+        Sim::Time start = Sim::now();
+        if (stats.nTransfers == 0 || start - _lastTransferEnd[peripheral] > Sim::SPI_BURST_GAP) {
+            stats.nBursts++;
+            _burstBytes[peripheral] = 0;
+            _burstTime[peripheral] = 0;
+        }
+        Sim::advance(duration);
+        stats.nTransfers++;
+        stats.nBytes += n;
+        stats.busy += duration;
+        _lastTransferEnd[peripheral] = Sim::now();
+        _burstBytes[peripheral] += n;
+        _burstTime[peripheral] += duration;
+        if (_burstBytes[peripheral] > stats.burstBytesMax) {
+            stats.burstBytesMax = _burstBytes[peripheral];
+        }
+        if (_burstTime[peripheral] > stats.burstTimeMax) {
+            stats.burstTimeMax = _burstTime[peripheral];
+        }
+
+        memset(rx, 0xFF, n); // MISO is pulled up when no device answers
+        if (_devices[peripheral].exchange) {
+            _devices[peripheral].exchange(tx, rx, n);
+        }
+    }
+
+}
+
+namespace Sim {
+
+    void connectSPI(SPI::Peripheral peripheral, const SPIDevice& device) {
+        SPI::_devices[peripheral] = device;
+    }
+
+    const SPIStats& spiStats(SPI::Peripheral peripheral) {
+        return SPI::_stats[peripheral];
+    }
+
+}
@@ -0,0 +1,271 @@
+#include "ssd1306.h"
+#include <string.h>
+#include "drivers/oled_ssd1306/font.h"
+#include "sim.h"
+
+namespace SSD1306 {
+
+    const int N_PAGES = HEIGHT / 8;
+    const int MAX_ARGS = 6;
+
+    const uint8_t CMD_ADDRESSING_MODE = 0x20;
+    const uint8_t CMD_COLUMN_START_END = 0x21;
+    const uint8_t CMD_PAGE_START_END = 0x22;
+    const uint8_t CMD_DISPLAY_OFF = 0xAE;
+    const uint8_t CMD_DISPLAY_ON = 0xAF;
+    const uint8_t CMD_DISPLAY_NORMAL = 0xA6;
+    const uint8_t CMD_DISPLAY_INVERTED = 0xA7;
+    const uint8_t CMD_CONTRAST = 0x81;
+
+    const int MODE_HORIZONTAL = 0;
+    const int MODE_VERTICAL = 1;
+    const int MODE_PAGE = 2;
+
+    uint8_t _gddram[N_PAGES][WIDTH];
+    GPIO::Pin _dc;
+    bool _on = false;
+    bool _inverted = false;
+    uint8_t _contrast = 0x7F;
+    int _addressingMode = MODE_PAGE;
+    int _columnStart = 0;
+    int _columnEnd = WIDTH - 1;
+    int _pageStart = 0;
+    int _pageEnd = N_PAGES - 1;
+    int _column = 0;
+    int _page = 0;
+    uint8_t _command = 0;
+    uint8_t _args[MAX_ARGS];
+    int _nArgs = 0;
+    int _nArgsExpected = 0;
+
+    // Internal functions
+    void reset();
+    void exchange(const uint8_t* tx, uint8_t* rx, int n);
+    void command(uint8_t byte);
+    void execute();
+    void data(uint8_t byte);
+    int nArgs(uint8_t command);
+    template<typename Char> bool matchChar(int x, int y, const Char& c, bool inverted);
+    template<typename Char> bool findText(const char* text, Char (*get)(char), int spacing, bool inverted);
+
+
+    void connect(SPI::Peripheral peripheral, GPIO::Pin dc, GPIO::Pin res) {
+        _dc = dc;
+        reset();
+        Sim::connectSPI(peripheral, {exchange, nullptr});
+        Sim::watchPin(res, [] (bool level) {
+            if (!level) {
+                reset();
+            }
+        });
+    }
+
+    bool isOn() {
+        return _on;
+    }
+
+    bool pixel(int x, int y) {
+        if (x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT) {
+            return false;
+        }
+        return _gddram[y / 8][x] & (1 << (y % 8));
+    }
+
+    // Look for the text in any of the fonts of the driver, normal or inverted, at any position
+    bool find(const char* text) {
+        for (int spacing = 1; spacing <= 2; spacing++) {
+            for (int inverted = 0; inverted <= 1; inverted++) {
+                if (findText(text, Font::getSmall, spacing, inverted)
+                        || findText(text, Font::getMedium, spacing, inverted)
+                        || findText(text, Font::getLarge, spacing, inverted)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void dump(FILE* file) {
+        fprintf(file, "+");
+        for (int x = 0; x < WIDTH; x++) {
+            fprintf(file, "-");
+        }
+        fprintf(file, "+\n");
+        for (int y = 0; y < HEIGHT; y++) {
+            fprintf(file, "|");
+            for (int x = 0; x < WIDTH; x++) {
+                fprintf(file, "%c", pixel(x, y) ? '#' : ' ');
+            }
+            fprintf(file, "|\n");
+        }
+        fprintf(file, "+");
+        for (int x = 0; x < WIDTH; x++) {
+            fprintf(file, "-");
+        }
+        fprintf(file, "+\n");
+    }
+
+    // State after RES, the content of the GDDRAM is kept
+    void reset() {
+        _on = false;
+        _inverted = false;
+        _contrast = 0x7F;
+        _addressingMode = MODE_PAGE;
+        _columnStart = 0;
+        _columnEnd = WIDTH - 1;
+        _pageStart = 0;
+        _pageEnd = N_PAGES - 1;
+        _column = 0;
+        _page = 0;
+        _nArgsExpected = 0;
+    }
+
+    // D/C# is sampled with each byte
+    void exchange(const uint8_t* tx, uint8_t* rx, int n) {
+        bool isData = Sim::pinLevel(_dc);
+        for (int i = 0; i < n; i++) {
+            if (isData) {
+                data(tx[i]);
+            } else {
+                command(tx[i]);
+            }
+        }
+    }
+
+    void command(uint8_t byte) {
+        if (_nArgsExpected > 0) {
+            _args[_nArgs++] = byte;
+            if (_nArgs == _nArgsExpected) {
+                _nArgsExpected = 0;
+                execute();
+            }
+            return;
+        }
+        _command = byte;
+        _nArgs = 0;
+        _nArgsExpected = nArgs(byte);
+        if (_nArgsExpected == 0) {
+            execute();
+        }
+    }
+
+    void execute() {
+        switch (_command) {
+            case CMD_ADDRESSING_MODE:
+                _addressingMode = _args[0] & 0x03;
+                break;
+
+            case CMD_COLUMN_START_END:
+                _columnStart = _args[0] & 0x7F;
+                _columnEnd = _args[1] & 0x7F;
+                _column = _columnStart;
+                break;
+
+            case CMD_PAGE_START_END:
+                _pageStart = _args[0] & 0x07;
+                _pageEnd = _args[1] & 0x07;
+                _page = _pageStart;
+                break;
+
+            case CMD_DISPLAY_OFF:
+            case CMD_DISPLAY_ON:
+                _on = _command == CMD_DISPLAY_ON;
+                break;
+
+            case CMD_DISPLAY_NORMAL:
+            case CMD_DISPLAY_INVERTED:
+                _inverted = _command == CMD_DISPLAY_INVERTED;
+                break;
+
+            case CMD_CONTRAST:
+                _contrast = _args[0];
+                break;
+
+            default:
+                // Page start address in page addressing mode
+                if (_command >= 0xB0 && _command <= 0xB7) {
+                    _page = _command & 0x07;
+                }
+                break;
+        }
+    }
+
+    // See datasheet §10.1.3 to §10.1.5 : the pointer wraps in the window
+    void data(uint8_t byte) {
+        _gddram[_page][_column] = byte;
+        if (_addressingMode == MODE_HORIZONTAL) {
+            if (++_column > _columnEnd) {
+                _column = _columnStart;
+                if (++_page > _pageEnd) {
+                    _page = _pageStart;
+                }
+            }
+        } else if (_addressingMode == MODE_VERTICAL) {
+            if (++_page > _pageEnd) {
+                _page = _pageStart;
+                if (++_column > _columnEnd) {
+                    _column = _columnStart;
+                }
+            }
+        } else if (++_column >= WIDTH) {
+            _column = 0;
+        }
+    }
+
+    // Number of bytes following each command
+    int nArgs(uint8_t command) {
+        switch (command) {
+            case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+                return 1;
+            case 0x21: case 0x22: case 0xA3:
+                return 2;
+            case 0x29: case 0x2A:
+                return 5;
+            case 0x26: case 0x27:
+                return 6;
+            default:
+                return 0;
+        }
+    }
+
+    // Bit j of a column of a character is the pixel at y + j. The whole cell of the glyph is
+    // compared, but not the gap before the next one.
+    template<typename Char>
+    bool matchChar(int x, int y, const Char& c, bool inverted) {
+        if (x + (int) c.width > WIDTH || y + (int) c.height > HEIGHT) {
+            return false;
+        }
+        for (unsigned int i = 0; i < c.width; i++) {
+            for (unsigned int j = 0; j < c.height; j++) {
+                bool on = (c.bitmap[i] >> j) & 1;
+                if (pixel(x + i, y + j) != (on != inverted)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    template<typename Char>
+    bool findText(const char* text, Char (*get)(char), int spacing, bool inverted) {
+        int length = strlen(text);
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                int cx = x;
+                int i = 0;
+                for (; i < length; i++) {
+                    Char c = get(text[i]);
+                    if (!matchChar(cx, y, c, inverted)) {
+                        break;
+                    }
+                    cx += c.width + spacing;
+                }
+                if (length > 0 && i == length) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+}
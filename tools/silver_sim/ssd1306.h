@@ -0,0 +1,24 @@
+#ifndef _SSD1306_H_
+#define _SSD1306_H_
+
+#include <stdio.h>
+#include <gpio.h>
+#include <spi.h>
+
+// Simulated SSD1306 OLED controller, as seen by drivers/oled_ssd1306 through the SPI bus :
+// command parser, addressing window and GDDRAM. The content of the screen is read back in
+// the coordinates of the firmware, to look for texts printed with the fonts of the driver.
+namespace SSD1306 {
+
+    const int WIDTH = 128;
+    const int HEIGHT = 64;
+
+    void connect(SPI::Peripheral peripheral, GPIO::Pin dc, GPIO::Pin res);
+    bool isOn();
+    bool pixel(int x, int y);
+    bool find(const char* text);
+    void dump(FILE* file);
+
+}
+
+#endif
@@ -0,0 +1,299 @@
+#include "sx127x.h"
+#include <string.h>
+
+namespace SX127x {
+
+    const uint8_t REG_FIFO = 0x00;
+    const uint8_t REG_OP_MODE = 0x01;
+    const uint8_t REG_FIFO_ADDR_PTR = 0x0D;
+    const uint8_t REG_FIFO_TX_BASE_ADDR = 0x0E;
+    const uint8_t REG_FIFO_RX_BASE_ADDR = 0x0F;
+    const uint8_t REG_FIFO_RX_CURRENT_ADDR = 0x10;
+    const uint8_t REG_IRQ_FLAGS_MASK = 0x11;
+    const uint8_t REG_IRQ_FLAGS = 0x12;
+    const uint8_t REG_FIFO_RX_BYTES_NB = 0x13;
+    const uint8_t REG_PKT_SNR_VALUE = 0x19;
+    const uint8_t REG_PKT_RSSI_VALUE = 0x1A;
+    const uint8_t REG_MODEM_CONFIG_1 = 0x1D;
+    const uint8_t REG_MODEM_CONFIG_2 = 0x1E;
+    const uint8_t REG_PREAMBLE_MSB = 0x20;
+    const uint8_t REG_PREAMBLE_LSB = 0x21;
+    const uint8_t REG_PAYLOAD_LENGTH = 0x22;
+    const uint8_t REG_MODEM_CONFIG_3 = 0x26;
+    const uint8_t REG_VERSION = 0x42;
+    const int N_REGISTERS = 0x80;
+    const int FIFO_SIZE = 256;
+
+    const uint8_t IRQ_CAD_DETECTED = 1 << 0;
+    const uint8_t IRQ_CAD_DONE = 1 << 2;
+    const uint8_t IRQ_TX_DONE = 1 << 3;
+    const uint8_t IRQ_VALID_HEADER = 1 << 4;
+    const uint8_t IRQ_RX_DONE = 1 << 6;
+    const uint8_t IRQ_DIO0 = IRQ_RX_DONE | IRQ_TX_DONE | IRQ_CAD_DONE; // Default mapping
+
+    const int MODE_SLEEP = 0;
+    const int MODE_STANDBY = 1;
+    const int MODE_TX = 3;
+    const int MODE_RX_CONTINUOUS = 5;
+    const int MODE_RX_SINGLE = 6;
+    const int MODE_CAD = 7;
+
+    const int VERSION = 0x12;
+    const int SNR = 10; // dB, of the received frames
+    const int CAD_SYMBOLS = 2;
+    const int DETECTION_SYMBOLS = 4; // Symbols of preamble needed to lock on a frame
+    const uint32_t BANDWIDTH_HZ[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+
+    uint8_t _registers[N_REGISTERS];
+    uint8_t _fifo[FIFO_SIZE];
+    SPI::Peripheral _peripheral = 0;
+    GPIO::Pin _dio0;
+    bool _addressed = false; // The first byte of a transaction has been received
+    uint8_t _address = 0;
+    bool _write = false;
+    bool _inReset = false;
+    int _mode = MODE_STANDBY;
+    Sim::Time _modeSince = 0;
+    Sim::Event _modeEvent = Sim::NO_EVENT; // End of the TX or of the CAD
+    std::vector<Frame> _onAir; // Frames received from other modules
+    std::function<void(const Frame& frame)> _txHandler;
+    Stats _stats;
+
+    // Internal functions
+    void reset();
+    uint8_t read(uint8_t address);
+    void write(uint8_t address, uint8_t value);
+    void setMode(int mode);
+    void setFlags(uint8_t flags);
+    void updateDIO0();
+    void exchange(const uint8_t* tx, uint8_t* rx, int n);
+    void endOfFrame(const Frame& frame);
+    Sim::Time symbolDuration();
+
+
+    void connect(SPI::Peripheral peripheral, GPIO::Pin reset, GPIO::Pin dio0) {
+        _peripheral = peripheral;
+        _dio0 = dio0;
+        SX127x::reset();
+        Sim::connectSPI(peripheral, {exchange, [] () { _addressed = false; }});
+
+        // The modem is held in reset while NRESET is low
+        Sim::watchPin(reset, [] (bool level) {
+            _inReset = !level;
+            if (_inReset) {
+                SX127x::reset();
+            }
+        });
+    }
+
+    // A frame sent by another module, which starts now
+    void receive(const std::vector<uint8_t>& data, bool explicitHeader, int rssi, int preambleLength) {
+        Frame frame;
+        frame.start = Sim::now();
+        frame.end = frame.start + timeOnAir(data.size(), explicitHeader, preambleLength);
+        frame.data = data;
+        frame.explicitHeader = explicitHeader;
+        frame.preambleLength = preambleLength;
+        frame.rssi = rssi;
+        _onAir.push_back(frame);
+        Sim::schedule(frame.end, [frame] () {
+            endOfFrame(frame);
+        });
+    }
+
+    // See datasheet §4.1.1.7. Time on air, with the modem settings of the registers
+    Sim::Time timeOnAir(int length, bool explicitHeader, int preambleLength) {
+        const int sf = _registers[REG_MODEM_CONFIG_2] >> 4;
+        const int cr = (_registers[REG_MODEM_CONFIG_1] >> 1) & 0x07;
+        const int ih = explicitHeader ? 0 : 1;
+        const int crc = (_registers[REG_MODEM_CONFIG_2] >> 2) & 1;
+        const int de = (_registers[REG_MODEM_CONFIG_3] >> 3) & 1;
+        int numerator = 8 * length - 4 * sf + 28 + 16 * crc - 20 * ih;
+        int denominator = 4 * (sf - 2 * de);
+        int nPayloadSymbols = 8;
+        if (numerator > 0) {
+            nPayloadSymbols += ((numerator + denominator - 1) / denominator) * (cr + 4);
+        }
+        Sim::Time nQuarterSymbols = 4 * (preambleLength + nPayloadSymbols) + 17;
+        return nQuarterSymbols * symbolDuration() / 4;
+    }
+
+    void onTx(std::function<void(const Frame& frame)> handler) {
+        _txHandler = handler;
+    }
+
+    int mode() {
+        return _mode;
+    }
+
+    const Stats& stats() {
+        _stats.modeTime[_mode] += Sim::now() - _modeSince;
+        _modeSince = Sim::now();
+        return _stats;
+    }
+
+    // Register values after a power-on reset
+    void reset() {
+        memset(_registers, 0, sizeof(_registers));
+        _registers[REG_OP_MODE] = 0x09;
+        _registers[REG_FIFO_TX_BASE_ADDR] = 0x80;
+        _registers[REG_MODEM_CONFIG_1] = 0x72;
+        _registers[REG_MODEM_CONFIG_2] = 0x70;
+        _registers[REG_PREAMBLE_LSB] = 0x08;
+        _registers[REG_PAYLOAD_LENGTH] = 0x01;
+        _registers[REG_VERSION] = VERSION;
+        _addressed = false;
+        setMode(MODE_STANDBY);
+        setFlags(0);
+    }
+
+    // The first byte selects the register and the direction, then the address is incremented
+    // after each byte, except for the FIFO which is accessed at REG_FIFO_ADDR_PTR
+    void exchange(const uint8_t* tx, uint8_t* rx, int n) {
+        for (int i = 0; i < n; i++) {
+            rx[i] = 0x00;
+            if (_inReset) {
+                continue;
+            }
+            if (!_addressed) {
+                _address = tx[i] & 0x7F;
+                _write = tx[i] & 0x80;
+                _addressed = true;
+                continue;
+            }
+            if (_write) {
+                write(_address, tx[i]);
+            } else {
+                rx[i] = read(_address);
+            }
+            if (_address != REG_FIFO) {
+                _address = (_address + 1) % N_REGISTERS;
+            }
+        }
+    }
+
+    uint8_t read(uint8_t address) {
+        if (address == REG_FIFO) {
+            return _fifo[_registers[REG_FIFO_ADDR_PTR]++];
+        }
+        return _registers[address];
+    }
+
+    void write(uint8_t address, uint8_t value) {
+        if (address == REG_FIFO) {
+            _fifo[_registers[REG_FIFO_ADDR_PTR]++] = value;
+        } else if (address == REG_IRQ_FLAGS) {
+            setFlags(_registers[REG_IRQ_FLAGS] & ~value);
+        } else if (address == REG_OP_MODE) {
+            // LongRangeMode can only be changed in sleep mode
+            if (_mode != MODE_SLEEP) {
+                value = (value & 0x7F) | (_registers[REG_OP_MODE] & 0x80);
+            }
+            _registers[REG_OP_MODE] = value;
+            setMode(value & 0x07);
+        } else if (address != REG_VERSION && address != REG_FIFO_RX_CURRENT_ADDR && address != REG_FIFO_RX_BYTES_NB) {
+            _registers[address] = value;
+        }
+    }
+
+    void setMode(int mode) {
+        if (mode == _mode) {
+            return;
+        }
+        Sim::cancel(_modeEvent);
+        _stats.modeTime[_mode] += Sim::now() - _modeSince;
+        _modeSince = Sim::now();
+        _mode = mode;
+        _registers[REG_OP_MODE] = (_registers[REG_OP_MODE] & 0xF8) | mode;
+
+        if (mode == MODE_TX) {
+            // The payload is sent from the TX base address of the FIFO
+            Frame frame;
+            frame.start = Sim::now();
+            frame.explicitHeader = !(_registers[REG_MODEM_CONFIG_1] & 1);
+            frame.preambleLength = _registers[REG_PREAMBLE_MSB] << 8 | _registers[REG_PREAMBLE_LSB];
+            for (int i = 0; i < _registers[REG_PAYLOAD_LENGTH]; i++) {
+                frame.data.push_back(_fifo[(_registers[REG_FIFO_TX_BASE_ADDR] + i) % FIFO_SIZE]);
+            }
+            frame.end = frame.start + timeOnAir(frame.data.size(), frame.explicitHeader, frame.preambleLength);
+            _stats.nTx++;
+            _stats.txBytes += frame.data.size();
+            _stats.txAirtime += frame.end - frame.start;
+            if (_txHandler) {
+                _txHandler(frame);
+            }
+            _modeEvent = Sim::schedule(frame.end, [] () {
+                _modeEvent = Sim::NO_EVENT;
+                setMode(MODE_STANDBY);
+                setFlags(_registers[REG_IRQ_FLAGS] | IRQ_TX_DONE);
+            });
+
+        } else if (mode == MODE_CAD) {
+            // A preamble on the air during the detection is found
+            Sim::Time start = Sim::now();
+            _modeEvent = Sim::schedule(start + CAD_SYMBOLS * symbolDuration(), [start] () {
+                _modeEvent = Sim::NO_EVENT;
+                uint8_t flags = IRQ_CAD_DONE;
+                for (const Frame& frame : _onAir) {
+                    Sim::Time preambleEnd = frame.start + frame.preambleLength * symbolDuration();
+                    if (frame.start <= Sim::now() && preambleEnd >= start) {
+                        flags |= IRQ_CAD_DETECTED;
+                    }
+                }
+                setMode(MODE_STANDBY);
+                setFlags(_registers[REG_IRQ_FLAGS] | flags);
+            });
+        }
+    }
+
+    // A frame is received if the modem was listening before the end of its preamble, and
+    // until its end, with the same header mode
+    void endOfFrame(const Frame& frame) {
+        for (unsigned int i = 0; i < _onAir.size(); i++) {
+            if (_onAir[i].start == frame.start && _onAir[i].data == frame.data) {
+                _onAir.erase(_onAir.begin() + i);
+                break;
+            }
+        }
+        Sim::Time lock = frame.start + (frame.preambleLength - DETECTION_SYMBOLS) * symbolDuration();
+        bool listening = (_mode == MODE_RX_CONTINUOUS || _mode == MODE_RX_SINGLE) && _modeSince <= lock;
+        bool explicitHeader = !(_registers[REG_MODEM_CONFIG_1] & 1);
+        bool sameLength = explicitHeader || frame.data.size() == _registers[REG_PAYLOAD_LENGTH];
+        if (_inReset || !listening || explicitHeader != frame.explicitHeader || !sameLength) {
+            _stats.nMissed++;
+            return;
+        }
+
+        uint8_t base = _registers[REG_FIFO_RX_BASE_ADDR];
+        for (unsigned int i = 0; i < frame.data.size(); i++) {
+            _fifo[(base + i) % FIFO_SIZE] = frame.data[i];
+        }
+        _registers[REG_FIFO_RX_CURRENT_ADDR] = base;
+        _registers[REG_FIFO_RX_BYTES_NB] = frame.data.size();
+        _registers[REG_PKT_RSSI_VALUE] = frame.rssi + 137;
+        _registers[REG_PKT_SNR_VALUE] = SNR * 4;
+        _stats.nRx++;
+        setFlags(_registers[REG_IRQ_FLAGS] | IRQ_RX_DONE | (explicitHeader ? IRQ_VALID_HEADER : 0));
+        if (_mode == MODE_RX_SINGLE) {
+            setMode(MODE_STANDBY);
+        }
+    }
+
+    void setFlags(uint8_t flags) {
+        _registers[REG_IRQ_FLAGS] = flags;
+        updateDIO0();
+    }
+
+    void updateDIO0() {
+        uint8_t flags = _registers[REG_IRQ_FLAGS] & ~_registers[REG_IRQ_FLAGS_MASK];
+        Sim::drivePin(_dio0, !_inReset && (flags & IRQ_DIO0));
+    }
+
+    // Tsym = 2^SF / BW
+    Sim::Time symbolDuration() {
+        const int sf = _registers[REG_MODEM_CONFIG_2] >> 4;
+        const int bw = _registers[REG_MODEM_CONFIG_1] >> 4;
+        return (Sim::S << sf) / BANDWIDTH_HZ[bw < 10 ? bw : 9];
+    }
+
+}
@@ -0,0 +1,46 @@
+#ifndef _SX127X_H_
+#define _SX127X_H_
+
+#include <stdint.h>
+#include <vector>
+#include <functional>
+#include <gpio.h>
+#include <spi.h>
+#include "sim.h"
+
+// Simulated SX1276/77/78 LoRa modem, as seen by drivers/lora through the SPI bus : register
+// file, FIFO, operating modes, IRQ flags on DIO0, and the time on air of the frames sent
+// and received. The frames from other modules are injected with receive().
+namespace SX127x {
+
+    const int N_MODES = 8;
+    const char* const MODE_NAMES[N_MODES] = {"sleep", "standby", "fstx", "tx", "fsrx", "rx", "rx single", "cad"};
+
+    struct Frame {
+        Sim::Time start = 0;
+        Sim::Time end = 0;
+        std::vector<uint8_t> data;
+        bool explicitHeader = false;
+        int preambleLength = 8; // Symbols
+        int rssi = 0; // dBm, received frames only
+    };
+
+    struct Stats {
+        int nTx = 0;
+        long txBytes = 0;
+        Sim::Time txAirtime = 0;
+        int nRx = 0;
+        int nMissed = 0; // Received frames which the modem wasn't listening to
+        Sim::Time modeTime[N_MODES] = {0};
+    };
+
+    void connect(SPI::Peripheral peripheral, GPIO::Pin reset, GPIO::Pin dio0);
+    void receive(const std::vector<uint8_t>& data, bool explicitHeader, int rssi, int preambleLength=8);
+    Sim::Time timeOnAir(int length, bool explicitHeader, int preambleLength);
+    void onTx(std::function<void(const Frame& frame)> handler);
+    int mode();
+    const Stats& stats(); // The time in the current mode is counted up to now
+
+}
+
+#endif
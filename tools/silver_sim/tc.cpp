@@ -0,0 +1,128 @@
+#include <tc.h>
+#include <pm.h>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/tc.cpp, for the free-running counters (see
+// Timestamp) and the delayed executions (see Shutter)
+namespace TC {
+
+    extern uint8_t INTERRUPT_PRIORITY;
+
+    const int N_COUNTERS = 6;
+    const uint32_t COUNTER_PERIOD = 1 << 16;
+
+    struct CounterModel {
+        unsigned long frequency = 0;
+        Sim::Time start = 0; // Time of the last zero of the counter
+        void (*handler)() = nullptr;
+        Sim::Event event = Sim::NO_EVENT;
+    };
+    CounterModel _counters[N_COUNTERS];
+
+    // Internal functions
+    int index(Counter counter);
+    Core::Interrupt interrupt(Counter counter);
+    unsigned long frequency(SourceClock sourceClock, unsigned long sourceClockFrequency);
+    void scheduleOverflow(Counter counter);
+    void scheduleDelayed(Counter counter, Sim::Time delay, bool repeat);
+    template<int I> void interruptHandler() {
+        if (_counters[I].handler != nullptr) {
+            _counters[I].handler();
+        }
+    }
+    void (*const HANDLERS[N_COUNTERS])() = {
+        interruptHandler<0>, interruptHandler<1>, interruptHandler<2>,
+        interruptHandler<3>, interruptHandler<4>, interruptHandler<5>,
+    };
+
+
+    void enableFreeRunningCounter(Counter counter, void (*overflowHandler)(), SourceClock sourceClock, unsigned long sourceClockFrequency) {
+        CounterModel& c = _counters[index(counter)];
+        Sim::cancel(c.event);
+        c.frequency = frequency(sourceClock, sourceClockFrequency);
+        c.start = Sim::now();
+        c.handler = overflowHandler;
+        scheduleOverflow(counter);
+    }
+
+    uint16_t counterValue(Counter counter) {
+        const CounterModel& c = _counters[index(counter)];
+        return (Sim::now() - c.start) * c.frequency / Sim::S;
+    }
+
+    unsigned long sourceClockFrequency(Counter counter) {
+        return _counters[index(counter)].frequency;
+    }
+
+    void execDelayed(Counter counter, void (*handler)(), unsigned long delay, Unit unit, bool repeat, SourceClock sourceClock, unsigned long sourceClockFrequency) {
+        CounterModel& c = _counters[index(counter)];
+        Sim::cancel(c.event);
+        Sim::clearPending(interrupt(counter));
+        c.frequency = frequency(sourceClock, sourceClockFrequency);
+        c.start = Sim::now();
+        c.handler = handler;
+        Sim::Time duration = 0;
+        if (unit == Unit::MILLISECONDS) {
+            duration = delay * Sim::MS;
+        } else if (unit == Unit::MICROSECONDS) {
+            duration = delay * Sim::US;
+        } else {
+            duration = (Sim::Time) delay * Sim::S / c.frequency;
+        }
+        scheduleDelayed(counter, duration, repeat);
+    }
+
+    // The interrupt is cleared with the status of the counter
+    void cancelDelayed(Counter counter) {
+        Sim::cancel(_counters[index(counter)].event);
+        Sim::clearPending(interrupt(counter));
+    }
+
+    int index(Counter counter) {
+        return counter.tc * N_COUNTERS_PER_TC + counter.n;
+    }
+
+    Core::Interrupt interrupt(Counter counter) {
+        return static_cast<Core::Interrupt>(static_cast<int>(Core::Interrupt::TC00) + index(counter));
+    }
+
+    unsigned long frequency(SourceClock sourceClock, unsigned long sourceClockFrequency) {
+        unsigned long pba = PM::getModuleClockFrequency(PM::CLK_TC0);
+        switch (sourceClock) {
+            case SourceClock::PBA_OVER_2:
+                return pba / 2;
+            case SourceClock::PBA_OVER_8:
+                return pba / 8;
+            case SourceClock::PBA_OVER_32:
+                return pba / 32;
+            case SourceClock::PBA_OVER_128:
+                return pba / 128;
+            default:
+                return sourceClockFrequency;
+        }
+    }
+
+    void scheduleOverflow(Counter counter) {
+        CounterModel& c = _counters[index(counter)];
+        c.event = Sim::schedule(c.start + (Sim::Time) COUNTER_PERIOD * Sim::S / c.frequency, [counter] () {
+            CounterModel& c = _counters[index(counter)];
+            c.start += (Sim::Time) COUNTER_PERIOD * Sim::S / c.frequency;
+            Sim::raise(interrupt(counter), INTERRUPT_PRIORITY, HANDLERS[index(counter)]);
+            scheduleOverflow(counter);
+        });
+    }
+
+    void scheduleDelayed(Counter counter, Sim::Time delay, bool repeat) {
+        CounterModel& c = _counters[index(counter)];
+        c.event = Sim::schedule(Sim::now() + delay, [counter, delay, repeat] () {
+            CounterModel& c = _counters[index(counter)];
+            c.event = Sim::NO_EVENT;
+            c.start = Sim::now();
+            Sim::raise(interrupt(counter), INTERRUPT_PRIORITY, HANDLERS[index(counter)]);
+            if (repeat) {
+                scheduleDelayed(counter, delay, repeat);
+            }
+        });
+    }
+
+}
@@ -0,0 +1,216 @@
+#include <usb.h>
+#include <scif.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "sim.h"
+
+// Simulated replacement of libtungsten/sam4l/usb.cpp, with the host on the other side of the
+// cable : it connects, sends vendor control requests, and polls the interrupt IN endpoints
+// every EP_INTERRUPT_INTERVAL. The handlers of the firmware are called from the USB interrupt.
+namespace USB {
+
+    extern uint8_t INTERRUPT_PRIORITY;
+
+    const int CONTROL_BUFFER_SIZE = 512; // Bank of endpoint 0
+
+    enum class HostEvent {
+        CONNECT,
+        DISCONNECT,
+        CONTROL,
+    };
+
+    struct Request {
+        HostEvent event;
+        SetupPacket setup;
+        std::vector<uint8_t> data;
+    };
+
+    struct EndpointModel {
+        uint8_t* bank = nullptr;
+        int (*inHandler)(int) = nullptr;
+        bool inInterrupt = false;
+        bool bankBusy = false; // Filled, until it is polled by the host
+        int size = 0;
+    };
+
+    void (*_connectedHandler)() = nullptr;
+    void (*_disconnectedHandler)() = nullptr;
+    int (*_controlHandler)(SetupPacket& lastSetupPacket, uint8_t* data, int size) = nullptr;
+    EndpointModel _endpoints[N_EP_MAX];
+    int _nEndpoints = 1; // Endpoint 0 is the control endpoint
+    std::deque<Request> _requests;
+    bool _connected = false;
+    Sim::Event _poll = Sim::NO_EVENT;
+    uint8_t _response[CONTROL_BUFFER_SIZE];
+    int _responseSize = 0;
+    bool _responseStalled = false;
+    std::function<void(const uint8_t* data, int size)> _packetHandler;
+
+    // Internal functions
+    void request(const Request& request);
+    void poll();
+
+
+    void initDevice(uint16_t vendorId, uint16_t productId, uint16_t deviceRevision) {
+        SCIF::enablePLL(0, 0);
+    }
+
+    void setStringDescriptor(StringDescriptors descriptor, const char* string, int size) {
+    }
+
+    Endpoint newEndpoint(EPType type, EPDir direction, EPBanks nBanks, EPSize size, uint8_t* bank0, uint8_t* bank1) {
+        if (_nEndpoints >= N_EP_MAX) {
+            return EP_ERROR;
+        }
+        _endpoints[_nEndpoints].bank = bank0;
+        return _nEndpoints++;
+    }
+
+    // The host enumerates the device as soon as it is ready
+    void setConnectedHandler(void (*handler)()) {
+        _connectedHandler = handler;
+        if (_connected) {
+            request({HostEvent::CONNECT, {}, {}});
+        }
+    }
+
+    void setDisconnectedHandler(void (*handler)()) {
+        _disconnectedHandler = handler;
+    }
+
+    void setControlHandler(int (*handler)(SetupPacket& lastSetupPacket, uint8_t* data, int size)) {
+        _controlHandler = handler;
+    }
+
+    void setEndpointHandler(Endpoint endpointNumber, EPHandlerType handlerType, int (*handler)(int)) {
+        if (handlerType == EPHandlerType::IN) {
+            _endpoints[endpointNumber].inHandler = handler;
+        }
+    }
+
+    // The IN handler is called as soon as the bank is free
+    void enableINInterrupt(Endpoint endpointNumber) {
+        _endpoints[endpointNumber].inInterrupt = true;
+        if (!_endpoints[endpointNumber].bankBusy) {
+            Sim::raise(Core::Interrupt::USBC, INTERRUPT_PRIORITY, interruptHandler);
+        }
+    }
+
+    void disableINInterrupt(Endpoint endpointNumber) {
+        _endpoints[endpointNumber].inInterrupt = false;
+    }
+
+    void interruptHandler() {
+        while (!_requests.empty()) {
+            Request r = _requests.front();
+            _requests.pop_front();
+            if (r.event == HostEvent::CONNECT) {
+                if (_connectedHandler != nullptr) {
+                    _connectedHandler();
+                }
+            } else if (r.event == HostEvent::DISCONNECT) {
+                if (_disconnectedHandler != nullptr) {
+                    _disconnectedHandler();
+                }
+            } else if (r.event == HostEvent::CONTROL) {
+                uint8_t buffer[CONTROL_BUFFER_SIZE];
+                int size = r.setup.direction == EPDir::IN ? r.setup.wLength : r.data.size();
+                memcpy(buffer, r.data.data(), r.data.size());
+                int n = _controlHandler != nullptr ? _controlHandler(r.setup, buffer, size) : 0;
+                _responseStalled = !r.setup.handled;
+                _responseSize = 0;
+                if (r.setup.direction == EPDir::IN && r.setup.handled) {
+                    _responseSize = n < r.setup.wLength ? n : r.setup.wLength;
+                    memcpy(_response, buffer, _responseSize);
+                }
+            }
+        }
+        for (int i = 1; i < _nEndpoints; i++) {
+            EndpointModel& ep = _endpoints[i];
+            if (_connected && ep.inInterrupt && !ep.bankBusy && ep.inHandler != nullptr) {
+                ep.size = ep.inHandler(0);
+                ep.bankBusy = true;
+            }
+        }
+    }
+
+    void request(const Request& r) {
+        _requests.push_back(r);
+        Sim::raise(Core::Interrupt::USBC, INTERRUPT_PRIORITY, interruptHandler);
+    }
+
+    // The host reads the banks which are ready
+    void poll() {
+        for (int i = 1; i < _nEndpoints; i++) {
+            EndpointModel& ep = _endpoints[i];
+            if (ep.bankBusy) {
+                if (_packetHandler) {
+                    _packetHandler(ep.bank, ep.size);
+                }
+                ep.bankBusy = false;
+                if (ep.inInterrupt) {
+                    Sim::raise(Core::Interrupt::USBC, INTERRUPT_PRIORITY, interruptHandler);
+                }
+            }
+        }
+        _poll = Sim::schedule(Sim::now() + EP_INTERRUPT_INTERVAL * Sim::MS, poll);
+    }
+
+}
+
+namespace Sim {
+
+    void usbConnect(bool connected) {
+        if (connected == USB::_connected) {
+            return;
+        }
+        USB::_connected = connected;
+        if (USB::_connectedHandler != nullptr) {
+            USB::request({connected ? USB::HostEvent::CONNECT : USB::HostEvent::DISCONNECT, {}, {}});
+        }
+        if (connected) {
+            USB::_poll = schedule(now() + USB::EP_INTERRUPT_INTERVAL * MS, USB::poll);
+        } else {
+            cancel(USB::_poll);
+            for (int i = 1; i < USB::_nEndpoints; i++) {
+                USB::_endpoints[i].bankBusy = false;
+            }
+        }
+    }
+
+    // Vendor request to the device, whose response is read with usbResponse()
+    void usbControl(bool in, uint8_t request, uint16_t value, const uint8_t* data, int size) {
+        USB::Request r;
+        r.event = USB::HostEvent::CONTROL;
+        r.setup.bmRequestType = (in ? 0x80 : 0x00) | static_cast<int>(USB::SetupRequestType::VENDOR) << 5;
+        r.setup.bRequest = request;
+        r.setup.wValue = value;
+        r.setup.wIndex = 0;
+        r.setup.wLength = size;
+        r.setup.direction = in ? USB::EPDir::IN : USB::EPDir::OUT;
+        r.setup.requestType = USB::SetupRequestType::VENDOR;
+        r.setup.recipent = USB::SetupRecipient::DEVICE;
+        r.setup.handled = false;
+        if (!in) {
+            r.data.assign(data, data + size);
+        }
+        USB::_responseStalled = true;
+        USB::_responseSize = 0;
+        if (USB::_connected) {
+            USB::request(r);
+        }
+    }
+
+    bool usbResponse(uint8_t* data, int& size) {
+        memcpy(data, USB::_response, USB::_responseSize);
+        size = USB::_responseSize;
+        return !USB::_responseStalled;
+    }
+
+    // Called with each packet read from the interrupt IN endpoints
+    void usbOnPacket(std::function<void(const uint8_t* data, int size)> handler) {
+        USB::_packetHandler = handler;
+    }
+
+}
@@ -0,0 +1,71 @@
+#ifndef _BACKEND_H_
+#define _BACKEND_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace Silver {
+
+    const uint16_t USB_VENDOR_ID = 0x03eb;
+    const uint16_t USB_PRODUCT_ID = 0xcbd0;
+
+    // Error codes, same values as libusb's
+    const int SUCCESS = 0;
+    const int ERROR_IO = -1;
+    const int ERROR_INVALID_PARAM = -2;
+    const int ERROR_NO_DEVICE = -4;
+    const int ERROR_BUSY = -6;
+    const int ERROR_TIMEOUT = -7;
+    const int ERROR_PIPE = -9;
+    const int ERROR_INTERRUPTED = -10;
+
+    // Timeout of a single control transfer
+    const unsigned int TRANSFER_TIMEOUT = 1000; // ms
+
+    struct DeviceInfo {
+        std::string id; // "bus-address", always unique
+        std::string serial; // String descriptor, may be shared by several devices
+    };
+
+    // An empty filter selects every device, otherwise a device is selected by its serial number or its id
+    inline bool matches(const DeviceInfo& info, const std::vector<std::string>& filter) {
+        return filter.empty()
+            || std::find(filter.begin(), filter.end(), info.serial) != filter.end()
+            || std::find(filter.begin(), filter.end(), info.id) != filter.end();
+    }
+
+    // Called on the event thread when a transfer completes. status is SUCCESS or an error code ;
+    // for IN transfers, data and length are the bytes received from the device.
+    using Completion = std::function<void(int status, const uint8_t* data, int length)>;
+
+    // Transport used by SilverController : LibUSBBackend talks to real devices,
+    // FakeBackend simulates them in-process
+    class Backend {
+    public:
+        virtual ~Backend() {}
+
+        // List the matching devices selected by the filter ; indexes in this list are used by the
+        // other functions. Enumerating again closes the devices of the previous list.
+        virtual int enumerate(std::vector<DeviceInfo>& devices, const std::vector<std::string>& filter) = 0;
+
+        virtual int open(int device) = 0;
+        virtual void close(int device) = 0;
+
+        // Submit an asynchronous vendor control transfer to an open device and return immediately.
+        // For OUT transfers data is copied before this function returns. May be called from any thread.
+        virtual int submitControl(int device, bool in, uint8_t request, uint16_t value, const uint8_t* data, uint16_t length, Completion completion) = 0;
+
+        // Wait at most timeout for completed transfers and call their completion handlers.
+        // Only called from the event thread.
+        virtual int handleEvents(unsigned int timeout) = 0;
+
+        // Make a pending handleEvents() return as soon as possible
+        virtual void interrupt() = 0;
+    };
+
+}
+
+#endif
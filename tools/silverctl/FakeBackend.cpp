@@ -0,0 +1,139 @@
+#include "FakeBackend.h"
+#include <stdio.h>
+
+namespace Silver {
+
+    // Size of the answer to CMD_GET_GUI_STATE, see sync_usb.cpp
+    const int GUI_STATE_SIZE = 22;
+
+    FakeBackend::FakeBackend(int nDevices, unsigned int latencyUs, unsigned int jitterUs, unsigned int seed)
+        : _devices(nDevices, Device{false, 0, 0}), _latencyUs(latencyUs), _jitterUs(jitterUs), _random(seed) {
+    }
+
+    int FakeBackend::enumerate(std::vector<DeviceInfo>& devices, const std::vector<std::string>& filter) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        devices.clear();
+        for (Device& device : _devices) {
+            device.open = false;
+        }
+        _enumerated.clear();
+        for (unsigned int i = 0; i < _devices.size(); i++) {
+            char serial[16];
+            snprintf(serial, sizeof(serial), "FAKE%03u", i);
+            DeviceInfo info = {"0-" + std::to_string(i + 1), serial};
+            if (matches(info, filter)) {
+                devices.push_back(info);
+                _enumerated.push_back(i);
+            }
+        }
+        return devices.size();
+    }
+
+    // Simulated device at the given index of the last enumeration, or nullptr
+    FakeBackend::Device* FakeBackend::find(int device) {
+        if (device < 0 || device >= static_cast<int>(_enumerated.size())) {
+            return nullptr;
+        }
+        return &_devices[_enumerated[device]];
+    }
+
+    int FakeBackend::open(int device) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Device* d = find(device);
+        if (d == nullptr) {
+            return ERROR_INVALID_PARAM;
+        }
+        d->open = true;
+        return SUCCESS;
+    }
+
+    void FakeBackend::close(int device) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Device* d = find(device);
+        if (d != nullptr) {
+            d->open = false;
+        }
+    }
+
+    int FakeBackend::submitControl(int device, bool in, uint8_t request, uint16_t value, const uint8_t* data, uint16_t length, Completion completion) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Device* d = find(device);
+        if (d == nullptr || !d->open) {
+            return ERROR_INVALID_PARAM;
+        }
+
+        Pending pending;
+        unsigned int delay = _latencyUs;
+        if (_jitterUs > 0) {
+            delay += _random() % (_jitterUs + 1);
+        }
+        pending.due = Clock::now() + std::chrono::microseconds(delay);
+        pending.sequence = _sequence++;
+        pending.completion = completion;
+        if (in) {
+            // The simulated devices answer every IN request with zeroes
+            int size = (request == 0x80 ? GUI_STATE_SIZE : 0);
+            if (size > length) {
+                size = length;
+            }
+            pending.data.assign(size, 0);
+        } else {
+            d->nCommands++;
+            d->lastCommand = request;
+        }
+        _pending.push(pending);
+        _cv.notify_one();
+        return SUCCESS;
+    }
+
+    int FakeBackend::handleEvents(unsigned int timeout) {
+        std::vector<Pending> completed;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+            while (!_interrupted) {
+                Clock::time_point now = Clock::now();
+                if (!_pending.empty() && _pending.top().due <= now) {
+                    break;
+                }
+                if (now >= deadline) {
+                    break;
+                }
+                Clock::time_point wakeup = deadline;
+                if (!_pending.empty() && _pending.top().due < wakeup) {
+                    wakeup = _pending.top().due;
+                }
+                _cv.wait_until(lock, wakeup);
+            }
+            _interrupted = false;
+            Clock::time_point now = Clock::now();
+            while (!_pending.empty() && _pending.top().due <= now) {
+                completed.push_back(_pending.top());
+                _pending.pop();
+            }
+        }
+
+        // Call the handlers without holding the lock, they may submit new transfers
+        for (Pending& pending : completed) {
+            pending.completion(SUCCESS, pending.data.data(), pending.data.size());
+        }
+        return SUCCESS;
+    }
+
+    void FakeBackend::interrupt() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _interrupted = true;
+        _cv.notify_one();
+    }
+
+    int FakeBackend::nCommands(int device) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _devices.at(device).nCommands;
+    }
+
+    uint8_t FakeBackend::lastCommand(int device) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _devices.at(device).lastCommand;
+    }
+
+}
@@ -0,0 +1,66 @@
+#ifndef _FAKE_BACKEND_H_
+#define _FAKE_BACKEND_H_
+
+#include "Backend.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <random>
+
+namespace Silver {
+
+    // In-process simulation of Silver devices, used to test and benchmark SilverController
+    // without hardware. Each transfer completes after a fixed latency plus a random jitter,
+    // which models the host controller scheduling and the device's handling time.
+    class FakeBackend : public Backend {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        FakeBackend(int nDevices, unsigned int latencyUs=500, unsigned int jitterUs=100, unsigned int seed=0);
+
+        int enumerate(std::vector<DeviceInfo>& devices, const std::vector<std::string>& filter) override;
+        int open(int device) override;
+        void close(int device) override;
+        int submitControl(int device, bool in, uint8_t request, uint16_t value, const uint8_t* data, uint16_t length, Completion completion) override;
+        int handleEvents(unsigned int timeout) override;
+        void interrupt() override;
+
+        // Number of OUT commands received by a simulated device, and the last one
+        int nCommands(int device);
+        uint8_t lastCommand(int device);
+
+    private:
+        struct Pending {
+            Clock::time_point due;
+            unsigned long sequence;
+            Completion completion;
+            std::vector<uint8_t> data;
+            bool operator<(const Pending& other) const { // Earliest first in the priority queue
+                return due != other.due ? due > other.due : sequence > other.sequence;
+            }
+        };
+
+        struct Device {
+            bool open;
+            int nCommands;
+            uint8_t lastCommand;
+        };
+
+        std::vector<Device> _devices;
+        std::vector<int> _enumerated; // Simulated device of each index of the last enumeration
+        unsigned int _latencyUs;
+        unsigned int _jitterUs;
+        std::mt19937 _random;
+        unsigned long _sequence = 0;
+        bool _interrupted = false;
+        std::priority_queue<Pending> _pending;
+        std::mutex _mutex;
+        std::condition_variable _cv;
+
+        Device* find(int device);
+    };
+
+}
+
+#endif
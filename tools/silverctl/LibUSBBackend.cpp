@@ -0,0 +1,174 @@
+#include "LibUSBBackend.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+namespace Silver {
+
+    LibUSBBackend::~LibUSBBackend() {
+        closeAll();
+        if (_context != nullptr) {
+            libusb_exit(_context);
+        }
+    }
+
+    // Release and close the handles of the last enumeration
+    void LibUSBBackend::closeAll() {
+        for (unsigned int i = 0; i < _handles.size(); i++) {
+            close(i);
+            libusb_close(_handles[i]);
+        }
+        _handles.clear();
+        _claimed.clear();
+    }
+
+    int LibUSBBackend::enumerate(std::vector<DeviceInfo>& devices, const std::vector<std::string>& filter) {
+        int r = 0;
+        devices.clear();
+        closeAll();
+
+        if (_context == nullptr) {
+            r = libusb_init(&_context);
+            if (r < 0) {
+                _context = nullptr;
+                return r;
+            }
+        }
+
+        // Get the list of devices
+        libusb_device** list;
+        ssize_t cnt = libusb_get_device_list(_context, &list);
+        if (cnt < 0) {
+            return static_cast<int>(cnt);
+        }
+
+        // Keep a handle on every device with the matching vendor and product ids which is selected
+        // by the filter. The serial number string can only be read once the device is opened.
+        for (ssize_t i = 0; i < cnt; i++) {
+            libusb_device* device = list[i];
+            struct libusb_device_descriptor desc;
+            if (libusb_get_device_descriptor(device, &desc) < 0) {
+                continue;
+            }
+            if (desc.idVendor != USB_VENDOR_ID || desc.idProduct != USB_PRODUCT_ID) {
+                continue;
+            }
+            libusb_device_handle* handle = nullptr;
+            if (libusb_open(device, &handle) < 0) {
+                continue;
+            }
+
+            DeviceInfo info;
+            info.id = std::to_string(libusb_get_bus_number(device)) + "-" + std::to_string(libusb_get_device_address(device));
+            unsigned char serial[64] = {0};
+            if (desc.iSerialNumber != 0 && libusb_get_string_descriptor_ascii(handle, desc.iSerialNumber, serial, sizeof(serial)) > 0) {
+                info.serial = reinterpret_cast<char*>(serial);
+            }
+            if (!matches(info, filter)) {
+                libusb_close(handle);
+                continue;
+            }
+            devices.push_back(info);
+            _handles.push_back(handle);
+            _claimed.push_back(false);
+        }
+
+        libusb_free_device_list(list, 1);
+        return devices.size();
+    }
+
+    int LibUSBBackend::open(int device) {
+        if (device < 0 || device >= static_cast<int>(_handles.size())) {
+            return ERROR_INVALID_PARAM;
+        }
+        libusb_device_handle* handle = _handles[device];
+
+        // Remove any active driver to take control of the interface
+        if (libusb_kernel_driver_active(handle, DEFAULT_INTERFACE) == 1) {
+            int r = libusb_detach_kernel_driver(handle, DEFAULT_INTERFACE);
+            if (r < 0) {
+                return r;
+            }
+        }
+
+        // Claim the interface
+        int r = libusb_claim_interface(handle, DEFAULT_INTERFACE);
+        if (r < 0) {
+            return r;
+        }
+        _claimed[device] = true;
+        return SUCCESS;
+    }
+
+    void LibUSBBackend::close(int device) {
+        if (device < 0 || device >= static_cast<int>(_handles.size()) || !_claimed[device]) {
+            return;
+        }
+        libusb_release_interface(_handles[device], DEFAULT_INTERFACE);
+        _claimed[device] = false;
+    }
+
+    int LibUSBBackend::submitControl(int device, bool in, uint8_t request, uint16_t value, const uint8_t* data, uint16_t length, Completion completion) {
+        if (device < 0 || device >= static_cast<int>(_handles.size()) || !_claimed[device]) {
+            return ERROR_INVALID_PARAM;
+        }
+
+        libusb_transfer* transfer = libusb_alloc_transfer(0);
+        if (transfer == nullptr) {
+            return ERROR_IO;
+        }
+
+        // The setup packet and the data stage share the same buffer, which is freed by libusb with the transfer
+        uint8_t* buffer = static_cast<uint8_t*>(malloc(LIBUSB_CONTROL_SETUP_SIZE + length));
+        if (buffer == nullptr) {
+            libusb_free_transfer(transfer);
+            return ERROR_IO;
+        }
+        uint8_t bmRequestType
+            = (in ? 1 : 0) << 7 // Direction
+            | 2 << 5            // Type : vendor
+            | 0;                // Recipent : device
+        libusb_fill_control_setup(buffer, bmRequestType, request, value, 0, length);
+        if (!in && length > 0) {
+            memcpy(buffer + LIBUSB_CONTROL_SETUP_SIZE, data, length);
+        }
+        libusb_fill_control_transfer(transfer, _handles[device], buffer, transferCallback, new Completion(completion), TRANSFER_TIMEOUT);
+        transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER | LIBUSB_TRANSFER_FREE_TRANSFER;
+
+        int r = libusb_submit_transfer(transfer);
+        if (r < 0) {
+            delete static_cast<Completion*>(transfer->user_data);
+            libusb_free_transfer(transfer);
+        }
+        return r;
+    }
+
+    void LIBUSB_CALL LibUSBBackend::transferCallback(libusb_transfer* transfer) {
+        Completion* completion = static_cast<Completion*>(transfer->user_data);
+        int status = SUCCESS;
+        switch (transfer->status) {
+            case LIBUSB_TRANSFER_COMPLETED: status = SUCCESS; break;
+            case LIBUSB_TRANSFER_TIMED_OUT: status = ERROR_TIMEOUT; break;
+            case LIBUSB_TRANSFER_STALL: status = ERROR_PIPE; break;
+            case LIBUSB_TRANSFER_NO_DEVICE: status = ERROR_NO_DEVICE; break;
+            case LIBUSB_TRANSFER_CANCELLED: status = ERROR_INTERRUPTED; break;
+            default: status = ERROR_IO; break;
+        }
+        (*completion)(status, libusb_control_transfer_get_data(transfer), transfer->actual_length);
+        delete completion;
+    }
+
+    int LibUSBBackend::handleEvents(unsigned int timeout) {
+        struct timeval tv;
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+        return libusb_handle_events_timeout_completed(_context, &tv, nullptr);
+    }
+
+    void LibUSBBackend::interrupt() {
+        if (_context != nullptr) {
+            libusb_interrupt_event_handler(_context);
+        }
+    }
+
+}
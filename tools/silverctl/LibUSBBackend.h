@@ -0,0 +1,34 @@
+#ifndef _LIBUSB_BACKEND_H_
+#define _LIBUSB_BACKEND_H_
+
+#include "Backend.h"
+#include <libusb-1.0/libusb.h>
+
+namespace Silver {
+
+    // Backend using the asynchronous API of libusb
+    class LibUSBBackend : public Backend {
+    private:
+        const uint16_t DEFAULT_INTERFACE = 0;
+
+        libusb_context* _context = nullptr;
+        std::vector<libusb_device_handle*> _handles;
+        std::vector<bool> _claimed;
+
+        void closeAll();
+        static void LIBUSB_CALL transferCallback(libusb_transfer* transfer);
+
+    public:
+        ~LibUSBBackend();
+
+        int enumerate(std::vector<DeviceInfo>& devices, const std::vector<std::string>& filter) override;
+        int open(int device) override;
+        void close(int device) override;
+        int submitControl(int device, bool in, uint8_t request, uint16_t value, const uint8_t* data, uint16_t length, Completion completion) override;
+        int handleEvents(unsigned int timeout) override;
+        void interrupt() override;
+    };
+
+}
+
+#endif
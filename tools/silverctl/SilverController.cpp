@@ -0,0 +1,121 @@
+#include "SilverController.h"
+
+namespace Silver {
+
+    // Maximum time spent waiting for events before checking if the thread should stop
+    const unsigned int EVENT_LOOP_TIMEOUT = 100; // ms
+
+    SilverController::SilverController(Backend* backend)
+        : _backend(backend), _running(false) {
+    }
+
+    SilverController::~SilverController() {
+        close();
+    }
+
+    int SilverController::open(const std::vector<std::string>& filter) {
+        close();
+
+        std::vector<DeviceInfo> devices;
+        int r = _backend->enumerate(devices, filter);
+        if (r < 0) {
+            return r;
+        }
+        for (unsigned int i = 0; i < devices.size(); i++) {
+            if (_backend->open(i) < 0) {
+                continue;
+            }
+            _devices.push_back(devices[i]);
+            _indexes.push_back(i);
+        }
+
+        // Start the event thread
+        _running = true;
+        _eventThread = std::thread(&SilverController::eventLoop, this);
+        return _devices.size();
+    }
+
+    void SilverController::close() {
+        if (_running) {
+            _running = false;
+            _backend->interrupt();
+            _eventThread.join();
+        }
+        for (int index : _indexes) {
+            _backend->close(index);
+        }
+        _devices.clear();
+        _indexes.clear();
+    }
+
+    void SilverController::eventLoop() {
+        while (_running) {
+            _backend->handleEvents(EVENT_LOOP_TIMEOUT);
+        }
+    }
+
+    // Submit a transfer ; the completion fills result and then fulfills promise
+    int SilverController::submit(int device, bool in, uint8_t command, const uint8_t* payload, int size, std::promise<Result>* promise, Result* result) {
+        if (device < 0 || device >= static_cast<int>(_devices.size())) {
+            return ERROR_INVALID_PARAM;
+        }
+        result->tSubmitted = std::chrono::steady_clock::now();
+        return _backend->submitControl(_indexes[device], in, command, 0, payload, size,
+            [promise, result](int status, const uint8_t* data, int length) {
+                result->tCompleted = std::chrono::steady_clock::now();
+                result->status = status;
+                if (length > 0) {
+                    result->data.assign(data, data + length);
+                }
+                promise->set_value(*result);
+                delete promise;
+                delete result;
+            });
+    }
+
+    std::future<Result> SilverController::command(int device, uint8_t command, const uint8_t* payload, int size) {
+        std::promise<Result>* promise = new std::promise<Result>();
+        Result* result = new Result();
+        std::future<Result> future = promise->get_future();
+        int r = submit(device, false, command, payload, size, promise, result);
+        if (r < 0) {
+            result->status = r;
+            promise->set_value(*result);
+            delete promise;
+            delete result;
+        }
+        return future;
+    }
+
+    std::future<Result> SilverController::request(int device, uint8_t command, int length) {
+        std::promise<Result>* promise = new std::promise<Result>();
+        Result* result = new Result();
+        std::future<Result> future = promise->get_future();
+        int r = submit(device, true, command, nullptr, length, promise, result);
+        if (r < 0) {
+            result->status = r;
+            promise->set_value(*result);
+            delete promise;
+            delete result;
+        }
+        return future;
+    }
+
+    std::vector<Result> SilverController::broadcast(uint8_t command, const uint8_t* payload, int size) {
+        // Submit everything first...
+        std::vector<std::future<Result>> futures;
+        futures.reserve(_devices.size());
+        for (unsigned int i = 0; i < _devices.size(); i++) {
+            futures.push_back(SilverController::command(i, command, payload, size));
+        }
+
+        // ...then wait for the completions
+        std::vector<Result> results;
+        results.reserve(futures.size());
+        for (std::future<Result>& future : futures) {
+            results.push_back(future.get());
+        }
+        return results;
+    }
+
+}
@@ -0,0 +1,69 @@
+#ifndef _SILVER_CONTROLLER_H_
+#define _SILVER_CONTROLLER_H_
+
+#include "Backend.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+namespace Silver {
+
+    // Commands, see sync.h
+    const uint8_t CMD_GET_GUI_STATE = 0x80;
+    const uint8_t CMD_GET_GUI_UPDATE = 0x81;
+    const uint8_t CMD_GET_RADIO_STATS = 0x82;
+    const uint8_t CMD_FOCUS = 0x90;
+    const uint8_t CMD_FOCUS_HOLD = 0x91;
+    const uint8_t CMD_FOCUS_RELEASE = 0x92;
+    const uint8_t CMD_TRIGGER = 0x93;
+    const uint8_t CMD_TRIGGER_NO_DELAY = 0x94;
+    const uint8_t CMD_TRIGGER_HOLD = 0x95;
+    const uint8_t CMD_TRIGGER_RELEASE = 0x96;
+
+    const int GUI_STATE_SIZE = 22;
+
+    struct Result {
+        int status = ERROR_IO;
+        std::vector<uint8_t> data;
+        std::chrono::steady_clock::time_point tSubmitted;
+        std::chrono::steady_clock::time_point tCompleted; // Measured on the event thread
+    };
+
+    // Drives any number of Silver devices concurrently : every open device shares a single
+    // event thread which processes the completions of the asynchronous transfers, so commands
+    // to different devices are in flight at the same time instead of one round-trip after the other
+    class SilverController {
+    private:
+        Backend* _backend;
+        std::vector<DeviceInfo> _devices; // Open devices
+        std::vector<int> _indexes; // Index of each open device in the backend
+        std::thread _eventThread;
+        std::atomic<bool> _running;
+
+        void eventLoop();
+        int submit(int device, bool in, uint8_t command, const uint8_t* payload, int size, std::promise<Result>* promise, Result* result);
+
+    public:
+        // The backend must outlive the controller
+        SilverController(Backend* backend);
+        ~SilverController();
+
+        // Open every matching device, or only those whose serial number or id is in the list.
+        // Return the number of open devices or an error code.
+        int open(const std::vector<std::string>& filter=std::vector<std::string>());
+        void close();
+        const std::vector<DeviceInfo>& devices() const { return _devices; }
+
+        // Send a command to one device (OUT), or read data from it (IN)
+        std::future<Result> command(int device, uint8_t command, const uint8_t* payload=nullptr, int size=0);
+        std::future<Result> request(int device, uint8_t command, int length);
+
+        // Send the same command to every open device with minimal skew : all the transfers are
+        // submitted back to back before waiting for any of them. Blocks until they all complete.
+        std::vector<Result> broadcast(uint8_t command, const uint8_t* payload=nullptr, int size=0);
+    };
+
+}
+
+#endif
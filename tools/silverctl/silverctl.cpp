@@ -0,0 +1,159 @@
+#include <iostream>
+#include <iomanip>
+#include <stdlib.h>
+#include <string.h>
+#include "SilverController.h"
+#include "LibUSBBackend.h"
+#include "FakeBackend.h"
+
+// Command-line tool to control every Silver module connected over USB at once
+
+using namespace Silver;
+
+void usage() {
+    std::cerr << "Usage : silverctl [--fake N] [--device SERIAL|ID]... COMMAND [ARGS]" << std::endl
+              << "Commands :" << std::endl
+              << "    list                     list the connected devices" << std::endl
+              << "    state                    print the GUI state of each device" << std::endl
+              << "    focus | focus-hold | focus-release" << std::endl
+              << "    trigger | trigger-no-delay | trigger-hold | trigger-release" << std::endl
+              << "    send CMD [BYTE]...       send a raw command with an optional payload (hex)" << std::endl
+              << "Options :" << std::endl
+              << "    --fake N                 use N simulated devices instead of USB" << std::endl
+              << "    --device SERIAL|ID       only use this device (may be repeated)" << std::endl;
+}
+
+struct NamedCommand {
+    const char* name;
+    uint8_t command;
+};
+
+const NamedCommand COMMANDS[] = {
+    {"focus", CMD_FOCUS},
+    {"focus-hold", CMD_FOCUS_HOLD},
+    {"focus-release", CMD_FOCUS_RELEASE},
+    {"trigger", CMD_TRIGGER},
+    {"trigger-no-delay", CMD_TRIGGER_NO_DELAY},
+    {"trigger-hold", CMD_TRIGGER_HOLD},
+    {"trigger-release", CMD_TRIGGER_RELEASE},
+};
+
+double us(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+// Print the result of a broadcast, with the completion time of each device relative to the first one
+int printResults(SilverController& controller, const std::vector<Result>& results) {
+    int errors = 0;
+    std::chrono::steady_clock::time_point first = results[0].tCompleted;
+    for (const Result& result : results) {
+        first = std::min(first, result.tCompleted);
+    }
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const DeviceInfo& info = controller.devices()[i];
+        std::cout << std::setw(8) << info.id << "  " << std::setw(10) << info.serial << "  ";
+        if (results[i].status < 0) {
+            std::cout << "error " << results[i].status << std::endl;
+            errors++;
+        } else {
+            std::cout << "ok  round-trip " << std::fixed << std::setprecision(0) << us(results[i].tCompleted - results[i].tSubmitted)
+                      << "us  skew +" << us(results[i].tCompleted - first) << "us" << std::endl;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char** argv) {
+    int nFake = -1;
+    std::vector<std::string> filter;
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--fake") == 0 && i + 1 < argc) {
+            nFake = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            filter.push_back(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (i >= argc) {
+        usage();
+        return 1;
+    }
+    std::string command = argv[i++];
+
+    Backend* backend = nullptr;
+    if (nFake >= 0) {
+        backend = new FakeBackend(nFake);
+    } else {
+        backend = new LibUSBBackend();
+    }
+
+    int r = 0;
+    {
+        SilverController controller(backend);
+        int n = controller.open(filter);
+        if (n < 0) {
+            std::cerr << "Unable to enumerate devices : error " << n << std::endl;
+            r = 1;
+        } else if (n == 0) {
+            std::cerr << "No device found" << std::endl;
+            r = 1;
+
+        } else if (command == "list") {
+            for (const DeviceInfo& info : controller.devices()) {
+                std::cout << std::setw(8) << info.id << "  " << info.serial << std::endl;
+            }
+
+        } else if (command == "state") {
+            std::vector<std::future<Result>> futures;
+            for (unsigned int d = 0; d < controller.devices().size(); d++) {
+                futures.push_back(controller.request(d, CMD_GET_GUI_STATE, GUI_STATE_SIZE));
+            }
+            for (unsigned int d = 0; d < futures.size(); d++) {
+                Result result = futures[d].get();
+                std::cout << std::setw(8) << controller.devices()[d].id << "  ";
+                if (result.status < 0) {
+                    std::cout << "error " << result.status;
+                    r = 1;
+                } else {
+                    for (uint8_t byte : result.data) {
+                        std::cout << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte) << std::setfill(' ') << std::dec;
+                    }
+                }
+                std::cout << std::endl;
+            }
+
+        } else if (command == "send") {
+            if (i >= argc) {
+                usage();
+                r = 1;
+            } else {
+                uint8_t cmd = strtoul(argv[i++], nullptr, 16);
+                std::vector<uint8_t> payload;
+                for (; i < argc; i++) {
+                    payload.push_back(strtoul(argv[i], nullptr, 16));
+                }
+                r = printResults(controller, controller.broadcast(cmd, payload.data(), payload.size())) > 0;
+            }
+
+        } else {
+            const NamedCommand* named = nullptr;
+            for (const NamedCommand& c : COMMANDS) {
+                if (command == c.name) {
+                    named = &c;
+                }
+            }
+            if (named == nullptr) {
+                usage();
+                r = 1;
+            } else {
+                r = printResults(controller, controller.broadcast(named->command)) > 0;
+            }
+        }
+    }
+
+    delete backend;
+    return r;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdlib.h>
+#include "SilverController.h"
+#include "FakeBackend.h"
+
+// Latency benchmark of SilverController against simulated devices : compares a trigger
+// broadcast to all the devices with sending the same command to one device after the other
+// Usage : silverctl_bench [N_DEVICES] [ITERATIONS] [LATENCY_US] [JITTER_US]
+
+using namespace Silver;
+
+double us(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+void printStats(const char* title, std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (double v : values) {
+        sum += v;
+    }
+    std::cout << std::setw(28) << std::left << title << std::right << std::fixed << std::setprecision(0)
+              << "  mean " << std::setw(7) << sum / values.size()
+              << "  p50 " << std::setw(7) << values[values.size() / 2]
+              << "  p99 " << std::setw(7) << values[values.size() * 99 / 100]
+              << "  max " << std::setw(7) << values.back() << "  (us)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int nDevices = argc > 1 ? atoi(argv[1]) : 12;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    unsigned int latency = argc > 3 ? atoi(argv[3]) : 500;
+    unsigned int jitter = argc > 4 ? atoi(argv[4]) : 100;
+    if (nDevices <= 0 || iterations <= 0) {
+        std::cerr << "Usage : silverctl_bench [N_DEVICES] [ITERATIONS] [LATENCY_US] [JITTER_US]" << std::endl;
+        return 1;
+    }
+
+    FakeBackend backend(nDevices, latency, jitter);
+    SilverController controller(&backend);
+    if (controller.open() != nDevices) {
+        std::cerr << "Unable to open the simulated devices" << std::endl;
+        return 1;
+    }
+    std::cout << nDevices << " devices, " << iterations << " iterations, latency " << latency << "us + jitter 0-" << jitter << "us" << std::endl;
+
+    // Broadcast : skew is the spread between the first and the last device acting on the command
+    std::vector<double> broadcastSkew;
+    std::vector<double> broadcastTotal;
+    int errors = 0;
+    for (int it = 0; it < iterations; it++) {
+        std::vector<Result> results = controller.broadcast(CMD_TRIGGER);
+        std::chrono::steady_clock::time_point first = results[0].tCompleted;
+        std::chrono::steady_clock::time_point last = results[0].tCompleted;
+        for (const Result& result : results) {
+            first = std::min(first, result.tCompleted);
+            last = std::max(last, result.tCompleted);
+            errors += result.status < 0;
+        }
+        broadcastSkew.push_back(us(last - first));
+        broadcastTotal.push_back(us(last - results[0].tSubmitted));
+    }
+
+    // Sequential : wait for each device before sending to the next, as a synchronous API does
+    std::vector<double> sequentialSkew;
+    std::vector<double> sequentialTotal;
+    for (int it = 0; it < iterations; it++) {
+        std::vector<Result> results;
+        for (int d = 0; d < nDevices; d++) {
+            results.push_back(controller.command(d, CMD_TRIGGER).get());
+            errors += results.back().status < 0;
+        }
+        sequentialSkew.push_back(us(results.back().tCompleted - results.front().tCompleted));
+        sequentialTotal.push_back(us(results.back().tCompleted - results.front().tSubmitted));
+    }
+
+    printStats("broadcast skew", broadcastSkew);
+    printStats("broadcast total", broadcastTotal);
+    printStats("sequential skew", sequentialSkew);
+    printStats("sequential total", sequentialTotal);
+
+    // Every simulated device must have received every command
+    for (int d = 0; d < nDevices; d++) {
+        if (backend.nCommands(d) != 2 * iterations) {
+            std::cerr << "Device " << d << " received " << backend.nCommands(d) << " commands instead of " << 2 * iterations << std::endl;
+            errors++;
+        }
+    }
+    if (errors > 0) {
+        std::cerr << errors << " errors" << std::endl;
+        return 1;
+    }
+    return 0;
+}
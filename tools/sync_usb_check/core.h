@@ -0,0 +1,18 @@
+#ifndef _CORE_H_
+#define _CORE_H_
+
+// Minimal replacement of libtungsten/sam4l/core.h : the time is set by the check, and the
+// interrupt handlers of the fake USB transport are called between the steps of the main loop
+namespace Core {
+
+    using Time = unsigned long long;
+
+    extern Time _time;
+    inline Time time() { return _time; }
+
+    inline void disableInterrupts() {}
+    inline void enableInterrupts() {}
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include <core.h>
+#include "sync_usb.h"
+
+// Host check of the records pushed by SyncUSB (sync_usb.h) on the interrupt IN endpoint, over a
+// fake USB transport : the main loop sends GUI updates, events and inputs at random, while the
+// host polls the endpoint and issues control requests at random times, connects and disconnects.
+// Every packet must hold whole records and fit in the endpoint, and the host must receive every
+// record in order, except those dropped while the queue was full, which are counted by
+// nOverflows(). Once the main loop stops sending, the queue must be drained : a record left
+// behind would mean that the IN interrupt was disabled with records pending. The updates fetched
+// with CMD_GET_GUI_UPDATE are checked the same way. The commands sent by the host must reach the
+// main loop in order, and a command must only be refused, with a stall, when the queue is full.
+
+namespace Core {
+    Time _time = 0;
+}
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%lld) at %llums\n", what, value, Core::_time);
+        }
+    }
+}
+
+// Fake transport, replacing libtungsten/sam4l/usb.cpp. The handlers of the firmware are called
+// from interrupt() and control(), standing for the USB interrupt, between two steps of the main loop.
+namespace USB {
+
+    void (*_connectedHandler)() = nullptr;
+    void (*_disconnectedHandler)() = nullptr;
+    int (*_controlHandler)(SetupPacket& lastSetupPacket, uint8_t* data, int size) = nullptr;
+    uint8_t* _bank = nullptr;
+    int (*_inHandler)(int) = nullptr;
+    bool _inInterrupt = false;
+    bool _bankBusy = false; // Filled by the IN handler, until the host polls it
+    int _bankSize = 0;
+    int _bankRecords = 0;
+    bool _bankLeftEnabled = false; // IN interrupt still enabled after the bank was filled
+    int _nEndpoints = 0;
+
+    void initDevice(uint16_t vendorId, uint16_t productId, uint16_t deviceRevision) {}
+    void setStringDescriptor(StringDescriptors descriptor, const char* string, int size) {}
+    void setConnectedHandler(void (*handler)()) { _connectedHandler = handler; }
+    void setDisconnectedHandler(void (*handler)()) { _disconnectedHandler = handler; }
+    void setControlHandler(int (*handler)(SetupPacket& lastSetupPacket, uint8_t* data, int size)) { _controlHandler = handler; }
+
+    Endpoint newEndpoint(EPType type, EPDir direction, EPBanks nBanks, EPSize size, uint8_t* bank0, uint8_t* bank1) {
+        check(type == EPType::INTERRUPT && direction == EPDir::IN && size == EPSize::SIZE64, "endpoint type", 0);
+        _bank = bank0;
+        return ++_nEndpoints;
+    }
+
+    void setEndpointHandler(Endpoint endpointNumber, EPHandlerType handlerType, int (*handler)(int)) {
+        check(endpointNumber == 1 && handlerType == EPHandlerType::IN, "endpoint handler", endpointNumber);
+        _inHandler = handler;
+    }
+
+    void enableINInterrupt(Endpoint endpointNumber) { _inInterrupt = true; }
+    void disableINInterrupt(Endpoint endpointNumber) { _inInterrupt = false; }
+
+    // The IN interrupt is raised as long as it is enabled and the bank is free
+    void interrupt() {
+        if (_inInterrupt && !_bankBusy && _inHandler != nullptr) {
+            _bankSize = _inHandler(0);
+            _bankBusy = true;
+            _bankLeftEnabled = _inInterrupt;
+            _bankRecords = 0;
+            for (int i = 0; i < _bankSize && _bank[i] > 0; i += _bank[i]) {
+                _bankRecords++;
+            }
+        }
+    }
+
+}
+
+// Records sent by the main loop and not received by the host yet
+std::deque<std::vector<uint8_t>> _expectedRecords;
+std::deque<std::vector<uint8_t>> _expectedUpdates;
+std::deque<std::vector<uint8_t>> _expectedCommands; // Sent by the host, not read by the main loop yet
+bool _connected = false;
+bool _hostPolling = false; // The host uses CMD_GET_GUI_UPDATE
+long _nPackets = 0;
+long _nRecords = 0;
+long _nUpdates = 0;
+long _nDropped = 0;
+long _nCommands = 0;
+long _nStalled = 0;
+int _maxPacketSize = 0;
+
+std::vector<uint8_t> record(uint8_t type, uint8_t command, const uint8_t* payload, int payloadSize) {
+    uint32_t t = Core::time();
+    std::vector<uint8_t> r(SyncUSB::RECORD_HEADER_SIZE + payloadSize);
+    r[0] = r.size();
+    r[1] = type;
+    r[2] = t >> 24;
+    r[3] = t >> 16;
+    r[4] = t >> 8;
+    r[5] = t;
+    r[6] = command;
+    memcpy(r.data() + SyncUSB::RECORD_HEADER_SIZE, payload, payloadSize);
+    return r;
+}
+
+// Records expected in the queue, not in the bank waiting for the host
+unsigned int queuedRecords() {
+    return _expectedRecords.size() - (USB::_bankBusy ? USB::_bankRecords : 0);
+}
+
+// A step of the main loop
+void send() {
+    unsigned int overflows = SyncUSB::nOverflows();
+    uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+    for (uint8_t& b : payload) {
+        b = rand();
+    }
+    int kind = rand() % 3;
+    std::vector<uint8_t> expected;
+    std::vector<uint8_t> update;
+    if (kind == 0) {
+        uint8_t command = rand() % 6;
+        int payloadSize = rand() % (Sync::MAX_PAYLOAD_SIZE + 1);
+        SyncUSB::send(command, payload, payloadSize);
+        expected = record(SyncUSB::RECORD_GUI_UPDATE, command, payload, payloadSize);
+        update.push_back(command);
+        update.insert(update.end(), payload, payload + payloadSize);
+    } else if (kind == 1) {
+        int rssi = -(rand() % 140);
+        uint32_t t = rand();
+        SyncUSB::sendEvent(Sync::CMD_TRIGGER, rssi, t);
+        uint8_t p[] = {static_cast<uint8_t>(rssi), static_cast<uint8_t>(t >> 24), static_cast<uint8_t>(t >> 16), static_cast<uint8_t>(t >> 8), static_cast<uint8_t>(t)};
+        expected = record(SyncUSB::RECORD_EVENT, Sync::CMD_TRIGGER, p, sizeof(p));
+    } else {
+        uint32_t t = rand();
+        uint32_t latency = rand() % 100000;
+        SyncUSB::sendInput(Sync::CMD_TRIGGER_NO_DELAY, t, latency);
+        uint8_t p[] = {static_cast<uint8_t>(t >> 24), static_cast<uint8_t>(t >> 16), static_cast<uint8_t>(t >> 8), static_cast<uint8_t>(t),
+            static_cast<uint8_t>(latency >> 24), static_cast<uint8_t>(latency >> 16), static_cast<uint8_t>(latency >> 8), static_cast<uint8_t>(latency)};
+        expected = record(SyncUSB::RECORD_INPUT, Sync::CMD_TRIGGER_NO_DELAY, p, sizeof(p));
+    }
+
+    // Nothing is queued while disconnected. Otherwise, each queue drops the item when it is full.
+    if (!_connected) {
+        check(SyncUSB::nOverflows() == overflows, "overflow while disconnected", SyncUSB::nOverflows());
+        return;
+    }
+    unsigned int nQueues = 1 + (kind == 0 && _hostPolling);
+    unsigned int dropped = SyncUSB::nOverflows() - overflows;
+    check(dropped <= nQueues, "overflows", dropped);
+    if (dropped == nQueues) {
+        _nDropped++;
+    } else {
+        // A GUI update goes into both queues : find out which one dropped it
+        bool recordQueued = dropped == 0 || queuedRecords() < SyncUSB::N_RECORDS;
+        if (recordQueued) {
+            _expectedRecords.push_back(expected);
+        }
+        if (kind == 0 && _hostPolling && (dropped == 0 || !recordQueued)) {
+            _expectedUpdates.push_back(update);
+        }
+    }
+    check(queuedRecords() <= SyncUSB::N_RECORDS, "records queued", queuedRecords());
+}
+
+// The host reads the bank of the endpoint, which must hold whole records
+void poll() {
+    bool filledNow = !USB::_bankBusy;
+    USB::interrupt();
+    if (!USB::_bankBusy) {
+        return;
+    }
+    USB::_bankBusy = false;
+    _nPackets++;
+    int size = USB::_bankSize;
+    check(size <= SyncUSB::EP_EVENTS_SIZE, "packet size", size);
+
+    // An empty packet is only sent once, when the queue was emptied by a disconnection
+    check(size > 0 || !USB::_bankLeftEnabled, "empty packets", size);
+    if (size > _maxPacketSize) {
+        _maxPacketSize = size;
+    }
+    int i = 0;
+    while (i < size) {
+        int recordSize = USB::_bank[i];
+        check(recordSize >= SyncUSB::RECORD_HEADER_SIZE && recordSize <= SyncUSB::RECORD_MAX_SIZE && i + recordSize <= size, "record size", recordSize);
+        if (recordSize < SyncUSB::RECORD_HEADER_SIZE || i + recordSize > size) {
+            break;
+        }
+        bool found = !_expectedRecords.empty() && _expectedRecords.front() == std::vector<uint8_t>(USB::_bank + i, USB::_bank + i + recordSize);
+        check(found, "record received out of order or corrupted", USB::_bank[i + 1]);
+        if (found) {
+            _expectedRecords.pop_front();
+        }
+        _nRecords++;
+        i += recordSize;
+    }
+
+    // The packet is only sent short if the next record doesn't fit
+    if (filledNow && !_expectedRecords.empty()) {
+        check(size + _expectedRecords.front()[0] > SyncUSB::EP_EVENTS_SIZE, "short packet", size);
+    }
+}
+
+// Control requests of the host
+void control(bool in, uint8_t request, const uint8_t* payload, int payloadSize) {
+    USB::SetupPacket setup = {};
+    setup.bRequest = request;
+    setup.direction = in ? USB::EPDir::IN : USB::EPDir::OUT;
+    setup.requestType = USB::SetupRequestType::VENDOR;
+    uint8_t data[512];
+    memcpy(data, payload, payloadSize);
+    unsigned int overflows = SyncUSB::nOverflows();
+    int n = USB::_controlHandler(setup, data, in ? sizeof(data) : payloadSize);
+
+    if (!in) {
+        // The command is refused and counted as an overflow only if the queue is full
+        bool full = _expectedCommands.size() >= SyncUSB::N_COMMANDS;
+        check(setup.handled == !full, "command stalled", _expectedCommands.size());
+        check(SyncUSB::nOverflows() - overflows == full, "command overflow", SyncUSB::nOverflows() - overflows);
+        if (setup.handled) {
+            std::vector<uint8_t> command(1 + payloadSize);
+            command[0] = request;
+            memcpy(command.data() + 1, payload, payloadSize);
+            _expectedCommands.push_back(command);
+        } else {
+            _nStalled++;
+        }
+        return;
+    }
+    check(setup.handled, "control request not handled", request);
+
+    if (in && request == Sync::CMD_GET_GUI_UPDATE) {
+        _hostPolling = true;
+        if (_expectedUpdates.empty()) {
+            check(n == 0, "unexpected update", n);
+        } else {
+            check(std::vector<uint8_t>(data, data + n) == _expectedUpdates.front(), "update", n);
+            _expectedUpdates.pop_front();
+            _nUpdates++;
+        }
+    }
+}
+
+// The host sends a command with a random payload
+void sendCommand() {
+    uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+    for (uint8_t& b : payload) {
+        b = rand();
+    }
+    control(false, rand() % 0x20, payload, rand() % (Sync::MAX_PAYLOAD_SIZE + 1));
+}
+
+// The main loop reads the pending commands, with or without their payload
+void receiveCommands() {
+    while (SyncUSB::commandAvailable()) {
+        check(!_expectedCommands.empty(), "unexpected command", 0);
+        if (_expectedCommands.empty()) {
+            SyncUSB::getCommand();
+            continue;
+        }
+        std::vector<uint8_t>& expected = _expectedCommands.front();
+        if (rand() % 2 == 0) {
+            uint8_t payload[Sync::MAX_PAYLOAD_SIZE];
+            uint8_t command = SyncUSB::getCommand();
+            int payloadSize = SyncUSB::getPayload(payload);
+            std::vector<uint8_t> received(1 + payloadSize);
+            received[0] = command;
+            memcpy(received.data() + 1, payload, payloadSize);
+            check(received == expected, "command received out of order or corrupted", command);
+        } else {
+            check(SyncUSB::getCommand() == expected[0], "command received out of order", expected[0]);
+        }
+        _expectedCommands.pop_front();
+        _nCommands++;
+    }
+    check(_expectedCommands.empty(), "commands left in the queue", _expectedCommands.size());
+}
+
+void connect(bool connected) {
+    _connected = connected;
+    _hostPolling = false;
+    _expectedRecords.clear();
+    _expectedUpdates.clear();
+    USB::_bankBusy = false;
+    if (connected) {
+        USB::_connectedHandler();
+    } else {
+        USB::_disconnectedHandler();
+    }
+}
+
+void drain() {
+    for (int i = 0; i < SyncUSB::N_RECORDS + 1; i++) {
+        poll();
+    }
+    check(_expectedRecords.empty(), "records left in the queue", _expectedRecords.size());
+    check(!USB::_inInterrupt, "IN interrupt left enabled", 0);
+    if (_hostPolling) {
+        for (int i = 0; i < SyncUSB::N_UPDATES + 1; i++) {
+            control(true, Sync::CMD_GET_GUI_UPDATE, nullptr, 0);
+        }
+        check(_expectedUpdates.empty(), "updates left in the queue", _expectedUpdates.size());
+    }
+}
+
+int main() {
+    srand(0);
+    SyncUSB::init();
+    check(USB::_bank != nullptr && USB::_inHandler != nullptr, "events endpoint", 0);
+
+    // Records sent while disconnected are dropped
+    send();
+    check(!USB::_inInterrupt, "IN interrupt while disconnected", 0);
+    connect(true);
+
+    for (long step = 0; step < 2000000; step++) {
+        Core::_time += rand() % 3;
+        int r = rand() % 1000;
+        if (r < 400) {
+            send();
+        } else if (r < 800) {
+            poll();
+        } else if (r < 900) {
+            if (_connected) {
+                control(true, Sync::CMD_GET_GUI_UPDATE, nullptr, 0);
+            }
+        } else if (r < 902) {
+            connect(!_connected);
+        } else if (r < 904) {
+            // Bursts fill the queue, then the host catches up
+            for (int i = 0; i < 3 * SyncUSB::N_RECORDS; i++) {
+                send();
+            }
+        } else if (r < 910) {
+            // Idle main loop : every record gets to the host
+            if (_connected) {
+                drain();
+            }
+        } else if (r < 920) {
+            USB::interrupt();
+        } else if (r < 960) {
+            if (_connected) {
+                sendCommand();
+            }
+        } else if (r < 980) {
+            receiveCommands();
+        }
+    }
+    if (!_connected) {
+        connect(true);
+    }
+    send();
+    drain();
+
+    receiveCommands();
+
+    printf("%ld packets (max %d bytes), %ld records, %ld updates, %ld records dropped, %ld commands (%ld stalled)\n",
+        _nPackets, _maxPacketSize, _nRecords, _nUpdates, _nDropped, _nCommands, _nStalled);
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks\n", _nChecks);
+    return 0;
+}
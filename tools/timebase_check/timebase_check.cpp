@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ast.h>
+#include "timestamp.h"
+
+// Host check of the timebase conversions : the AST tick conversions (libtungsten/sam4l/ast.h)
+// and the high-resolution timestamps (timestamp.h), compared with exact 128-bit arithmetic,
+// including the extension of the 16-bit TC counter and the wrap-around of the 32-bit
+// microsecond times sent over USB.
+
+using u128 = unsigned __int128;
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, unsigned long long value) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (%llu)\n", what, value);
+        }
+    }
+}
+
+uint64_t random64() {
+    return (uint64_t)rand() << 62 ^ (uint64_t)rand() << 31 ^ (uint64_t)rand();
+}
+
+void checkTicks(uint64_t ms, uint64_t us, AST::Ticks ticks) {
+    const u128 TPS = AST::TICKS_PER_SECOND;
+
+    // Exact conversions, rounded down from ticks and up to ticks
+    check(AST::ticksToMs(ticks) == (u128)ticks * 1000 / TPS, "ticksToMs", ticks);
+    check(AST::ticksToUs(ticks) == (u128)ticks * 1000000 / TPS, "ticksToUs", ticks);
+    check(AST::msToTicks(ms) == ((u128)ms * TPS + 999) / 1000, "msToTicks", ms);
+    check(AST::usToTicks(us) == ((u128)us * TPS + 999999) / 1000000, "usToTicks", us);
+
+    // A delay converted to ticks is never shorter than requested, and by less than a tick
+    check((u128)AST::msToTicks(ms) * 1000 >= (u128)ms * TPS, "msToTicks too short", ms);
+    check((u128)(AST::msToTicks(ms) - (ms > 0 ? 1 : 0)) * 1000 < (u128)ms * TPS || ms == 0, "msToTicks too long", ms);
+    check((u128)AST::usToTicks(us) * 1000000 >= (u128)us * TPS, "usToTicks too short", us);
+
+    // Round trips
+    check(AST::ticksToMs(AST::msToTicks(ms)) == ms, "ms round trip", ms);
+    check(AST::msToTicks(AST::ticksToMs(ticks)) <= ticks, "ticks round trip", ticks);
+}
+
+int main() {
+    const int N_STEPS = 1000000;
+    const unsigned long FREQUENCIES[] = {1500000, 12000000 / 32, 48000000 / 8, 32768, 1000000, 7};
+
+    // Tick conversions, on the whole range of a running system (up to several years) and
+    // around small values where the rounding matters most
+    for (uint64_t i = 0; i < 100000; i++) {
+        checkTicks(i, i, i);
+    }
+    for (int step = 0; step < N_STEPS; step++) {
+        uint64_t ms = random64() % (1ULL << 40);
+        uint64_t us = random64() % (1ULL << 44);
+        AST::Ticks ticks = random64() % (1ULL << 44);
+        checkTicks(ms, us, ticks);
+    }
+
+    // Counts to microseconds, for every count whose result fits in 64 bits (the product with
+    // 1000000 alone would overflow after ~5 hours at 1.5MHz)
+    for (unsigned long f : FREQUENCIES) {
+        const u128 maxCounts = ((u128)1 << 64) * f / 1000000;
+        for (int step = 0; step < N_STEPS; step++) {
+            Timestamp::Counts counts = step < N_STEPS / 2 ? random64() : random64() % (1ULL << 40);
+            if (counts < maxCounts) {
+                check(Timestamp::toMicroseconds(counts, f) == (u128)counts * 1000000 / f, "toMicroseconds", counts);
+            }
+        }
+    }
+    check(Timestamp::toMicroseconds(~0ULL, 1500000) == (u128)~0ULL * 1000000 / 1500000, "toMicroseconds max", 0);
+
+    // Extension of the 16-bit counter : the overflow interrupt is served with some latency after
+    // the counter has wrapped around, during which it is pending and not yet counted. The counts
+    // must stay monotonic and exact whatever the latency, up to half a counter period.
+    const uint32_t LATENCIES[] = {0, 1, 20, 1000, Timestamp::COUNTER_MAX / 2};
+    for (Timestamp::Counts t = 0; t < 64 * (Timestamp::COUNTER_MAX + 1ULL); t++) {
+        uint16_t value = t & Timestamp::COUNTER_MAX;
+        uint32_t wraps = t >> Timestamp::COUNTER_BITS;
+        for (uint32_t latency : LATENCIES) {
+            bool pending = wraps > 0 && value < latency;
+            uint32_t overflows = pending ? wraps - 1 : wraps;
+            check(Timestamp::extend(overflows, value, pending) == t, "extend", t);
+        }
+    }
+
+    // A value read just before the overflow, with the interrupt already pending when it is checked
+    check(Timestamp::extend(3, Timestamp::COUNTER_MAX, true) == 4ULL * (Timestamp::COUNTER_MAX + 1) - 1, "extend before overflow", 3);
+
+    // Elapsed times across the wrap-around of the 32-bit microsecond times
+    for (int step = 0; step < N_STEPS; step++) {
+        uint64_t from = random64() % (1ULL << 48);
+        uint64_t elapsed = random64() % (1ULL << 32);
+        uint64_t to = from + elapsed;
+        check(Timestamp::elapsedMicroseconds((uint32_t)from, (uint32_t)to) == elapsed, "elapsedMicroseconds", from);
+    }
+    check(Timestamp::elapsedMicroseconds(0xFFFFFF00, 0x00000100) == 0x200, "elapsedMicroseconds wrap", 0);
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %d ticks per second\n", _nChecks, (int)AST::TICKS_PER_SECOND);
+    return 0;
+}
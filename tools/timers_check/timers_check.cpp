@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <TimerList.h>
+
+// Host check of the timer list used by the Timers module (libtungsten/utils/TimerList.h) with a
+// virtual clock : random timers are started and cancelled, the clock jumps to the alarm which the
+// module would program (the earliest deadline), and the timers which expire are compared, in
+// order and in time, with a naive model which sorts every running timer at each step.
+
+const int N_TIMERS = 16;
+const int N_HANDLERS = 64;
+using List = TimerList<N_TIMERS>;
+using Time = List::Time;
+
+int _nChecks = 0;
+int _nFailures = 0;
+
+void check(bool condition, const char* what, long long step) {
+    _nChecks++;
+    if (!condition) {
+        _nFailures++;
+        if (_nFailures <= 20) {
+            fprintf(stderr, "FAIL : %s (step %lld)\n", what, step);
+        }
+    }
+}
+
+// Each running timer has its own handler, which records that it was called
+int _called = -1;
+template<int N>
+void handler() {
+    _called = N;
+}
+
+template<int N>
+struct Handlers {
+    static void fill(List::Handler* handlers) {
+        Handlers<N - 1>::fill(handlers);
+        handlers[N - 1] = handler<N - 1>;
+    }
+};
+
+template<>
+struct Handlers<0> {
+    static void fill(List::Handler* handlers) {}
+};
+
+struct Model {
+    int handle;
+    Time deadline;
+    Time period;
+    int handler;
+    unsigned long order; // Timers with the same deadline expire in this order
+};
+
+int main() {
+    srand(0);
+    List::Handler handlers[N_HANDLERS];
+    Handlers<N_HANDLERS>::fill(handlers);
+    bool handlerUsed[N_HANDLERS] = {};
+
+    List list;
+    std::vector<Model> model;
+    std::vector<int> staleHandles;
+    unsigned long order = 0;
+    Time now = 0;
+    long long nExpired = 0;
+    long long nPeriodic = 0;
+    const long long N_STEPS = 2000000;
+
+    for (long long step = 0; step < N_STEPS; step++) {
+        int action = rand() % 8;
+
+        if (action < 3) {
+            // Start a timer, sometimes on an existing deadline to check the order of ties
+            Time deadline = now + (rand() % 4 == 0 ? 0 : rand() % 2000);
+            if (!model.empty() && rand() % 4 == 0) {
+                deadline = model[rand() % model.size()].deadline;
+            }
+            Time period = rand() % 3 == 0 ? 1 + rand() % 500 : 0;
+            int h = rand() % N_HANDLERS;
+            while (handlerUsed[h]) {
+                h = (h + 1) % N_HANDLERS;
+            }
+            int handle = list.add(deadline, period, handlers[h]);
+            if (model.size() == N_TIMERS) {
+                check(handle == List::INVALID, "timer started while the list is full", step);
+            } else {
+                check(handle != List::INVALID, "timer not started", step);
+                handlerUsed[h] = true;
+                model.push_back({handle, deadline, period, h, order++});
+            }
+
+        } else if (action == 3) {
+            // Cancel a running timer, or try with a stale handle
+            if (!model.empty() && rand() % 4 != 0) {
+                int i = rand() % model.size();
+                check(list.cancel(model[i].handle), "running timer not cancelled", step);
+                check(!list.isRunning(model[i].handle), "cancelled timer still running", step);
+                handlerUsed[model[i].handler] = false;
+                staleHandles.push_back(model[i].handle);
+                model.erase(model.begin() + i);
+            } else if (!staleHandles.empty()) {
+                int handle = staleHandles[rand() % staleHandles.size()];
+                check(!list.cancel(handle), "stale handle cancelled a timer", step);
+                check(!list.isRunning(handle), "stale handle running", step);
+            }
+
+        } else {
+            // Advance the clock, but not beyond the alarm programmed for the earliest deadline
+            Time target = now + rand() % 1000;
+            if (!list.isEmpty()) {
+                check(!model.empty(), "timers running in the list only", step);
+                Time earliest = model.empty() ? 0 : model[0].deadline;
+                for (const Model& m : model) {
+                    earliest = std::min(earliest, m.deadline);
+                }
+                check(list.next() == earliest, "alarm not on the earliest deadline", step);
+                if (list.next() < target) {
+                    target = std::max(list.next(), now);
+                }
+            }
+            now = target;
+
+            // Expire the timers one by one, as the alarm handler does
+            while (1) {
+                List::Handler h = nullptr;
+                bool expired = list.expire(now, h);
+
+                // Expected : the earliest deadline, then the lowest order
+                int first = -1;
+                for (unsigned int i = 0; i < model.size(); i++) {
+                    if (model[i].deadline <= now && (first < 0 || model[i].deadline < model[first].deadline
+                            || (model[i].deadline == model[first].deadline && model[i].order < model[first].order))) {
+                        first = i;
+                    }
+                }
+                check(expired == (first >= 0), "expired timers", step);
+                if (!expired || first < 0) {
+                    break;
+                }
+                Model& m = model[first];
+                check(m.deadline == now, "timer expired late", step);
+                _called = -1;
+                h();
+                check(_called == m.handler, "wrong timer expired", step);
+                nExpired++;
+                if (m.period > 0) {
+                    nPeriodic++;
+                    m.deadline += ((now - m.deadline) / m.period + 1) * m.period;
+                    m.order = order++;
+                    check(list.isRunning(m.handle), "periodic timer stopped", step);
+                } else {
+                    check(!list.isRunning(m.handle), "one-shot timer still running", step);
+                    handlerUsed[m.handler] = false;
+                    staleHandles.push_back(m.handle);
+                    model.erase(model.begin() + first);
+                }
+            }
+        }
+
+        check(list.size() == model.size(), "number of timers", step);
+        if (staleHandles.size() > 1000) {
+            staleHandles.erase(staleHandles.begin(), staleHandles.begin() + 500);
+        }
+    }
+
+    // Periodic timers skip the periods missed while the alarm was late
+    List late;
+    late.add(100, 10, handlers[0]);
+    List::Handler h = nullptr;
+    check(late.expire(155, h), "late periodic timer", N_STEPS);
+    check(late.next() == 160, "missed periods not skipped", N_STEPS);
+    check(!late.expire(155, h), "late periodic timer expired twice", N_STEPS);
+
+    if (_nFailures > 0) {
+        printf("FAIL %d/%d checks\n", _nFailures, _nChecks);
+        return 1;
+    }
+    printf("ok   %d checks, %lld steps, %lld timers expired (%lld periodic)\n", _nChecks, N_STEPS, nExpired, nPeriodic);
+    return 0;
+}
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+# Upload a firmware to a Silver module through its USB bootloader, using the binary page protocol
+# Usage : upload.py [--full] [--no-compress] FIRMWARE.hex|FIRMWARE.bin
+#   --full         send every page, instead of only those which differ from the firmware currently in flash
+#   --no-compress  send the pages as is, instead of compressing each run of consecutive pages
+# The module must already be in bootloader mode (hold the bootloader button when powering it on).
+
+import struct
+import sys
+import time
+import zlib
+
+USB_VENDOR_ID = 0x03eb
+USB_PRODUCT_ID = 0xcbd0
+
+# Must match libtungsten/bootloader/bootloader.cpp
+REQ_CONNECT = 0x01
+REQ_GET_STATUS = 0x02
+REQ_WRITE_PAGE = 0x05
+REQ_FINISH = 0x06
+REQ_GET_PAGE_HASHES = 0x07
+REQ_WRITE_COMPRESSED = 0x08
+MAX_HASHES_PER_REQUEST = 128
+STATUS_READY = 0
+STATUS_BUSY = 1
+STATUS_ERROR = 2
+STATUS_DONE = 3
+ERRORS = ["NONE", "CHECKSUM_MISMATCH", "PROTECTED_AREA", "UNKNOWN_RECORD_TYPE", "OVERFLOW", "IMAGE_CRC_MISMATCH", "SEQUENCE", "INCOMPLETE_IMAGE"]
+BOOTLOADER_N_FLASH_PAGES = 32
+PAGE_SIZE = 512
+IMAGE_BASE = BOOTLOADER_N_FLASH_PAGES * PAGE_SIZE
+N_BUFFERS = 2
+COMPRESSED_CHUNK_SIZE = 512
+
+# Must match libtungsten/bootloader/lz.h
+LZ_WINDOW_SIZE = 2048
+LZ_MIN_MATCH = 3
+LZ_MAX_MATCH = LZ_MIN_MATCH + 31
+LZ_MAX_CHAIN = 64
+TIMEOUT = 5000 # ms
+
+
+def load_image(filename):
+    # Return the bytes to write from IMAGE_BASE, unused bytes being 0xFF
+    with open(filename, "rb") as f:
+        content = f.read()
+    if not filename.endswith(".hex"):
+        return bytearray(content)
+    image = bytearray()
+    extended = 0
+    for line in content.decode("ascii").splitlines():
+        line = line.strip()
+        if not line.startswith(":"):
+            continue
+        record = bytes.fromhex(line[1:])
+        n_bytes, address, record_type = record[0], struct.unpack(">H", record[1:3])[0], record[3]
+        if sum(record) & 0xFF != 0:
+            raise ValueError("checksum mismatch in line %r" % line)
+        if record_type == 0x00:
+            address += extended
+            if address < IMAGE_BASE:
+                raise ValueError("the firmware overlaps the bootloader, was it linked for the bootloader?")
+            address -= IMAGE_BASE
+            if len(image) < address + n_bytes:
+                image.extend(b"\xff" * (address + n_bytes - len(image)))
+            image[address:address + n_bytes] = record[4:4 + n_bytes]
+        elif record_type == 0x02:
+            extended = struct.unpack(">H", record[4:6])[0] << 4
+        elif record_type == 0x04:
+            extended = struct.unpack(">H", record[4:6])[0] << 16
+    return image
+
+
+def page_hash(page):
+    # Must match Upload::pageHash() : 32-bit FNV-1a over the little-endian words of the page
+    h = 0x811C9DC5
+    for word in struct.unpack("<%dI" % (len(page) // 4), page):
+        h = ((h ^ word) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def pages_of(image):
+    image = bytes(image) + b"\xff" * (-len(image) % PAGE_SIZE)
+    return [image[i:i + PAGE_SIZE] for i in range(0, len(image), PAGE_SIZE)]
+
+
+def compress(data):
+    # Greedy matching with hash chains, like tools/bootloader_sim/lz_compress.cpp
+    output = bytearray()
+    head = {}
+    prev = [-1] * len(data)
+    flags_pos = 0
+    n_items = 8
+
+    def insert(pos):
+        if pos + LZ_MIN_MATCH <= len(data):
+            key = data[pos:pos + LZ_MIN_MATCH]
+            prev[pos] = head.get(key, -1)
+            head[key] = pos
+
+    pos = 0
+    while pos < len(data):
+        if n_items == 8:
+            flags_pos = len(output)
+            output.append(0)
+            n_items = 0
+
+        # Look for the longest match in the window
+        best_length = 0
+        best_offset = 0
+        max_length = min(len(data) - pos, LZ_MAX_MATCH)
+        if max_length >= LZ_MIN_MATCH:
+            candidate = head.get(data[pos:pos + LZ_MIN_MATCH], -1)
+            chain = 0
+            while candidate >= 0 and pos - candidate <= LZ_WINDOW_SIZE and chain < LZ_MAX_CHAIN:
+                length = 0
+                while length < max_length and data[candidate + length] == data[pos + length]:
+                    length += 1
+                if length > best_length:
+                    best_length, best_offset = length, pos - candidate
+                    if length == max_length:
+                        break
+                candidate = prev[candidate]
+                chain += 1
+
+        if best_length >= LZ_MIN_MATCH:
+            output[flags_pos] |= 1 << n_items
+            output.append((best_offset - 1) & 0xFF)
+            output.append(((best_offset - 1) >> 8) << 5 | (best_length - LZ_MIN_MATCH))
+            for i in range(best_length):
+                insert(pos + i)
+            pos += best_length
+        else:
+            output.append(data[pos])
+            insert(pos)
+            pos += 1
+        n_items += 1
+    return bytes(output)
+
+
+def runs_of(indexes):
+    # Split a sorted list of page indexes into runs of consecutive pages
+    runs = []
+    for i in indexes:
+        if runs and runs[-1][-1] == i - 1:
+            runs[-1].append(i)
+        else:
+            runs.append([i])
+    return runs
+
+
+class Bootloader:
+    def __init__(self):
+        import usb.core
+        self.usb = usb.core
+        self.dev = usb.core.find(idVendor=USB_VENDOR_ID, idProduct=USB_PRODUCT_ID)
+        if self.dev is None:
+            raise IOError("device not found")
+
+    def out(self, request, value=0, data=None, index=0):
+        return self.dev.ctrl_transfer(0 << 7 | 2 << 5, request, value, index, data, TIMEOUT)
+
+    def status(self):
+        # Return the status, the number of free page buffers and whether a compressed chunk can be sent
+        status, free, error, chunk_free = bytes(self.dev.ctrl_transfer(1 << 7 | 2 << 5, REQ_GET_STATUS, 0, 0, 4, TIMEOUT))
+        if status == STATUS_ERROR:
+            raise IOError("bootloader error : %s" % (ERRORS[error] if error < len(ERRORS) else error))
+        return status, free, chunk_free
+
+    def page_hashes(self, n_pages):
+        hashes = []
+        while len(hashes) < n_pages:
+            n = min(MAX_HASHES_PER_REQUEST, n_pages - len(hashes))
+            data = bytes(self.dev.ctrl_transfer(1 << 7 | 2 << 5, REQ_GET_PAGE_HASHES, BOOTLOADER_N_FLASH_PAGES + len(hashes), 0, 4 * n, TIMEOUT))
+            hashes.extend(struct.unpack(">%dI" % n, data))
+        return hashes
+
+    def send_pages(self, pages, indexes):
+        credits = 0
+        for i in indexes:
+            while True:
+                # Only send a page when the bootloader has a free buffer for it
+                while credits == 0:
+                    _, credits, _ = self.status()
+                try:
+                    self.out(REQ_WRITE_PAGE, BOOTLOADER_N_FLASH_PAGES + i, pages[i])
+                    credits -= 1
+                    break
+                except self.usb.USBError:
+                    # STALL : no free buffer after all
+                    credits = 0
+
+    def send_compressed(self, first_page, stream):
+        for chunk in range(0, (len(stream) + COMPRESSED_CHUNK_SIZE - 1) // COMPRESSED_CHUNK_SIZE):
+            data = stream[chunk * COMPRESSED_CHUNK_SIZE:(chunk + 1) * COMPRESSED_CHUNK_SIZE]
+            while True:
+                # Only send a chunk when the previous one has been decompressed
+                while not self.status()[2]:
+                    pass
+                try:
+                    self.out(REQ_WRITE_COMPRESSED, BOOTLOADER_N_FLASH_PAGES + first_page, data, chunk)
+                    break
+                except self.usb.USBError:
+                    # STALL : the previous stream isn't completely queued yet
+                    pass
+
+    def upload(self, pages, full=False, compressed=True, progress=None):
+        # Return the number of pages and the number of bytes actually sent
+        self.out(REQ_CONNECT)
+        to_send = list(range(len(pages)))
+        if not full:
+            hashes = self.page_hashes(len(pages))
+            to_send = [i for i in to_send if hashes[i] != page_hash(pages[i])]
+        n_sent = 0
+        n_bytes = 0
+        for run in runs_of(to_send):
+            data = b"".join(pages[i] for i in run)
+            stream = compress(data) if compressed else data
+            if len(stream) < len(data):
+                self.send_compressed(run[0], stream)
+            else:
+                self.send_pages(pages, run)
+            n_sent += len(run)
+            n_bytes += min(len(stream), len(data))
+            if progress:
+                progress(n_sent, len(to_send))
+
+        # Ask the bootloader to check the CRC of the written pages
+        crc = zlib.crc32(b"".join(pages)) & 0xFFFFFFFF
+        self.out(REQ_FINISH, 0, struct.pack(">HHI", BOOTLOADER_N_FLASH_PAGES, len(pages), crc))
+        while True:
+            status, _, _ = self.status()
+            if status == STATUS_DONE:
+                return n_sent, n_bytes
+            time.sleep(0.01)
+
+
+def main():
+    args = sys.argv[1:]
+    full = "--full" in args
+    compressed = "--no-compress" not in args
+    args = [a for a in args if a not in ("--full", "--no-compress")]
+    if len(args) != 1:
+        print("Usage : upload.py [--full] [--no-compress] FIRMWARE.hex|FIRMWARE.bin", file=sys.stderr)
+        sys.exit(1)
+    pages = pages_of(load_image(args[0]))
+    t = time.time()
+
+    def progress(n, total):
+        sys.stdout.write("\rUploading : %d/%d pages" % (n, total))
+        sys.stdout.flush()
+
+    n_sent, n_bytes = Bootloader().upload(pages, full, compressed, progress)
+    dt = time.time() - t
+    print("\nDone : %d/%d pages sent (%d bytes) in %.2fs" % (n_sent, len(pages), n_bytes, dt))
+
+
+if __name__ == "__main__":
+    main()
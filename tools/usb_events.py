@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# Print the updates pushed by a Silver module on its interrupt IN endpoint, as they arrive
+# Usage : usb_events.py [--raw FILE]
+#   --raw FILE  decode packets previously saved to FILE (each prefixed by its size on one byte)
+
+import struct
+import sys
+
+USB_VENDOR_ID = 0x03eb
+USB_PRODUCT_ID = 0xcbd0
+EP_EVENTS = 0x81
+EP_EVENTS_SIZE = 64
+
+# Must match sync_usb.h
+RECORD_GUI_UPDATE = 0x01
+RECORD_EVENT = 0x02
+RECORD_INPUT = 0x03
+RECORD_HEADER_SIZE = 7
+RECORD_TYPES = {RECORD_GUI_UPDATE: "GUI_UPDATE", RECORD_EVENT: "EVENT", RECORD_INPUT: "INPUT"}
+
+# Must match sync.h
+COMMANDS = {
+    0x90: "FOCUS",
+    0x91: "FOCUS_HOLD",
+    0x92: "FOCUS_RELEASE",
+    0x93: "TRIGGER",
+    0x94: "TRIGGER_NO_DELAY",
+    0x95: "TRIGGER_HOLD",
+    0x96: "TRIGGER_RELEASE",
+}
+
+
+def decode_packet(packet):
+    # A packet contains one or more whole records
+    offset = 0
+    while offset + RECORD_HEADER_SIZE <= len(packet):
+        size, type, time, command = struct.unpack_from(">BBIB", packet, offset)
+        if size < RECORD_HEADER_SIZE or offset + size > len(packet):
+            raise ValueError("malformed record at offset %d" % offset)
+        payload = bytes(packet[offset + RECORD_HEADER_SIZE:offset + size])
+        record = {
+            "type": RECORD_TYPES.get(type, type),
+            "time": time,
+            "command": command,
+            "payload": payload,
+        }
+        if type == RECORD_EVENT and len(payload) >= 1:
+            record["rssi"], = struct.unpack_from(">b", payload)
+        if type == RECORD_EVENT and len(payload) >= 5:
+            record["rx_us"], = struct.unpack_from(">I", payload, 1)
+        if type == RECORD_INPUT and len(payload) >= 8:
+            record["edge_us"], record["latency_us"] = struct.unpack_from(">II", payload)
+        yield record
+        offset += size
+
+
+def packets_from_device():
+    import usb.core
+    dev = usb.core.find(idVendor=USB_VENDOR_ID, idProduct=USB_PRODUCT_ID)
+    if dev is None:
+        raise IOError("device not found")
+    while True:
+        try:
+            yield bytes(dev.read(EP_EVENTS, EP_EVENTS_SIZE, timeout=1000))
+        except usb.core.USBTimeoutError:
+            pass
+
+
+def packets_from_file(filename):
+    with open(filename, "rb") as f:
+        data = f.read()
+    offset = 0
+    while offset < len(data):
+        size = data[offset]
+        yield data[offset + 1:offset + 1 + size]
+        offset += 1 + size
+
+
+def main():
+    args = sys.argv[1:]
+    if "--raw" in args:
+        packets = packets_from_file(args[args.index("--raw") + 1])
+    else:
+        packets = packets_from_device()
+    for packet in packets:
+        for r in decode_packet(packet):
+            command = COMMANDS.get(r["command"], "0x%02x" % r["command"])
+            if r["type"] == "EVENT":
+                print("%10d ms  EVENT       %-16s rssi=%ddBm rx=%dus" % (r["time"], command, r.get("rssi", 0), r.get("rx_us", 0)))
+            elif r["type"] == "INPUT":
+                print("%10d ms  INPUT       %-16s edge=%dus latency=%dus" % (r["time"], command, r.get("edge_us", 0), r.get("latency_us", 0)))
+            else:
+                print("%10d ms  GUI_UPDATE  %-16s %s" % (r["time"], command, r["payload"].hex()))
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()